@@ -0,0 +1,107 @@
+/**************************************************************************************************
+* Filename:   agg_bench.cpp
+* Details:    Rows/sec of GROUP BY aggregation: done by the caller over "scan_next()", and done in
+*             the engine by "aggregate()" with few groups, many groups, and many groups spilled
+*             to temp pages under a small memory budget.
+*             Usage: ./<executable> [num_rows]
+**************************************************************************************************/
+
+/****************************************** HEADER FILES *****************************************/
+
+#include "bench_util.h"
+#include "../table_mgr/aggregate.h"
+
+#include <unordered_map>
+
+/************************************** BENCH IMPLEMENTATION *************************************/
+
+/* Order-independent digest of a result: the sum of every group's COUNT and SUM */
+static int64_t digest(const Table::agg_result_t &result, size_t ngroup)
+{
+	int64_t total = 0;
+	for(const Table::row_t &row : result.rows)
+		total += row[ngroup].i + (int64_t)row[ngroup + 1].d * 3;
+	return total;
+}
+
+int main(int argc, char* argv[])
+{
+	size_t num_rows = argc > 1 ? atol(argv[1]) : 100000;
+	const char db_name[] = "bench_db.dat";
+	uint16_t npages = std::min<size_t>(8000, num_rows / 25 + num_rows / 100 + 200); // the table, then room to spill
+
+	/* Keep the table in the pool, so only aggregation is measured */
+	Bench::fresh_db(db_name, npages, npages);
+	std::fstream dbfile(db_name, std::ios::in | std::ios::out | std::ios::binary);
+	Table::create_table(dbfile, "sales", {{"region", Table::TBL_TYPE_VCHAR, 12}, {"item", Table::TBL_TYPE_INT, 1},
+	                                      {"qty", Table::TBL_TYPE_SHORT, 1}});
+
+	std::vector<std::string> regions;
+	for(int r = 0; r < 50; r++)
+		regions.push_back("region-" + std::to_string(r));
+	std::vector<Table::row_t> rows;
+	for(size_t i = 0; i < num_rows; i++)
+	{
+		const std::string &region = regions[(i * 7919) % regions.size()];
+		rows.push_back({Page::val_str(region), Page::val_int((i * 104729) % (num_rows / 10 + 1)), Page::val_short(i % 100)});
+	}
+	Table::insert_stmt_t stmt;
+	Table::prepare_insert(dbfile, "sales", {"region", "item", "qty"}, stmt);
+	Table::insert_rows(dbfile, stmt, rows);
+
+	std::vector<Table::agg_spec_t> aggs = {{Table::AGG_COUNT, ""}, {Table::AGG_SUM, "qty"}, {Table::AGG_MIN, "qty"}, {Table::AGG_MAX, "qty"}};
+	bool ok = true;
+
+	/************************************ IN THE CALLER *************************************/
+
+	struct partial_t { int64_t count = 0, sum = 0; int16_t min = INT16_MAX, max = INT16_MIN; };
+	std::unordered_map<std::string, partial_t> groups;
+	Table::scan_cursor_t cur;
+	Table::row_t row;
+	Table::RID rid;
+	double start = Bench::now_sec();
+	Table::scan_open(dbfile, "sales", {}, {"region", "qty"}, cur);
+	while(Table::scan_next(cur, row, rid))
+	{
+		partial_t &p = groups[std::string(row[0].str.ptr, row[0].str.len)];
+		p.count++;
+		p.sum += row[1].s;
+		p.min = std::min(p.min, row[1].s);
+		p.max = std::max(p.max, row[1].s);
+	}
+	Bench::report("agg", "caller_scan_region", num_rows, Bench::now_sec() - start);
+	int64_t expected = 0;
+	for(const auto &g : groups)
+		expected += g.second.count + g.second.sum * 3;
+
+	/************************************** IN THE ENGINE ***********************************/
+
+	Table::agg_result_t result;
+	start = Bench::now_sec();
+	Table::aggregate(dbfile, "sales", {}, {"region"}, aggs, result);
+	Bench::report("agg", "engine_region", num_rows, Bench::now_sec() - start);
+	ok &= result.rows.size() == groups.size() && digest(result, 1) == expected;
+
+	start = Bench::now_sec();
+	size_t num_groups = Table::aggregate(dbfile, "sales", {}, {"item"}, aggs, result);
+	Bench::report("agg", "engine_item", num_rows, Bench::now_sec() - start);
+	int64_t item_digest = digest(result, 1);
+	ok &= item_digest == expected;
+
+	/* A budget of a few hundred KB makes the workers spill several times */
+	start = Bench::now_sec();
+	ok &= Table::aggregate(dbfile, "sales", {}, {"item"}, aggs, result, 1, 256 * 1024) == num_groups;
+	Bench::report("agg", "engine_item_spill", num_rows, Bench::now_sec() - start);
+	ok &= digest(result, 1) == item_digest;
+
+	Buffer_mgr::shutdown(dbfile);
+	dbfile.close();
+	remove(db_name);
+
+	if(!ok)
+	{
+		std::cerr << "aggregation results do not match" << std::endl;
+		return 1;
+	}
+	return 0;
+}
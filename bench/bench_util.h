@@ -0,0 +1,72 @@
+/**************************************************************************************************
+* Filename:   bench_util.h
+* Details:    Timing and result reporting shared by the benchmark programs. Each result is printed
+*             as one JSON object per line so runs can be collected and compared.
+**************************************************************************************************/
+
+/********************************************* GUARD *********************************************/
+
+#ifndef BENCH_UTIL_H
+#define BENCH_UTIL_H
+
+/***************************************** HEADER FILES ******************************************/
+
+#include "../paging/paging.h"
+#include "../paging/io_stats.h"
+#include "../buffer_mgr/buffer_mgr.h"
+#include "../table_mgr/table_mgr.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/************************************** BENCHMARK HELPERS ****************************************/
+
+namespace Bench
+{
+  /* Seconds on a monotonic clock */
+  inline double now_sec()
+  {
+    using namespace std::chrono;
+    return duration_cast<duration<double>>(steady_clock::now().time_since_epoch()).count();
+  }
+
+  /* Print one result line: {"bench": ..., "case": ..., "ops": ..., "seconds": ..., "ops_per_sec": ...} */
+  inline void report(const std::string &bench, const std::string &which, uint64_t ops, double secs)
+  {
+    printf("{\"bench\": \"%s\", \"case\": \"%s\", \"ops\": %llu, \"seconds\": %.6f, \"ops_per_sec\": %.1f}\n",
+           bench.c_str(), which.c_str(), (unsigned long long)ops, secs, secs > 0 ? ops / secs : 0.0);
+    fflush(stdout);
+  }
+
+  /* Print the buffer pool and file IO recorded since the last call (or since the start) as one line:
+     {"bench": ..., "case": ..., "io": {...}} ; see "io_stats.h" */
+  inline void report_io(const std::string &bench, const std::string &which)
+  {
+    printf("{\"bench\": \"%s\", \"case\": \"%s\", \"io\": %s}\n", bench.c_str(), which.c_str(),
+           Io_stats::io_stats_json(Io_stats::io_stats()).c_str());
+    fflush(stdout);
+    Io_stats::io_reset_stats();
+  }
+
+  /* Format a fresh DB file with the buffer pool (re)initialized to <pool_sz> pages */
+  inline void fresh_db(const char fname[], uint16_t npages, uint16_t pool_sz)
+  {
+    Buffer_mgr::initialize(pool_sz);
+    Table::tbl_format(fname, npages);
+  }
+
+  /* The "person" table used by "driver.cpp" */
+  inline void create_person(file_descriptor_t &dbfile, const std::string &tname)
+  {
+    std::vector<Table::col_def_t> cols = {{"first_name", Table::TBL_TYPE_VCHAR, 40},
+                                          {"last_name", Table::TBL_TYPE_VCHAR, 40},
+                                          {"age", Table::TBL_TYPE_SHORT, 1}};
+    Table::create_table(dbfile, tname, cols);
+  }
+}
+
+#endif // BENCH_UTIL_H
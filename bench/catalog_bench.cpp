@@ -0,0 +1,64 @@
+/**************************************************************************************************
+* Filename:   catalog_bench.cpp
+* Details:    Schema lookups ("read_table_descriptor()") against a catalog of a few tables and
+*             against one of many, whose "#master" and "#columns" span several pages.
+*             Usage: ./<executable> [num_tables] [num_lookups]
+**************************************************************************************************/
+
+/****************************************** HEADER FILES *****************************************/
+
+#include "bench_util.h"
+
+#include <random>
+
+/************************************** BENCH IMPLEMENTATION *************************************/
+
+/* Describe random tables among the first <num_tables> ; returns the columns seen, so the work is not optimized away */
+static size_t describe_random(file_descriptor_t &dbfile, size_t num_tables, size_t num_lookups, const char* bench_case)
+{
+	std::mt19937 gen(42);
+	std::uniform_int_distribution<size_t> pick(0, num_tables - 1);
+	size_t cols = 0;
+	double start = Bench::now_sec();
+	for(size_t i = 0; i < num_lookups; i++)
+	{
+		Table::table_descriptor_t td;
+		Table::read_table_descriptor(dbfile, "t" + std::to_string(pick(gen)), td);
+		cols += td.col_types.size();
+	}
+	Bench::report("catalog", bench_case, num_lookups, Bench::now_sec() - start);
+	return cols;
+}
+
+
+int main(int argc, char* argv[])
+{
+	size_t num_tables = argc > 1 ? atol(argv[1]) : 2000;
+	size_t num_lookups = argc > 2 ? atol(argv[2]) : 100000;
+	const char db_name[] = "bench_db.dat";
+	const size_t few = 10;
+	num_tables = std::max(num_tables, few);
+
+	Bench::fresh_db(db_name, std::min<size_t>(8000, num_tables + 200), 256); // one page per table, plus the catalog
+	std::fstream dbfile(db_name, std::ios::in | std::ios::out | std::ios::binary);
+
+	size_t cols = 0;
+	for(size_t t = 0; t < num_tables; t++)
+	{
+		Bench::create_person(dbfile, "t" + std::to_string(t));
+		if(t + 1 == few)
+			cols += describe_random(dbfile, few, num_lookups, "describe_few_tables");
+	}
+	cols += describe_random(dbfile, num_tables, num_lookups, "describe_many_tables");
+
+	Buffer_mgr::shutdown(dbfile);
+	dbfile.close();
+	remove(db_name);
+
+	if(cols != 2 * 3 * num_lookups)
+	{
+		std::cerr << "saw " << cols << " columns, expected " << 2 * 3 * num_lookups << std::endl;
+		return 1;
+	}
+	return 0;
+}
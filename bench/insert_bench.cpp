@@ -0,0 +1,87 @@
+/**************************************************************************************************
+* Filename:   insert_bench.cpp
+* Details:    Insert throughput of the row-at-a-time "insert_into()" path against "insert_batch()"
+*             and the typed "insert_rows()", and a CSV "bulk_load()".
+*             Usage: ./<executable> [num_rows] [batch_size]
+**************************************************************************************************/
+
+/****************************************** HEADER FILES *****************************************/
+
+#include "bench_util.h"
+
+/************************************** BENCH IMPLEMENTATION *************************************/
+
+int main(int argc, char* argv[])
+{
+	size_t num_rows = argc > 1 ? atol(argv[1]) : 100000;
+	size_t batch_size = argc > 2 ? atol(argv[2]) : 1000;
+	const char db_name[] = "bench_db.dat";
+
+	Bench::fresh_db(db_name, std::min<size_t>(8000, num_rows * 4 / 500 + 100), 64); // four tables of ~700 rows a page
+	std::fstream dbfile(db_name, std::ios::in | std::ios::out | std::ios::binary);
+	Bench::create_person(dbfile, "person_a");
+	Bench::create_person(dbfile, "person_b");
+	Bench::create_person(dbfile, "person_c");
+	Bench::create_person(dbfile, "person_d");
+
+	/************************************ ROW AT A TIME *************************************/
+
+	double start = Bench::now_sec();
+	for(size_t i = 0; i < num_rows; i++)
+	{
+		std::vector<Table::colval_t> vals = {{"first_name", "Joe"}, {"last_name", "Smith"}, {"age", std::to_string(i % 100)}};
+		Table::insert_into(dbfile, "person_a", vals);
+	}
+	Buffer_mgr::flush_all(dbfile);
+	Bench::report("insert", "insert_into", num_rows, Bench::now_sec() - start);
+
+	/************************************** BATCHED *****************************************/
+
+	start = Bench::now_sec();
+	Table::insert_stmt_t stmt;
+	Table::prepare_insert(dbfile, "person_b", {"first_name", "last_name", "age"}, stmt);
+	std::vector<std::vector<std::string>> rows;
+	for(size_t i = 0; i < num_rows; i += rows.size())
+	{
+		rows.clear();
+		for(size_t j = i; j < num_rows && j < i + batch_size; j++)
+			rows.push_back({"Joe", "Smith", std::to_string(j % 100)});
+		Table::insert_batch(dbfile, stmt, rows);
+	}
+	Buffer_mgr::flush_all(dbfile);
+	Bench::report("insert", "insert_batch", num_rows, Bench::now_sec() - start);
+
+	/*********************************** BATCHED, TYPED *************************************/
+
+	start = Bench::now_sec();
+	Table::prepare_insert(dbfile, "person_c", {"first_name", "last_name", "age"}, stmt);
+	std::vector<Table::row_t> typed_rows;
+	for(size_t i = 0; i < num_rows; i += typed_rows.size())
+	{
+		typed_rows.clear();
+		for(size_t j = i; j < num_rows && j < i + batch_size; j++)
+			typed_rows.push_back({Page::val_str("Joe", 3), Page::val_str("Smith", 5), Page::val_short(j % 100)});
+		Table::insert_rows(dbfile, stmt, typed_rows);
+	}
+	Buffer_mgr::flush_all(dbfile);
+	Bench::report("insert", "insert_rows", num_rows, Bench::now_sec() - start);
+
+	/************************************** BULK LOAD ***************************************/
+
+	const char csv_name[] = "bench_rows.csv";
+	FILE* csv = fopen(csv_name, "w");
+	for(size_t i = 0; i < num_rows; i++)
+		fprintf(csv, "Joe,Smith,%d\n", (int)(i % 100));
+	fclose(csv);
+
+	start = Bench::now_sec();
+	size_t loaded = Table::bulk_load(dbfile, "person_d", csv_name, Table::TBL_BULK_CSV, 0);
+	Buffer_mgr::flush_all(dbfile);
+	Bench::report("insert", "bulk_load", loaded, Bench::now_sec() - start);
+
+	Buffer_mgr::shutdown(dbfile);
+	dbfile.close();
+	remove(csv_name);
+	remove(db_name);
+	return 0;
+}
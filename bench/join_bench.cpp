@@ -0,0 +1,102 @@
+/**************************************************************************************************
+* Filename:   join_bench.cpp
+* Details:    Rows/sec of joining a "person" table with an "orders" table on the person's id: index
+*             nested loops over a B+tree, and the hash join in memory, on every core, and with a
+*             small memory budget so it partitions both inputs to temp pages.
+*             Usage: ./<executable> [num_rows]
+**************************************************************************************************/
+
+/****************************************** HEADER FILES *****************************************/
+
+#include "bench_util.h"
+#include "../index_mgr/index_mgr.h"
+#include "../table_mgr/hash_join.h"
+
+#include <thread>
+
+/************************************** BENCH IMPLEMENTATION *************************************/
+
+int main(int argc, char* argv[])
+{
+	size_t num_rows = argc > 1 ? atol(argv[1]) : 1000000;
+	const char db_name[] = "bench_db.dat";
+	uint16_t npages = std::min<size_t>(8000, num_rows / 160 + 200); // both tables, the index, then room to partition
+
+	/* Keep everything in the pool, so only the join is measured */
+	Bench::fresh_db(db_name, npages, npages);
+	std::fstream dbfile(db_name, std::ios::in | std::ios::out | std::ios::binary);
+	Table::create_table(dbfile, "person", {{"id", Table::TBL_TYPE_INT, 1}, {"name", Table::TBL_TYPE_VCHAR, 12}});
+	Table::create_table(dbfile, "orders", {{"person_id", Table::TBL_TYPE_INT, 1}, {"amount", Table::TBL_TYPE_SHORT, 1}});
+
+	/* Every person once, and orders for ids a tenth past the last person, which match nobody */
+	Table::insert_stmt_t stmt;
+	std::vector<Table::row_t> rows;
+	for(size_t i = 0; i < num_rows; i++)
+		rows.push_back({Page::val_int(i), Page::val_str("person-name", 11)});
+	Table::prepare_insert(dbfile, "person", {"id", "name"}, stmt);
+	Table::insert_rows(dbfile, stmt, rows);
+	rows.clear();
+	for(size_t i = 0; i < num_rows; i++)
+		rows.push_back({Page::val_int((i * 7919) % (num_rows + num_rows / 10)), Page::val_short(i % 100)});
+	Table::prepare_insert(dbfile, "orders", {"person_id", "amount"}, stmt);
+	Table::insert_rows(dbfile, stmt, rows);
+	rows.clear();
+
+	Index::create_index(dbfile, "person_id", "person", "id");
+	Table::index_def_t idx = Index::find_index(dbfile, "person_id");
+	bool ok = true;
+
+	/********************************** INDEX NESTED LOOPS **********************************/
+
+	size_t expected = 0;
+	int64_t expected_sum = 0;
+	std::vector<Table::RID> rids;
+	Table::scan_cursor_t cur;
+	Table::row_t row;
+	Table::RID rid;
+	double start = Bench::now_sec();
+	Table::scan_open(dbfile, "orders", {}, {"person_id", "amount"}, cur);
+	while(Table::scan_next(cur, row, rid))
+	{
+		Index::bt_lookup(dbfile, idx, row[0], rids);
+		expected += rids.size();
+		expected_sum += rids.size() * row[1].s;
+	}
+	Bench::report("join", "index_nested_loops", num_rows, Bench::now_sec() - start);
+
+	/************************************** HASH JOIN ***************************************/
+
+	Table::join_input_t person = {"person", {}, "id", {"name"}};
+	Table::join_input_t orders = {"orders", {}, "person_id", {"amount"}};
+	unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+	struct { const char* name; unsigned nthreads; size_t budget; } cases[] = {
+		{"hash_join", 1, Table::JOIN_MEM_BUDGET},
+		{"hash_join_all_cores", cores, Table::JOIN_MEM_BUDGET},
+		{"grace_hash_join", 1, 1024 * 1024}};
+	for(const auto &c : cases)
+	{
+		std::vector<int64_t> sums(c.nthreads, 0);
+		start = Bench::now_sec();
+		size_t matches = Table::hash_join(dbfile, person, orders, [&sums](unsigned worker, const Table::row_t &, const Table::row_t &right)
+		{
+			sums[worker] += right[0].s;
+		}, c.nthreads, c.budget);
+		Bench::report("join", c.name, 2 * num_rows, Bench::now_sec() - start);
+
+		int64_t sum = 0;
+		for(int64_t s : sums)
+			sum += s;
+		ok &= matches == expected && sum == expected_sum;
+	}
+
+	Buffer_mgr::shutdown(dbfile);
+	dbfile.close();
+	remove(db_name);
+
+	if(!ok)
+	{
+		std::cerr << "joins found different matches" << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,213 @@
+/**************************************************************************************************
+* Filename:   lock_bench.cpp
+* Details:    Lock requests/sec of "lock_row()" from several threads, on rows no one else locks and
+*             on a few hot rows; two threads locking rows in opposite orders until deadlocks are
+*             found and broken; escalation of many row locks; and rows/sec of "insert_rows()" from
+*             several writers into tables of their own and into one shared table. Every writer's
+*             rows must be there at the end. The lock manager's counters follow each case.
+*             Usage: ./<executable> [num_rows]
+**************************************************************************************************/
+
+/****************************************** HEADER FILES *****************************************/
+
+#include "bench_util.h"
+#include "../lock_mgr/lock_mgr.h"
+#include "../table_mgr/table_scan.h"
+
+#include <atomic>
+#include <thread>
+
+/************************************** BENCH IMPLEMENTATION *************************************/
+
+const unsigned NUM_THREADS = 4;
+const size_t BATCH_ROWS = 100;           // rows per "insert_rows()", each one transaction
+const size_t ROWS_PER_TXN = 20;          // row locks an owner takes before releasing them all
+const Lock_mgr::owner_t OWNER_BASE = 1u << 30; // well clear of the transaction ids the writers use
+
+/* The lock manager's counters since the last call, as one JSON line */
+static void report_stats(const std::string &which)
+{
+	Lock_mgr::lock_stats_t st = Lock_mgr::lock_stats();
+	printf("{\"bench\": \"lock\", \"case\": \"%s_stats\", \"requests\": %llu, \"held\": %llu, \"waits\": %llu, "
+	       "\"wait_seconds\": %.6f, \"max_wait_seconds\": %.6f, \"deadlocks\": %llu, \"escalations\": %llu, \"locks\": %llu}\n",
+	       which.c_str(), (unsigned long long)st.requests, (unsigned long long)st.held, (unsigned long long)st.waits,
+	       st.wait_seconds, st.max_wait_seconds, (unsigned long long)st.deadlocks, (unsigned long long)st.escalations,
+	       (unsigned long long)st.locks);
+	fflush(stdout);
+	Lock_mgr::lock_reset_stats();
+}
+
+/* Each thread locks <per_thread> rows X, ROWS_PER_TXN to an owner; with <hot> rows, all threads share the same few,
+   each owner taking them in the same order so they queue without deadlocking */
+static double lock_rows(size_t per_thread, uint16_t hot)
+{
+	std::vector<std::thread> threads;
+	double start = Bench::now_sec();
+	for(unsigned t = 0; t < NUM_THREADS; t++)
+		threads.emplace_back([=]() {
+			Lock_mgr::owner_t owner = OWNER_BASE + t * per_thread;
+			for(size_t i = 0; i < per_thread; i++)
+			{
+				uint32_t table = hot ? 1 : 100 + t;
+				uint16_t rec = hot ? i % ROWS_PER_TXN % hot : i % 4096;
+				Lock_mgr::lock_row(owner, table, rec / 64 + 1, rec, Lock_mgr::LOCK_X);
+				if((i + 1) % ROWS_PER_TXN == 0)
+					Lock_mgr::lock_release_all(owner++);
+			}
+			Lock_mgr::lock_release_all(owner);
+		});
+	for(std::thread &th : threads)
+		th.join();
+	return Bench::now_sec() - start;
+}
+
+/* Rows of <table> one scan sees, and the sum of their ids */
+static size_t count_rows(file_descriptor_t &dbfile, const std::string &table, long &id_sum)
+{
+	Table::scan_cursor_t cur;
+	Table::row_t row;
+	Table::RID rid;
+	size_t count = 0;
+	id_sum = 0;
+	Table::scan_open(dbfile, table, {}, {"id"}, cur);
+	while(Table::scan_next(cur, row, rid))
+	{
+		id_sum += row[0].i;
+		count++;
+	}
+	return count;
+}
+
+/* Each of NUM_THREADS writers inserts <per_thread> rows in batches, into a table of its own or all into "shared" */
+static bool insert_writers(file_descriptor_t &dbfile, size_t per_thread, bool shared)
+{
+	std::string which = shared ? "insert_shared" : "insert_own";
+	std::vector<std::thread> threads;
+	std::atomic<bool> failed(false);
+	double start = Bench::now_sec();
+	for(unsigned t = 0; t < NUM_THREADS; t++)
+		threads.emplace_back([&, t]() {
+			try
+			{
+				Table::insert_stmt_t stmt;
+				Table::prepare_insert(dbfile, shared ? "shared" : "own" + std::to_string(t), {"id", "name"}, stmt);
+				std::vector<Table::row_t> rows(BATCH_ROWS);
+				for(size_t done = 0; done < per_thread; done += BATCH_ROWS)
+				{
+					for(size_t i = 0; i < BATCH_ROWS; i++)
+						rows[i] = {Page::val_int(t * per_thread + done + i), Page::val_str("Someone", 7)};
+					Table::insert_rows(dbfile, stmt, rows);
+				}
+			}
+			catch(const std::exception &e)
+			{
+				fprintf(stderr, "%s: %s\n", which.c_str(), e.what());
+				failed = true;
+			}
+		});
+	for(std::thread &th : threads)
+		th.join();
+	Bench::report("lock", which, NUM_THREADS * per_thread, Bench::now_sec() - start);
+	report_stats(which);
+
+	/* Every row, once: ids 0 .. NUM_THREADS * per_thread - 1 between the tables written */
+	bool ok = !failed;
+	size_t count = 0;
+	long id_sum = 0;
+	for(unsigned t = 0; t < (shared ? 1 : NUM_THREADS); t++)
+	{
+		long sum;
+		count += count_rows(dbfile, shared ? "shared" : "own" + std::to_string(t), sum);
+		id_sum += sum;
+	}
+	long n = NUM_THREADS * per_thread;
+	if(count != (size_t)n || id_sum != n * (n - 1) / 2)
+	{
+		fprintf(stderr, "%s: %zu rows, expected %ld\n", which.c_str(), count, n);
+		ok = false;
+	}
+	return ok;
+}
+
+int main(int argc, char* argv[])
+{
+	size_t num_rows = argc > 1 ? atol(argv[1]) : 100000;
+	size_t per_thread = std::max<size_t>(ROWS_PER_TXN, num_rows / NUM_THREADS / ROWS_PER_TXN * ROWS_PER_TXN);
+	bool ok = true;
+	Lock_mgr::lock_reset_stats();
+
+	/*************************************** ROW LOCKS ***************************************/
+
+	Bench::report("lock", "rows_uncontended", NUM_THREADS * per_thread, lock_rows(per_thread, 0));
+	report_stats("rows_uncontended");
+	Bench::report("lock", "rows_hot", NUM_THREADS * per_thread, lock_rows(per_thread, 8));
+	report_stats("rows_hot");
+
+	/*************************************** DEADLOCKS ***************************************/
+
+	/* Two owners lock the same two rows in opposite orders: one of each colliding pair gives up, and tries again */
+	const size_t rounds = 200;
+	std::atomic<size_t> committed(0);
+	std::vector<std::thread> threads;
+	double start = Bench::now_sec();
+	for(unsigned t = 0; t < 2; t++)
+		threads.emplace_back([&, t]() {
+			Lock_mgr::owner_t owner = OWNER_BASE + t;
+			for(size_t r = 0; r < rounds; )
+			{
+				try
+				{
+					Lock_mgr::lock_row(owner, 2, 1, t, Lock_mgr::LOCK_X);
+					std::this_thread::yield();
+					Lock_mgr::lock_row(owner, 2, 1, 1 - t, Lock_mgr::LOCK_X);
+					committed++;
+					r++;
+				}
+				catch(const Lock_mgr::lock_error &) {}
+				Lock_mgr::lock_release_all(owner);
+			}
+		});
+	for(std::thread &th : threads)
+		th.join();
+	Bench::report("lock", "deadlock_pairs", committed, Bench::now_sec() - start);
+	report_stats("deadlock_pairs");
+	ok &= committed == 2 * rounds;
+
+	/************************************** ESCALATION ***************************************/
+
+	size_t escalate = Lock_mgr::lock_escalation();
+	start = Bench::now_sec();
+	for(size_t i = 0; i < 2 * escalate; i++)
+		Lock_mgr::lock_row(OWNER_BASE, 3, i / 512 + 1, i % 512, Lock_mgr::LOCK_X);
+	ok &= Lock_mgr::lock_mode_table(OWNER_BASE, 3) == Lock_mgr::LOCK_X;
+	Lock_mgr::lock_release_all(OWNER_BASE);
+	Bench::report("lock", "escalate_rows", 2 * escalate, Bench::now_sec() - start);
+	report_stats("escalate_rows");
+
+	/*************************************** WRITERS *****************************************/
+
+	const char db_name[] = "bench_db.dat";
+	uint16_t npages = std::min<size_t>(8000, 2 * NUM_THREADS * per_thread / 400 + 100);
+	Bench::fresh_db(db_name, npages, npages);
+	std::fstream dbfile(db_name, std::ios::in | std::ios::out | std::ios::binary);
+	std::vector<Table::col_def_t> cols = {{"id", Table::TBL_TYPE_INT, 1}, {"name", Table::TBL_TYPE_VCHAR, 20}};
+	for(unsigned t = 0; t < NUM_THREADS; t++)
+		Table::create_table(dbfile, "own" + std::to_string(t), cols);
+	Table::create_table(dbfile, "shared", cols);
+
+	size_t per_writer = std::max<size_t>(BATCH_ROWS, per_thread / BATCH_ROWS * BATCH_ROWS);
+	ok &= insert_writers(dbfile, per_writer, false);
+	ok &= insert_writers(dbfile, per_writer, true);
+	ok &= Lock_mgr::lock_stats().locks == 0;
+
+	Buffer_mgr::shutdown(dbfile);
+	dbfile.close();
+	remove(db_name);
+
+	if(!ok)
+	{
+		std::cerr << "lock bench found lost rows, stuck owners or leftover locks" << std::endl;
+		return 1;
+	}
+	return 0;
+}
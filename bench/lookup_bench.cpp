@@ -0,0 +1,96 @@
+/**************************************************************************************************
+* Filename:   lookup_bench.cpp
+* Details:    Point lookups by key: an extendible hash index against a B+tree index and a full
+*             table scan with an equality predicate.
+*             Usage: ./<executable> [num_rows] [num_lookups]
+**************************************************************************************************/
+
+/****************************************** HEADER FILES *****************************************/
+
+#include "bench_util.h"
+#include "../index_mgr/index_mgr.h"
+#include "../table_mgr/table_scan.h"
+
+#include <random>
+
+/************************************** BENCH IMPLEMENTATION *************************************/
+
+int main(int argc, char* argv[])
+{
+	size_t num_rows = argc > 1 ? atol(argv[1]) : 100000;
+	size_t num_lookups = argc > 2 ? atol(argv[2]) : 100000;
+	const char db_name[] = "bench_db.dat";
+	uint16_t npages = std::min<size_t>(8000, num_rows / 250 + 100);
+
+	/* Keep everything in the pool, so only the pages each lookup touches are measured */
+	Bench::fresh_db(db_name, npages, npages);
+	std::fstream dbfile(db_name, std::ios::in | std::ios::out | std::ios::binary);
+	Table::create_table(dbfile, "lookup", {{"id", Table::TBL_TYPE_INT, 1}, {"name", Table::TBL_TYPE_VCHAR, 40}});
+
+	Table::insert_stmt_t stmt;
+	Table::prepare_insert(dbfile, "lookup", {"id", "name"}, stmt);
+	std::vector<Table::row_t> rows;
+	for(size_t i = 0; i < num_rows; i++)
+		rows.push_back({Page::val_int(i * 7919 % num_rows), Page::val_str("Someone", 7)});
+	Table::insert_rows(dbfile, stmt, rows);
+
+	Index::create_hash_index(dbfile, "lookup_id_hash", "lookup", "id");
+	Index::create_index(dbfile, "lookup_id_btree", "lookup", "id");
+	Table::index_def_t hash = Index::find_index(dbfile, "lookup_id_hash");
+	Table::index_def_t btree = Index::find_index(dbfile, "lookup_id_btree");
+
+	std::mt19937 gen(42);
+	std::uniform_int_distribution<int32_t> pick(0, num_rows - 1);
+	std::vector<int32_t> keys(num_lookups);
+	for(int32_t &k : keys)
+		k = pick(gen);
+
+	std::vector<Table::RID> rids;
+	size_t found = 0;
+
+	/************************************* HASH INDEX ***************************************/
+
+	double start = Bench::now_sec();
+	for(int32_t k : keys)
+	{
+		Index::hx_lookup(dbfile, hash, Page::val_int(k), rids);
+		found += rids.size();
+	}
+	Bench::report("lookup", "hash_index", num_lookups, Bench::now_sec() - start);
+
+	/************************************* B+TREE INDEX *************************************/
+
+	start = Bench::now_sec();
+	for(int32_t k : keys)
+	{
+		Index::bt_lookup(dbfile, btree, Page::val_int(k), rids);
+		found += rids.size();
+	}
+	Bench::report("lookup", "btree_index", num_lookups, Bench::now_sec() - start);
+
+	/************************************** FULL SCAN ***************************************/
+
+	size_t num_scans = std::max<size_t>(1, std::min<size_t>(num_lookups, 20)); // each one reads the whole table
+	Table::scan_cursor_t cur;
+	Table::row_t row;
+	Table::RID rid;
+	start = Bench::now_sec();
+	for(size_t i = 0; i < num_scans; i++)
+	{
+		Table::scan_open(dbfile, "lookup", {{"id", Table::SCAN_EQ, Page::val_int(keys[i]), 0}}, {"id"}, cur);
+		while(Table::scan_next(cur, row, rid))
+			found++;
+	}
+	Bench::report("lookup", "full_scan", num_scans, Bench::now_sec() - start);
+
+	Buffer_mgr::shutdown(dbfile);
+	dbfile.close();
+	remove(db_name);
+
+	if(found != 2 * num_lookups + num_scans)
+	{
+		std::cerr << "lookups found " << found << " rows, expected " << 2 * num_lookups + num_scans << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,224 @@
+/**************************************************************************************************
+* Filename:   micro_bench.cpp
+* Details:    Operations/sec of the building blocks under every statement: adding, deleting and
+*             modifying records on a page, packing and unpacking a record, "buf_read()" on pages
+*             in the pool and on pages it has to fetch, "pgf_read()" and "pgf_write()" straight
+*             to the file, and end to end, "insert_into()" one row at a time. The pool cases and
+*             "insert_into()" are followed by what "io_stats.h" recorded during them.
+*             Usage: ./<executable> [num_ops]
+**************************************************************************************************/
+
+/****************************************** HEADER FILES *****************************************/
+
+#include "bench_util.h"
+#include "../paging/record_builder.h"
+
+#include <cstring>
+#include <random>
+
+/************************************** BENCH IMPLEMENTATION *************************************/
+
+const uint16_t FILE_PAGES = 2000; // pages of the file the buffer pool and file cases read
+const uint16_t HOT_PAGES = 200;   // pages a pool big enough for them is read across, all hits once warm
+const uint16_t SMALL_POOL = 16;   // a pool this small misses on nearly every read across the file
+
+/* Values of the "person" record every page case works on */
+static void pack_person(std::string &rec, int16_t age)
+{
+	Page::rec_begin(rec);
+	Page::rec_packstr(rec, "Joe");
+	Page::rec_packstr(rec, "Smith");
+	Page::rec_packshort(rec, age);
+	Page::rec_finish(rec);
+}
+
+/* An empty page, as the paging layer lays it out */
+static void empty_page(Page::Page_t &page)
+{
+	memset((void*)&page, 0, sizeof(page));
+	page.free_bytes = Page::PG_INITIAL_BYTES;
+}
+
+/* Add copies of <rec> until the page is full ; returns how many */
+static size_t fill_page(Page::Page_t &page, const std::string &rec)
+{
+	size_t added = 0;
+	empty_page(page);
+	while(page.free_bytes >= rec.size() + sizeof(uint16_t))
+	{
+		Page::pg_add_record(&page, (void*)rec.data(), rec.size());
+		added++;
+	}
+	return added;
+}
+
+int main(int argc, char* argv[])
+{
+	size_t num_ops = argc > 1 ? atol(argv[1]) : 1000000;
+	std::mt19937 gen(42);
+	Page::Page_t page;
+	std::string rec;
+	pack_person(rec, 37);
+
+	/****************************************** PAGES ****************************************/
+
+	size_t done = 0;
+	double start = Bench::now_sec();
+	while(done < num_ops)
+		done += fill_page(page, rec);
+	Bench::report("micro", "pg_add_record", done, Bench::now_sec() - start);
+
+	/* Deleting from the middle moves the records after it and fixes up the directory, so order matters: in random order */
+	double secs = 0;
+	size_t deleted = 0;
+	std::vector<uint16_t> ids;
+	while(deleted < num_ops / 10)
+	{
+		ids.resize(fill_page(page, rec));
+		for(uint16_t i = 0; i < ids.size(); i++)
+			ids[i] = i;
+		std::shuffle(ids.begin(), ids.end(), gen);
+		start = Bench::now_sec();
+		for(uint16_t id : ids)
+			Page::pg_del_record(&page, id);
+		secs += Bench::now_sec() - start;
+		deleted += ids.size();
+	}
+	Bench::report("micro", "pg_del_record", deleted, secs);
+
+	/* The same size in place, then alternately 8 bytes longer and back, moving the records after it */
+	std::string longer;
+	Page::rec_begin(longer);
+	Page::rec_packstr(longer, "Joe");
+	Page::rec_packstr(longer, "Smith-Jones");
+	Page::rec_packshort(longer, 37);
+	Page::rec_finish(longer);
+	size_t per_page = fill_page(page, rec) / 2; // half a page of records, leaving room for the longer ones
+	empty_page(page);
+	for(size_t i = 0; i < per_page; i++)
+		Page::pg_add_record(&page, (void*)rec.data(), rec.size());
+	std::uniform_int_distribution<uint16_t> pick(0, per_page - 1);
+	ids.resize(std::min<size_t>(num_ops, 1 << 16));
+	for(uint16_t &id : ids)
+		id = pick(gen);
+
+	start = Bench::now_sec();
+	for(size_t i = 0; i < num_ops; i++)
+		Page::pg_modify_record(&page, (void*)rec.data(), ids[i % ids.size()]);
+	Bench::report("micro", "pg_modify_same_size", num_ops, Bench::now_sec() - start);
+
+	size_t modifies = num_ops / 10;
+	start = Bench::now_sec();
+	for(size_t i = 0; i < modifies; i++)
+	{
+		uint16_t id = ids[i / 2 % ids.size()];
+		Page::pg_modify_record(&page, (void*)(i % 2 == 0 ? longer : rec).data(), id);
+	}
+	Bench::report("micro", "pg_modify_resize", modifies, Bench::now_sec() - start);
+
+	/***************************************** RECORDS ***************************************/
+
+	start = Bench::now_sec();
+	for(size_t i = 0; i < num_ops; i++)
+		pack_person(rec, i % 100);
+	Bench::report("micro", "rec_pack", num_ops, Bench::now_sec() - start);
+
+	Page::rec_builder_t rb;
+	Page::rb_reserve(rb, rec.size() + 64);
+	start = Bench::now_sec();
+	for(size_t i = 0; i < num_ops; i++)
+	{
+		Page::rb_begin(rb);
+		Page::rb_packval(rb, Page::val_str("Joe", 3));
+		Page::rb_packval(rb, Page::val_str("Smith", 5));
+		Page::rb_packval(rb, Page::val_short(i % 100));
+		Page::rb_finish(rb);
+	}
+	Bench::report("micro", "rec_build", num_ops, Bench::now_sec() - start);
+
+	std::vector<Page::value_t> vals;
+	long age_sum = 0;
+	start = Bench::now_sec();
+	for(size_t i = 0; i < num_ops; i++)
+	{
+		Page::rec_upackrow((void*)rec.data(), vals);
+		age_sum += vals[2].s;
+	}
+	Bench::report("micro", "rec_unpack", num_ops, Bench::now_sec() - start);
+
+	/************************************** BUFFER POOL **************************************/
+
+	const char db_name[] = "bench_db.dat";
+	Bench::fresh_db(db_name, FILE_PAGES, HOT_PAGES);
+	std::fstream dbfile(db_name, std::ios::in | std::ios::out | std::ios::binary);
+	std::uniform_int_distribution<int> hot(0, HOT_PAGES - 1), any(0, FILE_PAGES - 1);
+	std::vector<int> page_ids(std::min<size_t>(num_ops, 1 << 16));
+
+	for(int p = 0; p < HOT_PAGES; p++)
+		Buffer_mgr::buf_read(dbfile, p);
+	for(int &p : page_ids)
+		p = hot(gen);
+	Io_stats::io_reset_stats();
+	start = Bench::now_sec();
+	for(size_t i = 0; i < num_ops; i++)
+		Buffer_mgr::buf_read(dbfile, page_ids[i % page_ids.size()]);
+	Bench::report("micro", "buf_read_hit", num_ops, Bench::now_sec() - start);
+	Bench::report_io("micro", "buf_read_hit_io");
+
+	Buffer_mgr::shutdown(dbfile);
+	Buffer_mgr::initialize(SMALL_POOL);
+	for(int &p : page_ids)
+		p = any(gen);
+	size_t misses = num_ops / 10;
+	start = Bench::now_sec();
+	for(size_t i = 0; i < misses; i++)
+		Buffer_mgr::buf_read(dbfile, page_ids[i % page_ids.size()]);
+	Bench::report("micro", "buf_read_miss", misses, Bench::now_sec() - start);
+	Bench::report_io("micro", "buf_read_miss_io");
+	Buffer_mgr::shutdown(dbfile);
+
+	/******************************************* FILE ****************************************/
+
+	Page::Page_t buf;
+	start = Bench::now_sec();
+	for(size_t i = 0; i < misses; i++)
+		Page_file::pgf_read(dbfile, page_ids[i % page_ids.size()], &buf);
+	Bench::report("micro", "pgf_read", misses, Bench::now_sec() - start);
+
+	/* Pages past the catalog's, which nothing reads back */
+	std::uniform_int_distribution<int> spare(FILE_PAGES / 2, FILE_PAGES - 1);
+	for(int &p : page_ids)
+		p = spare(gen);
+	empty_page(buf);
+	start = Bench::now_sec();
+	for(size_t i = 0; i < misses; i++)
+		Page_file::pgf_write(dbfile, page_ids[i % page_ids.size()], &buf);
+	dbfile.flush();
+	Bench::report("micro", "pgf_write", misses, Bench::now_sec() - start);
+	dbfile.close();
+
+	/**************************************** END TO END *************************************/
+
+	size_t rows = num_ops / 10;
+	Bench::fresh_db(db_name, std::min<size_t>(8000, rows / 500 + 100), 64);
+	dbfile.open(db_name, std::ios::in | std::ios::out | std::ios::binary);
+	Bench::create_person(dbfile, "person");
+	Io_stats::io_reset_stats();
+	start = Bench::now_sec();
+	for(size_t i = 0; i < rows; i++)
+		Table::insert_into(dbfile, "person", {{"first_name", "Joe"}, {"last_name", "Smith"}, {"age", std::to_string(i % 100)}});
+	Buffer_mgr::flush_all(dbfile);
+	Bench::report("micro", "insert_into", rows, Bench::now_sec() - start);
+	Bench::report_io("micro", "insert_into_io");
+
+	Buffer_mgr::shutdown(dbfile);
+	dbfile.close();
+	remove(db_name);
+
+	if(age_sum != (long)(num_ops * ((num_ops - 1) % 100))) // every unpack reads the last record packed
+	{
+		std::cerr << "unpacked the wrong values" << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,134 @@
+/**************************************************************************************************
+* Filename:   mvcc_bench.cpp
+* Details:    Rows/sec of "scan_next()" and "vscan_next()" over a table on their own, and again
+*             while another thread inserts into the same table in batches, along with the rows/sec
+*             of those inserts. Every scan must see the preloaded rows plus whole batches only.
+*             Usage: ./<executable> [num_rows]
+**************************************************************************************************/
+
+/****************************************** HEADER FILES *****************************************/
+
+#include "bench_util.h"
+#include "../table_mgr/table_scan.h"
+
+#include <atomic>
+#include <thread>
+
+/************************************** BENCH IMPLEMENTATION *************************************/
+
+const size_t BATCH_ROWS = 100; // rows per insert, each one transaction
+
+/* Rows of the table one scan sees, through "scan_next()" or "vscan_next()" */
+static size_t count_rows(file_descriptor_t &dbfile, bool vectorized)
+{
+	size_t count = 0;
+	if(vectorized)
+	{
+		Table::vscan_cursor_t* vcur = new Table::vscan_cursor_t;
+		Table::vscan_open(dbfile, "mvcc", {}, {"id"}, *vcur);
+		while(Table::vscan_next(*vcur))
+			count += vcur->num_sel;
+		delete vcur;
+		return count;
+	}
+	Table::scan_cursor_t cur;
+	Table::row_t row;
+	Table::RID rid;
+	Table::scan_open(dbfile, "mvcc", {}, {"id", "name"}, cur);
+	while(Table::scan_next(cur, row, rid))
+		count++;
+	return count;
+}
+
+int main(int argc, char* argv[])
+{
+	size_t num_rows = argc > 1 ? atol(argv[1]) : 100000;
+	size_t max_inserted = 2 * num_rows; // per round, the inserter stops here if the scans are not done by then
+	const char db_name[] = "bench_db.dat";
+	uint16_t npages = std::min<size_t>(8000, (num_rows + 2 * max_inserted) / 300 + 100);
+
+	Bench::fresh_db(db_name, npages, npages);
+	std::fstream dbfile(db_name, std::ios::in | std::ios::out | std::ios::binary);
+	Table::create_table(dbfile, "mvcc", {{"id", Table::TBL_TYPE_INT, 1}, {"name", Table::TBL_TYPE_VCHAR, 20}, {"age", Table::TBL_TYPE_SHORT, 1}});
+
+	Table::insert_stmt_t stmt;
+	Table::prepare_insert(dbfile, "mvcc", {"id", "name", "age"}, stmt);
+	std::vector<Table::row_t> rows;
+	for(size_t i = 0; i < num_rows; i++)
+		rows.push_back({Page::val_int(i), Page::val_str("Someone", 7), Page::val_short(i % 100)});
+	Table::insert_rows(dbfile, stmt, rows);
+	rows.resize(BATCH_ROWS);
+
+	const int reps = 10;
+	bool ok = true;
+	size_t inserted = 0;
+	for(bool vectorized : {false, true})
+	{
+		std::string name = vectorized ? "vscan" : "scan";
+
+		/************************************* SCANS ALONE ***************************************/
+
+		size_t base = num_rows + inserted;
+		size_t total = 0;
+		double start = Bench::now_sec();
+		for(int r = 0; r < reps; r++)
+			total += count_rows(dbfile, vectorized);
+		Bench::report("mvcc", name + "_alone", total, Bench::now_sec() - start);
+		ok &= total == base * reps;
+
+		/***************************** SCANS WHILE ANOTHER THREAD INSERTS ************************/
+
+		std::atomic<bool> stop(false);
+		size_t batches = 0;
+		double ins_secs = 0;
+		std::thread inserter([&]() {
+			double ins_start = Bench::now_sec();
+			while(!stop && (batches + 1) * BATCH_ROWS <= max_inserted)
+			{
+				Table::insert_rows(dbfile, stmt, rows);
+				inserted += BATCH_ROWS;
+				batches++;
+			}
+			ins_secs = Bench::now_sec() - ins_start;
+		});
+
+		total = 0;
+		size_t last = base;
+		start = Bench::now_sec();
+		for(int r = 0; r < reps; r++)
+		{
+			size_t count = count_rows(dbfile, vectorized);
+			total += count;
+			if(count < last || (count - base) % BATCH_ROWS != 0) // a partial batch, or rows a later scan no longer sees
+			{
+				fprintf(stderr, "%s saw %zu rows after seeing %zu, with batches of %zu\n", name.c_str(), count, last, BATCH_ROWS);
+				ok = false;
+			}
+			last = count;
+		}
+		double scan_secs = Bench::now_sec() - start;
+		stop = true;
+		inserter.join();
+		Bench::report("mvcc", name + "_with_inserts", total, scan_secs);
+		Bench::report("mvcc", name + "_inserts", batches * BATCH_ROWS, ins_secs);
+
+		Table::mvcc_stats_t stats = Table::mvcc_stats();
+		if(stats.created != 0 || stats.active != 0 || stats.snapshots != 0) // every version is collected once all are done
+		{
+			fprintf(stderr, "%zu versions, %zu transactions, %zu snapshots left over\n", stats.created, stats.active, stats.snapshots);
+			ok = false;
+		}
+		ok &= count_rows(dbfile, vectorized) == num_rows + inserted;
+	}
+
+	Buffer_mgr::shutdown(dbfile);
+	dbfile.close();
+	remove(db_name);
+
+	if(!ok)
+	{
+		std::cerr << "scans did not see whole batches" << std::endl;
+		return 1;
+	}
+	return 0;
+}
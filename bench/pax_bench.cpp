@@ -0,0 +1,84 @@
+/**************************************************************************************************
+* Filename:   pax_bench.cpp
+* Details:    Rows/sec of a vectorized scan that filters on one column and projects another, out of
+*             a wide table: the same rows stored in row pages and in PAX pages.
+*             Usage: ./<executable> [num_rows]
+**************************************************************************************************/
+
+/****************************************** HEADER FILES *****************************************/
+
+#include "bench_util.h"
+#include "../table_mgr/table_scan.h"
+
+/************************************** BENCH IMPLEMENTATION *************************************/
+
+int main(int argc, char* argv[])
+{
+	size_t num_rows = argc > 1 ? atol(argv[1]) : 100000;
+	const char db_name[] = "bench_db.dat";
+	uint16_t npages = std::min<size_t>(8000, num_rows / 25 + 100);
+
+	/* Keep both tables in the pool, so only decoding and filtering are measured */
+	Bench::fresh_db(db_name, npages, npages);
+	std::fstream dbfile(db_name, std::ios::in | std::ios::out | std::ios::binary);
+	std::vector<Table::col_def_t> cols = {{"id", Table::TBL_TYPE_INT, 1}, {"age", Table::TBL_TYPE_SHORT, 1}};
+	for(int c = 0; c < 6; c++)
+		cols.push_back({"note" + std::to_string(c), Table::TBL_TYPE_VCHAR, 12});
+
+	std::vector<Table::row_t> rows;
+	for(size_t i = 0; i < num_rows; i++)
+	{
+		rows.push_back({Page::val_int(i), Page::val_short((i * 7919) % 100)});
+		for(int c = 0; c < 6; c++)
+			rows.back().push_back(Page::val_str("some text", 9));
+	}
+	std::vector<std::string> col_names;
+	for(const Table::col_def_t &col : cols)
+		col_names.push_back(col.name);
+
+	/* WHERE age >= 20 AND age < 30, projecting id */
+	std::vector<Table::scan_pred_t> preds = {{"age", Table::SCAN_GE, Page::val_short(20), 0},
+	                                         {"age", Table::SCAN_LT, Page::val_short(30), 0}};
+	const int reps = 5;
+	size_t expected = 0;
+	const char* names[] = {"rows", "pax"};
+	for(uint16_t type : {Table::DB_TYPE_ROWS, Table::DB_TYPE_PAX})
+	{
+		std::string table = names[type == Table::DB_TYPE_PAX];
+		Table::create_table(dbfile, table, cols, type);
+		Table::insert_stmt_t stmt;
+		Table::prepare_insert(dbfile, table, col_names, stmt);
+		Table::insert_rows(dbfile, stmt, rows);
+
+		Table::vscan_cursor_t* vcur = new Table::vscan_cursor_t;
+		size_t matched = 0;
+		int64_t sum = 0;
+		double start = Bench::now_sec();
+		for(int r = 0; r < reps; r++)
+		{
+			Table::vscan_open(dbfile, table, preds, {"id"}, *vcur);
+			while(Table::vscan_next(*vcur))
+			{
+				const Page::vec_column_t &ids = vcur->batch.cols[vcur->proj_col[0]];
+				for(uint16_t i = 0; i < vcur->num_sel; i++)
+					sum += ids.ints[vcur->sel[i]];
+				matched += vcur->num_sel;
+			}
+		}
+		Bench::report("pax", "vscan_" + table, num_rows * reps, Bench::now_sec() - start);
+		delete vcur;
+
+		if(expected == 0)
+			expected = matched;
+		else if(matched != expected)
+		{
+			fprintf(stderr, "%s matched %zu rows, expected %zu\n", table.c_str(), matched, expected);
+			return 1;
+		}
+	}
+
+	Buffer_mgr::shutdown(dbfile);
+	dbfile.close();
+	remove(db_name);
+	return 0;
+}
@@ -0,0 +1,76 @@
+/**************************************************************************************************
+* Filename:   pscan_bench.cpp
+* Details:    Rows/sec of a filtered count over the whole table: "vscan_next()" on one thread
+*             against "pscan_count()" on 1, 2, 4, ... workers up to the number of cores.
+*             Usage: ./<executable> [num_rows]
+**************************************************************************************************/
+
+/****************************************** HEADER FILES *****************************************/
+
+#include "bench_util.h"
+#include "../table_mgr/table_scan.h"
+
+#include <thread>
+
+/************************************** BENCH IMPLEMENTATION *************************************/
+
+int main(int argc, char* argv[])
+{
+	size_t num_rows = argc > 1 ? atol(argv[1]) : 1000000;
+	const char db_name[] = "bench_db.dat";
+	uint16_t npages = std::min<size_t>(8000, num_rows / 500 + 100);
+
+	/* Keep the whole table in the pool, so the workers only contend on the pool itself */
+	Bench::fresh_db(db_name, npages, npages);
+	std::fstream dbfile(db_name, std::ios::in | std::ios::out | std::ios::binary);
+	Table::create_table(dbfile, "scan", {{"id", Table::TBL_TYPE_INT, 1}, {"name", Table::TBL_TYPE_VCHAR, 40}, {"age", Table::TBL_TYPE_SHORT, 1}});
+
+	Table::insert_stmt_t stmt;
+	Table::prepare_insert(dbfile, "scan", {"id", "name", "age"}, stmt);
+	std::vector<Table::row_t> rows;
+	for(size_t i = 0; i < num_rows; i++)
+		rows.push_back({Page::val_int(i), Page::val_str("Someone", 7), Page::val_short((i * 7919) % 100)});
+	Table::insert_rows(dbfile, stmt, rows);
+
+	/* WHERE age >= 20 AND age < 30 */
+	std::vector<Table::scan_pred_t> preds = {{"age", Table::SCAN_GE, Page::val_short(20), 0},
+	                                         {"age", Table::SCAN_LT, Page::val_short(30), 0}};
+	const int reps = 5;
+
+	/*********************************** ONE THREAD ***************************************/
+
+	Table::vscan_cursor_t* vcur = new Table::vscan_cursor_t;
+	size_t matched = 0;
+	double start = Bench::now_sec();
+	for(int r = 0; r < reps; r++)
+	{
+		Table::vscan_open(dbfile, "scan", preds, {}, *vcur);
+		while(Table::vscan_next(*vcur))
+			matched += vcur->num_sel;
+	}
+	Bench::report("pscan", "vscan", num_rows * reps, Bench::now_sec() - start);
+	delete vcur;
+
+	/************************************* PARALLEL ***************************************/
+
+	unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+	for(unsigned nthreads = 1; nthreads <= std::max(cores, 4u); nthreads *= 2)
+	{
+		size_t pmatched = 0;
+		start = Bench::now_sec();
+		for(int r = 0; r < reps; r++)
+			pmatched += Table::pscan_count(dbfile, "scan", preds, nthreads);
+		Bench::report("pscan", "pscan_" + std::to_string(nthreads), num_rows * reps, Bench::now_sec() - start);
+
+		if(pmatched != matched)
+		{
+			fprintf(stderr, "pscan on %u workers matched %zu rows, vscan matched %zu\n", nthreads, pmatched, matched);
+			return 1;
+		}
+	}
+
+	Buffer_mgr::shutdown(dbfile);
+	dbfile.close();
+	remove(db_name);
+	return 0;
+}
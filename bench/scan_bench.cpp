@@ -0,0 +1,85 @@
+/**************************************************************************************************
+* Filename:   scan_bench.cpp
+* Details:    Rows/sec of a filtered table scan: the row-at-a-time "scan_next()" against the
+*             vectorized "vscan_next()" with AVX2, SSE2 and scalar filter kernels.
+*             Usage: ./<executable> [num_rows]
+**************************************************************************************************/
+
+/****************************************** HEADER FILES *****************************************/
+
+#include "bench_util.h"
+#include "../table_mgr/table_scan.h"
+
+/************************************** BENCH IMPLEMENTATION *************************************/
+
+int main(int argc, char* argv[])
+{
+	size_t num_rows = argc > 1 ? atol(argv[1]) : 1000000;
+	const char db_name[] = "bench_db.dat";
+	uint16_t npages = std::min<size_t>(8000, num_rows / 500 + 100);
+
+	/* Keep the whole table in the pool, so only decoding and filtering are measured */
+	Bench::fresh_db(db_name, npages, npages);
+	std::fstream dbfile(db_name, std::ios::in | std::ios::out | std::ios::binary);
+	Table::create_table(dbfile, "scan", {{"id", Table::TBL_TYPE_INT, 1}, {"name", Table::TBL_TYPE_VCHAR, 40}, {"age", Table::TBL_TYPE_SHORT, 1}});
+
+	Table::insert_stmt_t stmt;
+	Table::prepare_insert(dbfile, "scan", {"id", "name", "age"}, stmt);
+	std::vector<Table::row_t> rows;
+	for(size_t i = 0; i < num_rows; i++)
+		rows.push_back({Page::val_int(i), Page::val_str("Someone", 7), Page::val_short((i * 7919) % 100)});
+	Table::insert_rows(dbfile, stmt, rows);
+
+	/* WHERE age >= 20 AND age < 30 AND id >= num_rows / 2, projecting id */
+	std::vector<Table::scan_pred_t> preds = {{"age", Table::SCAN_GE, Page::val_short(20), 0},
+	                                         {"age", Table::SCAN_LT, Page::val_short(30), 0},
+	                                         {"id", Table::SCAN_GE, Page::val_int(num_rows / 2), 0}};
+	const int reps = 5;
+
+	/********************************* ROW AT A TIME *************************************/
+
+	Table::scan_cursor_t cur;
+	Table::row_t row;
+	Table::RID rid;
+	size_t matched = 0;
+	double start = Bench::now_sec();
+	for(int r = 0; r < reps; r++)
+	{
+		Table::scan_open(dbfile, "scan", preds, {"id"}, cur);
+		while(Table::scan_next(cur, row, rid))
+			matched++;
+	}
+	Bench::report("scan", "scan_next", num_rows * reps, Bench::now_sec() - start);
+
+	/*********************************** VECTORIZED ***************************************/
+
+	const char* names[] = {"vscan_scalar", "vscan_sse2", "vscan_avx2"};
+	for(int level = Page::VEC_AVX2; level >= Page::VEC_SCALAR; level--)
+	{
+		if(Page::vec_set_level(level) != level)
+			continue; // not supported by this CPU
+
+		Table::vscan_cursor_t* vcur = new Table::vscan_cursor_t;
+		size_t vmatched = 0;
+		start = Bench::now_sec();
+		for(int r = 0; r < reps; r++)
+		{
+			Table::vscan_open(dbfile, "scan", preds, {"id"}, *vcur);
+			while(Table::vscan_next(*vcur))
+				vmatched += vcur->num_sel;
+		}
+		Bench::report("scan", names[level], num_rows * reps, Bench::now_sec() - start);
+		delete vcur;
+
+		if(vmatched != matched)
+		{
+			fprintf(stderr, "%s matched %zu rows, scan_next matched %zu\n", names[level], vmatched, matched);
+			return 1;
+		}
+	}
+
+	Buffer_mgr::shutdown(dbfile);
+	dbfile.close();
+	remove(db_name);
+	return 0;
+}
@@ -0,0 +1,323 @@
+/**************************************************************************************************
+* Filename:   server_bench.cpp
+* Details:    Load generator for the server ("server/server.h"): several connections insert rows
+*             in batches, look them up by key one request at a time and pipelined, and count them
+*             with predicate scans. Prints requests/sec of each case and the latency of its
+*             requests (p50, p99, p99.9, max), from being sent to their response. Every row must
+*             be found. The server must already be listening at <socket_path>, on a fresh DB file.
+*             Usage: ./<executable> <socket_path> [num_rows] [connections] [depth]
+**************************************************************************************************/
+
+/****************************************** HEADER FILES *****************************************/
+
+#include "bench_util.h"
+#include "../server/protocol.h"
+#include "../table_mgr/table_scan.h"
+
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <unistd.h>
+
+/************************************** BENCH IMPLEMENTATION *************************************/
+
+const size_t BATCH_ROWS = 100; // rows per insert request
+const int32_t GROUPS = 10;     // rows are spread over this many values of "grp"
+
+/* Builds request <i> of connection <conn> into <out>, tagged <i> */
+typedef std::function<void(unsigned conn, size_t i, std::string &out)> make_t;
+
+/* Checks the payload of the response to request <i> of connection <conn> */
+typedef std::function<bool(unsigned conn, size_t i, Server::msg_reader_t &body)> check_t;
+
+/* Print the spread of the latencies of one case, in microseconds */
+static void report_latency(const std::string &which, std::vector<double> &lat)
+{
+	if(lat.empty())
+		return;
+	std::sort(lat.begin(), lat.end());
+	auto pct = [&lat](double p) { return 1e6 * lat[std::min(lat.size() - 1, (size_t)(p * lat.size()))]; };
+	printf("{\"bench\": \"server\", \"case\": \"%s_latency\", \"requests\": %zu, \"p50_us\": %.1f, \"p99_us\": %.1f, "
+	       "\"p999_us\": %.1f, \"max_us\": %.1f}\n", which.c_str(), lat.size(), pct(0.5), pct(0.99), pct(0.999), 1e6 * lat.back());
+	fflush(stdout);
+}
+
+/* Connect, giving a server that was just started a few seconds to listen */
+static int connect_server(const std::string &path)
+{
+	for(int tries = 0; ; tries++)
+	{
+		try
+		{
+			return Server::msg_connect(path);
+		}
+		catch(const Server::srv_error &)
+		{
+			if(tries == 100)
+				throw;
+			usleep(50000);
+		}
+	}
+}
+
+/* Send <n> requests on one connection, at most <depth> of them unanswered at a time, and check each response as it comes */
+static bool run_pipelined(int fd, unsigned conn, size_t n, unsigned depth, const make_t &make, const check_t &check, std::vector<double> &lat)
+{
+	Server::msg_inbox_t inbox;
+	inbox.fd = fd;
+	Server::msg_reader_t body;
+	std::vector<double> sent_at(n);
+	std::string out;
+	size_t next = 0;
+	for(size_t done = 0; done < n; done++)
+	{
+		out.clear();
+		double now = Bench::now_sec();
+		for(; next < n && next - done < depth; next++)
+		{
+			make(conn, next, out);
+			sent_at[next] = now;
+		}
+		if(!out.empty())
+			Server::msg_send_all(fd, out.data(), out.size());
+
+		if(!Server::msg_recv_frame(inbox, body))
+		{
+			fprintf(stderr, "the server hung up\n");
+			return false;
+		}
+		lat.push_back(Bench::now_sec() - sent_at[done]);
+		uint32_t tag = Server::msg_get_u32(body);
+		BYTE status = Server::msg_get_u8(body);
+		if(status != Server::SRV_OK)
+		{
+			fprintf(stderr, "request %u failed: %s\n", tag, Server::msg_get_str(body).c_str());
+			return false;
+		}
+		if(tag != done || !check(conn, done, body))
+		{
+			fprintf(stderr, "wrong response to request %zu (tag %u)\n", done, tag);
+			return false;
+		}
+	}
+	return true;
+}
+
+/* Run <per_conn> requests on each of <nconns> connections side by side, and report the case */
+static bool run_clients(const std::string &path, const std::string &which, unsigned nconns, size_t per_conn, unsigned depth,
+                        uint64_t ops_per_request, const make_t &make, const check_t &check)
+{
+	std::vector<std::vector<double>> lats(nconns);
+	std::vector<int> fds;
+	for(unsigned c = 0; c < nconns; c++)
+		fds.push_back(connect_server(path));
+
+	std::atomic<bool> failed(false);
+	std::vector<std::thread> threads;
+	double start = Bench::now_sec();
+	for(unsigned c = 0; c < nconns; c++)
+		threads.emplace_back([&, c]() {
+			try
+			{
+				if(!run_pipelined(fds[c], c, per_conn, depth, make, check, lats[c]))
+					failed = true;
+			}
+			catch(const std::exception &e)
+			{
+				fprintf(stderr, "%s: %s\n", which.c_str(), e.what());
+				failed = true;
+			}
+		});
+	for(std::thread &th : threads)
+		th.join();
+	Bench::report("server", which, nconns * per_conn * ops_per_request, Bench::now_sec() - start);
+
+	std::vector<double> all;
+	for(unsigned c = 0; c < nconns; c++)
+	{
+		all.insert(all.end(), lats[c].begin(), lats[c].end());
+		close(fds[c]);
+	}
+	report_latency(which, all);
+	return !failed;
+}
+
+/* Read the |ncols|nrows| of a rows response */
+static uint32_t rows_header(Server::msg_reader_t &body, uint16_t &ncols)
+{
+	ncols = Server::msg_get_u16(body);
+	return Server::msg_get_u32(body);
+}
+
+int main(int argc, char* argv[])
+{
+	if(argc < 2)
+	{
+		printf("ERROR: Use ./<executable> <socket_path> [num_rows] [connections] [depth] as format.\n");
+		return 1;
+	}
+	std::string path = argv[1];
+	size_t num_rows = argc > 2 ? atol(argv[2]) : 100000;
+	unsigned nconns = argc > 3 ? atoi(argv[3]) : 4;
+	unsigned depth = argc > 4 ? atoi(argv[4]) : 16;
+	size_t batches = std::max<size_t>(1, num_rows / BATCH_ROWS / nconns); // per connection
+	int32_t total = batches * nconns * BATCH_ROWS;
+	bool ok = true;
+	const std::string name = "Someone";
+
+	/***************************************** SETUP *****************************************/
+
+	std::string out;
+	size_t at = Server::msg_frame_begin(out, 0, Server::SRV_CREATE_TABLE);
+	Server::msg_put_str(out, "load");
+	Server::msg_put_u8(out, 0);
+	Server::msg_put_u16(out, 3);
+	for(const Table::col_def_t &col : std::vector<Table::col_def_t>{{"id", Table::TBL_TYPE_INT, 1}, {"name", Table::TBL_TYPE_VCHAR, 20},
+	                                                                 {"grp", Table::TBL_TYPE_INT, 1}})
+	{
+		Server::msg_put_str(out, col.name);
+		Server::msg_put_u16(out, col.type);
+		Server::msg_put_u16(out, col.size);
+	}
+	Server::msg_frame_end(out, at);
+	at = Server::msg_frame_begin(out, 1, Server::SRV_CREATE_INDEX);
+	Server::msg_put_str(out, "load_id");
+	Server::msg_put_str(out, "load");
+	Server::msg_put_str(out, "id");
+	Server::msg_put_u8(out, 1);
+	Server::msg_frame_end(out, at);
+	/* A table that is not there, with the longest name a str holds: an error whose text is longer still, and the connection
+	   goes on. A longer name is refused before it is sent */
+	at = Server::msg_frame_begin(out, 2, Server::SRV_LOOKUP);
+	Server::msg_put_str(out, std::string(UINT16_MAX, 'n'));
+	Server::msg_put_str(out, "id");
+	Server::msg_put_val(out, Page::val_int(0));
+	Server::msg_put_u16(out, 0);
+	Server::msg_frame_end(out, at);
+
+	try
+	{
+		std::string too_long;
+		Server::msg_put_str(too_long, std::string(UINT16_MAX + 1, 'n'));
+		std::cerr << "a string longer than a str holds was not refused" << std::endl;
+		return 1;
+	}
+	catch(const Server::srv_error &) {}
+
+	int fd = connect_server(path);
+	Server::msg_send_all(fd, out.data(), out.size());
+	Server::msg_inbox_t inbox;
+	inbox.fd = fd;
+	Server::msg_reader_t body;
+	for(uint32_t tag = 0; tag < 3; tag++)
+	{
+		if(!Server::msg_recv_frame(inbox, body) || Server::msg_get_u32(body) != tag)
+		{
+			std::cerr << "no response to setup request " << tag << std::endl;
+			return 1;
+		}
+		BYTE status = Server::msg_get_u8(body);
+		if(status != (tag == 2 ? Server::SRV_ERROR : Server::SRV_OK))
+		{
+			std::cerr << "setup request " << tag << ": " << (status == Server::SRV_OK ? "no error" : Server::msg_get_str(body)) << std::endl;
+			return 1;
+		}
+	}
+	close(fd);
+
+	/***************************************** INSERTS ***************************************/
+
+	ok &= run_clients(path, "insert_rows", nconns, batches, depth, BATCH_ROWS,
+		[&](unsigned conn, size_t i, std::string &out) {
+			size_t at = Server::msg_frame_begin(out, i, Server::SRV_INSERT);
+			Server::msg_put_str(out, "load");
+			Server::msg_put_u16(out, 3);
+			for(const char* col : {"id", "name", "grp"})
+				Server::msg_put_str(out, col);
+			Server::msg_put_u32(out, BATCH_ROWS);
+			int32_t first = (conn * batches + i) * BATCH_ROWS;
+			for(int32_t id = first; id < first + (int32_t)BATCH_ROWS; id++)
+			{
+				Server::msg_put_val(out, Page::val_int(id));
+				Server::msg_put_val(out, Page::val_str(name));
+				Server::msg_put_val(out, Page::val_int(id % GROUPS));
+			}
+			Server::msg_frame_end(out, at);
+		},
+		[](unsigned, size_t, Server::msg_reader_t &body) { return Server::msg_get_u32(body) == BATCH_ROWS; });
+
+	/***************************************** LOOKUPS ***************************************/
+
+	auto key_of = [total](unsigned conn, size_t i) { return (int32_t)((i * 2654435761u + conn * 40503u) % total); };
+	make_t lookup = [&](unsigned conn, size_t i, std::string &out) {
+		size_t at = Server::msg_frame_begin(out, i, Server::SRV_LOOKUP);
+		Server::msg_put_str(out, "load");
+		Server::msg_put_str(out, "id");
+		Server::msg_put_val(out, Page::val_int(key_of(conn, i)));
+		Server::msg_put_u16(out, 0);
+		Server::msg_frame_end(out, at);
+	};
+	check_t found = [&](unsigned conn, size_t i, Server::msg_reader_t &body) {
+		uint16_t ncols;
+		if(rows_header(body, ncols) != 1 || ncols != 3)
+			return false;
+		Page::value_t id = Server::msg_get_val(body);
+		return id.type == Page::RTYPE_INT && id.i == key_of(conn, i);
+	};
+	size_t lookups = std::max<size_t>(1, std::min<size_t>(total, 100000) / nconns);
+	ok &= run_clients(path, "lookup_depth1", nconns, lookups / 4 + 1, 1, 1, lookup, found);
+	ok &= run_clients(path, "lookup_pipelined", nconns, lookups, depth, 1, lookup, found);
+
+	/****************************************** SCANS ****************************************/
+
+	const size_t scans = 20; // per connection ; each one reads the whole table
+	ok &= run_clients(path, "scan_count", nconns, scans, depth, 1,
+		[](unsigned conn, size_t i, std::string &out) {
+			size_t at = Server::msg_frame_begin(out, i, Server::SRV_SCAN);
+			Server::msg_put_str(out, "load");
+			Server::msg_put_u16(out, 1);
+			Server::msg_put_str(out, "grp");
+			Server::msg_put_u8(out, Table::SCAN_EQ);
+			Server::msg_put_val(out, Page::val_int((conn + i) % GROUPS));
+			Server::msg_put_u16(out, 0);
+			Server::msg_put_u8(out, Server::SRV_SCAN_COUNT);
+			Server::msg_put_u32(out, 0);
+			Server::msg_frame_end(out, at);
+		},
+		[total](unsigned, size_t, Server::msg_reader_t &body) {
+			uint16_t ncols;
+			return rows_header(body, ncols) == (uint32_t)(total / GROUPS);
+		});
+
+	const uint32_t limit = 100;
+	ok &= run_clients(path, "scan_rows", nconns, scans, depth, 1,
+		[](unsigned conn, size_t i, std::string &out) {
+			size_t at = Server::msg_frame_begin(out, i, Server::SRV_SCAN);
+			Server::msg_put_str(out, "load");
+			Server::msg_put_u16(out, 1);
+			Server::msg_put_str(out, "id");
+			Server::msg_put_u8(out, Table::SCAN_GE);
+			Server::msg_put_val(out, Page::val_int(conn * 1000 + i));
+			Server::msg_put_u16(out, 2);
+			Server::msg_put_str(out, "id");
+			Server::msg_put_str(out, "name");
+			Server::msg_put_u8(out, 0);
+			Server::msg_put_u32(out, limit);
+			Server::msg_frame_end(out, at);
+		},
+		[&](unsigned conn, size_t i, Server::msg_reader_t &body) {
+			uint16_t ncols;
+			uint32_t n = rows_header(body, ncols);
+			bool right = ncols == 2 && n == std::min<uint32_t>(limit, total - std::min<int32_t>(total, conn * 1000 + i));
+			for(uint32_t r = 0; right && r < n; r++)
+				right = Server::msg_get_val(body).i >= (int32_t)(conn * 1000 + i) && Server::msg_get_val(body).str.len == name.size();
+			return right;
+		});
+
+	if(!ok)
+	{
+		std::cerr << "the server lost rows or answered wrongly" << std::endl;
+		return 1;
+	}
+	return 0;
+}
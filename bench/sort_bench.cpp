@@ -0,0 +1,78 @@
+/**************************************************************************************************
+* Filename:   sort_bench.cpp
+* Details:    Rows/sec of ORDER BY over a table sorted in memory and with a small memory budget, so
+*             runs go to temp pages and are merged, and of building a B+tree from sorted entries.
+*             Usage: ./<executable> [num_rows]
+**************************************************************************************************/
+
+/****************************************** HEADER FILES *****************************************/
+
+#include "bench_util.h"
+#include "../index_mgr/index_mgr.h"
+#include "../table_mgr/external_sort.h"
+
+/************************************** BENCH IMPLEMENTATION *************************************/
+
+int main(int argc, char* argv[])
+{
+	size_t num_rows = argc > 1 ? atol(argv[1]) : 100000;
+	const char db_name[] = "bench_db.dat";
+	uint16_t npages = std::min<size_t>(8000, num_rows / 100 + 200); // the table, then room for runs and the index
+
+	/* Keep everything in the pool, so only the sort is measured */
+	Bench::fresh_db(db_name, npages, npages);
+	std::fstream dbfile(db_name, std::ios::in | std::ios::out | std::ios::binary);
+	Table::create_table(dbfile, "sorted", {{"id", Table::TBL_TYPE_INT, 1}, {"name", Table::TBL_TYPE_VCHAR, 16}});
+
+	std::vector<std::string> names;
+	for(size_t i = 0; i < num_rows; i++)
+		names.push_back("name-" + std::to_string((i * 7919) % num_rows));
+	std::vector<Table::row_t> rows;
+	for(size_t i = 0; i < num_rows; i++)
+		rows.push_back({Page::val_int((i * 104729) % num_rows), Page::val_str(names[i])});
+	Table::insert_stmt_t stmt;
+	Table::prepare_insert(dbfile, "sorted", {"id", "name"}, stmt);
+	Table::insert_rows(dbfile, stmt, rows);
+	bool ok = true;
+
+	/*************************************** ORDER BY ***************************************/
+
+	/* ORDER BY name DESC, id */
+	struct { const char* name; size_t budget; } cases[] = {{"order_by_in_memory", Table::SORT_MEM_BUDGET},
+	                                                       {"order_by_external", 256 * 1024}};
+	for(const auto &c : cases)
+	{
+		Table::order_cursor_t cur;
+		Table::row_t row;
+		std::string last;
+		size_t n = 0;
+		double start = Bench::now_sec();
+		Table::order_open(dbfile, "sorted", {}, {{"name", true}, {"id", false}}, {"name"}, cur, c.budget);
+		while(Table::order_next(cur, row))
+		{
+			std::string name(row[0].str.ptr, row[0].str.len);
+			ok &= n == 0 || name <= last;
+			last.swap(name);
+			n++;
+		}
+		Bench::report("sort", c.name, num_rows, Bench::now_sec() - start);
+		ok &= n == num_rows;
+	}
+
+	/************************************* INDEX BUILD **************************************/
+
+	double start = Bench::now_sec();
+	Index::create_index(dbfile, "sorted_name", "sorted", "name");
+	Bench::report("sort", "btree_bulk_build", num_rows, Bench::now_sec() - start);
+
+	Buffer_mgr::shutdown(dbfile);
+	dbfile.close();
+	remove(db_name);
+
+	if(!ok)
+	{
+		std::cerr << "rows came back out of order" << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,118 @@
+/**************************************************************************************************
+* Filename:   txn_bench.cpp
+* Details:    Rows/sec of "insert_rows()" in batches, each batch its own transaction, committed
+*             explicitly per batch, or aborted; and of "insert_into()" one row per transaction
+*             against many rows in one transaction. Committed rows must all be there, and aborted
+*             ones, along with the pages they took, must be gone.
+*             Usage: ./<executable> [num_rows]
+**************************************************************************************************/
+
+/****************************************** HEADER FILES *****************************************/
+
+#include "bench_util.h"
+#include "../table_mgr/table_scan.h"
+#include "../table_mgr/transaction.h"
+
+/************************************** BENCH IMPLEMENTATION *************************************/
+
+const size_t BATCH_ROWS = 1000; // rows per "insert_rows()"
+
+/* Rows of the table one scan sees */
+static size_t count_rows(file_descriptor_t &dbfile, const std::string &table)
+{
+	Table::scan_cursor_t cur;
+	Table::row_t row;
+	Table::RID rid;
+	size_t count = 0;
+	Table::scan_open(dbfile, table, {}, {"id"}, cur);
+	while(Table::scan_next(cur, row, rid))
+		count++;
+	return count;
+}
+
+static uint16_t free_pages(file_descriptor_t &dbfile)
+{
+	return static_cast<Page_file::page_free_t*>(Buffer_mgr::buf_read(dbfile, Page_file::PGF_PAGES_FREE_ID))->size;
+}
+
+int main(int argc, char* argv[])
+{
+	size_t num_rows = argc > 1 ? atol(argv[1]) : 100000;
+	size_t batches = std::max<size_t>(1, num_rows / BATCH_ROWS);
+	const char db_name[] = "bench_db.dat";
+	uint16_t npages = std::min<size_t>(8000, 3 * batches * BATCH_ROWS / 400 + 200);
+	bool ok = true;
+
+	Bench::fresh_db(db_name, npages, npages);
+	std::fstream dbfile(db_name, std::ios::in | std::ios::out | std::ios::binary);
+	std::vector<Table::col_def_t> cols = {{"id", Table::TBL_TYPE_INT, 1}, {"name", Table::TBL_TYPE_VCHAR, 20}};
+	for(const char* name : {"own", "explicit", "aborted", "single", "grouped"})
+		Table::create_table(dbfile, name, cols);
+
+	std::vector<Table::row_t> rows;
+	for(size_t i = 0; i < BATCH_ROWS; i++)
+		rows.push_back({Page::val_int(i), Page::val_str("Someone", 7)});
+
+	/************************************** BATCHES ******************************************/
+
+	Table::insert_stmt_t stmt;
+	Table::prepare_insert(dbfile, "own", {"id", "name"}, stmt);
+	double start = Bench::now_sec();
+	for(size_t b = 0; b < batches; b++)
+		Table::insert_rows(dbfile, stmt, rows);
+	Bench::report("txn", "batch_own", batches * BATCH_ROWS, Bench::now_sec() - start);
+	ok &= count_rows(dbfile, "own") == batches * BATCH_ROWS;
+
+	Table::txn_t txn;
+	Table::prepare_insert(dbfile, "explicit", {"id", "name"}, stmt);
+	start = Bench::now_sec();
+	for(size_t b = 0; b < batches; b++)
+	{
+		Table::txn_begin(dbfile, txn);
+		Table::insert_rows(dbfile, stmt, rows);
+		Table::txn_commit(txn);
+	}
+	Bench::report("txn", "batch_commit", batches * BATCH_ROWS, Bench::now_sec() - start);
+	ok &= count_rows(dbfile, "explicit") == batches * BATCH_ROWS;
+
+	uint16_t free_before = free_pages(dbfile);
+	Table::prepare_insert(dbfile, "aborted", {"id", "name"}, stmt);
+	start = Bench::now_sec();
+	for(size_t b = 0; b < batches; b++)
+	{
+		Table::txn_begin(dbfile, txn);
+		Table::insert_rows(dbfile, stmt, rows);
+		Table::txn_abort(txn);
+	}
+	Bench::report("txn", "batch_abort", batches * BATCH_ROWS, Bench::now_sec() - start);
+	ok &= count_rows(dbfile, "aborted") == 0 && free_pages(dbfile) == free_before;
+
+	/*************************************** SINGLE ROWS *************************************/
+
+	size_t singles = std::min<size_t>(num_rows, 20000);
+	std::vector<Table::colval_t> vals = {{"id", "1"}, {"name", "Someone"}};
+	start = Bench::now_sec();
+	for(size_t i = 0; i < singles; i++)
+		Table::insert_into(dbfile, "single", vals);
+	Bench::report("txn", "row_own", singles, Bench::now_sec() - start);
+	ok &= count_rows(dbfile, "single") == singles;
+
+	start = Bench::now_sec();
+	Table::txn_begin(dbfile, txn);
+	for(size_t i = 0; i < singles; i++)
+		Table::insert_into(dbfile, "grouped", vals);
+	Table::txn_commit(txn);
+	Bench::report("txn", "row_grouped", singles, Bench::now_sec() - start);
+	ok &= count_rows(dbfile, "grouped") == singles;
+
+	Buffer_mgr::shutdown(dbfile);
+	dbfile.close();
+	remove(db_name);
+
+	if(!ok)
+	{
+		std::cerr << "transactions lost committed rows or kept aborted ones" << std::endl;
+		return 1;
+	}
+	return 0;
+}
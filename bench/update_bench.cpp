@@ -0,0 +1,244 @@
+/**************************************************************************************************
+* Filename:   update_bench.cpp
+* Details:    Rows/sec of "update_where()" and "delete_where()" over large ranges of an indexed
+*             table: an update that writes new versions, the same update repeated in one
+*             transaction (rewritten in place), a delete, and for comparison the same kind of
+*             update done a row at a time through the index, each with the buffer pool and file IO
+*             it did. The rows every scan sees afterwards are checked, and again in a second run of
+*             the program on the file it left, which must find the same rows and vacuum away every
+*             version the first one deleted. That vacuum runs beside an open snapshot, so the pages it
+*             takes out are still waiting when it ends, and a third run must free them.
+*             Usage: ./<executable> [num_rows]
+**************************************************************************************************/
+
+/****************************************** HEADER FILES *****************************************/
+
+#include "bench_util.h"
+#include "../table_mgr/table_modify.h"
+#include "../table_mgr/transaction.h"
+#include "../table_mgr/vacuum.h"
+#include "../index_mgr/index_mgr.h"
+#include "../index_mgr/btree.h"
+#include "../lock_mgr/lock_mgr.h"
+
+/************************************** BENCH IMPLEMENTATION *************************************/
+
+/* Rows of the table whose <val> is <val>, and all of its rows */
+static void count_rows(file_descriptor_t &dbfile, int32_t val, size_t &matching, size_t &total)
+{
+	Table::scan_cursor_t cur;
+	Table::row_t row;
+	Table::RID rid;
+	matching = total = 0;
+	Table::scan_open(dbfile, "upd", {}, {"val"}, cur);
+	while(Table::scan_next(cur, row, rid))
+	{
+		matching += row[0].i == val;
+		total++;
+	}
+}
+
+/* Print what an update or delete did, beside its throughput */
+static void report_stats(const std::string &which, const Table::modify_stats_t &stats)
+{
+	printf("{\"bench\": \"update\", \"case\": \"%s_stats\", \"rows\": %zu, \"in_place\": %zu, \"same_page\": %zu, \"moved\": %zu, \"pages\": %zu}\n",
+	       which.c_str(), stats.rows, stats.in_place, stats.same_page, stats.moved, stats.pages);
+	fflush(stdout);
+}
+
+/* Versions the first run deletes: the old one of every row the updates and the row at a time updates give a new one, and
+   every row the delete takes */
+static size_t deleted_versions(size_t num_rows, size_t half, size_t by_row)
+{
+	return half + half + by_row + (num_rows - half);
+}
+
+/* Pages on the file's free list */
+static uint16_t free_pages(file_descriptor_t &dbfile)
+{
+	uint16_t size = static_cast<Page_file::page_free_t*>(Buffer_mgr::buf_pin(dbfile, Page_file::PGF_PAGES_FREE_ID))->size;
+	Buffer_mgr::buf_unpin(Page_file::PGF_PAGES_FREE_ID);
+	return size;
+}
+
+/* The third run: the pages the second one's vacuum left waiting go back to the free list */
+static int check_released(const char db_name[], uint16_t npages, size_t waiting)
+{
+	Buffer_mgr::initialize(npages);
+	std::fstream dbfile(db_name, std::ios::in | std::ios::out | std::ios::binary);
+	uint16_t before = free_pages(dbfile);
+	size_t still = Table::vacuum_release(dbfile);
+	uint16_t after = free_pages(dbfile);
+	printf("{\"bench\": \"update\", \"case\": \"released\", \"pages\": %u}\n", after - before);
+	Buffer_mgr::shutdown(dbfile);
+	dbfile.close();
+	if(still != 0 || after - before != (int)waiting)
+	{
+		std::cerr << "the pages a vacuum left waiting were not freed after a restart" << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
+/* The second run: the file the first one left, opened by a program with none of its versions in memory */
+static int check_reopened(const char* program, const char db_name[], size_t num_rows, uint16_t npages)
+{
+	Buffer_mgr::initialize(npages);
+	std::fstream dbfile(db_name, std::ios::in | std::ios::out | std::ios::binary);
+	size_t half = num_rows / 2, by_row = std::min<size_t>(num_rows - half, 10000);
+	size_t matching, total;
+	count_rows(dbfile, 3, matching, total);
+	bool ok = matching == half && total == half;
+
+	/* Index entries of the deleted versions are still there until the vacuum, and must not be seen */
+	Table::index_def_t idx = Index::find_index(dbfile, "upd_id");
+	std::vector<Table::RID> rids;
+	Table::snapshot_t snap;
+	Table::snapshot_open(snap);
+	for(int32_t key : {0, (int32_t)half - 1, (int32_t)half, (int32_t)num_rows - 1})
+	{
+		Index::bt_lookup(dbfile, idx, Page::val_int(key), rids);
+		size_t seen = 0;
+		for(Table::RID rid : rids)
+			seen += Table::mvcc_visible(snap, Buffer_mgr::buf_read(dbfile, rid.page_id), rid);
+		ok &= seen == (key < (int32_t)half ? 1u : 0u);
+	}
+	Table::snapshot_close(snap);
+
+	/* A reader open throughout keeps the pages the vacuum takes out waiting, until the program ends */
+	Table::snapshot_t reader;
+	Table::snapshot_open(reader);
+	Table::vacuum_stats_t vs = Table::vacuum_table(dbfile, "upd");
+	size_t waiting = Table::vacuum_release(dbfile);
+	Table::snapshot_close(reader);
+	count_rows(dbfile, 3, matching, total);
+	ok &= vs.reclaimed >= deleted_versions(num_rows, half, by_row) && matching == half && total == half && waiting > 0;
+	printf("{\"bench\": \"update\", \"case\": \"reopened\", \"rows\": %zu, \"reclaimed\": %zu, \"pages_before\": %zu, \"pages_after\": %zu, \"waiting\": %zu}\n",
+	       total, vs.reclaimed, vs.pages_before, vs.pages_after, waiting);
+	Buffer_mgr::shutdown(dbfile);
+	dbfile.close();
+	fflush(stdout);
+	std::string again = std::string(program) + " " + std::to_string(num_rows) + " released " + std::to_string(waiting);
+	ok &= system(again.c_str()) == 0;
+	if(!ok)
+	{
+		std::cerr << "the rows deleted or updated before the file was closed came back" << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
+int main(int argc, char* argv[])
+{
+	size_t num_rows = argc > 1 ? atol(argv[1]) : 100000;
+	const char db_name[] = "bench_db.dat";
+	uint16_t npages = std::min<size_t>(16000, num_rows / 60 + 200);
+	if(argc > 2 && std::string(argv[2]) == "reopened")
+		return check_reopened(argv[0], db_name, num_rows, npages);
+	if(argc > 3 && std::string(argv[2]) == "released")
+		return check_released(db_name, npages, atol(argv[3]));
+
+	Bench::fresh_db(db_name, npages, npages);
+	std::fstream dbfile(db_name, std::ios::in | std::ios::out | std::ios::binary);
+	Table::create_table(dbfile, "upd", {{"id", Table::TBL_TYPE_INT, 1}, {"val", Table::TBL_TYPE_INT, 1}, {"name", Table::TBL_TYPE_VCHAR, 20}});
+
+	Table::insert_stmt_t stmt;
+	Table::prepare_insert(dbfile, "upd", {"id", "val", "name"}, stmt);
+	std::vector<Table::row_t> rows;
+	for(size_t i = 0; i < num_rows; i++)
+		rows.push_back({Page::val_int(i), Page::val_int(0), Page::val_str("Someone", 7)});
+	Table::insert_rows(dbfile, stmt, rows);
+	Index::create_index(dbfile, "upd_id", "upd", "id");
+	Buffer_mgr::flush_all(dbfile);
+	Io_stats::io_reset_stats();
+
+	bool ok = true;
+	size_t matching, total;
+	int32_t half = num_rows / 2;
+	std::vector<Table::scan_pred_t> first_half = {{"id", Table::SCAN_LT, Page::val_int(half), 0}};
+
+	/************************************* NEW VERSIONS ****************************************/
+
+	double start = Bench::now_sec();
+	Table::modify_stats_t stats = Table::update_where(dbfile, "upd", first_half, {{"val", Page::val_int(1)}});
+	Bench::report("update", "update_where", stats.rows, Bench::now_sec() - start);
+	report_stats("update_where", stats);
+	Bench::report_io("update", "update_where_io");
+	count_rows(dbfile, 1, matching, total);
+	ok &= stats.rows == (size_t)half && matching == (size_t)half && total == num_rows;
+
+	/************************** THE SAME ROWS AGAIN, IN ONE TRANSACTION ************************/
+
+	Table::txn_t txn;
+	Table::txn_begin(dbfile, txn);
+	start = Bench::now_sec();
+	Table::update_where(dbfile, "upd", first_half, {{"val", Page::val_int(2)}});
+	double first_secs = Bench::now_sec() - start;
+	start = Bench::now_sec();
+	stats = Table::update_where(dbfile, "upd", first_half, {{"val", Page::val_int(3)}});
+	double again_secs = Bench::now_sec() - start;
+	Table::txn_commit(txn);
+	Bench::report("update", "update_where_in_txn", stats.rows, first_secs);
+	Bench::report("update", "update_where_in_place", stats.rows, again_secs);
+	report_stats("update_where_in_place", stats);
+	Bench::report_io("update", "update_where_in_txn_io");
+	count_rows(dbfile, 3, matching, total);
+	ok &= stats.in_place == (size_t)half && matching == (size_t)half && total == num_rows;
+
+	/******************************** A ROW AT A TIME, BY INDEX ********************************/
+
+	/* Each row looked up through the index and updated in its own transaction, as a server request would */
+	size_t by_row = std::min<size_t>(num_rows - half, 10000);
+	Table::index_def_t idx = Index::find_index(dbfile, "upd_id");
+	std::vector<Table::RID> rids;
+	std::string rec;
+	Table::row_t row;
+	start = Bench::now_sec();
+	for(size_t i = half; i < half + by_row; i++)
+	{
+		Table::txn_scope_t scope(dbfile);
+		Lock_mgr::lock_table(scope.txn->xid, stmt.td.lock_id, Lock_mgr::LOCK_X);
+		Table::snapshot_t snap;
+		Table::snapshot_open(snap, scope.txn->xid);
+		Index::bt_lookup(dbfile, idx, Page::val_int(i), rids);
+		for(Table::RID rid : rids)
+		{
+			if(!Table::mvcc_visible(snap, Buffer_mgr::buf_read(dbfile, rid.page_id), rid))
+				continue;
+			Table::read_row(dbfile, rid, rec, row);
+			Table::delete_rows(dbfile, {rid});
+			row[1] = Page::val_int(4);
+			Table::insert_rows(dbfile, stmt, {row});
+		}
+		Table::snapshot_close(snap);
+	}
+	Bench::report("update", "update_by_row", by_row, Bench::now_sec() - start);
+	Bench::report_io("update", "update_by_row_io");
+	count_rows(dbfile, 4, matching, total);
+	ok &= matching == by_row && total == num_rows;
+
+	/****************************************** DELETE *****************************************/
+
+	start = Bench::now_sec();
+	stats = Table::delete_where(dbfile, "upd", {{"id", Table::SCAN_GE, Page::val_int(half), 0}});
+	Bench::report("update", "delete_where", stats.rows, Bench::now_sec() - start);
+	Bench::report_io("update", "delete_where_io");
+	count_rows(dbfile, 3, matching, total);
+	ok &= stats.rows == num_rows - half && matching == (size_t)half && total == (size_t)half;
+
+	/************************************ AFTER A RESTART **************************************/
+
+	Buffer_mgr::shutdown(dbfile);
+	dbfile.close();
+	fflush(stdout);
+	std::string again = std::string(argv[0]) + " " + std::to_string(num_rows) + " reopened";
+	ok &= system(again.c_str()) == 0;
+	remove(db_name);
+
+	if(!ok)
+	{
+		std::cerr << "updates or deletes left the wrong rows" << std::endl;
+		return 1;
+	}
+	return 0;
+}
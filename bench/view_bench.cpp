@@ -0,0 +1,157 @@
+/**************************************************************************************************
+* Filename:   view_bench.cpp
+* Details:    Rows/sec of reading a string column off pinned pages: copied out with
+*             "rec_upackstr()", read in place with a record view and with a column view, and
+*             through "scan_next()" on a row table and on a PAX table.
+*             Usage: ./<executable> [num_rows]
+**************************************************************************************************/
+
+/****************************************** HEADER FILES *****************************************/
+
+#include "bench_util.h"
+#include "../table_mgr/table_scan.h"
+#include "../paging/record_view.h"
+
+#include <functional>
+
+/************************************** BENCH IMPLEMENTATION *************************************/
+
+/* Call <visit> with every page of the table, pinned */
+static void each_page(file_descriptor_t &dbfile, const std::string &table, const std::function<void(void*)> &visit)
+{
+	Table::table_descriptor_t td;
+	Table::read_table_descriptor(dbfile, table, td);
+	for(uint16_t page_id = td.first_page; page_id != 0; )
+	{
+		void* page = Buffer_mgr::buf_pin(dbfile, page_id);
+		visit(page);
+		uint16_t next_page = static_cast<Table::table_page_t*>(page)->next_page;
+		Buffer_mgr::buf_unpin(page_id);
+		page_id = next_page;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	size_t num_rows = argc > 1 ? atol(argv[1]) : 100000;
+	const char db_name[] = "bench_db.dat";
+	uint16_t npages = std::min<size_t>(8000, num_rows / 40 + 100);
+
+	/* Keep both tables in the pool, so only reading the records is measured */
+	Bench::fresh_db(db_name, npages, npages);
+	std::fstream dbfile(db_name, std::ios::in | std::ios::out | std::ios::binary);
+	std::vector<Table::col_def_t> cols = {{"id", Table::TBL_TYPE_INT, 1}, {"name", Table::TBL_TYPE_VCHAR, 40},
+	                                      {"age", Table::TBL_TYPE_SHORT, 1}};
+	std::vector<std::string> names;
+	for(size_t i = 0; i < num_rows; i++)
+		names.push_back("customer name number " + std::to_string(i)); // past the small-string buffer
+	std::vector<Table::row_t> rows;
+	size_t expected = 0;
+	for(size_t i = 0; i < num_rows; i++)
+	{
+		rows.push_back({Page::val_int(i), Page::val_str(names[i]), Page::val_short(i % 100)});
+		expected += names[i].size();
+	}
+	for(uint16_t type : {Table::DB_TYPE_ROWS, Table::DB_TYPE_PAX})
+	{
+		std::string table = type == Table::DB_TYPE_PAX ? "pax" : "rows";
+		Table::create_table(dbfile, table, cols, type);
+		Table::insert_stmt_t stmt;
+		Table::prepare_insert(dbfile, table, {"id", "name", "age"}, stmt);
+		Table::insert_rows(dbfile, stmt, rows);
+	}
+
+	const int reps = 5;
+	bool ok = true;
+	size_t total;
+
+	/*********************************** ROW PAGES, ONE RECORD AT A TIME ************************************/
+
+	total = 0;
+	double start = Bench::now_sec();
+	for(int r = 0; r < reps; r++)
+	{
+		each_page(dbfile, "rows", [&](void* page) {
+			uint16_t next = 0, rec_id = 0;
+			for(BYTE* rec; (rec = Page::next_record(page, next)) != nullptr; rec_id = next)
+			{
+				if(PG_DIRECTORY(page)[rec_id] == Page::PG_REC_UNUSED)
+					continue;
+				unsigned short offset = sizeof(uint16_t);
+				Page::rec_upackint(rec, offset);
+				std::string name;
+				total += Page::rec_upackstr(rec, offset, name);
+			}
+		});
+	}
+	Bench::report("view", "rec_upackstr", num_rows * reps, Bench::now_sec() - start);
+	ok &= total == expected * reps;
+
+	total = 0;
+	start = Bench::now_sec();
+	for(int r = 0; r < reps; r++)
+	{
+		each_page(dbfile, "rows", [&](void* page) {
+			Page::record_view_t view;
+			for(uint16_t rec_id = 0; rec_id < *PG_NUM_RECORDS_PTR(page); rec_id++)
+			{
+				if(Page::rv_open(view, page, rec_id))
+					total += Page::rv_str(view, 1).size();
+			}
+		});
+	}
+	Bench::report("view", "record_view", num_rows * reps, Bench::now_sec() - start);
+	ok &= total == expected * reps;
+
+	/*********************************** A WHOLE COLUMN OF A PAGE AT A TIME **********************************/
+
+	for(const char* table : {"rows", "pax"})
+	{
+		total = 0;
+		start = Bench::now_sec();
+		for(int r = 0; r < reps; r++)
+		{
+			each_page(dbfile, table, [&](void* page) {
+				Page::column_view_t col;
+				Page::cv_open(col, page, 1);
+				for(uint16_t row = 0; row < Page::cv_count(col); row++)
+				{
+					if(Page::cv_is_live(col, row))
+						total += Page::cv_str(col, row).size();
+				}
+			});
+		}
+		Bench::report("view", std::string("column_view_") + table, num_rows * reps, Bench::now_sec() - start);
+		ok &= total == expected * reps;
+	}
+
+	/******************************************* THROUGH A SCAN *********************************************/
+
+	for(const char* table : {"rows", "pax"})
+	{
+		Table::scan_cursor_t cur;
+		Table::row_t row;
+		Table::RID rid;
+		total = 0;
+		start = Bench::now_sec();
+		for(int r = 0; r < reps; r++)
+		{
+			Table::scan_open(dbfile, table, {}, {"name"}, cur);
+			while(Table::scan_next(cur, row, rid))
+				total += row[0].str.len;
+		}
+		Bench::report("view", std::string("scan_next_") + table, num_rows * reps, Bench::now_sec() - start);
+		ok &= total == expected * reps;
+	}
+
+	Buffer_mgr::shutdown(dbfile);
+	dbfile.close();
+	remove(db_name);
+
+	if(!ok)
+	{
+		std::cerr << "string column totals do not match" << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -1,18 +1,25 @@
 #include "buffer_mgr.h"
+#include "../paging/io_stats.h"
+#include <algorithm>
+#include <cstring>
 #include <memory>
+#include <mutex>
 
 namespace Buffer_mgr {
   std::map<uint16_t, buffer_descriptor_t> page_pool;
   uint16_t pool_size;
   bool initialized = false;
   uint16_t num_dirty = 0;
-  std::list<buffer_descriptor_t> LRU; // timestamp, page_id
+  std::list<uint16_t> LRU; // page ids, most recently used first
+  std::recursive_mutex pool_mutex; // guards everything above
+  std::shared_mutex latches[BUF_LATCHES];
   bool full () {
     return (page_pool.size() >= pool_size);
   }
 };                                    // namespace Buffer_mgr
 
 void Buffer_mgr::initialize(uint16_t pool_sz) {
+  std::lock_guard<std::recursive_mutex> guard(pool_mutex);
   // Dirty pages should be flushed before initializing
   if (num_dirty) {
     throw buffering_error(
@@ -22,6 +29,7 @@ void Buffer_mgr::initialize(uint16_t pool_sz) {
   pool_size = pool_sz;
 }
 void Buffer_mgr::shutdown(file_descriptor_t &pfile) {
+  std::lock_guard<std::recursive_mutex> guard(pool_mutex);
   // Write all dirty pages to secondary storage
   flush_all(pfile);
   // reset the page pool
@@ -35,49 +43,40 @@ void Buffer_mgr::shutdown(file_descriptor_t &pfile) {
   initialized = false;
 }
 
-std::list<Buffer_mgr::buffer_descriptor_t>::iterator
-Buffer_mgr::find(uint16_t page_id) {
-  // Loop throug the LRU history and fine the page with the id
-  for (auto it = LRU.begin(); it != LRU.end(); it++) {
-    if (it->page_id == page_id) {
-      return it;
-    }
-  }
-
-  // Return end() if the page was not found
-  return LRU.end();
+std::list<uint16_t>::iterator Buffer_mgr::find(uint16_t page_id) {
+  // Every buffered page keeps its place in the LRU history, so no walk is needed
+  std::lock_guard<std::recursive_mutex> guard(pool_mutex);
+  auto it = page_pool.find(page_id);
+  return it == page_pool.end() ? LRU.end() : it->second.lru;
 }
 
 void Buffer_mgr::LRU_Remove(uint16_t page_id) {
-  // find if the page is in the LRU queue (should be unique)
-  auto lit = find(page_id);
-  if (lit != LRU.end()) {
-    LRU.erase(lit);
+  std::lock_guard<std::recursive_mutex> guard(pool_mutex);
+  auto it = page_pool.find(page_id);
+  if (it != page_pool.end() && it->second.lru != LRU.end()) {
+    LRU.erase(it->second.lru);
+    it->second.lru = LRU.end();
   }
 }
 
 void Buffer_mgr::LRU_update(uint16_t page_id) {
+  std::lock_guard<std::recursive_mutex> guard(pool_mutex);
+  auto it = page_pool.find(page_id);
+  if (it == page_pool.end()) {
+    throw buffering_error("LRU update of page that is not buffered");
+  }
 
-  // find if the page is in the LRU queue (should be unique)
-  auto lit = find(page_id);
-
-  // If found, update it (remove then insert at the beginning)
-  buffer_descriptor_t bd;
-  if (lit != LRU.end()) {
-    bd = *lit;
-    LRU.erase(lit);
+  // Move the page to the front (as most recently used), adding it if it has no history yet
+  if (it->second.lru != LRU.end()) {
+    LRU.splice(LRU.begin(), LRU, it->second.lru);
   } else {
-    // page not in LRU history, to add it to the front (as most recently used)
-    auto it = page_pool.find(page_id);
-    if (it == page_pool.end()) {
-      throw buffering_error("LRU update of page that is not buffered");
-    }
-    bd = it->second;
+    LRU.push_front(page_id);
   }
-  LRU.push_front(bd);
+  it->second.lru = LRU.begin();
 }
 
 void Buffer_mgr::flush(file_descriptor_t &pfile, uint16_t page_id) {
+  std::lock_guard<std::recursive_mutex> guard(pool_mutex);
   std::map<uint16_t, buffer_descriptor_t>::iterator it =
       page_pool.find(page_id);
   if (it == page_pool.end()) {
@@ -87,34 +86,43 @@ void Buffer_mgr::flush(file_descriptor_t &pfile, uint16_t page_id) {
     Page_file::pgf_write(pfile, page_id, it->second.page);
     it->second.dirty = false;
     num_dirty--;
+    Io_stats::io_count(Io_stats::IO_WRITEBACKS);
   }
   // LRU_Remove(page_id);  // What should we do with a flushed page?
 }
 
 void Buffer_mgr::flush_all(file_descriptor_t &pfile) {
+  std::lock_guard<std::recursive_mutex> guard(pool_mutex);
   if (!num_dirty) {
     return;
   }
-  for (std::pair<uint16_t, buffer_descriptor_t> one : page_pool) {
+  Io_stats::io_timer_t timer(Io_stats::IO_FLUSH_NS);
+  for (std::pair<const uint16_t, buffer_descriptor_t> &one : page_pool) {
     if (one.second.dirty) {
       Page_file::pgf_write(pfile, one.first, one.second.page);
       one.second.dirty = false;
       num_dirty--;
+      Io_stats::io_count(Io_stats::IO_WRITEBACKS);
     }
   }
 }
 
 void Buffer_mgr::buf_write(file_descriptor_t &pfile, int page_id) {
+  std::lock_guard<std::recursive_mutex> guard(pool_mutex);
   auto it = page_pool.find(page_id);
   if (it != page_pool.end()) {
-    it->second.dirty = true;
-    num_dirty++;
+    // a page already dirty is only counted once
+    if (!it->second.dirty) {
+      it->second.dirty = true;
+      num_dirty++;
+    }
   } else {
     throw buffering_error("Cannot write to page that is not buffered");
   }
 }
 // Read a page from disk to memory
 void *Buffer_mgr::buf_read(file_descriptor_t &pfile, int page_id) {
+  std::lock_guard<std::recursive_mutex> guard(pool_mutex);
   // see if it is already in the buffer pool
   std::map<uint16_t, buffer_descriptor_t>::iterator it =
       page_pool.find(page_id);
@@ -122,7 +130,10 @@ void *Buffer_mgr::buf_read(file_descriptor_t &pfile, int page_id) {
   void *retval = 0; 
   if (it != page_pool.end()) {
     retval = it->second.page;
+    Io_stats::io_count(Io_stats::IO_HITS);
   } else {
+    Io_stats::io_timer_t timer(Io_stats::IO_MISS_NS);
+    Io_stats::io_count(Io_stats::IO_MISSES);
     retval = (void *) new BYTE[PAGE_SIZE];
     std::unique_ptr<char> cleanup((char *) retval);
     // it was not buffered, so read it:
@@ -133,8 +144,9 @@ void *Buffer_mgr::buf_read(file_descriptor_t &pfile, int page_id) {
     if (full()) {
       replace(pfile);
     }
-    page_pool.insert(std::pair<uint16_t, buffer_descriptor_t>(
-        page_id, buffer_descriptor_t(page_id, retval, false)));
+    buffer_descriptor_t bd(page_id, retval, false);
+    bd.lru = LRU.end();
+    page_pool.insert(std::pair<uint16_t, buffer_descriptor_t>(page_id, bd));
 
     cleanup.release();
   }
@@ -143,25 +155,130 @@ void *Buffer_mgr::buf_read(file_descriptor_t &pfile, int page_id) {
   return retval;
 }
 
-uint16_t Buffer_mgr::replace(file_descriptor_t &pfile) {
-  // get the id of the oldest page
-  int16_t retval = LRU.back().page_id;
+void Buffer_mgr::buf_prefetch(file_descriptor_t &pfile, int first_page_id,
+                              int count) {
+  std::lock_guard<std::recursive_mutex> guard(pool_mutex);
+  // never take more than a quarter of the pool, so read ahead cannot push
+  // out the pages that are being worked on
+  count = std::min<int>(count, pool_size / 4);
 
-  // remove the page from the LRU history
-  LRU.pop_back();
+  // only the span between the first and last page not yet buffered is read
+  int lo = first_page_id + count, hi = first_page_id - 1;
+  for (int id = first_page_id; id < first_page_id + count; id++) {
+    if (page_pool.find(id) == page_pool.end()) {
+      lo = std::min(lo, id);
+      hi = std::max(hi, id);
+    }
+  }
+  if (hi - lo + 1 < 2) {
+    return; // a single page is read just as well by buf_read
+  }
 
-  // delete the page from the page pool
-  std::map<uint16_t, buffer_descriptor_t>::iterator it = page_pool.find(retval);
-  if (it == page_pool.end()) {
-    throw buffering_error("Page in LRU does not exist in pool");
+  // pages already buffered are newer than the copy read from disk, even if
+  // making room below writes one out and drops it
+  std::vector<bool> buffered(hi - lo + 1);
+  for (int id = lo; id <= hi; id++) {
+    buffered[id - lo] = page_pool.find(id) != page_pool.end();
   }
 
+  std::unique_ptr<BYTE[]> run(new BYTE[(size_t)PAGE_SIZE * (hi - lo + 1)]);
+  Page_file::pgf_read_run(pfile, lo, hi - lo + 1, run.get());
+
+  // add them last to first, so the first page to be used is the most recent
+  for (int id = hi; id >= lo; id--) {
+    if (buffered[id - lo] || page_pool.find(id) != page_pool.end()) {
+      continue;
+    }
+    if (full()) {
+      replace(pfile);
+    }
+    void *page = (void *) new BYTE[PAGE_SIZE];
+    memcpy(page, run.get() + (size_t)PAGE_SIZE * (id - lo), PAGE_SIZE);
+    buffer_descriptor_t bd(id, page, false);
+    bd.lru = LRU.end();
+    page_pool.insert(std::pair<uint16_t, buffer_descriptor_t>(id, bd));
+    LRU_update(id);
+    Io_stats::io_count(Io_stats::IO_PREFETCHED);
+  }
+}
+
+void *Buffer_mgr::buf_pin(file_descriptor_t &pfile, int page_id) {
+  std::lock_guard<std::recursive_mutex> guard(pool_mutex); // so the page cannot be replaced between the read and the pin
+  void *page = buf_read(pfile, page_id);
+  page_pool.find(page_id)->second.pin_count++;
+  return page;
+}
+
+void Buffer_mgr::buf_unpin(uint16_t page_id) {
+  std::lock_guard<std::recursive_mutex> guard(pool_mutex);
+  auto it = page_pool.find(page_id);
+  if (it == page_pool.end() || it->second.pin_count == 0) {
+    throw buffering_error("Cannot unpin a page that is not pinned");
+  }
+  it->second.pin_count--;
+}
+
+uint16_t Buffer_mgr::buf_pin_count(uint16_t page_id) {
+  std::lock_guard<std::recursive_mutex> guard(pool_mutex);
+  auto it = page_pool.find(page_id);
+  return it == page_pool.end() ? 0 : it->second.pin_count;
+}
+
+uint16_t Buffer_mgr::replace(file_descriptor_t &pfile) {
+  std::lock_guard<std::recursive_mutex> guard(pool_mutex);
+  // get the oldest page that is not pinned
+  auto lit = LRU.end();
+  std::map<uint16_t, buffer_descriptor_t>::iterator it;
+  do {
+    if (lit == LRU.begin()) {
+      throw buffering_error("Every page in the pool is pinned");
+    }
+    lit--;
+    it = page_pool.find(*lit);
+    if (it == page_pool.end()) {
+      throw buffering_error("Page in LRU does not exist in pool");
+    }
+  } while (it->second.pin_count > 0);
+  uint16_t retval = *lit;
+
+  // remove the page from the LRU history
+  LRU.erase(lit);
+
   // flush the page first
   flush(pfile, retval);
 
+  // delete the page from the page pool
   delete[] (char *) it->second.page;
 
   page_pool.erase(it);
+  Io_stats::io_count(Io_stats::IO_EVICTIONS);
 
   return retval;
-}
\ No newline at end of file
+}
+
+std::shared_mutex &Buffer_mgr::buf_latch(uint16_t page_id) {
+  return latches[page_id % BUF_LATCHES];
+}
+
+void Buffer_mgr::discard(uint16_t page_id) {
+  std::lock_guard<std::recursive_mutex> guard(pool_mutex);
+  auto it = page_pool.find(page_id);
+  if (it == page_pool.end()) {
+    return;
+  }
+  if (it->second.dirty) {
+    num_dirty--;
+  }
+  LRU_Remove(page_id);
+  delete[] (char *) it->second.page;
+  page_pool.erase(it);
+}
+
+void Buffer_mgr::buf_write_run(file_descriptor_t &pfile, int first_page_id,
+                               int count, void *pages_buf) {
+  std::lock_guard<std::recursive_mutex> guard(pool_mutex);
+  for (int i = 0; i < count; i++) {
+    discard(first_page_id + i); // never read a stale copy from the pool
+  }
+  Page_file::pgf_write_run(pfile, first_page_id, count, pages_buf);
+}
@@ -5,20 +5,35 @@
 
 #include <climits>
 #include <map>
+#include <shared_mutex>
 #include <string>
 #include <list>
 
 namespace Buffer_mgr {
-  // Note: all locking is handles by the lock manager, not here.
+  // Note: locking of page contents is handled by the lock manager (lock_mgr/lock_mgr.h), not here.
+  // The pool's own bookkeeping is guarded by one mutex, so pages can be read,
+  // pinned and unpinned from several threads; a page used by one thread while
+  // others read must be pinned, since an unpinned buffer may be replaced.
+  //
+  // Latches keep a reader from seeing a page half changed: whoever changes a
+  // page another thread may be reading holds its latch exclusively for the
+  // change, and a reader holds it shared just while it looks.  They are short
+  // and never held across calls, unlike the lock manager's locks.
+  //
+  // Hits, misses, evictions, writebacks and flushes are counted and timed in
+  // Io_stats (paging/io_stats.h), along with the file IO under them.
+
+  const uint16_t BUF_LATCHES = 1024; // page ids share latches modulo this
 
   struct buffer_descriptor_t {
     //buffer_descriptor_t(uint16_t pid, void *pg, bool dty) : page(pg), dirty(dty), page_id(pid) {}
-    buffer_descriptor_t(uint16_t pgid, void *pg, bool dty) : page(pg), dirty(dty), page_id(pgid) {}
-    buffer_descriptor_t() : page(0), dirty(false) {}
+    buffer_descriptor_t(uint16_t pgid, void *pg, bool dty) : page(pg), dirty(dty), page_id(pgid), pin_count(0) {}
+    buffer_descriptor_t() : page(0), dirty(false), pin_count(0) {}
     void *page;
     bool dirty;
     uint16_t page_id;
-    // need pinned
+    uint16_t pin_count; // a pinned page is never replaced
+    std::list<uint16_t>::iterator lru; // the page's place in the LRU history
   };
 
   class buffering_error : public std::runtime_error {
@@ -27,7 +42,8 @@ namespace Buffer_mgr {
     buffering_error(const char *what) : std::runtime_error(what) {}
   };
 
-  std::list<buffer_descriptor_t>::iterator find(uint16_t page_id);
+  // The page's place in the LRU history (end() if it is not buffered)
+  std::list<uint16_t>::iterator find(uint16_t page_id);
   
   void initialize(uint16_t pool_sz);
   void shutdown(file_descriptor_t &pfile);
@@ -44,6 +60,31 @@ namespace Buffer_mgr {
   // Read a page from disk to memory
   void *buf_read(file_descriptor_t &pfile, int page_id);
 
+  // Read up to <count> consecutive pages into the pool with one file read,
+  // ahead of a sequential scan.  Pages already buffered are left alone.
+  void buf_prefetch(file_descriptor_t &pfile, int first_page_id, int count);
+
+  // Read a page and pin it, so its buffer stays valid across other reads
+  // until it is unpinned.  Pins nest.
+  void *buf_pin(file_descriptor_t &pfile, int page_id);
+  void buf_unpin(uint16_t page_id);
+  // Pins on a page (0 if it is not buffered).  Someone who holds the page's
+  // latch exclusively and finds only their own pins knows no one is reading
+  // the page unlatched, as scans do with the page they are on.
+  uint16_t buf_pin_count(uint16_t page_id);
+
+  // The latch of a page, for a std::shared_lock or std::unique_lock.
+  std::shared_mutex &buf_latch(uint16_t page_id);
+
+  // Drop a page from the pool without writing it, for pages that are about
+  // to be written directly to the file.
+  void discard(uint16_t page_id);
+  // Write <count> page images straight to consecutive pages of the file,
+  // discarding any copy of them the pool holds.  Done under the pool's lock,
+  // as every other read and write of the file is, so no seek comes between.
+  void buf_write_run(file_descriptor_t &pfile, int first_page_id, int count,
+                     void *pages_buf);
+
   uint16_t replace(file_descriptor_t &pfile);
   bool full(); 
 
@@ -26,7 +26,7 @@ int main(int argc, char* argv[])
 
 	/********************************* FORMAT THE DB FILE IN BINARY ********************************/
 
-	uint16_t ref_num = 8; // the number of pages for the DB file
+	uint16_t ref_num = 16; // the number of pages for the DB file (pages 4-7 hold the catalog indexes)
 	uint16_t &num_pages = ref_num;
 	Table::tbl_format(test_db_name, num_pages);
 
@@ -131,6 +131,11 @@ int main(int argc, char* argv[])
 
 	Table::insert_into(pfile, table_name_0, vals_C);
 
+	/************************************** PRINT PERSON TABLE *************************************/
+
+	Table::print_master(pfile);
+	Table::print_table(pfile, table_name_0);
+
 	/******************************************** FINALIZE *****************************************/
 
 	Buffer_mgr::shutdown(pfile);
@@ -0,0 +1,604 @@
+/**************************************************************************************************
+* Filename:   btree.cpp
+* Details:    Implements the B+tree indexes declared in "btree.h".
+**************************************************************************************************/
+
+/****************************************** HEADER FILES *****************************************/
+
+#include "btree.h"
+#include "index_mgr.h"
+#include "../buffer_mgr/buffer_mgr.h"
+#include "../table_mgr/external_sort.h"
+#include "../table_mgr/transaction.h"
+
+#include <algorithm>
+
+/******************************************* CONSTANTS *******************************************/
+
+namespace Index
+{
+  const uint16_t BT_ENTRY_BYTES = sizeof(bt_node_t::entries);
+}
+
+/************************************ FUNCTION IMPLEMENTATIONS ***********************************/
+
+namespace Index
+{
+  /* Bytes of an internal entry: |key|RID|child| */
+  static uint16_t bt_inner_size(const Table::index_def_t &idx)
+  {
+    return bt_entry_size(idx) + sizeof(uint16_t);
+  }
+
+
+  static uint16_t bt_capacity(const Table::index_def_t &idx, bool leaf)
+  {
+    return BT_ENTRY_BYTES / (leaf ? bt_entry_size(idx) : bt_inner_size(idx));
+  }
+
+
+  static uint16_t bt_child(const Table::index_def_t &idx, bt_node_t* node, uint16_t i)
+  {
+    uint16_t child;
+    memcpy(&child, node->entries + i * bt_inner_size(idx) + bt_entry_size(idx), sizeof(uint16_t));
+    return child;
+  }
+
+
+  static Table::RID bt_entry_rid(const Table::index_def_t &idx, const BYTE* entry)
+  {
+    Table::RID rid;
+    memcpy(&rid, entry + idx.key_size, sizeof(Table::RID));
+    return rid;
+  }
+
+
+  /* A node is pinned for as long as it is used, so reading other pages cannot replace it ; every pin is matched by a
+     "Buffer_mgr::buf_unpin()" */
+  static bt_node_t* bt_pin(file_descriptor_t &dbfile, uint16_t page_id)
+  {
+    return static_cast<bt_node_t*>(Buffer_mgr::buf_pin(dbfile, page_id));
+  }
+
+
+  /* Take a page off the free list and format it as an empty node */
+  static uint16_t bt_new_node(file_descriptor_t &dbfile, bool leaf)
+  {
+    std::vector<uint16_t> ids;
+    Table::tbl_alloc_pages(dbfile, 1, ids);
+    Table::txn_touch(dbfile, ids[0]);
+    bt_node_t* node = bt_pin(dbfile, ids[0]);
+    memset((void*)node, 0, sizeof(bt_node_t));
+    node->leaf = leaf;
+    Buffer_mgr::buf_write(dbfile, ids[0]);
+    Buffer_mgr::buf_unpin(ids[0]);
+    return ids[0];
+  }
+
+
+  /* First position in the node whose |key|RID| is >= <target> (or > <target> when <upper> is set) */
+  static uint16_t bt_search(const Table::index_def_t &idx, bt_node_t* node, const BYTE* target, bool upper)
+  {
+    uint16_t size = node->leaf ? bt_entry_size(idx) : bt_inner_size(idx);
+    uint16_t lo = 0, hi = node->num_keys;
+    while(lo < hi)
+    {
+      uint16_t mid = (lo + hi) / 2;
+      int cmp = bt_cmp_entry(idx, node->entries + mid * size, target);
+      if(cmp < 0 || (upper && cmp == 0))
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    return lo;
+  }
+
+
+  /* The child of an internal node that holds <target> */
+  static uint16_t bt_descend(const Table::index_def_t &idx, bt_node_t* node, const BYTE* target)
+  {
+    uint16_t pos = bt_search(idx, node, target, true);
+    return pos == 0 ? node->first_child : bt_child(idx, node, pos - 1);
+  }
+
+
+  /* Put <ent> at <pos> of the node, splitting it when it is full. On a split, <up> gets the first |key|RID| of the new right node,
+     <up_child> its page, and true is returned */
+  static bool bt_node_put(file_descriptor_t &dbfile, const Table::index_def_t &idx, uint16_t page_id, uint16_t pos, const BYTE* ent,
+                          BYTE* up, uint16_t &up_child)
+  {
+    bt_node_t* node = bt_pin(dbfile, page_id);
+    bool leaf = node->leaf;
+    uint16_t size = leaf ? bt_entry_size(idx) : bt_inner_size(idx);
+    uint16_t n = node->num_keys;
+
+    if(n < bt_capacity(idx, leaf))
+    {
+      Table::txn_touch(dbfile, page_id);
+      memmove(node->entries + (pos + 1) * size, node->entries + pos * size, (n - pos) * size);
+      memcpy(node->entries + pos * size, ent, size);
+      node->num_keys++;
+      Buffer_mgr::buf_write(dbfile, page_id);
+      Buffer_mgr::buf_unpin(page_id);
+      return false;
+    }
+    Buffer_mgr::buf_unpin(page_id);
+
+    /* Allocating may throw when no page is free, so do it before holding on to the node */
+    uint16_t right_id = bt_new_node(dbfile, leaf);
+    Table::txn_touch(dbfile, page_id);
+    node = bt_pin(dbfile, page_id);
+
+    std::vector<BYTE> all((n + 1) * size);
+    memcpy(all.data(), node->entries, pos * size);
+    memcpy(all.data() + pos * size, ent, size);
+    memcpy(all.data() + (pos + 1) * size, node->entries + pos * size, (n - pos) * size);
+
+    uint16_t total = n + 1;
+    uint16_t mid = total / 2;
+    uint16_t right_first = leaf ? mid : mid + 1; // an internal split moves the middle entry up instead of copying it
+    uint16_t old_next = node->next_leaf;
+
+    memcpy(up, all.data() + mid * size, bt_entry_size(idx));
+    up_child = right_id;
+
+    node->num_keys = mid;
+    memcpy(node->entries, all.data(), mid * size);
+    if(leaf)
+      node->next_leaf = right_id;
+    Buffer_mgr::buf_write(dbfile, page_id);
+    Buffer_mgr::buf_unpin(page_id);
+
+    Table::txn_touch(dbfile, right_id);
+    bt_node_t* right = bt_pin(dbfile, right_id);
+    right->num_keys = total - right_first;
+    memcpy(right->entries, all.data() + right_first * size, right->num_keys * size);
+    if(leaf)
+      right->next_leaf = old_next;
+    else
+      memcpy(&right->first_child, all.data() + mid * size + bt_entry_size(idx), sizeof(uint16_t));
+    Buffer_mgr::buf_write(dbfile, right_id);
+    Buffer_mgr::buf_unpin(right_id);
+    return true;
+  }
+
+
+  /* Insert a leaf entry below <page_id> ; returns true (with <up>/<up_child> set) if <page_id> split */
+  static bool bt_insert_at(file_descriptor_t &dbfile, const Table::index_def_t &idx, uint16_t page_id, const BYTE* entry,
+                           BYTE* up, uint16_t &up_child)
+  {
+    bt_node_t* node = bt_pin(dbfile, page_id);
+    bool leaf = node->leaf;
+    uint16_t pos = bt_search(idx, node, entry, !leaf);
+    uint16_t child = leaf ? 0 : pos == 0 ? node->first_child : bt_child(idx, node, pos - 1);
+    Buffer_mgr::buf_unpin(page_id); // the child and the put below pin what they change themselves
+    if(leaf)
+      return bt_node_put(dbfile, idx, page_id, pos, entry, up, up_child);
+
+    BYTE sep[BT_MAX_ENTRY];
+    uint16_t new_child;
+    if(!bt_insert_at(dbfile, idx, child, entry, sep, new_child))
+      return false;
+
+    /* The child split, so its new right sibling goes in right after it */
+    memcpy(sep + bt_entry_size(idx), &new_child, sizeof(uint16_t));
+    return bt_node_put(dbfile, idx, page_id, pos, sep, up, up_child);
+  }
+
+
+  static void bt_insert_entry(file_descriptor_t &dbfile, Table::index_def_t &idx, const BYTE* entry)
+  {
+    BYTE up[BT_MAX_ENTRY];
+    uint16_t up_child;
+    if(!bt_insert_at(dbfile, idx, idx.root, entry, up, up_child))
+      return;
+
+    /* The root split: grow the tree by one level */
+    uint16_t new_root = bt_new_node(dbfile, false);
+    Table::txn_touch(dbfile, new_root);
+    bt_node_t* root = bt_pin(dbfile, new_root);
+    root->first_child = idx.root;
+    root->num_keys = 1;
+    memcpy(root->entries, up, bt_entry_size(idx));
+    memcpy(root->entries + bt_entry_size(idx), &up_child, sizeof(uint16_t));
+    Buffer_mgr::buf_write(dbfile, new_root);
+    Buffer_mgr::buf_unpin(new_root);
+
+    idx.root = new_root;
+    idx_update_master(dbfile, idx);
+  }
+
+
+  void bt_insert(file_descriptor_t &dbfile, Table::index_def_t &idx, const Page::value_t &key, Table::RID rid)
+  {
+    BYTE entry[BT_MAX_ENTRY];
+    if(!bt_make_key(idx, key, entry))
+      return;
+    memcpy(entry + idx.key_size, &rid, sizeof(Table::RID));
+    bt_insert_entry(dbfile, idx, entry);
+  }
+
+
+  void bt_insert_record(file_descriptor_t &dbfile, Table::index_def_t &idx, const BYTE* rec, Table::RID rid)
+  {
+    BYTE entry[BT_MAX_ENTRY];
+    if(!bt_key_from_record(idx, rec, entry))
+      return;
+    memcpy(entry + idx.key_size, &rid, sizeof(Table::RID));
+    bt_insert_entry(dbfile, idx, entry);
+  }
+
+
+  bool bt_delete_record(file_descriptor_t &dbfile, const Table::index_def_t &idx, const BYTE* rec, Table::RID rid)
+  {
+    BYTE entry[BT_MAX_ENTRY];
+    if(!bt_key_from_record(idx, rec, entry))
+      return false;
+    memcpy(entry + idx.key_size, &rid, sizeof(Table::RID));
+
+    /* Entries are unique by |key|RID|, so it can only be in the one leaf an insert of it would reach */
+    uint16_t page_id = idx.root;
+    bt_node_t* node = bt_pin(dbfile, page_id);
+    while(!node->leaf)
+    {
+      uint16_t child = bt_descend(idx, node, entry);
+      Buffer_mgr::buf_unpin(page_id);
+      page_id = child;
+      node = bt_pin(dbfile, page_id);
+    }
+    uint16_t size = bt_entry_size(idx);
+    uint16_t pos = bt_search(idx, node, entry, false);
+    if(pos >= node->num_keys || bt_cmp_entry(idx, node->entries + pos * size, entry) != 0)
+    {
+      Buffer_mgr::buf_unpin(page_id);
+      return false;
+    }
+
+    Table::txn_touch(dbfile, page_id);
+    memmove(node->entries + pos * size, node->entries + (pos + 1) * size, (node->num_keys - pos - 1) * size);
+    node->num_keys--;
+    Buffer_mgr::buf_write(dbfile, page_id);
+    Buffer_mgr::buf_unpin(page_id);
+    return true;
+  }
+
+
+  void bt_lookup(file_descriptor_t &dbfile, const Table::index_def_t &idx, const Page::value_t &key, std::vector<Table::RID> &rids)
+  {
+    rids.clear();
+    bt_cursor_t cur;
+    bt_open_range(dbfile, idx, &key, &key, cur);
+    Page::value_t found;
+    Table::RID rid;
+    while(bt_next(cur, found, rid))
+      rids.push_back(rid);
+  }
+
+
+  void bt_open_range(file_descriptor_t &dbfile, const Table::index_def_t &idx, const Page::value_t* lo, const Page::value_t* hi, bt_cursor_t &cur)
+  {
+    cur.dbfile = &dbfile;
+    cur.idx = &idx;
+    cur.pos = 0;
+    cur.has_hi = false;
+    if(hi != nullptr && hi->type != Page::RTYPE_NULL)
+    {
+      cur.hi.assign(idx.key_size, '\0');
+      cur.has_hi = bt_make_key(idx, *hi, (BYTE*)&cur.hi[0]);
+    }
+
+    if(lo == nullptr || lo->type == Page::RTYPE_NULL)
+    {
+      cur.leaf = idx.first_leaf;
+      return;
+    }
+
+    /* Descend towards |lo|lowest RID| */
+    BYTE target[BT_MAX_ENTRY] = {0};
+    bt_make_key(idx, *lo, target);
+    uint16_t page_id = idx.root;
+    bt_node_t* node = bt_pin(dbfile, page_id);
+    while(!node->leaf)
+    {
+      uint16_t child = bt_descend(idx, node, target);
+      Buffer_mgr::buf_unpin(page_id);
+      page_id = child;
+      node = bt_pin(dbfile, page_id);
+    }
+    cur.leaf = page_id;
+    cur.pos = bt_search(idx, node, target, false);
+    Buffer_mgr::buf_unpin(page_id);
+  }
+
+
+  static Page::value_t bt_unpack_key(const Table::index_def_t &idx, const BYTE* slot)
+  {
+    if(idx.key_type == Table::TBL_TYPE_SHORT)
+    {
+      int16_t s;
+      memcpy(&s, slot, sizeof(s));
+      return Page::val_short(s);
+    }
+    if(idx.key_type == Table::TBL_TYPE_INT)
+    {
+      int32_t i;
+      memcpy(&i, slot, sizeof(i));
+      return Page::val_int(i);
+    }
+    uint16_t len;
+    memcpy(&len, slot, sizeof(len));
+    return Page::val_str((const char*)slot + sizeof(uint16_t), len);
+  }
+
+
+  bool bt_next(bt_cursor_t &cur, Page::value_t &key, Table::RID &rid)
+  {
+    const Table::index_def_t &idx = *cur.idx;
+    while(cur.leaf != 0)
+    {
+      uint16_t page_id = cur.leaf;
+      bt_node_t* node = bt_pin(*cur.dbfile, page_id);
+      if(cur.pos >= node->num_keys)
+      {
+        cur.leaf = node->next_leaf;
+        cur.pos = 0;
+        Buffer_mgr::buf_unpin(page_id);
+        continue;
+      }
+
+      const BYTE* entry = node->entries + cur.pos * bt_entry_size(idx);
+      if(cur.has_hi && bt_cmp_key(idx, entry, (const BYTE*)cur.hi.data()) > 0)
+      {
+        cur.leaf = 0;
+        Buffer_mgr::buf_unpin(page_id);
+        return false;
+      }
+      cur.key.assign((const char*)entry, idx.key_size);
+      key = bt_unpack_key(idx, (const BYTE*)cur.key.data());
+      rid = bt_entry_rid(idx, entry);
+      cur.pos++;
+      Buffer_mgr::buf_unpin(page_id);
+      return true;
+    }
+    return false;
+  }
+
+
+  /* Node images being built for one level of a bulk build */
+  struct bt_level_t
+  {
+    std::vector<std::string> firsts; // first |key|RID| below each node
+    std::vector<uint16_t> pages;
+  };
+
+
+  static void bt_write_node(file_descriptor_t &dbfile, uint16_t page_id, const bt_node_t &img)
+  {
+    Table::txn_touch(dbfile, page_id);
+    bt_node_t* node = bt_pin(dbfile, page_id);
+    memcpy((void*)node, (const void*)&img, sizeof(bt_node_t));
+    Buffer_mgr::buf_write(dbfile, page_id);
+    Buffer_mgr::buf_unpin(page_id);
+  }
+
+
+  void bt_bulk_build(file_descriptor_t &dbfile, Table::index_def_t &idx, const std::function<bool(BYTE* entry)> &next)
+  {
+    uint16_t esize = bt_entry_size(idx);
+    uint16_t isize = bt_inner_size(idx);
+    uint16_t leaf_cap = bt_capacity(idx, true);
+    uint16_t inner_cap = bt_capacity(idx, false);
+
+    /* Fill leaves left to right, linking each to the next one as it is started */
+    bt_level_t level;
+    bt_node_t img;
+    memset((void*)&img, 0, sizeof(img));
+    img.leaf = 1;
+    uint16_t img_id = bt_new_node(dbfile, true);
+    level.pages.push_back(img_id);
+    level.firsts.push_back(std::string());
+
+    BYTE entry[BT_MAX_ENTRY], prev[BT_MAX_ENTRY];
+    bool have_prev = false;
+    while(next(entry))
+    {
+      if(have_prev && bt_cmp_entry(idx, prev, entry) >= 0)
+        throw index_error("Bulk build entries are not in sorted order.");
+      memcpy(prev, entry, esize);
+      have_prev = true;
+
+      if(img.num_keys == leaf_cap)
+      {
+        uint16_t next_id = bt_new_node(dbfile, true);
+        img.next_leaf = next_id;
+        bt_write_node(dbfile, img_id, img);
+        memset((void*)&img, 0, sizeof(img));
+        img.leaf = 1;
+        img_id = next_id;
+        level.pages.push_back(img_id);
+        level.firsts.push_back(std::string());
+      }
+      if(img.num_keys == 0)
+        level.firsts.back().assign((const char*)entry, esize);
+      memcpy(img.entries + img.num_keys * esize, entry, esize);
+      img.num_keys++;
+    }
+    bt_write_node(dbfile, img_id, img);
+    idx.first_leaf = level.pages[0];
+
+    /* Build internal levels until one node is left: each node holds up to <inner_cap> + 1 children */
+    while(level.pages.size() > 1)
+    {
+      bt_level_t up;
+      for(size_t i = 0; i < level.pages.size(); i += inner_cap + 1)
+      {
+        memset((void*)&img, 0, sizeof(img));
+        img.first_child = level.pages[i];
+        for(size_t c = i + 1; c < level.pages.size() && c <= i + inner_cap; c++)
+        {
+          BYTE* ent = img.entries + img.num_keys * isize;
+          memcpy(ent, level.firsts[c].data(), esize);
+          memcpy(ent + esize, &level.pages[c], sizeof(uint16_t));
+          img.num_keys++;
+        }
+        uint16_t id = bt_new_node(dbfile, false);
+        bt_write_node(dbfile, id, img);
+        up.pages.push_back(id);
+        up.firsts.push_back(level.firsts[i]);
+      }
+      level = up;
+    }
+    idx.root = level.pages[0];
+  }
+
+
+  uint16_t bt_entry_size(const Table::index_def_t &idx)
+  {
+    return idx.key_size + sizeof(Table::RID);
+  }
+
+
+  bool bt_make_key(const Table::index_def_t &idx, const Page::value_t &val, BYTE* slot)
+  {
+    if(val.type == Page::RTYPE_NULL)
+      return false;
+
+    if(idx.key_type == Table::TBL_TYPE_VCHAR && val.type == Page::RTYPE_STRING)
+    {
+      if(val.str.len > idx.key_size - sizeof(uint16_t))
+        throw index_error("Key is longer than the indexed column allows.");
+      memset(slot, 0, idx.key_size);
+      memcpy(slot, &val.str.len, sizeof(uint16_t));
+      memcpy(slot + sizeof(uint16_t), val.str.ptr, val.str.len);
+      return true;
+    }
+
+    if(val.type == Page::RTYPE_SHORT || val.type == Page::RTYPE_INT)
+    {
+      int32_t num = (val.type == Page::RTYPE_SHORT) ? val.s : val.i;
+      if(idx.key_type == Table::TBL_TYPE_INT)
+      {
+        memcpy(slot, &num, sizeof(int32_t));
+        return true;
+      }
+      if(idx.key_type == Table::TBL_TYPE_SHORT && num >= INT16_MIN && num <= INT16_MAX)
+      {
+        int16_t s = num;
+        memcpy(slot, &s, sizeof(int16_t));
+        return true;
+      }
+    }
+    throw index_error("Key value does not match the type of index \"" + idx.name + "\".");
+  }
+
+
+  bool bt_key_from_record(const Table::index_def_t &idx, const BYTE* rec, BYTE* slot)
+  {
+    /* Walk to the indexed field */
+    uint16_t rec_size = ((const Page::record_t*)rec)->size;
+    unsigned short offset = sizeof(uint16_t);
+    for(uint16_t f = 0; f < idx.col; f++)
+    {
+      if(offset >= rec_size)
+        return false;
+      uint16_t type = *(const uint16_t*)(rec + offset);
+      offset += sizeof(uint16_t) + (type >= Page::RTYPE_STRING ? type - Page::RTYPE_STRING : type);
+    }
+    if(offset >= rec_size)
+      return false;
+    return bt_make_key(idx, Page::rec_upackval((void*)rec, offset), slot);
+  }
+
+
+  int bt_cmp_key(const Table::index_def_t &idx, const BYTE* a, const BYTE* b)
+  {
+    if(idx.key_type == Table::TBL_TYPE_SHORT)
+    {
+      int16_t x, y;
+      memcpy(&x, a, sizeof(x));
+      memcpy(&y, b, sizeof(y));
+      return (x > y) - (x < y);
+    }
+    if(idx.key_type == Table::TBL_TYPE_INT)
+    {
+      int32_t x, y;
+      memcpy(&x, a, sizeof(x));
+      memcpy(&y, b, sizeof(y));
+      return (x > y) - (x < y);
+    }
+    uint16_t la, lb;
+    memcpy(&la, a, sizeof(la));
+    memcpy(&lb, b, sizeof(lb));
+    int cmp = memcmp(a + sizeof(uint16_t), b + sizeof(uint16_t), std::min(la, lb));
+    return cmp != 0 ? cmp : (la > lb) - (la < lb);
+  }
+
+
+  int bt_cmp_entry(const Table::index_def_t &idx, const BYTE* a, const BYTE* b)
+  {
+    int cmp = bt_cmp_key(idx, a, b);
+    if(cmp != 0)
+      return cmp;
+    Table::RID ra = bt_entry_rid(idx, a), rb = bt_entry_rid(idx, b);
+    if(ra.page_id != rb.page_id)
+      return ra.page_id < rb.page_id ? -1 : 1;
+    return (ra.rec_id > rb.rec_id) - (ra.rec_id < rb.rec_id);
+  }
+
+
+  void create_index(file_descriptor_t &dbfile, const std::string &index_name, const std::string &table_name, const std::string &col_name)
+  {
+    Table::txn_scope_t scope(dbfile); // the build is one write: an error leaves no pages taken and no "#master" row
+    Table::index_def_t idx = idx_new_def(dbfile, index_name, table_name, col_name, Table::DB_TYPE_BTREE);
+
+    /* Sort the entries of every current record by key and then RID, in a bounded amount of memory: the sort key is the
+       normalized key followed by the RID's page and record ids, big-endian */
+    uint16_t esize = bt_entry_size(idx);
+    Table::sorter_t sorter;
+    Table::scan_cursor_t cur;
+    Table::row_t row;
+    Table::RID rid;
+    BYTE entry[BT_MAX_ENTRY];
+    std::string key;
+    cur.page_id = 0; // nothing to unpin if the scan cannot be opened
+    Table::sort_open(dbfile, sorter);
+    try
+    {
+      Table::scan_open(dbfile, table_name, {}, {col_name}, cur);
+      while(Table::scan_next(cur, row, rid))
+      {
+        if(!bt_make_key(idx, row[0], entry))
+          continue;
+        memcpy(entry + idx.key_size, &rid, sizeof(Table::RID));
+        key.clear();
+        Table::sort_norm_key(key, row[0]);
+        for(uint16_t id : {rid.page_id, rid.rec_id})
+        {
+          key.push_back(id >> 8);
+          key.push_back(id & 0xff);
+        }
+        Table::sort_add(sorter, (const BYTE*)key.data(), key.size(), entry, esize);
+      }
+      Table::sort_finish(sorter);
+
+      bt_bulk_build(dbfile, idx, [&](BYTE* out) {
+        const BYTE* sort_key;
+        const BYTE* payload;
+        uint16_t key_len, payload_len;
+        if(!Table::sort_next(sorter, sort_key, key_len, payload, payload_len))
+          return false;
+        memcpy(out, payload, esize);
+        return true;
+      });
+    }
+    catch(...)
+    {
+      Table::scan_close(cur);
+      Table::sort_close(sorter);
+      throw;
+    }
+    Table::sort_close(sorter);
+
+    idx_write_master(dbfile, idx);
+  }
+}
@@ -0,0 +1,113 @@
+/**************************************************************************************************
+* Filename:   btree.h
+* Details:    Defines the API for disk-resident B+tree indexes on a table column.
+**************************************************************************************************/
+
+/*************************************************************************************************
+  An index maps the values of one SHORT, INT or VCHAR column to the RIDs of the records holding
+  them. Its nodes are pages taken from the free pages list and read through the buffer manager.
+
+  A node page is:  |leaf|num_keys|next_leaf|first_child|entry|entry|...|
+    A leaf entry is |key|RID| and leaves are linked left to right through <next_leaf>.
+    An internal entry is |key|RID|child|: <child> holds every entry >= |key|RID|, and <first_child>
+    holds every entry below the first one.
+
+  Keys are fixed size: an int16, an int32, or for a VCHAR a uint16 length followed by <max_size>
+  bytes. Entries are ordered by key and then by RID, so duplicate keys are fine. NULLs are not
+  indexed.
+
+  The index's "#master" row holds its root in <fp>, its first leaf in <lp>, DB_TYPE_BTREE in <type>
+  and "table.column" in <def>.
+*************************************************************************************************/
+
+/********************************************* GUARD *********************************************/
+
+#ifndef BTREE_H
+#define BTREE_H
+
+/***************************************** HEADER FILES ******************************************/
+
+#include "../table_mgr/table_mgr.h"
+
+#include <functional>
+
+/******************************************* CONSTANTS *******************************************/
+
+namespace Index
+{
+  const uint16_t BT_MAX_ENTRY = sizeof(uint16_t) + UINT8_MAX + sizeof(Table::RID) + sizeof(uint16_t); // bound on one internal entry
+}
+
+/************************************** IMPLEMENT STRUCTURES *************************************/
+
+namespace Index
+{
+  /* Structure that formats an index node page */
+  struct bt_node_t
+  {
+    uint16_t leaf; // 1 for a leaf
+    uint16_t num_keys;
+    uint16_t next_leaf; // leaves only: the leaf to the right (0 for the last one)
+    uint16_t first_child; // internal nodes only
+    BYTE entries[PAGE_SIZE - 4 * sizeof(uint16_t)];
+  };
+
+  /* Structure that holds the state of a range scan over the leaves ; <idx> must outlive the cursor */
+  struct bt_cursor_t
+  {
+    file_descriptor_t* dbfile;
+    const Table::index_def_t* idx;
+    uint16_t leaf; // 0 when the scan is done
+    uint16_t pos;
+    bool has_hi;
+    std::string hi; // key slot of the (inclusive) upper bound
+    std::string key; // key slot of the last entry returned
+  };
+}
+
+namespace Index
+{
+  /************************************* FUNCTION PROTOTYPES *************************************/
+
+  /* Build a B+tree over <col_name> of an existing table from its current records, and record it in "#master" */
+  void create_index(file_descriptor_t &dbfile, const std::string &index_name, const std::string &table_name, const std::string &col_name);
+
+  /* Add the entry for a record just added at <rid> ; does nothing when the indexed column is NULL */
+  void bt_insert_record(file_descriptor_t &dbfile, Table::index_def_t &idx, const BYTE* rec, Table::RID rid);
+
+  /* Add (<key>, <rid>) ; the root in "#master" is updated when it splits */
+  void bt_insert(file_descriptor_t &dbfile, Table::index_def_t &idx, const Page::value_t &key, Table::RID rid);
+
+  /* Remove the entry of the record at <rid> ; false if the index has none (its column is NULL, or it was never added). Nodes are
+     not merged: a leaf may be left empty, and the tree keeps its shape */
+  bool bt_delete_record(file_descriptor_t &dbfile, const Table::index_def_t &idx, const BYTE* rec, Table::RID rid);
+
+  /* Every RID whose key equals <key> */
+  void bt_lookup(file_descriptor_t &dbfile, const Table::index_def_t &idx, const Page::value_t &key, std::vector<Table::RID> &rids);
+
+  /* Position a cursor on the first entry with key >= *lo (or the first entry when <lo> is null), stopping after *hi */
+  void bt_open_range(file_descriptor_t &dbfile, const Table::index_def_t &idx, const Page::value_t* lo, const Page::value_t* hi, bt_cursor_t &cur);
+
+  /* Next entry of the range ; the key is unpacked into <key> (strings point into the cursor) ; false at the end */
+  bool bt_next(bt_cursor_t &cur, Page::value_t &key, Table::RID &rid);
+
+  /* Build the tree from leaf entries (|key|RID|, see "bt_entry_size()") handed out in sorted order by <next>, which returns false
+     once there are no more. Leaves are filled left to right and the internal levels built over them. Sets <idx.root> and
+     <idx.first_leaf> ; the caller records them in "#master" */
+  void bt_bulk_build(file_descriptor_t &dbfile, Table::index_def_t &idx, const std::function<bool(BYTE* entry)> &next);
+
+  /* Bytes of a leaf entry for the index */
+  uint16_t bt_entry_size(const Table::index_def_t &idx);
+
+  /* Write the key slot of <val> ; false if <val> is NULL. Throws an <index_error> if it is not of the key's type */
+  bool bt_make_key(const Table::index_def_t &idx, const Page::value_t &val, BYTE* slot);
+
+  /* Write the key slot of the indexed column of a packed record ; false if the column is NULL */
+  bool bt_key_from_record(const Table::index_def_t &idx, const BYTE* rec, BYTE* slot);
+
+  /* Compare two key slots (and then RIDs, for bt_cmp_entry) ; <0, 0 or >0 */
+  int bt_cmp_key(const Table::index_def_t &idx, const BYTE* a, const BYTE* b);
+  int bt_cmp_entry(const Table::index_def_t &idx, const BYTE* a, const BYTE* b);
+}
+
+#endif // BTREE_H
@@ -0,0 +1,354 @@
+/**************************************************************************************************
+* Filename:   hash_index.cpp
+* Details:    Implements the extendible hash indexes declared in "hash_index.h".
+**************************************************************************************************/
+
+/****************************************** HEADER FILES *****************************************/
+
+#include "hash_index.h"
+#include "index_mgr.h"
+#include "../buffer_mgr/buffer_mgr.h"
+#include "../table_mgr/table_scan.h"
+#include "../table_mgr/transaction.h"
+
+/************************************ FUNCTION IMPLEMENTATIONS ***********************************/
+
+namespace Index
+{
+  static uint16_t hx_capacity(const Table::index_def_t &idx)
+  {
+    return sizeof(hx_bucket_t::entries) / bt_entry_size(idx);
+  }
+
+
+  /* First position in the bucket page whose |key|RID| is >= <target> ; each page is kept sorted so lookups binary search it */
+  static uint16_t hx_search(const Table::index_def_t &idx, hx_bucket_t* bucket, const BYTE* target)
+  {
+    uint16_t esize = bt_entry_size(idx);
+    uint16_t lo = 0, hi = bucket->num_entries;
+    while(lo < hi)
+    {
+      uint16_t mid = (lo + hi) / 2;
+      if(bt_cmp_entry(idx, bucket->entries + mid * esize, target) < 0)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    return lo;
+  }
+
+
+  /* Add an entry to a bucket page with room, in order */
+  static void hx_put(const Table::index_def_t &idx, hx_bucket_t* bucket, const BYTE* entry)
+  {
+    uint16_t esize = bt_entry_size(idx);
+    uint16_t pos = hx_search(idx, bucket, entry);
+    memmove(bucket->entries + (pos + 1) * esize, bucket->entries + pos * esize, (bucket->num_entries - pos) * esize);
+    memcpy(bucket->entries + pos * esize, entry, esize);
+    bucket->num_entries++;
+  }
+
+
+  /* A directory or bucket page is pinned for as long as it is used, so reading other pages cannot replace it ; every pin is
+     matched by a "Buffer_mgr::buf_unpin()", before anything that may throw */
+  static void* hx_pin(file_descriptor_t &dbfile, uint16_t page_id)
+  {
+    return Buffer_mgr::buf_pin(dbfile, page_id);
+  }
+
+
+  /* Take a page off the free list and format it as an empty bucket */
+  static uint16_t hx_new_bucket(file_descriptor_t &dbfile, uint16_t local_depth)
+  {
+    std::vector<uint16_t> ids;
+    Table::tbl_alloc_pages(dbfile, 1, ids);
+    Table::txn_touch(dbfile, ids[0]);
+    hx_bucket_t* bucket = static_cast<hx_bucket_t*>(hx_pin(dbfile, ids[0]));
+    memset((void*)bucket, 0, sizeof(hx_bucket_t));
+    bucket->local_depth = local_depth;
+    Buffer_mgr::buf_write(dbfile, ids[0]);
+    Buffer_mgr::buf_unpin(ids[0]);
+    return ids[0];
+  }
+
+
+  /* Append to the first page of the bucket's overflow chain with room, adding a page at the end if there is none */
+  static void hx_chain_put(file_descriptor_t &dbfile, const Table::index_def_t &idx, uint16_t page_id, const BYTE* entry)
+  {
+    while(true)
+    {
+      hx_bucket_t* bucket = static_cast<hx_bucket_t*>(hx_pin(dbfile, page_id));
+      if(bucket->num_entries < hx_capacity(idx))
+      {
+        Table::txn_touch(dbfile, page_id);
+        hx_put(idx, bucket, entry);
+        Buffer_mgr::buf_write(dbfile, page_id);
+        Buffer_mgr::buf_unpin(page_id);
+        return;
+      }
+      uint16_t next = bucket->overflow;
+      uint16_t local_depth = bucket->local_depth;
+      Buffer_mgr::buf_unpin(page_id);
+      if(next == 0)
+      {
+        next = hx_new_bucket(dbfile, local_depth); // may throw when no page is free, so <bucket> is pinned again below
+        Table::txn_touch(dbfile, page_id);
+        bucket = static_cast<hx_bucket_t*>(hx_pin(dbfile, page_id));
+        bucket->overflow = next;
+        Buffer_mgr::buf_write(dbfile, page_id);
+        Buffer_mgr::buf_unpin(page_id);
+      }
+      page_id = next;
+    }
+  }
+
+
+  /* Double the directory: the new upper half points at the same buckets as the lower half */
+  static void hx_grow_dir(file_descriptor_t &dbfile, const Table::index_def_t &idx)
+  {
+    Table::txn_touch(dbfile, idx.root);
+    hx_dir_t* dir = static_cast<hx_dir_t*>(hx_pin(dbfile, idx.root));
+    uint16_t n = 1 << dir->global_depth;
+    memcpy(dir->buckets + n, dir->buckets, n * sizeof(uint16_t));
+    dir->global_depth++;
+    Buffer_mgr::buf_write(dbfile, idx.root);
+    Buffer_mgr::buf_unpin(idx.root);
+  }
+
+
+  /* Split a bucket of depth <ld> on bit <ld> of the hash: entries with the bit set move to a new bucket, and so do the
+     directory slots that have it set */
+  static void hx_split(file_descriptor_t &dbfile, const Table::index_def_t &idx, uint16_t page_id, uint16_t ld)
+  {
+    uint16_t esize = bt_entry_size(idx);
+    uint16_t new_id = hx_new_bucket(dbfile, ld + 1);
+    std::vector<BYTE> moving;
+    moving.reserve(sizeof(hx_bucket_t::entries)); // so nothing is allocated while the bucket is pinned
+
+    Table::txn_touch(dbfile, page_id);
+    hx_bucket_t* old = static_cast<hx_bucket_t*>(hx_pin(dbfile, page_id));
+    uint16_t kept = 0;
+    for(uint16_t i = 0; i < old->num_entries; i++)
+    {
+      BYTE* entry = old->entries + i * esize;
+      if((hx_hash(idx, entry) >> ld) & 1)
+        moving.insert(moving.end(), entry, entry + esize);
+      else
+        memmove(old->entries + (kept++) * esize, entry, esize);
+    }
+    old->num_entries = kept;
+    old->local_depth = ld + 1;
+    Buffer_mgr::buf_write(dbfile, page_id);
+    Buffer_mgr::buf_unpin(page_id);
+
+    Table::txn_touch(dbfile, new_id);
+    hx_bucket_t* bucket = static_cast<hx_bucket_t*>(hx_pin(dbfile, new_id));
+    bucket->num_entries = moving.size() / esize;
+    memcpy(bucket->entries, moving.data(), moving.size());
+    Buffer_mgr::buf_write(dbfile, new_id);
+    Buffer_mgr::buf_unpin(new_id);
+
+    Table::txn_touch(dbfile, idx.root);
+    hx_dir_t* dir = static_cast<hx_dir_t*>(hx_pin(dbfile, idx.root));
+    for(uint32_t slot = 0; slot < (1u << dir->global_depth); slot++)
+    {
+      if(dir->buckets[slot] == page_id && ((slot >> ld) & 1))
+        dir->buckets[slot] = new_id;
+    }
+    Buffer_mgr::buf_write(dbfile, idx.root);
+    Buffer_mgr::buf_unpin(idx.root);
+  }
+
+
+  /* The first page of the bucket the directory maps <hash> to */
+  static uint16_t hx_bucket_of(file_descriptor_t &dbfile, const Table::index_def_t &idx, uint64_t hash, uint16_t &global_depth)
+  {
+    hx_dir_t* dir = static_cast<hx_dir_t*>(hx_pin(dbfile, idx.root));
+    global_depth = dir->global_depth;
+    uint16_t page_id = dir->buckets[hash & ((1u << global_depth) - 1)];
+    Buffer_mgr::buf_unpin(idx.root);
+    return page_id;
+  }
+
+
+  static void hx_insert_entry(file_descriptor_t &dbfile, const Table::index_def_t &idx, const BYTE* entry)
+  {
+    uint64_t hash = hx_hash(idx, entry);
+    while(true)
+    {
+      uint16_t global_depth;
+      uint16_t page_id = hx_bucket_of(dbfile, idx, hash, global_depth);
+
+      hx_bucket_t* bucket = static_cast<hx_bucket_t*>(hx_pin(dbfile, page_id));
+      if(bucket->num_entries < hx_capacity(idx))
+      {
+        Table::txn_touch(dbfile, page_id);
+        hx_put(idx, bucket, entry);
+        Buffer_mgr::buf_write(dbfile, page_id);
+        Buffer_mgr::buf_unpin(page_id);
+        return;
+      }
+      uint16_t local_depth = bucket->local_depth;
+      Buffer_mgr::buf_unpin(page_id);
+
+      if(local_depth == HX_MAX_DEPTH)
+      {
+        hx_chain_put(dbfile, idx, page_id, entry);
+        return;
+      }
+      if(local_depth == global_depth)
+        hx_grow_dir(dbfile, idx);
+      hx_split(dbfile, idx, page_id, local_depth); // then try again: the entry's bucket may still be full
+    }
+  }
+
+
+  void hx_insert(file_descriptor_t &dbfile, Table::index_def_t &idx, const Page::value_t &key, Table::RID rid)
+  {
+    BYTE entry[BT_MAX_ENTRY];
+    if(!bt_make_key(idx, key, entry))
+      return;
+    memcpy(entry + idx.key_size, &rid, sizeof(Table::RID));
+    hx_insert_entry(dbfile, idx, entry);
+  }
+
+
+  void hx_insert_record(file_descriptor_t &dbfile, Table::index_def_t &idx, const BYTE* rec, Table::RID rid)
+  {
+    BYTE entry[BT_MAX_ENTRY];
+    if(!bt_key_from_record(idx, rec, entry))
+      return;
+    memcpy(entry + idx.key_size, &rid, sizeof(Table::RID));
+    hx_insert_entry(dbfile, idx, entry);
+  }
+
+
+  bool hx_delete_record(file_descriptor_t &dbfile, const Table::index_def_t &idx, const BYTE* rec, Table::RID rid)
+  {
+    BYTE entry[BT_MAX_ENTRY];
+    if(!bt_key_from_record(idx, rec, entry))
+      return false;
+    memcpy(entry + idx.key_size, &rid, sizeof(Table::RID));
+
+    uint16_t esize = bt_entry_size(idx);
+    uint16_t global_depth;
+    uint16_t page_id = hx_bucket_of(dbfile, idx, hx_hash(idx, entry), global_depth);
+    while(page_id != 0)
+    {
+      hx_bucket_t* bucket = static_cast<hx_bucket_t*>(hx_pin(dbfile, page_id));
+      uint16_t pos = hx_search(idx, bucket, entry);
+      if(pos < bucket->num_entries && bt_cmp_entry(idx, bucket->entries + pos * esize, entry) == 0)
+      {
+        Table::txn_touch(dbfile, page_id);
+        memmove(bucket->entries + pos * esize, bucket->entries + (pos + 1) * esize, (bucket->num_entries - pos - 1) * esize);
+        bucket->num_entries--;
+        Buffer_mgr::buf_write(dbfile, page_id);
+        Buffer_mgr::buf_unpin(page_id);
+        return true;
+      }
+      uint16_t next = bucket->overflow;
+      Buffer_mgr::buf_unpin(page_id);
+      page_id = next;
+    }
+    return false;
+  }
+
+
+  void hx_lookup(file_descriptor_t &dbfile, const Table::index_def_t &idx, const Page::value_t &key, std::vector<Table::RID> &rids)
+  {
+    rids.clear();
+    BYTE target[BT_MAX_ENTRY] = {0}; // |key|lowest RID|
+    if(!bt_make_key(idx, key, target))
+      return;
+
+    uint16_t esize = bt_entry_size(idx);
+    uint16_t global_depth;
+    uint16_t page_id = hx_bucket_of(dbfile, idx, hx_hash(idx, target), global_depth);
+    while(page_id != 0)
+    {
+      hx_bucket_t* bucket = static_cast<hx_bucket_t*>(hx_pin(dbfile, page_id));
+      try
+      {
+        for(uint16_t i = hx_search(idx, bucket, target); i < bucket->num_entries; i++)
+        {
+          const BYTE* entry = bucket->entries + i * esize;
+          if(bt_cmp_key(idx, entry, target) != 0)
+            break;
+          Table::RID rid;
+          memcpy(&rid, entry + idx.key_size, sizeof(Table::RID));
+          rids.push_back(rid);
+        }
+      }
+      catch(...)
+      {
+        Buffer_mgr::buf_unpin(page_id);
+        throw;
+      }
+      uint16_t next = bucket->overflow;
+      Buffer_mgr::buf_unpin(page_id);
+      page_id = next;
+    }
+  }
+
+
+  uint64_t hx_hash(const Table::index_def_t &idx, const BYTE* slot)
+  {
+    /* FNV-1a over the key slot (VCHAR slots are zero padded, so equal strings hash alike), then a final mix so the
+       low bits the directory uses depend on every byte */
+    uint64_t h = 14695981039346656037ULL;
+    for(uint16_t i = 0; i < idx.key_size; i++)
+      h = (h ^ slot[i]) * 1099511628211ULL;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+  }
+
+
+  void hx_create(file_descriptor_t &dbfile, Table::index_def_t &idx)
+  {
+    uint16_t bucket_id = hx_new_bucket(dbfile, 0);
+    std::vector<uint16_t> ids;
+    Table::tbl_alloc_pages(dbfile, 1, ids);
+    Table::txn_touch(dbfile, ids[0]);
+    hx_dir_t* dir = static_cast<hx_dir_t*>(hx_pin(dbfile, ids[0]));
+    memset((void*)dir, 0, sizeof(hx_dir_t));
+    dir->buckets[0] = bucket_id;
+    Buffer_mgr::buf_write(dbfile, ids[0]);
+    Buffer_mgr::buf_unpin(ids[0]);
+    idx.root = ids[0];
+    idx.first_leaf = ids[0];
+  }
+
+
+  void create_hash_index(file_descriptor_t &dbfile, const std::string &index_name, const std::string &table_name, const std::string &col_name)
+  {
+    Table::txn_scope_t scope(dbfile); // the build is one write: an error leaves no pages taken and no "#master" row
+    Table::index_def_t idx = idx_new_def(dbfile, index_name, table_name, col_name, Table::DB_TYPE_HASH);
+
+    /* Gather the entries of every current record before touching any index page */
+    uint16_t esize = bt_entry_size(idx);
+    std::vector<BYTE> entries;
+    std::vector<BYTE> entry(esize);
+    Table::scan_cursor_t cur;
+    Table::row_t row;
+    Table::RID rid;
+    Table::scan_open(dbfile, table_name, {}, {col_name}, cur);
+    while(Table::scan_next(cur, row, rid))
+    {
+      if(!bt_make_key(idx, row[0], entry.data()))
+        continue;
+      memcpy(entry.data() + idx.key_size, &rid, sizeof(Table::RID));
+      entries.insert(entries.end(), entry.begin(), entry.end());
+    }
+
+    hx_create(dbfile, idx);
+
+    for(size_t off = 0; off < entries.size(); off += esize)
+      hx_insert_entry(dbfile, idx, entries.data() + off);
+
+    idx_write_master(dbfile, idx);
+  }
+}
@@ -0,0 +1,88 @@
+/**************************************************************************************************
+* Filename:   hash_index.h
+* Details:    Defines the API for disk-resident extendible hash indexes on a table column.
+**************************************************************************************************/
+
+/*************************************************************************************************
+  A hash index answers equality lookups with two page reads: its directory page, then one bucket.
+  Keys and entries are the same fixed-size |key|RID| as a B+tree leaf entry (see "btree.h").
+
+  The directory page is:  |global_depth|bucket|bucket|...|
+    It has 2^<global_depth> slots, and a key goes to the slot given by the low <global_depth> bits
+    of its hash. Several slots share a bucket whose <local_depth> is below <global_depth>.
+
+  A bucket page is:  |local_depth|num_entries|overflow|unused|entry|entry|...|
+    When a full bucket gets a new entry it splits in two on the next bit of the hash, doubling the
+    directory first if its <local_depth> equals <global_depth>. Only that one bucket's entries
+    move. At HX_MAX_DEPTH the directory cannot grow, so a full bucket chains <overflow> pages
+    instead (this is also where many copies of one key end up).
+
+  The index's "#master" row holds the directory page in <fp> and <lp>, DB_TYPE_HASH in <type> and
+  "table.column" in <def>.
+*************************************************************************************************/
+
+/********************************************* GUARD *********************************************/
+
+#ifndef HASH_INDEX_H
+#define HASH_INDEX_H
+
+/***************************************** HEADER FILES ******************************************/
+
+#include "../table_mgr/table_mgr.h"
+
+/******************************************* CONSTANTS *******************************************/
+
+namespace Index
+{
+  const uint16_t HX_MAX_DEPTH = 12; // 4096 slots fit in the directory page
+}
+
+/************************************** IMPLEMENT STRUCTURES *************************************/
+
+namespace Index
+{
+  /* Structure that formats the directory page */
+  struct hx_dir_t
+  {
+    uint16_t global_depth;
+    uint16_t buckets[(PAGE_SIZE - sizeof(uint16_t)) / sizeof(uint16_t)];
+  };
+
+  /* Structure that formats a bucket page */
+  struct hx_bucket_t
+  {
+    uint16_t local_depth;
+    uint16_t num_entries;
+    uint16_t overflow; // next page of the bucket's chain (0 for none)
+    uint16_t unused;
+    BYTE entries[PAGE_SIZE - 4 * sizeof(uint16_t)];
+  };
+}
+
+namespace Index
+{
+  /************************************* FUNCTION PROTOTYPES *************************************/
+
+  /* Build a hash index over <col_name> of an existing table from its current records, and record it in "#master" */
+  void create_hash_index(file_descriptor_t &dbfile, const std::string &index_name, const std::string &table_name, const std::string &col_name);
+
+  /* Take an empty directory (depth 0) and one bucket off the free list ; sets <idx.root> and <idx.first_leaf> */
+  void hx_create(file_descriptor_t &dbfile, Table::index_def_t &idx);
+
+  /* Add the entry for a record just added at <rid> ; does nothing when the indexed column is NULL */
+  void hx_insert_record(file_descriptor_t &dbfile, Table::index_def_t &idx, const BYTE* rec, Table::RID rid);
+
+  /* Add (<key>, <rid>) */
+  void hx_insert(file_descriptor_t &dbfile, Table::index_def_t &idx, const Page::value_t &key, Table::RID rid);
+
+  /* Remove the entry of the record at <rid> ; false if the index has none. Buckets are not merged, nor overflow pages freed */
+  bool hx_delete_record(file_descriptor_t &dbfile, const Table::index_def_t &idx, const BYTE* rec, Table::RID rid);
+
+  /* Every RID whose key equals <key> */
+  void hx_lookup(file_descriptor_t &dbfile, const Table::index_def_t &idx, const Page::value_t &key, std::vector<Table::RID> &rids);
+
+  /* Hash of a key slot */
+  uint64_t hx_hash(const Table::index_def_t &idx, const BYTE* slot);
+}
+
+#endif // HASH_INDEX_H
@@ -0,0 +1,160 @@
+/**************************************************************************************************
+* Filename:   index_mgr.cpp
+* Details:    Implements the index catalog functions declared in "index_mgr.h".
+**************************************************************************************************/
+
+/****************************************** HEADER FILES *****************************************/
+
+#include "index_mgr.h"
+#include "../buffer_mgr/buffer_mgr.h"
+#include "../lock_mgr/lock_mgr.h"
+#include "../table_mgr/table_scan.h"
+#include "../table_mgr/transaction.h"
+
+#include <algorithm>
+
+/************************************ FUNCTION IMPLEMENTATIONS ***********************************/
+
+namespace Index
+{
+  /* Scan "#master" for index rows ; <want> picks them by name or by table */
+  static void idx_scan_master(file_descriptor_t &dbfile, const std::function<bool(const std::string &name, const std::string &table)> &want,
+                              std::vector<Table::index_def_t> &indexes)
+  {
+    indexes.clear();
+    std::vector<Table::scan_pred_t> preds = {{"type", Table::SCAN_GE, Page::val_short(Table::DB_TYPE_BTREE), 0}};
+    Table::scan_cursor_t cur;
+    Table::row_t row;
+    Table::RID rid;
+    Table::scan_open(dbfile, Table::TBL_MASTER_NAME, preds, {"name", "fp", "lp", "type", "def"}, cur);
+    while(Table::scan_next(cur, row, rid))
+    {
+      if(row[3].s != Table::DB_TYPE_BTREE && row[3].s != Table::DB_TYPE_HASH)
+        continue;
+      std::string name(row[0].str.ptr, row[0].str.len);
+      std::string def(row[4].str.ptr, row[4].str.len);
+      size_t dot = def.rfind('.');
+      if(dot == std::string::npos)
+        throw index_error("Index \"" + name + "\" has a bad definition.");
+
+      Table::index_def_t idx;
+      idx.name = name;
+      idx.table = def.substr(0, dot);
+      idx.column = def.substr(dot + 1);
+      if(!want(idx.name, idx.table))
+        continue;
+      idx.type = row[3].s;
+      idx.root = row[1].s;
+      idx.first_leaf = row[2].s;
+      idx.master_rid = rid;
+      indexes.push_back(idx);
+    }
+
+    /* Column lookups read other catalog pages, so they wait until the scan is done */
+    for(Table::index_def_t &idx : indexes)
+      idx_resolve_column(dbfile, idx);
+  }
+
+
+  void find_indexes(file_descriptor_t &dbfile, const std::string &table_name, std::vector<Table::index_def_t> &indexes)
+  {
+    idx_scan_master(dbfile, [&table_name](const std::string &, const std::string &table) { return table == table_name; }, indexes);
+  }
+
+
+  Table::index_def_t find_index(file_descriptor_t &dbfile, const std::string &index_name)
+  {
+    std::vector<Table::index_def_t> found;
+    idx_scan_master(dbfile, [&index_name](const std::string &name, const std::string &) { return name == index_name; }, found);
+    if(found.empty())
+      throw index_error("Index \"" + index_name + "\" not found.");
+    return found[0];
+  }
+
+
+  void idx_insert_record(file_descriptor_t &dbfile, Table::index_def_t &idx, const BYTE* rec, Table::RID rid)
+  {
+    if(idx.type == Table::DB_TYPE_HASH)
+      hx_insert_record(dbfile, idx, rec, rid);
+    else
+      bt_insert_record(dbfile, idx, rec, rid);
+  }
+
+
+  bool idx_delete_record(file_descriptor_t &dbfile, const Table::index_def_t &idx, const BYTE* rec, Table::RID rid)
+  {
+    if(idx.type == Table::DB_TYPE_HASH)
+      return hx_delete_record(dbfile, idx, rec, rid);
+    return bt_delete_record(dbfile, idx, rec, rid);
+  }
+
+
+  Table::index_def_t idx_new_def(file_descriptor_t &dbfile, const std::string &index_name, const std::string &table_name,
+                                 const std::string &col_name, uint16_t type)
+  {
+    Table::RID rid;
+    if(index_name.empty() || index_name.size() > Table::TBL_NAME_SIZE)
+      throw index_error("Index name must be 1 to 40 characters.");
+    if(!Table::master_lookup(dbfile, index_name, rid).name.empty())
+      throw index_error("\"" + index_name + "\" already exists.");
+
+    /* The build reads the table through a snapshot: S keeps writers out until it commits, so none adds a record it misses */
+    if(!Table::master_lookup(dbfile, table_name, rid).name.empty())
+      Lock_mgr::lock_table(Table::txn_current()->xid, ((uint32_t)rid.page_id << 16) | rid.rec_id, Lock_mgr::LOCK_S);
+
+    Table::index_def_t idx;
+    idx.name = index_name;
+    idx.table = table_name;
+    idx.column = col_name;
+    idx.type = type;
+    idx.root = 0;
+    idx.first_leaf = 0;
+    idx_resolve_column(dbfile, idx);
+    return idx;
+  }
+
+
+  void idx_resolve_column(file_descriptor_t &dbfile, Table::index_def_t &idx)
+  {
+    Table::table_descriptor_t td;
+    Table::read_table_descriptor(dbfile, idx.table, td);
+    std::sort(td.col_types.begin(), td.col_types.end(), [](const Table::column_type_t &a, const Table::column_type_t &b) { return a.ord < b.ord; });
+
+    idx.col = Table::tbl_col_index(td, idx.column);
+    const Table::column_type_t &col = td.col_types[idx.col];
+    idx.key_type = col.type;
+    if(col.type == Table::TBL_TYPE_SHORT)
+      idx.key_size = sizeof(int16_t);
+    else if(col.type == Table::TBL_TYPE_INT)
+      idx.key_size = sizeof(int32_t);
+    else if(col.type == Table::TBL_TYPE_VCHAR && col.max_size <= UINT8_MAX)
+      idx.key_size = sizeof(uint16_t) + col.max_size;
+    else
+      throw index_error("Column \"" + idx.column + "\" cannot be indexed.");
+  }
+
+
+  /* The "#master" row of an index */
+  static Table::master_table_row_t idx_master_row(const Table::index_def_t &idx)
+  {
+    Table::master_table_row_t mtr;
+    mtr.name = idx.name;
+    mtr.first_page = idx.root;
+    mtr.last_page = idx.first_leaf;
+    mtr.type = idx.type;
+    mtr.def = idx.table + "." + idx.column;
+    return mtr;
+  }
+
+
+  void idx_write_master(file_descriptor_t &dbfile, Table::index_def_t &idx)
+  {
+    idx.master_rid = Table::write_new_master_row(dbfile, idx_master_row(idx));
+  }
+
+
+  void idx_update_master(file_descriptor_t &dbfile, const Table::index_def_t &idx)
+  {
+    Table::write_updated_master_row(dbfile, idx_master_row(idx), idx.master_rid);
+  }
+}
@@ -0,0 +1,62 @@
+/**************************************************************************************************
+* Filename:   index_mgr.h
+* Details:    Defines the API shared by every index type: finding a table's indexes in "#master"
+*             and keeping them up to date as records are added and reclaimed.
+**************************************************************************************************/
+
+/*************************************************************************************************
+  Every index has one "#master" row: |name|fp|lp|type|def="table.column"|. <type> says which kind
+  of index it is (DB_TYPE_BTREE or DB_TYPE_HASH) and what <fp> and <lp> hold for it.
+*************************************************************************************************/
+
+/********************************************* GUARD *********************************************/
+
+#ifndef INDEX_MGR_H
+#define INDEX_MGR_H
+
+/***************************************** HEADER FILES ******************************************/
+
+#include "btree.h"
+#include "hash_index.h"
+
+namespace Index
+{
+  /************************************** DEFINE INDEX ERROR *************************************/
+
+  class index_error : public std::runtime_error
+  {
+    public:
+      index_error(std::string what) : std::runtime_error(what) {}
+      index_error(const char *what) : std::runtime_error(what) {}
+  };
+
+  /************************************* FUNCTION PROTOTYPES *************************************/
+
+  /* Find every index on the table, of any type, in "#master" order */
+  void find_indexes(file_descriptor_t &dbfile, const std::string &table_name, std::vector<Table::index_def_t> &indexes);
+
+  /* Find the index with the given name ; throws an <index_error> if there is none */
+  Table::index_def_t find_index(file_descriptor_t &dbfile, const std::string &index_name);
+
+  /* Add the entry for a record just added at <rid> to an index of any type */
+  void idx_insert_record(file_descriptor_t &dbfile, Table::index_def_t &idx, const BYTE* rec, Table::RID rid);
+
+  /* Remove the entry of the record <rec> at <rid> from an index of any type, before its space is reclaimed ; false if there was none */
+  bool idx_delete_record(file_descriptor_t &dbfile, const Table::index_def_t &idx, const BYTE* rec, Table::RID rid);
+
+  /* Start the definition of a new index, in the build's transaction: the table is locked S until it ends. Throws an
+     <index_error> if the name is taken or the column cannot be indexed */
+  Table::index_def_t idx_new_def(file_descriptor_t &dbfile, const std::string &index_name, const std::string &table_name,
+                                 const std::string &col_name, uint16_t type);
+
+  /* Fill in <col>, <key_type> and <key_size> of <idx> from its table's descriptor */
+  void idx_resolve_column(file_descriptor_t &dbfile, Table::index_def_t &idx);
+
+  /* Append the "#master" row of a new index and set <idx.master_rid> */
+  void idx_write_master(file_descriptor_t &dbfile, Table::index_def_t &idx);
+
+  /* Rewrite <fp> and <lp> of the index's "#master" row from <idx.root> and <idx.first_leaf> */
+  void idx_update_master(file_descriptor_t &dbfile, const Table::index_def_t &idx);
+}
+
+#endif // INDEX_MGR_H
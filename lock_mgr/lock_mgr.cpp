@@ -0,0 +1,497 @@
+#include "lock_mgr.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace Lock_mgr {
+  // What is locked: a table (level 0), a page of it (1) or a record (2)
+  struct lock_key_t {
+    uint32_t table;
+    uint16_t page_id;
+    uint16_t rec_id;
+    BYTE level;
+    bool operator==(const lock_key_t &o) const {
+      return table == o.table && page_id == o.page_id && rec_id == o.rec_id &&
+             level == o.level;
+    }
+  };
+  struct lock_key_hash {
+    size_t operator()(const lock_key_t &k) const {
+      uint64_t h = ((uint64_t)k.table << 32) ^ ((uint64_t)k.page_id << 16) ^
+                   k.rec_id ^ ((uint64_t)k.level << 62);
+      h ^= h >> 33;
+      h *= 0xff51afd7ed558ccdULL;
+      h ^= h >> 33;
+      return h;
+    }
+  };
+
+  // One owner's request on a lock: it holds <mode> and waits while <want> is
+  // stronger (a new request holds LOCK_NONE)
+  struct lock_request_t {
+    owner_t owner;
+    BYTE mode;
+    BYTE want;
+  };
+
+  struct lock_head_t {
+    std::vector<lock_request_t> queue; // in the order requests came
+    std::condition_variable cv;
+  };
+
+  struct lock_partition_t {
+    std::mutex mutex;
+    std::unordered_map<lock_key_t, lock_head_t, lock_key_hash> heads;
+    uint64_t waits = 0;
+    double wait_seconds = 0;
+    double max_wait_seconds = 0;
+    uint64_t deadlocks = 0;
+    uint64_t locks = 0; // requests holding a mode
+  };
+
+  struct table_rows_t {
+    size_t rows = 0; // record locks held on the table
+    bool any_x = false;
+  };
+
+  // What an owner holds; only its own thread touches it
+  struct owner_state_t {
+    std::unordered_map<lock_key_t, BYTE, lock_key_hash> held;
+    std::unordered_map<uint32_t, table_rows_t> tables;
+    uint64_t requests = 0;
+    uint64_t held_already = 0;
+  };
+
+  const uint16_t OWNER_PARTITIONS = 16;
+  struct owner_partition_t {
+    std::mutex mutex;
+    std::unordered_map<owner_t, std::unique_ptr<owner_state_t>> owners;
+  };
+
+  lock_partition_t partitions[LOCK_PARTITIONS];
+  owner_partition_t owner_partitions[OWNER_PARTITIONS];
+
+  // The waits-for graph: who each waiting owner waits for.  Only ever locked
+  // on its own or inside a partition's mutex, never the other way around.
+  std::mutex graph_mutex;
+  std::unordered_map<owner_t, std::vector<owner_t>> waits_for;
+
+  std::atomic<size_t> escalate_rows(LOCK_ESCALATE_ROWS);
+  std::atomic<uint64_t> total_requests(0), total_held(0), total_escalations(0);
+
+  //                           NONE    IS     IX     S      SIX    X
+  const bool compat[6][6] = {{true,  true,  true,  true,  true,  true},   // NONE
+                             {true,  true,  true,  true,  true,  false},  // IS
+                             {true,  true,  true,  false, false, false},  // IX
+                             {true,  true,  false, true,  false, false},  // S
+                             {true,  true,  false, false, false, false},  // SIX
+                             {true,  false, false, false, false, false}}; // X
+
+  // The weakest mode at least as strong as both
+  BYTE lk_sup(BYTE a, BYTE b) {
+    if (a == b || b == LOCK_NONE)
+      return a;
+    if (a == LOCK_NONE)
+      return b;
+    if ((a == LOCK_IX && b == LOCK_S) || (a == LOCK_S && b == LOCK_IX))
+      return LOCK_SIX;
+    return std::max(a, b);
+  }
+
+  inline bool lk_covers(BYTE held, BYTE want) { return lk_sup(held, want) == held; }
+
+  inline lock_partition_t &lk_partition(const lock_key_t &key) {
+    return partitions[lock_key_hash()(key) % LOCK_PARTITIONS];
+  }
+
+  inline lock_key_t lk_key(uint32_t table, uint16_t page_id, uint16_t rec_id,
+                           BYTE level) {
+    return {table, page_id, rec_id, level};
+  }
+
+  owner_state_t *lk_owner(owner_t owner, bool create) {
+    owner_partition_t &op = owner_partitions[owner % OWNER_PARTITIONS];
+    std::lock_guard<std::mutex> guard(op.mutex);
+    auto it = op.owners.find(owner);
+    if (it != op.owners.end())
+      return it->second.get();
+    if (!create)
+      return nullptr;
+    owner_state_t *state = new owner_state_t;
+    op.owners[owner].reset(state);
+    return state;
+  }
+
+  inline BYTE lk_held(const owner_state_t *state, const lock_key_t &key) {
+    if (state == nullptr)
+      return LOCK_NONE;
+    auto it = state->held.find(key);
+    return it == state->held.end() ? LOCK_NONE : it->second;
+  }
+
+  // True if request <r> of the queue can have its <want> now: no one else
+  // holds a conflicting mode, and (for a new request) no one waits before it
+  bool lk_grantable(const lock_head_t &head, size_t r) {
+    const lock_request_t &req = head.queue[r];
+    for (size_t i = 0; i < head.queue.size(); i++) {
+      const lock_request_t &q = head.queue[i];
+      if (i == r)
+        continue;
+      if (!compat[q.mode][req.want])
+        return false;
+      if (req.mode == LOCK_NONE && i < r && q.mode != q.want)
+        return false;
+    }
+    return true;
+  }
+
+  // Who request <r> waits for: the holders of a conflicting mode, and (for a
+  // new request) the waiters ahead of it
+  void lk_blockers(const lock_head_t &head, size_t r,
+                   std::vector<owner_t> &blockers) {
+    const lock_request_t &req = head.queue[r];
+    blockers.clear();
+    for (size_t i = 0; i < head.queue.size(); i++) {
+      const lock_request_t &q = head.queue[i];
+      if (i == r)
+        continue;
+      if (!compat[q.mode][req.want] ||
+          (req.mode == LOCK_NONE && i < r && q.mode != q.want &&
+           !compat[q.want][req.want]))
+        blockers.push_back(q.owner);
+    }
+  }
+
+  // Grant whatever waiting requests can go now (conversions first, then new
+  // requests in order), wake their owners, and bring the waits-for graph up
+  // to date for the rest; called with the partition locked
+  void lk_grant(lock_partition_t &part, lock_head_t &head) {
+    std::vector<owner_t> granted;
+    for (int pass = 0; pass < 2; pass++) {
+      for (size_t r = 0; r < head.queue.size(); r++) {
+        lock_request_t &req = head.queue[r];
+        if (req.mode == req.want || (pass == 0) != (req.mode != LOCK_NONE))
+          continue;
+        if (!lk_grantable(head, r)) {
+          if (pass == 1)
+            break;
+          continue;
+        }
+        if (req.mode == LOCK_NONE)
+          part.locks++;
+        req.mode = req.want;
+        granted.push_back(req.owner);
+      }
+    }
+    if (granted.empty())
+      return;
+
+    std::lock_guard<std::mutex> guard(graph_mutex);
+    for (owner_t owner : granted)
+      waits_for.erase(owner);
+    std::vector<owner_t> blockers;
+    for (size_t r = 0; r < head.queue.size(); r++) {
+      if (head.queue[r].mode == head.queue[r].want)
+        continue;
+      lk_blockers(head, r, blockers);
+      waits_for[head.queue[r].owner] = blockers;
+    }
+    head.cv.notify_all();
+  }
+
+  // True if following the waits-for graph from <owner> comes back to it
+  bool lk_deadlocked(owner_t owner) {
+    std::lock_guard<std::mutex> guard(graph_mutex);
+    std::vector<owner_t> stack = {owner};
+    std::unordered_set<owner_t> seen;
+    while (!stack.empty()) {
+      owner_t o = stack.back();
+      stack.pop_back();
+      auto it = waits_for.find(o);
+      if (it == waits_for.end())
+        continue;
+      for (owner_t next : it->second) {
+        if (next == owner)
+          return true;
+        if (seen.insert(next).second)
+          stack.push_back(next);
+      }
+    }
+    return false;
+  }
+
+  size_t lk_find(const lock_head_t &head, owner_t owner) {
+    for (size_t r = 0; r < head.queue.size(); r++) {
+      if (head.queue[r].owner == owner)
+        return r;
+    }
+    return head.queue.size();
+  }
+
+  // Get <key> in at least <mode>, waiting as long as it takes; throws a
+  // lock_error if waiting would deadlock
+  void lk_acquire(owner_t owner, owner_state_t &state, const lock_key_t &key,
+                  BYTE mode) {
+    state.requests++;
+    BYTE have = lk_held(&state, key);
+    if (lk_covers(have, mode)) {
+      state.held_already++;
+      return;
+    }
+    BYTE want = lk_sup(have, mode);
+
+    lock_partition_t &part = lk_partition(key);
+    std::unique_lock<std::mutex> lock(part.mutex);
+    lock_head_t &head = part.heads[key];
+    size_t r = lk_find(head, owner);
+    if (r == head.queue.size())
+      head.queue.push_back({owner, LOCK_NONE, want});
+    else
+      head.queue[r].want = want;
+
+    if (lk_grantable(head, r)) {
+      if (head.queue[r].mode == LOCK_NONE)
+        part.locks++;
+      head.queue[r].mode = want;
+      state.held[key] = want;
+      return;
+    }
+
+    // Wait, looking for a deadlock now and then
+    auto start = std::chrono::steady_clock::now();
+    std::vector<owner_t> blockers;
+    bool deadlock = false;
+    while (true) {
+      r = lk_find(head, owner);
+      if (head.queue[r].mode == want)
+        break;
+      lk_blockers(head, r, blockers);
+      {
+        std::lock_guard<std::mutex> guard(graph_mutex);
+        waits_for[owner] = blockers;
+      }
+      if (lk_deadlocked(owner)) {
+        deadlock = true;
+        break;
+      }
+      head.cv.wait_for(lock, std::chrono::milliseconds(LOCK_DEADLOCK_MS));
+    }
+
+    double waited = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    part.waits++;
+    part.wait_seconds += waited;
+    part.max_wait_seconds = std::max(part.max_wait_seconds, waited);
+    {
+      std::lock_guard<std::mutex> guard(graph_mutex);
+      waits_for.erase(owner);
+    }
+    if (!deadlock) {
+      state.held[key] = want;
+      return;
+    }
+
+    // Give up the request: a new one leaves the queue, a conversion keeps the
+    // mode it had.  Either may let others go
+    part.deadlocks++;
+    lock_request_t &req = head.queue[r];
+    if (req.mode == LOCK_NONE)
+      head.queue.erase(head.queue.begin() + r);
+    else
+      req.want = req.mode;
+    lk_grant(part, head);
+    if (head.queue.empty())
+      part.heads.erase(key);
+    throw lock_error(std::string("Deadlock: owner ") + std::to_string(owner) +
+                     " gave up waiting for " + lock_mode_name(want));
+  }
+
+  // Give up one lock of the owner
+  void lk_release(owner_t owner, owner_state_t &state, const lock_key_t &key) {
+    state.held.erase(key);
+    lock_partition_t &part = lk_partition(key);
+    std::lock_guard<std::mutex> guard(part.mutex);
+    auto it = part.heads.find(key);
+    if (it == part.heads.end())
+      return;
+    lock_head_t &head = it->second;
+    size_t r = lk_find(head, owner);
+    if (r == head.queue.size())
+      return;
+    head.queue.erase(head.queue.begin() + r);
+    part.locks--;
+    if (head.queue.empty())
+      part.heads.erase(it);
+    else
+      lk_grant(part, head);
+  }
+
+  // Trade the owner's record locks on <table> for one table lock
+  void lk_escalate(owner_t owner, owner_state_t &state, uint32_t table) {
+    table_rows_t &rows = state.tables[table];
+    lock_key_t tkey = lk_key(table, 0, 0, 0);
+    lk_acquire(owner, state, tkey, rows.any_x ? LOCK_X : LOCK_S);
+    BYTE tmode = lk_held(&state, tkey);
+
+    std::vector<lock_key_t> covered;
+    for (const auto &h : state.held) {
+      if (h.first.table == table && h.first.level > 0 && lk_covers(tmode, h.second))
+        covered.push_back(h.first);
+    }
+    for (const lock_key_t &key : covered)
+      lk_release(owner, state, key);
+    rows.rows = 0;
+    rows.any_x = false;
+    for (const auto &h : state.held) {
+      if (h.first.table == table && h.first.level == 2) {
+        rows.rows++;
+        rows.any_x |= h.second == LOCK_X;
+      }
+    }
+    total_escalations++;
+  }
+
+  inline BYTE lk_intent(BYTE mode) { return mode == LOCK_S ? LOCK_IS : LOCK_IX; }
+}; // namespace Lock_mgr
+
+void Lock_mgr::lock_table(owner_t owner, uint32_t table, BYTE mode) {
+  if (mode == LOCK_NONE || mode > LOCK_X)
+    throw lock_error("Unknown lock mode.");
+  owner_state_t &state = *lk_owner(owner, true);
+  lk_acquire(owner, state, lk_key(table, 0, 0, 0), mode);
+}
+
+void Lock_mgr::lock_page(owner_t owner, uint32_t table, uint16_t page_id,
+                         BYTE mode) {
+  if (mode != LOCK_S && mode != LOCK_X)
+    throw lock_error("Pages are locked in S or X.");
+  owner_state_t &state = *lk_owner(owner, true);
+  lock_key_t tkey = lk_key(table, 0, 0, 0);
+  if (lk_covers(lk_held(&state, tkey), mode)) {
+    state.requests++;
+    state.held_already++;
+    return;
+  }
+  lk_acquire(owner, state, tkey, lk_intent(mode));
+  lk_acquire(owner, state, lk_key(table, page_id, 0, 1), mode);
+}
+
+void Lock_mgr::lock_row(owner_t owner, uint32_t table, uint16_t page_id,
+                        uint16_t rec_id, BYTE mode) {
+  if (mode != LOCK_S && mode != LOCK_X)
+    throw lock_error("Records are locked in S or X.");
+  owner_state_t &state = *lk_owner(owner, true);
+  lock_key_t tkey = lk_key(table, 0, 0, 0);
+  lock_key_t pkey = lk_key(table, page_id, 0, 1);
+  if (lk_covers(lk_held(&state, tkey), mode) ||
+      lk_covers(lk_held(&state, pkey), mode)) {
+    state.requests++;
+    state.held_already++;
+    return;
+  }
+  lk_acquire(owner, state, tkey, lk_intent(mode));
+  lk_acquire(owner, state, pkey, lk_intent(mode));
+
+  lock_key_t rkey = lk_key(table, page_id, rec_id, 2);
+  bool is_new = lk_held(&state, rkey) == LOCK_NONE;
+  lk_acquire(owner, state, rkey, mode);
+  table_rows_t &rows = state.tables[table];
+  rows.rows += is_new;
+  rows.any_x |= mode == LOCK_X;
+  size_t limit = escalate_rows;
+  if (limit != 0 && rows.rows > limit)
+    lk_escalate(owner, state, table);
+}
+
+BYTE Lock_mgr::lock_mode_table(owner_t owner, uint32_t table) {
+  return lk_held(lk_owner(owner, false), lk_key(table, 0, 0, 0));
+}
+
+BYTE Lock_mgr::lock_mode_page(owner_t owner, uint32_t table, uint16_t page_id) {
+  const owner_state_t *state = lk_owner(owner, false);
+  BYTE tmode = lk_held(state, lk_key(table, 0, 0, 0));
+  if (tmode == LOCK_X || tmode == LOCK_S)
+    return tmode;
+  BYTE pmode = lk_held(state, lk_key(table, page_id, 0, 1));
+  if (pmode == LOCK_NONE && tmode == LOCK_SIX)
+    return LOCK_S;
+  return pmode;
+}
+
+BYTE Lock_mgr::lock_mode_row(owner_t owner, uint32_t table, uint16_t page_id,
+                             uint16_t rec_id) {
+  BYTE pmode = lock_mode_page(owner, table, page_id);
+  if (pmode == LOCK_X)
+    return pmode;
+  BYTE rmode = lk_held(lk_owner(owner, false), lk_key(table, page_id, rec_id, 2));
+  if (rmode != LOCK_NONE)
+    return rmode;
+  return pmode == LOCK_S ? LOCK_S : LOCK_NONE;
+}
+
+void Lock_mgr::lock_release_all(owner_t owner) {
+  owner_state_t *state = lk_owner(owner, false);
+  if (state == nullptr)
+    return;
+  // Records first, then pages, then tables, so no one is granted a table
+  // lock while a record beneath it is still held
+  std::vector<lock_key_t> keys;
+  for (const auto &h : state->held)
+    keys.push_back(h.first);
+  std::sort(keys.begin(), keys.end(), [](const lock_key_t &a, const lock_key_t &b) {
+    return a.level > b.level;
+  });
+  for (const lock_key_t &key : keys)
+    lk_release(owner, *state, key);
+  total_requests += state->requests;
+  total_held += state->held_already;
+
+  owner_partition_t &op = owner_partitions[owner % OWNER_PARTITIONS];
+  std::lock_guard<std::mutex> guard(op.mutex);
+  op.owners.erase(owner);
+}
+
+size_t Lock_mgr::lock_set_escalation(size_t rows) {
+  return escalate_rows.exchange(rows);
+}
+
+size_t Lock_mgr::lock_escalation() { return escalate_rows; }
+
+Lock_mgr::lock_stats_t Lock_mgr::lock_stats() {
+  lock_stats_t stats = {};
+  stats.requests = total_requests;
+  stats.held = total_held;
+  stats.escalations = total_escalations;
+  for (lock_partition_t &part : partitions) {
+    std::lock_guard<std::mutex> guard(part.mutex);
+    stats.waits += part.waits;
+    stats.wait_seconds += part.wait_seconds;
+    stats.max_wait_seconds = std::max(stats.max_wait_seconds, part.max_wait_seconds);
+    stats.deadlocks += part.deadlocks;
+    stats.locks += part.locks;
+  }
+  return stats;
+}
+
+void Lock_mgr::lock_reset_stats() {
+  total_requests = 0;
+  total_held = 0;
+  total_escalations = 0;
+  for (lock_partition_t &part : partitions) {
+    std::lock_guard<std::mutex> guard(part.mutex);
+    part.waits = 0;
+    part.wait_seconds = 0;
+    part.max_wait_seconds = 0;
+    part.deadlocks = 0;
+  }
+}
+
+const char *Lock_mgr::lock_mode_name(BYTE mode) {
+  static const char *names[] = {"NONE", "IS", "IX", "S", "SIX", "X"};
+  return mode <= LOCK_X ? names[mode] : "?";
+}
@@ -0,0 +1,97 @@
+#ifndef LOCK_MGR_H
+#define LOCK_MGR_H
+
+#include "../paging/paging.h"
+
+#include <cstdint>
+#include <string>
+
+namespace Lock_mgr {
+  // Locks on tables, pages and records, held by an owner (a writing
+  // transaction) until it releases them all at once when it ends.
+  //
+  // Locks nest: a record lock is taken under an intention lock on its page,
+  // and a page lock under one on its table, so a table lock conflicts with
+  // the record and page locks taken beneath it without anyone looking for
+  // them.  lock_row() and lock_page() take the intention locks above them
+  // first.  Asking again for a lock already held in a mode at least as strong
+  // returns at once; asking for a stronger one converts the lock, waiting for
+  // the holders that conflict with the stronger mode.
+  //
+  // The lock table is hashed over LOCK_PARTITIONS, each with its own mutex, so
+  // owners locking different things do not meet at one mutex.  A request that
+  // has to wait records which owners it waits for; the waits-for graph is
+  // searched for a cycle when it starts waiting, and again every
+  // LOCK_DEADLOCK_MS while it waits.  The owner that finds the cycle gives up
+  // its request and gets a lock_error; it should release its locks (ending its
+  // transaction) and may try again.
+  //
+  // An owner that locks more than lock_escalation() records of one table has
+  // them escalated to one table lock: S if all it asked for were S, else X.
+  // Bulk operations lock the whole table up front instead.
+  //
+  // An owner is used by one thread at a time.  Readers that read through an
+  // MVCC snapshot take no locks at all.
+
+  typedef uint32_t owner_t;
+
+  // Lock modes, weakest first
+  const BYTE LOCK_NONE = 0;
+  const BYTE LOCK_IS = 1;   // intention to lock records (or pages) beneath in S
+  const BYTE LOCK_IX = 2;   // intention to lock records (or pages) beneath in X
+  const BYTE LOCK_S = 3;    // shared
+  const BYTE LOCK_SIX = 4;  // S, and intention to lock beneath in X
+  const BYTE LOCK_X = 5;    // exclusive
+
+  const uint16_t LOCK_PARTITIONS = 64;
+  const unsigned LOCK_DEADLOCK_MS = 10;   // how often a waiter looks for a deadlock again
+  const size_t LOCK_ESCALATE_ROWS = 5000; // the default of lock_escalation()
+
+  struct lock_stats_t {
+    uint64_t requests;     // calls that asked for a lock
+    uint64_t held;         // of those, already held in a mode at least as strong
+    uint64_t waits;        // requests that had to wait
+    double wait_seconds;   // time spent waiting, summed
+    double max_wait_seconds;
+    uint64_t deadlocks;    // requests given up to break a cycle
+    uint64_t escalations;
+    uint64_t locks;        // locks held right now, over all owners
+  };
+
+  class lock_error : public std::runtime_error {
+  public:
+    lock_error(std::string what) : std::runtime_error(what) {}
+    lock_error(const char *what) : std::runtime_error(what) {}
+  };
+
+  // Lock a table; <table> is any number naming it for every owner.
+  void lock_table(owner_t owner, uint32_t table, BYTE mode);
+  // Lock a page of a table (S or X), under IS or IX on the table.
+  void lock_page(owner_t owner, uint32_t table, uint16_t page_id, BYTE mode);
+  // Lock a record (S or X), under IS or IX on its page and table.
+  void lock_row(owner_t owner, uint32_t table, uint16_t page_id,
+                uint16_t rec_id, BYTE mode);
+
+  // The mode <owner> holds a table, page or record in (LOCK_NONE if none);
+  // a page or record covered by a table lock reports that table's mode.
+  BYTE lock_mode_table(owner_t owner, uint32_t table);
+  BYTE lock_mode_page(owner_t owner, uint32_t table, uint16_t page_id);
+  BYTE lock_mode_row(owner_t owner, uint32_t table, uint16_t page_id,
+                     uint16_t rec_id);
+
+  // Release every lock of the owner, waking whoever waits for them.
+  void lock_release_all(owner_t owner);
+
+  // Records of one table an owner may lock before they are escalated
+  // (0 never escalates); returns the old value.
+  size_t lock_set_escalation(size_t rows);
+  size_t lock_escalation();
+
+  lock_stats_t lock_stats();
+  void lock_reset_stats();
+
+  // "IS", "IX", ... for messages
+  const char *lock_mode_name(BYTE mode);
+}; // namespace Lock_mgr
+
+#endif // LOCK_MGR_H
@@ -0,0 +1,207 @@
+#include "io_stats.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+namespace Io_stats {
+  const size_t IO_WORDS = sizeof(io_stats_t) / sizeof(uint64_t);
+
+  // A thread's counters.  Only the owner writes them, so a relaxed load and
+  // store is enough to add (no locked instruction); the atomics are there so
+  // io_stats() may read them meanwhile.
+  struct io_block_t {
+    std::atomic<uint64_t> words[IO_WORDS];
+    io_block_t() {
+      for (std::atomic<uint64_t> &w : words)
+        w.store(0, std::memory_order_relaxed);
+    }
+  };
+
+  std::mutex registry_mutex;
+  std::vector<io_block_t *> live;  // blocks of running threads
+  uint64_t retired[IO_WORDS];      // sums of threads that have exited
+  uint64_t baseline[IO_WORDS];     // sums at the last io_reset_stats()
+  // guarded by registry_mutex
+
+  // Where a thread records once its own block is gone, from the destructors
+  // of statics that run after it; updates racing here may be lost.
+  io_block_t orphan;
+
+  static thread_local io_block_t *mine = nullptr;
+
+  // Registers a thread's block on its first use, and folds it into the
+  // retired sums when the thread exits.
+  struct io_owner_t {
+    io_block_t block;
+    io_owner_t() {
+      std::lock_guard<std::mutex> guard(registry_mutex);
+      live.push_back(&block);
+    }
+    ~io_owner_t() {
+      std::lock_guard<std::mutex> guard(registry_mutex);
+      for (size_t i = 0; i < IO_WORDS; i++)
+        retired[i] += block.words[i].load(std::memory_order_relaxed);
+      for (size_t i = 0; i < live.size(); i++) {
+        if (live[i] == &block) {
+          live[i] = live.back();
+          live.pop_back();
+          break;
+        }
+      }
+      mine = &orphan;
+    }
+  };
+
+  static std::atomic<uint64_t> *io_word(size_t offset) {
+    if (!mine) {
+      static thread_local io_owner_t owner;
+      mine = &owner.block;
+    }
+    return &mine->words[offset / sizeof(uint64_t)];
+  }
+
+  static void io_add(std::atomic<uint64_t> &w, uint64_t n) {
+    w.store(w.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+  }
+
+  static unsigned io_bucket(uint64_t ns) {
+    unsigned b = ns ? 64 - __builtin_clzll(ns) : 0;
+    return b < IO_HIST_BUCKETS ? b : IO_HIST_BUCKETS - 1;
+  }
+
+  static void io_sum(uint64_t (&words)[IO_WORDS]) {
+    memcpy(words, retired, sizeof(words));
+    for (size_t i = 0; i < IO_WORDS; i++)
+      words[i] += orphan.words[i].load(std::memory_order_relaxed);
+    for (io_block_t *block : live)
+      for (size_t i = 0; i < IO_WORDS; i++)
+        words[i] += block->words[i].load(std::memory_order_relaxed);
+  }
+
+  static void io_json_hist(std::string &out, const char *name, const io_hist_t &h) {
+    char buf[256];
+    snprintf(buf, sizeof(buf),
+             ", \"%s\": {\"count\": %llu, \"mean\": %llu, \"p50\": %llu, \"p99\": %llu, \"max\": %llu}",
+             name, (unsigned long long)h.count,
+             (unsigned long long)(h.count ? h.total_ns / h.count : 0),
+             (unsigned long long)io_percentile(h, 0.5),
+             (unsigned long long)io_percentile(h, 0.99),
+             (unsigned long long)io_percentile(h, 1));
+    out += buf;
+  }
+
+  static void io_text_hist(std::string &out, const char *name, const io_hist_t &h) {
+    char buf[256];
+    snprintf(buf, sizeof(buf), "  %-6s %10llu %10llu %10llu %10llu %10llu\n", name,
+             (unsigned long long)h.count,
+             (unsigned long long)(h.count ? h.total_ns / h.count : 0),
+             (unsigned long long)io_percentile(h, 0.5),
+             (unsigned long long)io_percentile(h, 0.99),
+             (unsigned long long)io_percentile(h, 1));
+    out += buf;
+  }
+}; // namespace Io_stats
+
+void Io_stats::io_count(size_t counter, uint64_t n) {
+  io_add(*io_word(counter), n);
+}
+
+void Io_stats::io_time(size_t hist, uint64_t ns) {
+  std::atomic<uint64_t> *h = io_word(hist);
+  io_add(h[offsetof(io_hist_t, count) / sizeof(uint64_t)], 1);
+  io_add(h[offsetof(io_hist_t, total_ns) / sizeof(uint64_t)], ns);
+  io_add(h[offsetof(io_hist_t, buckets) / sizeof(uint64_t) + io_bucket(ns)], 1);
+}
+
+uint64_t Io_stats::io_now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+Io_stats::io_stats_t Io_stats::io_stats() {
+  uint64_t words[IO_WORDS];
+  std::lock_guard<std::mutex> guard(registry_mutex);
+  io_sum(words);
+  for (size_t i = 0; i < IO_WORDS; i++)
+    words[i] -= baseline[i];
+  io_stats_t stats;
+  memcpy(&stats, words, sizeof(stats));
+  return stats;
+}
+
+void Io_stats::io_reset_stats() {
+  std::lock_guard<std::mutex> guard(registry_mutex);
+  io_sum(baseline);
+}
+
+Io_stats::io_stats_t Io_stats::io_delta(const io_stats_t &after, const io_stats_t &before) {
+  uint64_t a[IO_WORDS], b[IO_WORDS];
+  memcpy(a, &after, sizeof(a));
+  memcpy(b, &before, sizeof(b));
+  for (size_t i = 0; i < IO_WORDS; i++)
+    a[i] -= b[i];
+  io_stats_t delta;
+  memcpy(&delta, a, sizeof(delta));
+  return delta;
+}
+
+uint64_t Io_stats::io_percentile(const io_hist_t &hist, double p) {
+  if (!hist.count)
+    return 0;
+  // the rank of the timing wanted, counting from 1
+  uint64_t rank = (uint64_t)(p * hist.count);
+  if (rank < p * hist.count)
+    rank++;
+  rank = std::max<uint64_t>(rank, 1);
+  uint64_t seen = 0;
+  for (unsigned b = 0; b < IO_HIST_BUCKETS; b++) {
+    seen += hist.buckets[b];
+    if (seen >= rank)
+      return (uint64_t)1 << b;
+  }
+  return (uint64_t)1 << (IO_HIST_BUCKETS - 1);
+}
+
+std::string Io_stats::io_stats_text(const io_stats_t &s) {
+  char buf[512];
+  uint64_t lookups = s.hits + s.misses;
+  snprintf(buf, sizeof(buf),
+           "buffer pool: %llu hits, %llu misses (%.1f%% hits), %llu prefetched, %llu evictions, %llu writebacks\n"
+           "page file:   %llu reads (%llu bytes), %llu writes (%llu bytes)\n"
+           "  %-6s %10s %10s %10s %10s %10s\n",
+           (unsigned long long)s.hits, (unsigned long long)s.misses,
+           lookups ? 100.0 * s.hits / lookups : 0.0, (unsigned long long)s.prefetched,
+           (unsigned long long)s.evictions, (unsigned long long)s.writebacks,
+           (unsigned long long)s.reads, (unsigned long long)s.read_bytes,
+           (unsigned long long)s.writes, (unsigned long long)s.write_bytes,
+           "ns", "count", "mean", "p50", "p99", "max");
+  std::string out = buf;
+  io_text_hist(out, "miss", s.miss_ns);
+  io_text_hist(out, "read", s.read_ns);
+  io_text_hist(out, "write", s.write_ns);
+  io_text_hist(out, "flush", s.flush_ns);
+  return out;
+}
+
+std::string Io_stats::io_stats_json(const io_stats_t &s) {
+  char buf[512];
+  snprintf(buf, sizeof(buf),
+           "{\"hits\": %llu, \"misses\": %llu, \"prefetched\": %llu, \"evictions\": %llu, \"writebacks\": %llu, "
+           "\"reads\": %llu, \"read_bytes\": %llu, \"writes\": %llu, \"write_bytes\": %llu",
+           (unsigned long long)s.hits, (unsigned long long)s.misses, (unsigned long long)s.prefetched,
+           (unsigned long long)s.evictions, (unsigned long long)s.writebacks,
+           (unsigned long long)s.reads, (unsigned long long)s.read_bytes,
+           (unsigned long long)s.writes, (unsigned long long)s.write_bytes);
+  std::string out = buf;
+  io_json_hist(out, "miss_ns", s.miss_ns);
+  io_json_hist(out, "read_ns", s.read_ns);
+  io_json_hist(out, "write_ns", s.write_ns);
+  io_json_hist(out, "flush_ns", s.flush_ns);
+  out += "}";
+  return out;
+}
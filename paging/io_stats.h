@@ -0,0 +1,88 @@
+#ifndef IO_STATS_H
+#define IO_STATS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Counters and latency histograms of the buffer pool and of page file IO,
+// cheap enough to leave on.
+//
+// Each thread adds to a block of its own, so recording never takes a lock or
+// shares a cache line; only io_stats() walks the blocks of every thread (and
+// what threads that have exited left behind) and sums them.  io_reset_stats()
+// does not touch the blocks either: it records the current sums, and later
+// snapshots are taken relative to them.
+//
+// Latencies go into log2 buckets of nanoseconds, so percentiles and the
+// maximum are reported as the upper bound of their bucket (within 2x).
+
+namespace Io_stats {
+  const unsigned IO_HIST_BUCKETS = 40; // bucket b holds [2^(b-1), 2^b) ns; the last one also anything longer
+
+  struct io_hist_t {
+    uint64_t count;
+    uint64_t total_ns;
+    uint64_t buckets[IO_HIST_BUCKETS];
+  };
+
+  // Every field is a uint64_t or made of them, which io_stats.cpp relies on.
+  struct io_stats_t {
+    uint64_t hits;        // buf_read of a page in the pool
+    uint64_t misses;      // buf_read that had to read the page from the file
+    uint64_t prefetched;  // pages brought in by buf_prefetch
+    uint64_t evictions;   // pages replaced to make room
+    uint64_t writebacks;  // dirty pages written back, when replaced or flushed
+    uint64_t reads;       // pgf_read and pgf_read_run calls
+    uint64_t read_bytes;
+    uint64_t writes;      // pgf_write and pgf_write_run calls
+    uint64_t write_bytes;
+    io_hist_t miss_ns;    // whole buf_read misses, making room included
+    io_hist_t read_ns;
+    io_hist_t write_ns;
+    io_hist_t flush_ns;   // flush_all calls
+  };
+
+  // What to add to, for io_count() and io_time()
+  const size_t IO_HITS = offsetof(io_stats_t, hits);
+  const size_t IO_MISSES = offsetof(io_stats_t, misses);
+  const size_t IO_PREFETCHED = offsetof(io_stats_t, prefetched);
+  const size_t IO_EVICTIONS = offsetof(io_stats_t, evictions);
+  const size_t IO_WRITEBACKS = offsetof(io_stats_t, writebacks);
+  const size_t IO_READS = offsetof(io_stats_t, reads);
+  const size_t IO_READ_BYTES = offsetof(io_stats_t, read_bytes);
+  const size_t IO_WRITES = offsetof(io_stats_t, writes);
+  const size_t IO_WRITE_BYTES = offsetof(io_stats_t, write_bytes);
+  const size_t IO_MISS_NS = offsetof(io_stats_t, miss_ns);
+  const size_t IO_READ_NS = offsetof(io_stats_t, read_ns);
+  const size_t IO_WRITE_NS = offsetof(io_stats_t, write_ns);
+  const size_t IO_FLUSH_NS = offsetof(io_stats_t, flush_ns);
+
+  void io_count(size_t counter, uint64_t n = 1);
+  void io_time(size_t hist, uint64_t ns);
+  uint64_t io_now_ns();
+
+  // Times the scope it is declared in into a histogram.
+  struct io_timer_t {
+    size_t hist;
+    uint64_t start;
+    io_timer_t(size_t h) : hist(h), start(io_now_ns()) {}
+    ~io_timer_t() { io_time(hist, io_now_ns() - start); }
+  };
+
+  // Everything recorded since the last io_reset_stats(), over all threads.
+  io_stats_t io_stats();
+  void io_reset_stats();
+  // What was recorded between two snapshots.
+  io_stats_t io_delta(const io_stats_t &after, const io_stats_t &before);
+
+  // Upper bound of the latency below which fraction <p> of the timings fall
+  // (p = 1 for the maximum); 0 if nothing was timed.
+  uint64_t io_percentile(const io_hist_t &hist, double p);
+
+  // A table for people, and one line of JSON for scripts.
+  std::string io_stats_text(const io_stats_t &stats);
+  std::string io_stats_json(const io_stats_t &stats);
+}; // namespace Io_stats
+
+#endif // IO_STATS_H
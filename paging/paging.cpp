@@ -1,4 +1,6 @@
 #include "paging.h"
+#include "pax_page.h"
+#include "io_stats.h"
 
 #include <fstream>
 #include <iostream>
@@ -59,6 +61,19 @@ std::ostream &operator<<(std::ostream &os, const Page::record_t &rec) {
 }
 
 std::ostream &operator<<(std::ostream &os, const Page::Page_t &page) {
+  if (Page::pax_is_pax(&page)) {
+    const Page::pax_header_t *h = (const Page::pax_header_t *)&page;
+    os << "PAX, Columns = " << h->num_cols << ", Rows = " << h->num_rows
+       << " of " << h->capacity << ", records: ";
+    std::string rec;
+    for (uint16_t id = 0; id < h->num_rows; id++) {
+      if (Page::pax_get_record(&page, id, rec))
+        os << std::endl << "   id = " << id << ", " << *(const Page::record_t *)rec.data();
+      else
+        os << std::endl << "   id = " << id << ", UNUSED";
+    }
+    return os;
+  }
   os << "Bytes free = " << page.free_bytes << ", Entries = " << page.dir_size
      << ", records: ";
   uint16_t *dirarray = PG_DIRECTORY(&page);
@@ -68,13 +83,36 @@ std::ostream &operator<<(std::ostream &os, const Page::Page_t &page) {
     if (entry == Page::PG_REC_UNUSED) {
       os << std::endl << "   id = " << id++ << ", UNUSED";
     } else {
-      Page::record_t *rec = (Page::record_t *)(((BYTE *)&page) + entry);
+      Page::record_t *rec =
+          (Page::record_t *)(((BYTE *)&page) + Page::pg_rec_offset(entry));
       os << std::endl << "   id = " << id++ << ", " << *rec;
+      if (entry & Page::PG_REC_DELETED)
+        os << " (deleted)";
     }
   }
   return os;
 }
 
+std::ostream &operator<<(std::ostream &os, const Page::value_t &val) {
+  switch (val.type) {
+  case Page::RTYPE_NULL:
+    os << "NULL";
+    break;
+  case Page::RTYPE_SHORT:
+    os << val.s;
+    break;
+  case Page::RTYPE_INT:
+    os << val.i;
+    break;
+  case Page::RTYPE_DOUBLE:
+    os << val.d;
+    break;
+  default:
+    os.write(val.str.ptr, val.str.len);
+  }
+  return os;
+}
+
 void Page_file::print(file_descriptor_t &pfile) {
   pfile.seekg(0, std::ios_base::beg);
   Page::Page_header_t ph;
@@ -120,7 +158,7 @@ void Page_file::print(const char fname[]) {
 }
 
 void Page_file::pgf_format(const char fname[200], uint16_t fsize) {
-  // page file header:  |sig+first_free+reserved|  ...    |
+  // page file header:  |sig+num_pages+meta+reserved|  ...    |
 
   if (fsize <= 4) {
     // pages 0, 1, 2, and 3 are reserved
@@ -132,7 +170,7 @@ void Page_file::pgf_format(const char fname[200], uint16_t fsize) {
   }
 
   // fix up page header here
-  Page::Page_header_t ph = {{'E', 'A', 'G', 'L'}, fsize};
+  Page::Page_header_t ph = {{'E', 'A', 'G', 'L'}, fsize, {0}};
   memset(              //(BYTE *)&ph + strlen("EAGL") + sizeof(unsigned short)
          ph.rest, 0,
          sizeof(Page::Page_header_t::rest));
@@ -160,6 +198,9 @@ void Page_file::pgf_format(const char fname[200], uint16_t fsize) {
 // Write a page in memory to disk.
 void Page_file::pgf_write(file_descriptor_t &pfile, int page_id,
                           void *page_buf) {
+  Io_stats::io_timer_t timer(Io_stats::IO_WRITE_NS);
+  Io_stats::io_count(Io_stats::IO_WRITES);
+  Io_stats::io_count(Io_stats::IO_WRITE_BYTES, PAGE_SIZE);
   pfile.seekg(PAGE_SIZE * page_id, std::ios_base::beg);
   if (pfile.fail() || pfile.bad()) {
     throw std::runtime_error("Cannot seek to page");
@@ -169,9 +210,28 @@ void Page_file::pgf_write(file_descriptor_t &pfile, int page_id,
     throw std::runtime_error("Cannot write to page");
   }
 }
+void Page_file::pgf_write_run(file_descriptor_t &pfile, int first_page_id,
+                              int count, void *pages_buf) {
+  Io_stats::io_timer_t timer(Io_stats::IO_WRITE_NS);
+  Io_stats::io_count(Io_stats::IO_WRITES);
+  Io_stats::io_count(Io_stats::IO_WRITE_BYTES, (uint64_t)PAGE_SIZE * count);
+  pfile.seekp(PAGE_SIZE * (std::streamoff)first_page_id, std::ios_base::beg);
+  if (pfile.fail() || pfile.bad()) {
+    throw std::runtime_error("Cannot seek to page");
+  }
+  pfile.write(reinterpret_cast<char *>(pages_buf),
+              (std::streamsize)PAGE_SIZE * count);
+  if (pfile.fail() || pfile.bad()) {
+    throw std::runtime_error("Cannot write to page");
+  }
+}
+
 // Read a page from disk to memory
 void Page_file::pgf_read(file_descriptor_t &pfile, int page_id,
                          void *page_buf) {
+  Io_stats::io_timer_t timer(Io_stats::IO_READ_NS);
+  Io_stats::io_count(Io_stats::IO_READS);
+  Io_stats::io_count(Io_stats::IO_READ_BYTES, PAGE_SIZE);
   pfile.seekg(PAGE_SIZE * page_id, std::ios_base::beg);
   // pfile.clear();
   // std::cout << pfile.tellg() << std::endl;
@@ -190,6 +250,22 @@ void Page_file::pgf_read(file_descriptor_t &pfile, int page_id,
   }
 }
 
+void Page_file::pgf_read_run(file_descriptor_t &pfile, int first_page_id,
+                             int count, void *pages_buf) {
+  Io_stats::io_timer_t timer(Io_stats::IO_READ_NS);
+  Io_stats::io_count(Io_stats::IO_READS);
+  Io_stats::io_count(Io_stats::IO_READ_BYTES, (uint64_t)PAGE_SIZE * count);
+  pfile.seekg(PAGE_SIZE * (std::streamoff)first_page_id, std::ios_base::beg);
+  if (pfile.fail() || pfile.bad()) {
+    throw std::runtime_error("Cannot seek to page");
+  }
+  pfile.read(reinterpret_cast<char *>(pages_buf),
+             (std::streamsize)PAGE_SIZE * count);
+  if (pfile.fail() || pfile.bad()) {
+    throw std::runtime_error("Cannot read page");
+  }
+}
+
 // return the page number of a page of size 0
 int Page_file::pgf_find_free(file_descriptor_t &pfile) { return 0; }
 
@@ -218,20 +294,18 @@ void Page::pg_pushdown(void *page_buf, uint16_t num_bytes,
 
 // Returns a pointer to the record in memory.
 void *Page::rec_get_ref(void *page, uint16_t rec_id, uint16_t &size) {
-  record_t *start = (record_t *)(reinterpret_cast<rec_offset_t *>(
-                                     PG_DIRECTORY(page))[rec_id] +
+  record_t *start = (record_t *)(pg_rec_offset(PG_DIRECTORY(page)[rec_id]) +
                                  reinterpret_cast<char *>(page));
   size = start->size;
   return start;
 }
 
-// Returns number of bytes left if whole record is not copied.  Throws exception
-// if size > the record len.
-BYTE *Page::rec_make_copy(void *page, BYTE rec_id, void *rec_buffer,
+// Copies the record into <rec_buffer>, which must have room for it (no record
+// is larger than a page), and sets <size> to its length.  Returns <rec_buffer>.
+BYTE *Page::rec_make_copy(void *page, uint16_t rec_id, void *rec_buffer,
                           uint16_t &size) {
-  BYTE *offset = reinterpret_cast<BYTE *>(rec_get_ref(page, rec_id, size));
-  BYTE *buf = new BYTE[size];
-  memcpy(buf, offset, size);
+  void *rec = rec_get_ref(page, rec_id, size);
+  memcpy(rec_buffer, rec, size);
   return (BYTE *)rec_buffer;
 }
 
@@ -252,25 +326,15 @@ Page::pg_add_record(void *page, void *record,
   memcpy(dest, record, ((record_t *)record)->size);
   pgptr->free_bytes -= reclen;
 
-  // Now, update record directory
+  // Now, update record directory: it grows down by one entry, so slide the
+  // old entries down and put the new record's offset last.  No copy of the
+  // directory is made, so adding a record never allocates.
   rec_offset_t *pgdir = reinterpret_cast<rec_offset_t *>(PG_DIRECTORY(page));
-  // bad, expensive cheat below :
   unsigned short *num_records_ptr = PG_NUM_RECORDS_PTR(page);
-
-  // Copy the directory to this vector that
-  //  will be used to add the new offset
-  std::vector<unsigned short> dir(pgdir, pgdir + *num_records_ptr);
-
-  // add the record offset to the end of the copied directory
-  dir.push_back((BYTE *)dest - (BYTE *)page); 
-
-  pgdir--; // Back up the pointer to the page directory because the it is larger
-           // by one.
+  memmove(pgdir - 1, pgdir, *num_records_ptr * sizeof(uint16_t));
+  pgdir[*num_records_ptr - 1] = (BYTE *)dest - (BYTE *)page;
 
   pgptr->free_bytes -= sizeof(uint16_t); // new directory entry takes 2 bytes
-  memcpy(pgdir, dir.data(),
-         dir.size() *
-             sizeof(uint16_t)); // Replace the old directory with the new one
   uint16_t retval = *num_records_ptr; // The added record id is the last, so we
                                       // will return this index
   (*num_records_ptr)++; // Increase the num_records count in the page by one.
@@ -299,33 +363,60 @@ void Page::pg_del_record(void *page, unsigned short rec_id) {
   ((Page_t *)page)->free_bytes += size;
 }
 
+void Page::pg_mark_deleted(void *page, uint16_t rec_id) {
+  if (pax_is_pax(page)) {
+    pax_header_t *h = (pax_header_t *)page;
+    if (rec_id >= h->num_rows)
+      throw paging_error("record id out of range");
+    ((BYTE *)page)[h->dead + rec_id] |= PAX_ROW_DELETED;
+    return;
+  }
+  uint16_t *pgdir = PG_DIRECTORY(page);
+  if (rec_id >= *PG_NUM_RECORDS_PTR(page) || pgdir[rec_id] == PG_REC_UNUSED)
+    throw paging_error("no record to mark deleted");
+  pgdir[rec_id] |= PG_REC_DELETED;
+}
+
+bool Page::pg_is_deleted(const void *page, uint16_t rec_id) {
+  if (pax_is_pax(page)) {
+    const pax_header_t *h = (const pax_header_t *)page;
+    return rec_id < h->num_rows &&
+           (((const BYTE *)page)[h->dead + rec_id] & PAX_ROW_DELETED);
+  }
+  const uint16_t *pgdir = PG_DIRECTORY(page);
+  return rec_id < *PG_NUM_RECORDS_PTR(page) &&
+         pgdir[rec_id] != PG_REC_UNUSED && (pgdir[rec_id] & PG_REC_DELETED);
+}
+
 void Page::pg_fixup_directory(void *page, uint16_t rec_id, uint16_t offset) {
   uint16_t num_records = *PG_NUM_RECORDS_PTR(page);
   rec_offset_t *pgdir = reinterpret_cast<rec_offset_t *>(PG_DIRECTORY(page));
+  uint16_t at = pg_rec_offset(pgdir[rec_id]);
   for (uint16_t id = 0; id < num_records; id++) {
-    if (pgdir[id] != PG_REC_UNUSED && pgdir[id] > pgdir[rec_id]) {
+    // adding to the offset keeps a deleted mark, as offsets stay below it
+    if (pgdir[id] != PG_REC_UNUSED && pg_rec_offset(pgdir[id]) > at) {
       pgdir[id] += offset;
     }
   }
 }
 
 int Page::pg_modify_record(void *page, void *record, uint16_t rec_id) {
-  //  // Return > 0 if record is now too big and must to moved
-  //       to another page.
+  // Returns 0 once the record is replaced, or > 0 (the bytes missing) if the
+  // new record is now too big and must be moved to another page, in which
+  // case the page is left as it was.
   Page_t *pg = static_cast<Page_t *>(page);
+  if (rec_id >= *PG_NUM_RECORDS_PTR(page))
+    throw paging_error("page id out of range");
   uint16_t rec_len = ((record_t *)record)->size;
   uint16_t *fbptr = &(pg->free_bytes);
   uint16_t *pgdir = PG_DIRECTORY(page);
-  uint16_t offset = pgdir[rec_id];
+  uint16_t offset = pg_rec_offset(pgdir[rec_id]);
   record_t *old_rec = reinterpret_cast<record_t *>((BYTE *)page + offset);
-  if (rec_id > *PG_NUM_RECORDS_PTR(page))
-    throw paging_error("page id out of range");
   if (rec_len - old_rec->size > *fbptr)
     return rec_len - old_rec->size;
   if (rec_len == old_rec->size) {
     // copy the record to the page
     memcpy(old_rec, record, rec_len);
-    return 0;
   } else if (rec_len < old_rec->size) {
     unsigned short dif = old_rec->size - rec_len;
     pg_compact(page, old_rec->size - rec_len,
@@ -334,6 +425,7 @@ int Page::pg_modify_record(void *page, void *record, uint16_t rec_id) {
     memcpy(old_rec, record, rec_len);
     // Then, update the record directory by fixing up the offsets
     pg_fixup_directory(page, rec_id, 0 - dif);
+    *fbptr += dif;
   } else {
     // push_down the record after this one the required number of bytes
     unsigned short dif = rec_len - old_rec->size;
@@ -342,8 +434,9 @@ int Page::pg_modify_record(void *page, void *record, uint16_t rec_id) {
     memcpy(old_rec, record, rec_len);
     // Then, update the record directory by fixing up the offsets
     pg_fixup_directory(page, rec_id, dif);
+    *fbptr -= dif;
   }
-  return rec_len;
+  return 0;
 }
 
 BYTE *Page::next_record(void *page, uint16_t &next) {
@@ -352,7 +445,7 @@ BYTE *Page::next_record(void *page, uint16_t &next) {
   }
   uint16_t *dir = PG_DIRECTORY(page);
 
-  BYTE *where = (BYTE *) page + dir[next];
+  BYTE *where = (BYTE *) page + pg_rec_offset(dir[next]);
   next++;
   return where;
 }
@@ -392,6 +485,14 @@ void Page::rec_packstr(std::string &buf, const std::string &str) {
   memcpy(bufdata + old_size + sizeof(uint16_t), str.data(), str.size());
 }
 
+// A NULL is only a type spec, with no data following it
+void Page::rec_packnull(std::string &buf) {
+  size_t old_size = buf.size();
+  buf.resize(old_size + sizeof(uint16_t));
+  char *bufdata = const_cast<char *>(buf.data());
+  *(uint16_t *)(bufdata + old_size) = RTYPE_NULL;
+}
+
 // Throws exception if next item is not an int
 int Page::rec_upackint(void *buf, unsigned short &next) {
   // int val;
@@ -426,6 +527,120 @@ int Page::rec_upackstr(void *buf, unsigned short &next, std::string &val) {
   return val.size();
 }
 
+void Page::rec_packdouble(std::string &buf, double val) {
+  size_t old_size = buf.size();
+  buf.resize(old_size + sizeof(uint16_t) + sizeof(double));
+  char *bufdata = const_cast<char *>(buf.data());
+  *(uint16_t *)(bufdata + old_size) = RTYPE_DOUBLE;
+  memcpy(bufdata + old_size + sizeof(uint16_t), &val, sizeof(double));
+}
+
+Page::value_t Page::val_null() {
+  value_t v;
+  v.type = RTYPE_NULL;
+  return v;
+}
+
+Page::value_t Page::val_short(int16_t val) {
+  value_t v;
+  v.type = RTYPE_SHORT;
+  v.s = val;
+  return v;
+}
+
+Page::value_t Page::val_int(int32_t val) {
+  value_t v;
+  v.type = RTYPE_INT;
+  v.i = val;
+  return v;
+}
+
+Page::value_t Page::val_double(double val) {
+  value_t v;
+  v.type = RTYPE_DOUBLE;
+  v.d = val;
+  return v;
+}
+
+Page::value_t Page::val_str(const char *ptr, uint16_t len) {
+  value_t v;
+  v.type = RTYPE_STRING;
+  v.str.ptr = ptr;
+  v.str.len = len;
+  return v;
+}
+
+Page::value_t Page::val_str(const std::string &str) {
+  return val_str(str.data(), str.size());
+}
+
+// Appends the value straight to the record, no conversions.
+void Page::rec_packval(std::string &buf, const value_t &val) {
+  switch (val.type) {
+  case RTYPE_NULL:
+    rec_packnull(buf);
+    break;
+  case RTYPE_SHORT:
+    rec_packshort(buf, val.s);
+    break;
+  case RTYPE_INT:
+    rec_packint(buf, val.i);
+    break;
+  case RTYPE_DOUBLE:
+    rec_packdouble(buf, val.d);
+    break;
+  case RTYPE_STRING: {
+    size_t old_size = buf.size();
+    buf.resize(old_size + sizeof(uint16_t) + val.str.len);
+    char *bufdata = const_cast<char *>(buf.data());
+    *(uint16_t *)(bufdata + old_size) = RTYPE_STRING + val.str.len;
+    memcpy(bufdata + old_size + sizeof(uint16_t), val.str.ptr, val.str.len);
+    break;
+  }
+  default:
+    throw record_error("cannot pack a value of unknown type");
+  }
+}
+
+Page::value_t Page::rec_upackval(void *buf, unsigned short &next) {
+  BYTE *where = reinterpret_cast<BYTE *>(buf) + next;
+  uint16_t type = *(uint16_t *)where;
+  BYTE *data = where + sizeof(uint16_t);
+  value_t v;
+  switch (type) {
+  case RTYPE_NULL:
+    v = val_null();
+    break;
+  case RTYPE_SHORT:
+    v = val_short(*(int16_t *)data);
+    break;
+  case RTYPE_INT:
+    v = val_int(*(int32_t *)data);
+    break;
+  case RTYPE_DOUBLE:
+    v.type = RTYPE_DOUBLE;
+    memcpy(&v.d, data, sizeof(double));
+    break;
+  default:
+    if (type < RTYPE_STRING)
+      throw record_error("cannot unpack a field of unknown type");
+    v = val_str(reinterpret_cast<char *>(data), type - RTYPE_STRING);
+    next += sizeof(uint16_t) + v.str.len;
+    return v;
+  }
+  next += sizeof(uint16_t) + type; // for numbers the type is also the size
+  return v;
+}
+
+void Page::rec_upackrow(void *rec, std::vector<value_t> &vals) {
+  uint16_t size = ((record_t *)rec)->size;
+  unsigned short next = sizeof(uint16_t);
+  vals.clear();
+  while (next < size) {
+    vals.push_back(rec_upackval(rec, next));
+  }
+}
+
 void Page::rec_finish(std::string &buf) { // should set the size
   uint16_t *bufdata = (uint16_t *)const_cast<char *>(buf.data());
   *bufdata = buf.size(); // Remember, rec_begin should have
@@ -15,6 +15,7 @@
 #include <stdexcept>
 #include <exception>
 #include <string>
+#include <vector>
 
 typedef uint8_t BYTE;
 
@@ -84,10 +85,16 @@ namespace Page {
   struct Page_header_t {
     char sig[4];
     unsigned short num_pages;
-    BYTE rest[PAGE_SIZE - 4 - sizeof(unsigned short)];
+    uint16_t meta[8]; // page ids the layers above paging keep at a fixed place (0 = unset)
+    BYTE rest[PAGE_SIZE - 4 - sizeof(unsigned short) - 8 * sizeof(uint16_t)];
   };
 
   const uint16_t PG_REC_UNUSED = USHRT_MAX;
+  // A directory entry with this bit set is a record a transaction deleted:
+  // it stays where it is and is still read, and the layers above decide who
+  // sees it.  Offsets are below PAGE_SIZE, so the bit is never part of one.
+  const uint16_t PG_REC_DELETED = 0x8000;
+  static_assert(PAGE_SIZE <= PG_REC_DELETED, "offsets must leave the deleted bit free");
   const unsigned short PG_INITIAL_BYTES =
       PAGE_SIZE - 2 * sizeof(unsigned short);
   typedef unsigned short rec_offset_t;
@@ -96,10 +103,18 @@ namespace Page {
   void pg_compact(void *page_buf, uint16_t num_bytes, BYTE *start);
   void pg_pushdown(void *page_buf, uint16_t num_bytes, BYTE *start);
   void *rec_get_ref(void *page, uint16_t rec_id, uint16_t &size);
-  BYTE *rec_make_copy(void *page, BYTE rec_id, void *rec_buffer,
+  BYTE *rec_make_copy(void *page, uint16_t rec_id, void *rec_buffer,
                       uint16_t &size);
   uint16_t pg_add_record(void *page, void *record, uint16_t reclen);
   void pg_del_record(void *page, unsigned short rec_id);
+  // Mark record <rec_id> of a row or PAX page deleted, leaving it in place;
+  // pg_del_record() still takes it out once no one reads it.
+  void pg_mark_deleted(void *page, uint16_t rec_id);
+  bool pg_is_deleted(const void *page, uint16_t rec_id);
+  // The offset a used directory entry points at, without its deleted mark
+  inline uint16_t pg_rec_offset(uint16_t entry) {
+    return entry & (uint16_t)~PG_REC_DELETED;
+  }
   void pg_fixup_directory(void *page, uint16_t rec_id, uint16_t offset);
   int pg_modify_record(void *page, void *record, uint16_t rec_id);
 
@@ -114,15 +129,49 @@ namespace Page {
   void rec_packint(std::string &buf, int val);
   void rec_packshort(std::string &buf, int16_t val);
   void rec_packstr(std::string &buf, const std::string &str);
+  void rec_packnull(std::string &buf);
   int rec_upackint(void *buf, unsigned short &next);
   int16_t rec_upackshort(void *buf, unsigned short &next);
+  // Copies the string out; see record_view.h to read it in place
   int rec_upackstr(void *buf, unsigned short &next, std::string &val);
   void rec_finish(std::string &buf);
   void rec_begin(std::string &buf);
+
+  // A typed field value.  <type> is one of the RTYPE_* constants above, and
+  // selects the member of the union that is valid.  A string value does not
+  // own its bytes: it points at the caller's buffer (or, once unpacked, into
+  // the record it was read from).
+  struct value_t {
+    BYTE type;
+    union {
+      int16_t s;
+      int32_t i;
+      double d;
+      struct {
+        const char *ptr;
+        uint16_t len;
+      } str;
+    };
+  };
+
+  value_t val_null();
+  value_t val_short(int16_t val);
+  value_t val_int(int32_t val);
+  value_t val_double(double val);
+  value_t val_str(const char *ptr, uint16_t len);
+  value_t val_str(const std::string &str);
+
+  void rec_packdouble(std::string &buf, double val);
+  void rec_packval(std::string &buf, const value_t &val);
+  // Unpack the next field whatever its type; strings point into <buf>
+  value_t rec_upackval(void *buf, unsigned short &next);
+  // Unpack every field of a record built with rec_begin()/rec_finish()
+  void rec_upackrow(void *rec, std::vector<value_t> &vals);
 }; // namespace Page
 
 std::ostream &operator<<(std::ostream &os, const Page::record_t &rec);
 std::ostream &operator<<(std::ostream &os, const Page::Page_t &page);
+std::ostream &operator<<(std::ostream &os, const Page::value_t &val);
 
 typedef std::fstream file_descriptor_t;
 namespace Page_file {
@@ -147,8 +196,14 @@ namespace Page_file {
 
   // Write a page in memory to disk.
   void pgf_write(file_descriptor_t &pfile, int page_id, void *page_buf);
+  // Write <count> pages from memory to consecutive pages on disk, in one write.
+  void pgf_write_run(file_descriptor_t &pfile, int first_page_id, int count,
+                     void *pages_buf);
   // Read a page from disk to memory
   void pgf_read(file_descriptor_t &pfile, int page_id, void *page_buf);
+  // Read <count> consecutive pages from disk to memory, in one read.
+  void pgf_read_run(file_descriptor_t &pfile, int first_page_id, int count,
+                    void *pages_buf);
 
   // return the page number of a page of size 0
   int pgf_find_free(file_descriptor_t &pfile);
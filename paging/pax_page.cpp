@@ -0,0 +1,219 @@
+#include "pax_page.h"
+
+#include <algorithm>
+
+namespace Page {
+  static inline uint32_t pax_align(uint32_t off, uint32_t to) {
+    return (off + to - 1) / to * to;
+  }
+
+  // Place every array of a page laid out for <capacity> rows; returns where
+  // the last one ends.  <cols> may be null to only measure.
+  static uint32_t pax_layout(const std::vector<BYTE> &types,
+                             const std::vector<uint16_t> &widths,
+                             uint32_t capacity, pax_col_t *cols,
+                             uint16_t &dead) {
+    uint32_t off = sizeof(pax_header_t) + types.size() * sizeof(pax_col_t);
+    dead = off;
+    off += capacity;
+    for (size_t c = 0; c < types.size(); c++) {
+      uint32_t nulls = off;
+      off += capacity;
+      uint32_t lens = 0;
+      if (types[c] == RTYPE_STRING) {
+        lens = off = pax_align(off, sizeof(uint16_t));
+        off += capacity * sizeof(uint16_t);
+      }
+      uint32_t values = off = pax_align(off, 8);  // whole words for the kernels
+      off += capacity * widths[c];
+      if (cols != nullptr) {
+        cols[c].type = types[c];
+        cols[c].width = widths[c];
+        cols[c].nulls = nulls;
+        cols[c].lens = lens;
+        cols[c].values = values;
+      }
+    }
+    return off;
+  }
+
+  static inline const pax_col_t *pax_cols(const void *page) {
+    return (const pax_col_t *)((const BYTE *)page + sizeof(pax_header_t));
+  }
+}; // namespace Page
+
+uint16_t Page::pax_capacity(const std::vector<BYTE> &types,
+                            const std::vector<uint16_t> &widths) {
+  uint32_t room = PAGE_SIZE - 2 * sizeof(uint16_t);  // less the mark
+  uint32_t row_bytes = 1;                             // its deleted flag
+  for (size_t c = 0; c < types.size(); c++)
+    row_bytes += 1 + widths[c] + (types[c] == RTYPE_STRING ? sizeof(uint16_t) : 0);
+
+  // start from the estimate and back off until the padding fits as well
+  uint16_t dead;
+  uint32_t capacity = room / row_bytes;
+  while (capacity > 0 && pax_layout(types, widths, capacity, nullptr, dead) > room)
+    capacity--;
+  return std::min<uint32_t>(capacity, USHRT_MAX - 1);
+}
+
+void Page::pax_init_page(void *page, const std::vector<BYTE> &types,
+                         const std::vector<uint16_t> &widths) {
+  uint16_t capacity = pax_capacity(types, widths);
+  if (capacity == 0) {
+    throw paging_error("fields are too wide for a PAX page");
+  }
+  memset(page, 0, PAGE_SIZE);
+  pax_header_t *h = (pax_header_t *)page;
+  h->num_cols = types.size();
+  h->capacity = capacity;
+  pax_layout(types, widths, capacity,
+             (pax_col_t *)((BYTE *)page + sizeof(pax_header_t)), h->dead);
+  ((Page_t *)page)->dir_size = PG_PAX_MARK;
+}
+
+bool Page::pax_is_pax(const void *page) {
+  return ((const Page_t *)page)->dir_size == PG_PAX_MARK;
+}
+
+bool Page::pax_full(const void *page) {
+  const pax_header_t *h = (const pax_header_t *)page;
+  return h->num_rows >= h->capacity;
+}
+
+uint16_t Page::pax_add_record(void *page, const void *record) {
+  pax_header_t *h = (pax_header_t *)page;
+  if (h->num_rows >= h->capacity) {
+    throw record_error("PAX page is full");
+  }
+  const pax_col_t *cols = pax_cols(page);
+  BYTE *p = (BYTE *)page;
+  const BYTE *rec = (const BYTE *)record;
+  uint16_t rec_size = ((const record_t *)rec)->size;
+  uint16_t row = h->num_rows;
+
+  // check every field before anything is written, so a bad record leaves no trace
+  uint16_t offset = sizeof(uint16_t);
+  for (uint16_t c = 0; offset < rec_size; c++) {
+    uint16_t type = *(const uint16_t *)(rec + offset);
+    BYTE tag = type >= RTYPE_STRING ? RTYPE_STRING : type;
+    if (c >= h->num_cols) {
+      throw record_error("record has more fields than the PAX page");
+    }
+    if (tag != RTYPE_NULL && tag != cols[c].type &&
+        !(tag == RTYPE_SHORT && cols[c].type == RTYPE_INT)) {
+      throw record_error("field type differs from its PAX minipage");
+    }
+    if (tag == RTYPE_STRING && type - RTYPE_STRING > cols[c].width) {
+      throw record_error("string is longer than its PAX minipage allows");
+    }
+    offset += sizeof(uint16_t) + (tag == RTYPE_STRING ? type - RTYPE_STRING : type);
+  }
+
+  offset = sizeof(uint16_t);
+  for (uint16_t c = 0; c < h->num_cols; c++) {
+    // a record with fewer fields stores NULL for the missing ones
+    uint16_t type = offset < rec_size ? *(const uint16_t *)(rec + offset) : RTYPE_NULL;
+    const BYTE *data = rec + offset + sizeof(uint16_t);
+    BYTE *slot = p + cols[c].values + (uint32_t)row * cols[c].width;
+    p[cols[c].nulls + row] = (type == RTYPE_NULL);
+    memset(slot, 0, cols[c].width);
+    if (cols[c].type == RTYPE_STRING) {
+      uint16_t len = type == RTYPE_NULL ? 0 : type - RTYPE_STRING;
+      ((uint16_t *)(p + cols[c].lens))[row] = len;
+      memcpy(slot, data, len);
+    } else if (type == RTYPE_SHORT && cols[c].type == RTYPE_INT) {
+      *(int32_t *)slot = *(const int16_t *)data;
+    } else if (type != RTYPE_NULL) {
+      memcpy(slot, data, cols[c].width);
+    }
+    if (offset < rec_size)
+      offset += sizeof(uint16_t) + (type >= RTYPE_STRING ? type - RTYPE_STRING : type);
+  }
+  p[h->dead + row] = 0;
+  return h->num_rows++;
+}
+
+bool Page::pax_get_record(const void *page, uint16_t rec_id, std::string &rec) {
+  const pax_header_t *h = (const pax_header_t *)page;
+  const BYTE *p = (const BYTE *)page;
+  if (rec_id >= h->num_rows || (p[h->dead + rec_id] & PAX_ROW_DEAD)) {
+    return false;
+  }
+  const pax_col_t *cols = pax_cols(page);
+  rec_begin(rec);
+  for (uint16_t c = 0; c < h->num_cols; c++) {
+    const BYTE *slot = p + cols[c].values + (uint32_t)rec_id * cols[c].width;
+    if (p[cols[c].nulls + rec_id])
+      rec_packnull(rec);
+    else if (cols[c].type == RTYPE_SHORT)
+      rec_packshort(rec, *(const int16_t *)slot);
+    else if (cols[c].type == RTYPE_INT)
+      rec_packint(rec, *(const int32_t *)slot);
+    else
+      rec_packval(rec, val_str((const char *)slot, ((const uint16_t *)(p + cols[c].lens))[rec_id]));
+  }
+  rec_finish(rec);
+  return true;
+}
+
+uint16_t Page::pax_decode_page(void *page, uint16_t &next, vec_batch_t &batch) {
+  const pax_header_t *h = (const pax_header_t *)page;
+  const pax_col_t *cols = pax_cols(page);
+  const BYTE *p = (const BYTE *)page;
+  uint16_t first = next;
+  uint16_t n = 0;
+  for (; next < h->num_rows && n < VEC_BATCH_SIZE; next++) {
+    if (!(p[h->dead + next] & PAX_ROW_DEAD))
+      batch.rec_ids[n++] = next;
+  }
+  bool dense = (n == next - first);  // no deleted rows in between
+
+  for (uint16_t f = 0; f < batch.field_col.size(); f++) {
+    int16_t c = batch.field_col[f];
+    if (c < 0)
+      continue;
+    vec_column_t &col = batch.cols[c];
+    if (f >= h->num_cols) {  // a field the page does not have reads as NULL
+      memset(col.nulls, 1, n);
+      memset(col.shorts, 0, n * sizeof(int16_t));
+      memset(col.ints, 0, n * sizeof(int32_t));
+      continue;
+    }
+
+    const pax_col_t &pc = cols[f];
+    if (col.type == RTYPE_NULL)
+      col.type = pc.type;
+    else if (col.type != pc.type)
+      throw record_error("field types differ between records");
+
+    const BYTE *nulls = p + pc.nulls;
+    const BYTE *values = p + pc.values;
+    if (dense) {
+      memcpy(col.nulls, nulls + first, n);
+      if (pc.type == RTYPE_SHORT)
+        memcpy(col.shorts, values + first * sizeof(int16_t), n * sizeof(int16_t));
+      else if (pc.type == RTYPE_INT)
+        memcpy(col.ints, values + first * sizeof(int32_t), n * sizeof(int32_t));
+      else
+        memcpy(col.str_lens, (const uint16_t *)(p + pc.lens) + first, n * sizeof(uint16_t));
+    } else {
+      for (uint16_t i = 0; i < n; i++) {
+        uint16_t r = batch.rec_ids[i];
+        col.nulls[i] = nulls[r];
+        if (pc.type == RTYPE_SHORT)
+          col.shorts[i] = ((const int16_t *)values)[r];
+        else if (pc.type == RTYPE_INT)
+          col.ints[i] = ((const int32_t *)values)[r];
+        else
+          col.str_lens[i] = ((const uint16_t *)(p + pc.lens))[r];
+      }
+    }
+    if (pc.type == RTYPE_STRING) {
+      for (uint16_t i = 0; i < n; i++)
+        col.strs[i] = (const char *)values + (uint32_t)batch.rec_ids[i] * pc.width;
+    }
+  }
+  batch.count = n;
+  return n;
+}
@@ -0,0 +1,75 @@
+#ifndef PAX_PAGE_H
+#define PAX_PAGE_H
+
+#include "vec_batch.h"
+
+// PAX pages: the records of a page stored field by field.
+//
+// A PAX page holds the same records a row page would, but each field is kept
+// in its own minipage, an array with one fixed-width slot per row.  A scan
+// that needs two fields of a wide record reads two contiguous arrays and
+// nothing else, and the SHORT/INT arrays go straight to the filter kernels.
+//
+// page:  |pax_header_t|pax_col_t|pax_col_t|...|dead|minipage|minipage|...|mark|unused|
+// minipage:  |nulls[capacity]|lens[capacity] (strings only)|values[capacity * width]|
+//
+// The first two bytes are the table's next page, as in a row table page, and
+// <mark> sits where a row page keeps its directory size.  It is PG_PAX_MARK
+// there, which no row page reaches, so any page tells which layout it has.
+// Rows are appended and never move, so a row's id is its slot and RIDs stay
+// valid.  A NULL value is a 1 in <nulls> over a zeroed slot.
+
+namespace Page {
+  const uint16_t PG_PAX_MARK = USHRT_MAX;
+
+  // Bits of a row's deleted flag.  A PAX_ROW_DEAD row is gone and skipped;
+  // a PAX_ROW_DELETED one was deleted by a transaction and is still read, as
+  // a row page's PG_REC_DELETED records are (see pg_mark_deleted()).
+  const BYTE PAX_ROW_DEAD = 1;
+  const BYTE PAX_ROW_DELETED = 2;
+
+  struct pax_header_t {
+    uint16_t next_page;
+    uint16_t num_cols;
+    uint16_t num_rows;   // rows added, deleted ones included
+    uint16_t capacity;   // rows the minipages have room for
+    uint16_t dead;       // offset of the per-row deleted flags
+    uint16_t unused[3];
+  };
+
+  struct pax_col_t {
+    uint16_t type;       // RTYPE_SHORT, RTYPE_INT or RTYPE_STRING
+    uint16_t width;      // bytes of one value (the longest string for RTYPE_STRING)
+    uint16_t nulls;      // offsets of the minipage's arrays in the page
+    uint16_t lens;
+    uint16_t values;
+    uint16_t unused[3];
+  };
+
+  // Rows that fit in one page for fields of these RTYPE_* types and widths;
+  // 0 if not even one does.
+  uint16_t pax_capacity(const std::vector<BYTE> &types,
+                        const std::vector<uint16_t> &widths);
+
+  // Lay out an empty PAX page for fields of these types and widths.
+  void pax_init_page(void *page, const std::vector<BYTE> &types,
+                     const std::vector<uint16_t> &widths);
+
+  bool pax_is_pax(const void *page);
+  bool pax_full(const void *page);
+
+  // Spread a record built with rec_begin()...rec_finish() over the
+  // minipages; returns its row id.  Throws a record_error if the page is full
+  // or a field does not fit its minipage (a SHORT widens into an INT one).
+  uint16_t pax_add_record(void *page, const void *record);
+
+  // Put row <rec_id> back together as a packed record in <rec>; false if
+  // there is no such live row.
+  bool pax_get_record(const void *page, uint16_t rec_id, std::string &rec);
+
+  // Same as vec_decode_page(), for a PAX page.  Runs of rows with no deleted
+  // ones between them are copied a whole array at a time.
+  uint16_t pax_decode_page(void *page, uint16_t &next, vec_batch_t &batch);
+}; // namespace Page
+
+#endif // PAX_PAGE_H
@@ -0,0 +1,81 @@
+#include "record_builder.h"
+
+#include <algorithm>
+
+namespace Page {
+  // Bump <len> bytes of field data, after its type spec, onto the record;
+  // returns where the data goes.
+  static inline BYTE *rb_field(rec_builder_t &rb, uint16_t type,
+                               uint16_t len) {
+    size_t end = (size_t)rb.used + sizeof(uint16_t) + len;
+    if (end > rb.arena.size())
+      throw record_error("record is larger than its builder's arena");
+    BYTE *where = rb.arena.data() + rb.used;
+    memcpy(where, &type, sizeof(uint16_t));
+    rb.used = end;
+    return where + sizeof(uint16_t);
+  }
+}; // namespace Page
+
+void Page::rb_reserve(rec_builder_t &rb, size_t capacity) {
+  capacity = std::min<size_t>(std::max<size_t>(capacity, sizeof(uint16_t)), USHRT_MAX);
+  if (rb.arena.size() < capacity)
+    rb.arena.resize(capacity);
+  rb.used = sizeof(uint16_t);
+}
+
+void Page::rb_begin(rec_builder_t &rb) {
+  if (rb.arena.size() < sizeof(uint16_t))
+    rb_reserve(rb, sizeof(uint16_t));
+  rb.used = sizeof(uint16_t);
+}
+
+void Page::rb_packnull(rec_builder_t &rb) { rb_field(rb, RTYPE_NULL, 0); }
+
+void Page::rb_packshort(rec_builder_t &rb, int16_t val) {
+  memcpy(rb_field(rb, RTYPE_SHORT, sizeof(int16_t)), &val, sizeof(int16_t));
+}
+
+void Page::rb_packint(rec_builder_t &rb, int32_t val) {
+  memcpy(rb_field(rb, RTYPE_INT, sizeof(int32_t)), &val, sizeof(int32_t));
+}
+
+void Page::rb_packdouble(rec_builder_t &rb, double val) {
+  memcpy(rb_field(rb, RTYPE_DOUBLE, sizeof(double)), &val, sizeof(double));
+}
+
+void Page::rb_packstr(rec_builder_t &rb, const char *ptr, uint16_t len) {
+  if (len > USHRT_MAX - RTYPE_STRING)
+    throw record_error("string is too long for a record");
+  memcpy(rb_field(rb, RTYPE_STRING + len, len), ptr, len);
+}
+
+void Page::rb_packval(rec_builder_t &rb, const value_t &val) {
+  switch (val.type) {
+  case RTYPE_NULL:
+    rb_packnull(rb);
+    break;
+  case RTYPE_SHORT:
+    rb_packshort(rb, val.s);
+    break;
+  case RTYPE_INT:
+    rb_packint(rb, val.i);
+    break;
+  case RTYPE_DOUBLE:
+    rb_packdouble(rb, val.d);
+    break;
+  case RTYPE_STRING:
+    rb_packstr(rb, val.str.ptr, val.str.len);
+    break;
+  default:
+    throw record_error("cannot pack a value of unknown type");
+  }
+}
+
+void Page::rb_finish(rec_builder_t &rb) {
+  memcpy(rb.arena.data(), &rb.used, sizeof(uint16_t));
+}
+
+BYTE *Page::rb_data(rec_builder_t &rb) { return rb.arena.data(); }
+
+uint16_t Page::rb_size(const rec_builder_t &rb) { return rb.used; }
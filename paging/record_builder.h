@@ -0,0 +1,44 @@
+#ifndef RECORD_BUILDER_H
+#define RECORD_BUILDER_H
+
+#include "paging.h"
+
+// Packing records into a reusable arena.
+//
+// rec_begin() and rec_pack* build a record in a std::string, growing it (and
+// zero-filling the new bytes) once per field.  A record builder packs the same
+// fields, byte for byte, into an arena sized once up front for the largest
+// record it will be given: each field is bumped onto the end of the record
+// being built, and rb_begin() starts the next record over the same bytes.
+// Once the arena is reserved, building any number of records allocates
+// nothing, and the finished record is handed to pg_add_record() (or
+// pax_add_record()) where it lies.
+//
+// A field that would not fit in the arena throws a record_error; reserve the
+// most the schema allows and that never happens.
+
+namespace Page {
+  struct rec_builder_t {
+    std::vector<BYTE> arena;  // only ever grows
+    uint16_t used;            // bytes of the record being built, size included
+  };
+
+  // Make room for records of up to <capacity> bytes (at most a uint16_t's
+  // worth); a builder that already has as much keeps its arena.
+  void rb_reserve(rec_builder_t &rb, size_t capacity);
+
+  void rb_begin(rec_builder_t &rb);
+  void rb_packnull(rec_builder_t &rb);
+  void rb_packshort(rec_builder_t &rb, int16_t val);
+  void rb_packint(rec_builder_t &rb, int32_t val);
+  void rb_packdouble(rec_builder_t &rb, double val);
+  void rb_packstr(rec_builder_t &rb, const char *ptr, uint16_t len);
+  void rb_packval(rec_builder_t &rb, const value_t &val);
+  // Write the record's size; the record is then rb_size() bytes at rb_data().
+  void rb_finish(rec_builder_t &rb);
+
+  BYTE *rb_data(rec_builder_t &rb);
+  uint16_t rb_size(const rec_builder_t &rb);
+}; // namespace Page
+
+#endif // RECORD_BUILDER_H
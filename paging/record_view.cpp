@@ -0,0 +1,219 @@
+#include "record_view.h"
+#include "pax_page.h"
+
+namespace Page {
+  // Bytes of a field's data, given its type spec.
+  static inline uint16_t rv_data_size(uint16_t type) {
+    return type >= RTYPE_STRING ? type - RTYPE_STRING : type;
+  }
+
+  // Offset of field <f> in the record, or 0 if it has fewer fields.
+  static uint16_t rv_offset(const record_view_t &view, uint16_t f) {
+    if (f >= view.num_fields)
+      return 0;
+    if (f < RV_MAX_FIELDS)
+      return view.offsets[f];
+    uint16_t offset = view.offsets[RV_MAX_FIELDS - 1];
+    for (uint16_t i = RV_MAX_FIELDS - 1; i < f; i++)
+      offset += sizeof(uint16_t) + rv_data_size(*(const uint16_t *)(view.rec + offset));
+    return offset;
+  }
+
+  // Type spec of field <f> as packed (string length included); a missing
+  // field is a NULL.
+  static inline uint16_t rv_spec(const record_view_t &view, uint16_t f,
+                                 uint16_t &offset) {
+    offset = rv_offset(view, f);
+    return offset == 0 ? RTYPE_NULL : *(const uint16_t *)(view.rec + offset);
+  }
+
+  // The field of row <row>: returns its type spec as packed in a record
+  // (string length included), and points <data> at its bytes.  A row page's
+  // record is walked to the field; a PAX page reads it off the minipage.
+  static uint16_t cv_field(const column_view_t &col, uint16_t row,
+                           const BYTE *&data) {
+    if (col.pax) {
+      if (col.type == RTYPE_NULL || col.nulls[row])
+        return RTYPE_NULL;
+      data = col.values + (uint32_t)row * col.width;
+      return col.type == RTYPE_STRING ? RTYPE_STRING + col.lens[row] : col.type;
+    }
+    const BYTE *rec = col.page + pg_rec_offset(PG_DIRECTORY(col.page)[row]);
+    uint16_t size = ((const record_t *)rec)->size;
+    uint16_t offset = sizeof(uint16_t);
+    for (uint16_t f = 0; f < col.field && offset < size; f++)
+      offset += sizeof(uint16_t) + rv_data_size(*(const uint16_t *)(rec + offset));
+    if (offset >= size)
+      return RTYPE_NULL;
+    data = rec + offset + sizeof(uint16_t);
+    return *(const uint16_t *)(rec + offset);
+  }
+}; // namespace Page
+
+void Page::rv_open(record_view_t &view, const void *rec) {
+  view.rec = (const BYTE *)rec;
+  view.size = ((const record_t *)rec)->size;
+  view.num_fields = 0;
+  uint16_t offset = sizeof(uint16_t);
+  while (offset < view.size) {
+    if (view.num_fields < RV_MAX_FIELDS)
+      view.offsets[view.num_fields] = offset;
+    view.num_fields++;
+    offset += sizeof(uint16_t) + rv_data_size(*(const uint16_t *)(view.rec + offset));
+  }
+}
+
+bool Page::rv_open(record_view_t &view, const void *page, uint16_t rec_id) {
+  if (rec_id >= *PG_NUM_RECORDS_PTR(page))
+    return false;
+  uint16_t offset = PG_DIRECTORY(page)[rec_id];
+  if (offset == PG_REC_UNUSED)
+    return false;
+  rv_open(view, (const BYTE *)page + pg_rec_offset(offset));
+  return true;
+}
+
+BYTE Page::rv_type(const record_view_t &view, uint16_t f) {
+  uint16_t offset;
+  uint16_t type = rv_spec(view, f, offset);
+  return type >= RTYPE_STRING ? RTYPE_STRING : type;
+}
+
+bool Page::rv_is_null(const record_view_t &view, uint16_t f) {
+  uint16_t offset;
+  return rv_spec(view, f, offset) == RTYPE_NULL;
+}
+
+int16_t Page::rv_short(const record_view_t &view, uint16_t f) {
+  uint16_t offset;
+  if (rv_spec(view, f, offset) != RTYPE_SHORT)
+    throw record_error("cannot convert type to a short");
+  return *(const int16_t *)(view.rec + offset + sizeof(uint16_t));
+}
+
+int32_t Page::rv_int(const record_view_t &view, uint16_t f) {
+  uint16_t offset;
+  uint16_t type = rv_spec(view, f, offset);
+  const BYTE *data = view.rec + offset + sizeof(uint16_t);
+  if (type == RTYPE_INT)
+    return *(const int32_t *)data;
+  if (type == RTYPE_SHORT)
+    return *(const int16_t *)data;
+  throw record_error("cannot convert type to an integer");
+}
+
+double Page::rv_double(const record_view_t &view, uint16_t f) {
+  uint16_t offset;
+  if (rv_spec(view, f, offset) != RTYPE_DOUBLE)
+    throw record_error("cannot convert type to a double");
+  double val;
+  memcpy(&val, view.rec + offset + sizeof(uint16_t), sizeof(double));
+  return val;
+}
+
+std::string_view Page::rv_str(const record_view_t &view, uint16_t f) {
+  uint16_t offset;
+  uint16_t type = rv_spec(view, f, offset);
+  if (type < RTYPE_STRING)
+    throw record_error("cannot convert type to a string");
+  return std::string_view((const char *)view.rec + offset + sizeof(uint16_t),
+                          type - RTYPE_STRING);
+}
+
+Page::value_t Page::rv_value(const record_view_t &view, uint16_t f) {
+  uint16_t offset = rv_offset(view, f);
+  if (offset == 0)
+    return val_null();
+  unsigned short next = offset;
+  return rec_upackval((void *)view.rec, next);
+}
+
+void Page::cv_open(column_view_t &col, const void *page, uint16_t field) {
+  col.page = (const BYTE *)page;
+  col.field = field;
+  col.pax = pax_is_pax(page);
+  if (!col.pax) {
+    col.num_rows = *PG_NUM_RECORDS_PTR(page);
+    return;
+  }
+  const pax_header_t *h = (const pax_header_t *)page;
+  col.num_rows = h->num_rows;
+  col.dead = col.page + h->dead;
+  if (field >= h->num_cols) {
+    col.type = RTYPE_NULL;
+    return;
+  }
+  const pax_col_t &pc = ((const pax_col_t *)(col.page + sizeof(pax_header_t)))[field];
+  col.type = pc.type;
+  col.width = pc.width;
+  col.nulls = col.page + pc.nulls;
+  col.lens = (const uint16_t *)(col.page + pc.lens);
+  col.values = col.page + pc.values;
+}
+
+uint16_t Page::cv_count(const column_view_t &col) { return col.num_rows; }
+
+bool Page::cv_is_live(const column_view_t &col, uint16_t row) {
+  if (row >= col.num_rows)
+    return false;
+  return col.pax ? !(col.dead[row] & PAX_ROW_DEAD) : PG_DIRECTORY(col.page)[row] != PG_REC_UNUSED;
+}
+
+BYTE Page::cv_type(const column_view_t &col, uint16_t row) {
+  const BYTE *data;
+  uint16_t type = cv_field(col, row, data);
+  return type >= RTYPE_STRING ? RTYPE_STRING : type;
+}
+
+bool Page::cv_is_null(const column_view_t &col, uint16_t row) {
+  const BYTE *data;
+  return cv_field(col, row, data) == RTYPE_NULL;
+}
+
+int16_t Page::cv_short(const column_view_t &col, uint16_t row) {
+  const BYTE *data;
+  if (cv_field(col, row, data) != RTYPE_SHORT)
+    throw record_error("cannot convert type to a short");
+  return *(const int16_t *)data;
+}
+
+int32_t Page::cv_int(const column_view_t &col, uint16_t row) {
+  const BYTE *data;
+  uint16_t type = cv_field(col, row, data);
+  if (type == RTYPE_INT)
+    return *(const int32_t *)data;
+  if (type == RTYPE_SHORT)
+    return *(const int16_t *)data;
+  throw record_error("cannot convert type to an integer");
+}
+
+std::string_view Page::cv_str(const column_view_t &col, uint16_t row) {
+  const BYTE *data;
+  uint16_t type = cv_field(col, row, data);
+  if (type < RTYPE_STRING)
+    throw record_error("cannot convert type to a string");
+  return std::string_view((const char *)data, type - RTYPE_STRING);
+}
+
+Page::value_t Page::cv_value(const column_view_t &col, uint16_t row) {
+  const BYTE *data;
+  uint16_t type = cv_field(col, row, data);
+  switch (type) {
+  case RTYPE_NULL:
+    return val_null();
+  case RTYPE_SHORT:
+    return val_short(*(const int16_t *)data);
+  case RTYPE_INT:
+    return val_int(*(const int32_t *)data);
+  case RTYPE_DOUBLE: {
+    value_t v;
+    v.type = RTYPE_DOUBLE;
+    memcpy(&v.d, data, sizeof(double));
+    return v;
+  }
+  default:
+    if (type < RTYPE_STRING)
+      throw record_error("cannot unpack a field of unknown type");
+    return val_str((const char *)data, type - RTYPE_STRING);
+  }
+}
@@ -0,0 +1,89 @@
+#ifndef RECORD_VIEW_H
+#define RECORD_VIEW_H
+
+#include "paging.h"
+
+#include <string_view>
+
+// Zero-copy views of records and of fields across a page.
+//
+// rec_upack* copy each field out of the record (rec_upackstr into a
+// std::string).  A view instead points into the buffer the record lives in,
+// usually a pinned page: numbers are read in place, and a string comes back
+// as a std::string_view over its bytes.  Nothing is allocated, so a read-only
+// path can look at any number of rows without touching the heap.
+//
+// A view, and every string_view it hands out, is only valid while the buffer
+// under it is: for a page, until the page is unpinned (or changed).
+//
+// record_view_t: the fields of one packed record, found once when the view is
+// opened, then read in any order.
+//
+// column_view_t: one field position across every row of a page, row page or
+// PAX page (see pax_page.h).  On a PAX page it reads the field's minipage
+// directly, with no record put back together.  A field past the end of a
+// record (or of the page's minipages) reads as NULL.
+//
+// The typed accessors throw a record_error when the field has another type.
+
+namespace Page {
+  const uint16_t RV_MAX_FIELDS = 64; // fields whose offsets a record view keeps
+
+  struct record_view_t {
+    const BYTE *rec;
+    uint16_t size;                   // of the whole record
+    uint16_t num_fields;
+    uint16_t offsets[RV_MAX_FIELDS]; // where the first fields start; later
+                                     // ones are walked to from the last
+  };
+
+  // View the record at <rec>, built with rec_begin()...rec_finish().
+  void rv_open(record_view_t &view, const void *rec);
+  // View record <rec_id> of a row page; false if it was deleted or is past
+  // the end of the directory.
+  bool rv_open(record_view_t &view, const void *page, uint16_t rec_id);
+
+  // RTYPE_* of field <f> (RTYPE_STRING for every string length).
+  BYTE rv_type(const record_view_t &view, uint16_t f);
+  bool rv_is_null(const record_view_t &view, uint16_t f);
+  int16_t rv_short(const record_view_t &view, uint16_t f);
+  // An INT, or a SHORT widened to one.
+  int32_t rv_int(const record_view_t &view, uint16_t f);
+  double rv_double(const record_view_t &view, uint16_t f);
+  std::string_view rv_str(const record_view_t &view, uint16_t f);
+  // Field <f> whatever its type; a string points into the record.
+  value_t rv_value(const record_view_t &view, uint16_t f);
+
+  struct column_view_t {
+    const BYTE *page;
+    uint16_t field;
+    uint16_t num_rows;  // directory entries, or PAX rows (deleted ones included)
+    bool pax;
+    // PAX pages only: the field's minipage (<type> is RTYPE_NULL when the
+    // page has no such field) and the per-row deleted flags
+    BYTE type;
+    uint16_t width;
+    const BYTE *nulls;
+    const uint16_t *lens;
+    const BYTE *values;
+    const BYTE *dead;
+  };
+
+  // View field position <field> of every row of <page>.
+  void cv_open(column_view_t &col, const void *page, uint16_t field);
+
+  // Rows are numbered from 0 to cv_count() - 1, the same ids as in a RID;
+  // only live ones may be read.
+  uint16_t cv_count(const column_view_t &col);
+  bool cv_is_live(const column_view_t &col, uint16_t row);
+
+  BYTE cv_type(const column_view_t &col, uint16_t row);
+  bool cv_is_null(const column_view_t &col, uint16_t row);
+  int16_t cv_short(const column_view_t &col, uint16_t row);
+  // An INT, or a SHORT widened to one.
+  int32_t cv_int(const column_view_t &col, uint16_t row);
+  std::string_view cv_str(const column_view_t &col, uint16_t row);
+  value_t cv_value(const column_view_t &col, uint16_t row);
+}; // namespace Page
+
+#endif // RECORD_VIEW_H
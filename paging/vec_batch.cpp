@@ -0,0 +1,226 @@
+#include "vec_batch.h"
+#include "pax_page.h"
+
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define VEC_X86 1
+#include <immintrin.h>
+#endif
+
+namespace Page {
+  static BYTE vec_supported_level() {
+#ifdef VEC_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+      return VEC_AVX2;
+    if (__builtin_cpu_supports("sse2"))
+      return VEC_SSE2;
+#endif
+    return VEC_SCALAR;
+  }
+
+  static const BYTE vec_max_level = vec_supported_level();
+  static BYTE vec_cur_level = vec_max_level;
+}; // namespace Page
+
+void Page::vec_init_batch(vec_batch_t &batch, const std::vector<uint16_t> &fields) {
+  batch.count = 0;
+  batch.fields = fields;
+  batch.cols.resize(fields.size());
+  uint16_t last = 0;
+  for (uint16_t f : fields)
+    last = std::max(last, f);
+  batch.field_col.assign(fields.empty() ? 0 : last + 1, -1);
+  for (size_t c = 0; c < fields.size(); c++) {
+    batch.field_col[fields[c]] = c;
+    batch.cols[c].type = RTYPE_NULL;
+  }
+}
+
+uint16_t Page::vec_decode_page(void *page, uint16_t &next, vec_batch_t &batch) {
+  if (pax_is_pax(page))
+    return pax_decode_page(page, next, batch);
+  uint16_t num_records = *PG_NUM_RECORDS_PTR(page);
+  uint16_t *dir = PG_DIRECTORY(page);
+  uint16_t num_fields = batch.field_col.size();
+  uint16_t n = 0;
+
+  for (; next < num_records && n < VEC_BATCH_SIZE; next++) {
+    if (dir[next] == PG_REC_UNUSED)
+      continue;
+    BYTE *rec = (BYTE *)page + pg_rec_offset(dir[next]);
+    uint16_t rec_size = ((record_t *)rec)->size;
+    uint16_t offset = sizeof(uint16_t);
+    batch.rec_ids[n] = next;
+
+    for (uint16_t f = 0; f < num_fields; f++) {
+      // a record with fewer fields reads as NULL for the missing ones
+      uint16_t type = offset < rec_size ? *(uint16_t *)(rec + offset) : RTYPE_NULL;
+      BYTE *data = rec + offset + sizeof(uint16_t);
+      int16_t c = batch.field_col[f];
+      if (c >= 0) {
+        vec_column_t &col = batch.cols[c];
+        col.shorts[n] = 0; // NULLs still get a defined value for the kernels
+        col.ints[n] = 0;
+        col.nulls[n] = (type == RTYPE_NULL);
+        if (type != RTYPE_NULL) {
+          BYTE tag = type >= RTYPE_STRING ? RTYPE_STRING : type;
+          if (col.type == RTYPE_NULL)
+            col.type = tag;
+          else if (col.type != tag)
+            throw record_error("field types differ between records");
+          switch (tag) {
+          case RTYPE_SHORT:
+            col.shorts[n] = *(int16_t *)data;
+            break;
+          case RTYPE_INT:
+            col.ints[n] = *(int32_t *)data;
+            break;
+          case RTYPE_STRING:
+            col.strs[n] = (const char *)data;
+            col.str_lens[n] = type - RTYPE_STRING;
+            break;
+          default:
+            throw record_error("cannot decode a field of this type into a batch");
+          }
+        }
+      }
+      if (offset < rec_size)
+        offset += sizeof(uint16_t) + (type >= RTYPE_STRING ? type - RTYPE_STRING : type);
+    }
+    n++;
+  }
+  batch.count = n;
+  return n;
+}
+
+BYTE Page::vec_level() { return vec_cur_level; }
+
+BYTE Page::vec_set_level(BYTE level) {
+  vec_cur_level = std::min(level, vec_max_level);
+  return vec_cur_level;
+}
+
+// The SIMD kernels below each handle a whole number of vectors and return how
+// many values they did; the scalar loop finishes the rest.
+
+#ifdef VEC_X86
+__attribute__((target("sse2"))) static uint16_t
+vec_filter_i16_sse2(const int16_t *vals, uint16_t n, int16_t lo, int16_t hi,
+                    bool negate, BYTE *mask) {
+  const __m128i vlo = _mm_set1_epi16(lo), vhi = _mm_set1_epi16(hi);
+  const __m128i flip = _mm_set1_epi8(negate ? 0 : -1);
+  uint16_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m128i a = _mm_loadu_si128((const __m128i *)(vals + i));
+    __m128i b = _mm_loadu_si128((const __m128i *)(vals + i + 8));
+    // out of range = v < lo || v > hi
+    __m128i oa = _mm_or_si128(_mm_cmpgt_epi16(vlo, a), _mm_cmpgt_epi16(a, vhi));
+    __m128i ob = _mm_or_si128(_mm_cmpgt_epi16(vlo, b), _mm_cmpgt_epi16(b, vhi));
+    __m128i keep = _mm_xor_si128(_mm_packs_epi16(oa, ob), flip);
+    __m128i m = _mm_loadu_si128((const __m128i *)(mask + i));
+    _mm_storeu_si128((__m128i *)(mask + i), _mm_and_si128(m, keep));
+  }
+  return i;
+}
+
+__attribute__((target("avx2"))) static uint16_t
+vec_filter_i16_avx2(const int16_t *vals, uint16_t n, int16_t lo, int16_t hi,
+                    bool negate, BYTE *mask) {
+  const __m256i vlo = _mm256_set1_epi16(lo), vhi = _mm256_set1_epi16(hi);
+  const __m256i flip = _mm256_set1_epi8(negate ? 0 : -1);
+  uint16_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    __m256i a = _mm256_loadu_si256((const __m256i *)(vals + i));
+    __m256i b = _mm256_loadu_si256((const __m256i *)(vals + i + 16));
+    __m256i oa = _mm256_or_si256(_mm256_cmpgt_epi16(vlo, a), _mm256_cmpgt_epi16(a, vhi));
+    __m256i ob = _mm256_or_si256(_mm256_cmpgt_epi16(vlo, b), _mm256_cmpgt_epi16(b, vhi));
+    // packs works within 128-bit lanes, so put the quadwords back in order
+    __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi16(oa, ob), 0xD8);
+    __m256i keep = _mm256_xor_si256(packed, flip);
+    __m256i m = _mm256_loadu_si256((const __m256i *)(mask + i));
+    _mm256_storeu_si256((__m256i *)(mask + i), _mm256_and_si256(m, keep));
+  }
+  return i;
+}
+
+__attribute__((target("sse2"))) static uint16_t
+vec_filter_i32_sse2(const int32_t *vals, uint16_t n, int32_t lo, int32_t hi,
+                    bool negate, BYTE *mask) {
+  const __m128i vlo = _mm_set1_epi32(lo), vhi = _mm_set1_epi32(hi);
+  const __m128i flip = _mm_set1_epi8(negate ? 0 : -1);
+  uint16_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m128i o[4];
+    for (int k = 0; k < 4; k++) {
+      __m128i v = _mm_loadu_si128((const __m128i *)(vals + i + 4 * k));
+      o[k] = _mm_or_si128(_mm_cmpgt_epi32(vlo, v), _mm_cmpgt_epi32(v, vhi));
+    }
+    __m128i packed = _mm_packs_epi16(_mm_packs_epi32(o[0], o[1]),
+                                     _mm_packs_epi32(o[2], o[3]));
+    __m128i keep = _mm_xor_si128(packed, flip);
+    __m128i m = _mm_loadu_si128((const __m128i *)(mask + i));
+    _mm_storeu_si128((__m128i *)(mask + i), _mm_and_si128(m, keep));
+  }
+  return i;
+}
+
+__attribute__((target("avx2"))) static uint16_t
+vec_filter_i32_avx2(const int32_t *vals, uint16_t n, int32_t lo, int32_t hi,
+                    bool negate, BYTE *mask) {
+  const __m256i vlo = _mm256_set1_epi32(lo), vhi = _mm256_set1_epi32(hi);
+  const __m256i flip = _mm256_set1_epi8(negate ? 0 : -1);
+  const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+  uint16_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    __m256i o[4];
+    for (int k = 0; k < 4; k++) {
+      __m256i v = _mm256_loadu_si256((const __m256i *)(vals + i + 8 * k));
+      o[k] = _mm256_or_si256(_mm256_cmpgt_epi32(vlo, v), _mm256_cmpgt_epi32(v, vhi));
+    }
+    __m256i packed = _mm256_packs_epi16(_mm256_packs_epi32(o[0], o[1]),
+                                        _mm256_packs_epi32(o[2], o[3]));
+    __m256i keep = _mm256_xor_si256(_mm256_permutevar8x32_epi32(packed, order), flip);
+    __m256i m = _mm256_loadu_si256((const __m256i *)(mask + i));
+    _mm256_storeu_si256((__m256i *)(mask + i), _mm256_and_si256(m, keep));
+  }
+  return i;
+}
+#endif
+
+void Page::vec_filter_i16(const int16_t *vals, uint16_t n, int16_t lo,
+                          int16_t hi, bool negate, BYTE *mask) {
+  uint16_t i = 0;
+#ifdef VEC_X86
+  if (vec_cur_level == VEC_AVX2)
+    i = vec_filter_i16_avx2(vals, n, lo, hi, negate, mask);
+  else if (vec_cur_level == VEC_SSE2)
+    i = vec_filter_i16_sse2(vals, n, lo, hi, negate, mask);
+#endif
+  for (; i < n; i++)
+    mask[i] &= ((vals[i] >= lo && vals[i] <= hi) != negate);
+}
+
+void Page::vec_filter_i32(const int32_t *vals, uint16_t n, int32_t lo,
+                          int32_t hi, bool negate, BYTE *mask) {
+  uint16_t i = 0;
+#ifdef VEC_X86
+  if (vec_cur_level == VEC_AVX2)
+    i = vec_filter_i32_avx2(vals, n, lo, hi, negate, mask);
+  else if (vec_cur_level == VEC_SSE2)
+    i = vec_filter_i32_sse2(vals, n, lo, hi, negate, mask);
+#endif
+  for (; i < n; i++)
+    mask[i] &= ((vals[i] >= lo && vals[i] <= hi) != negate);
+}
+
+uint16_t Page::vec_mask_to_sel(const BYTE *mask, uint16_t n, uint16_t *sel) {
+  // branch free: always write, only advance past selected rows
+  uint16_t k = 0;
+  for (uint16_t i = 0; i < n; i++) {
+    sel[k] = i;
+    k += mask[i];
+  }
+  return k;
+}
@@ -0,0 +1,69 @@
+#ifndef VEC_BATCH_H
+#define VEC_BATCH_H
+
+#include "paging.h"
+
+// Columnar decoding of a page's records, and filter kernels over the decoded
+// columns.
+//
+// vec_decode_page() unpacks up to VEC_BATCH_SIZE records of a page into one
+// array per requested field, the way rec_upack* unpack one field of one
+// record.  A PAX page (see pax_page.h) is copied from its minipages instead.  Filters then run over whole arrays: each one narrows a byte mask
+// (1 = row still selected), and vec_mask_to_sel() turns the final mask into a
+// selection vector of batch positions.
+//
+// The SHORT/INT range kernels use AVX2 or SSE2 when the CPU has them, and a
+// scalar loop otherwise.  vec_set_level() can force a lower level.
+
+namespace Page {
+  const uint16_t VEC_BATCH_SIZE = 1024;
+
+  const BYTE VEC_SCALAR = 0;
+  const BYTE VEC_SSE2 = 1;
+  const BYTE VEC_AVX2 = 2;
+
+  // One decoded field across the rows of a batch.  <type> is the RTYPE_* of
+  // the field; only the array for that type is filled in.  Strings point into
+  // the page they were decoded from.
+  struct vec_column_t {
+    BYTE type;
+    int16_t shorts[VEC_BATCH_SIZE];
+    int32_t ints[VEC_BATCH_SIZE];
+    const char *strs[VEC_BATCH_SIZE];
+    uint16_t str_lens[VEC_BATCH_SIZE];
+    BYTE nulls[VEC_BATCH_SIZE]; // 1 where the row's value is NULL
+  };
+
+  struct vec_batch_t {
+    uint16_t count;                      // rows decoded
+    uint16_t rec_ids[VEC_BATCH_SIZE];    // directory index of each row
+    std::vector<uint16_t> fields;        // field position of each column
+    std::vector<vec_column_t> cols;
+    std::vector<int16_t> field_col;      // column of each field position, or -1
+  };
+
+  // Set up <batch> to decode the given field positions (in any order).
+  void vec_init_batch(vec_batch_t &batch, const std::vector<uint16_t> &fields);
+
+  // Decode live records starting at directory index <next> until the batch is
+  // full or the page runs out; <next> is left at the first record not decoded.
+  // The type of a column is that of its first non-NULL value; throws a
+  // record_error if a later value has another type.  Returns batch.count.
+  uint16_t vec_decode_page(void *page, uint16_t &next, vec_batch_t &batch);
+
+  // Level of the kernels in use, and a way to lower it (it is never raised
+  // past what the CPU supports).  Returns the level that is now in use.
+  BYTE vec_level();
+  BYTE vec_set_level(BYTE level);
+
+  // mask[i] &= (lo <= vals[i] && vals[i] <= hi) != negate
+  void vec_filter_i16(const int16_t *vals, uint16_t n, int16_t lo, int16_t hi,
+                      bool negate, BYTE *mask);
+  void vec_filter_i32(const int32_t *vals, uint16_t n, int32_t lo, int32_t hi,
+                      bool negate, BYTE *mask);
+
+  // Write the positions of the set bytes of <mask> to <sel>; returns how many.
+  uint16_t vec_mask_to_sel(const BYTE *mask, uint16_t n, uint16_t *sel);
+}; // namespace Page
+
+#endif // VEC_BATCH_H
@@ -0,0 +1,76 @@
+/**************************************************************************************************
+* Filename:   db_server.cpp
+* Details:    Serves one DB file over a Unix domain socket (see "server.h") until SIGINT or
+*             SIGTERM, then writes the buffer pool back. A DB file that does not exist yet is
+*             formatted first. The buffer pool and file IO it did are printed on the way out.
+*             Usage: ./<executable> <db_file> <socket_path> [workers] [pool_pages] [format_pages]
+**************************************************************************************************/
+
+/****************************************** HEADER FILES *****************************************/
+
+#include "server.h"
+#include "../buffer_mgr/buffer_mgr.h"
+#include "../paging/io_stats.h"
+#include "../table_mgr/table_mgr.h"
+
+#include <csignal>
+#include <fstream>
+#include <iostream>
+
+/************************************** SERVER IMPLEMENTATION ************************************/
+
+static void on_signal(int)
+{
+	Server::srv_stop();
+}
+
+int main(int argc, char* argv[])
+{
+
+	/**************************************** ERROR CHECKING ***************************************/
+
+	if(argc < 3 || argc > 6)
+	{
+		printf("ERROR: Wrong number of command line arguments. Use ./<executable> <db_file> <socket_path> [workers] [pool_pages] [format_pages] as format.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	/******************************************** SETUP ********************************************/
+
+	const char* db_name = argv[1];
+	Server::srv_config_t cfg;
+	cfg.socket_path = argv[2];
+	cfg.workers = argc > 3 ? atoi(argv[3]) : 4;
+	uint16_t pool_size = argc > 4 ? atoi(argv[4]) : 4096; // every worker reads through this one pool
+	uint16_t format_pages = argc > 5 ? atoi(argv[5]) : 8000;
+	Buffer_mgr::initialize(pool_size);
+
+	if(!std::ifstream(db_name).good())
+		Table::tbl_format(db_name, format_pages);
+	std::fstream dbfile(db_name, std::ios::in | std::ios::out | std::ios::binary);
+	if(!dbfile.is_open())
+	{
+		std::cerr << "Cannot open \"" << db_name << "\"" << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	/********************************************* SERVE *******************************************/
+
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+	int status = EXIT_SUCCESS;
+	try
+	{
+		Server::srv_run(dbfile, cfg);
+	}
+	catch(const std::exception &e)
+	{
+		std::cerr << e.what() << std::endl;
+		status = EXIT_FAILURE;
+	}
+
+	Buffer_mgr::shutdown(dbfile);
+	dbfile.close();
+	std::cerr << Io_stats::io_stats_text(Io_stats::io_stats());
+	return status;
+}
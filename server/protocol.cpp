@@ -0,0 +1,278 @@
+/**************************************************************************************************
+* Filename:   protocol.cpp
+* Details:    Implements the message encoding and socket helpers declared in "protocol.h".
+**************************************************************************************************/
+
+/****************************************** HEADER FILES *****************************************/
+
+#include "protocol.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/************************************ FUNCTION IMPLEMENTATIONS ***********************************/
+
+namespace Server
+{
+  /* Append <len> bytes of <v> as they are in memory */
+  static void msg_put_raw(std::string &out, const void* v, size_t len)
+  {
+    out.append(static_cast<const char*>(v), len);
+  }
+
+
+  /* Take the next <len> bytes of the body */
+  static const BYTE* msg_get_raw(msg_reader_t &in, size_t len)
+  {
+    if(static_cast<size_t>(in.end - in.pos) < len)
+      throw srv_error("Message ends before its last field.");
+    const BYTE* at = in.pos;
+    in.pos += len;
+    return at;
+  }
+
+
+  size_t msg_frame_begin(std::string &out, uint32_t tag, BYTE code)
+  {
+    size_t start = out.size();
+    msg_put_u32(out, 0); // filled in by "msg_frame_end()"
+    msg_put_u32(out, tag);
+    msg_put_u8(out, code);
+    return start;
+  }
+
+
+  void msg_frame_end(std::string &out, size_t start)
+  {
+    uint32_t len = out.size() - start - SRV_FRAME_HEADER;
+    memcpy(&out[start], &len, sizeof(len));
+  }
+
+
+  bool msg_frame_ready(const BYTE* buf, size_t len, uint32_t &body_len)
+  {
+    if(len < SRV_FRAME_HEADER)
+      return false;
+    memcpy(&body_len, buf, sizeof(body_len));
+    if(body_len > SRV_MAX_FRAME)
+      throw srv_error("Frame of " + std::to_string(body_len) + " bytes is too long.");
+    return len - SRV_FRAME_HEADER >= body_len;
+  }
+
+
+  void msg_put_u8(std::string &out, BYTE v)
+  {
+    out.push_back(static_cast<char>(v));
+  }
+
+
+  void msg_put_u16(std::string &out, uint16_t v)
+  {
+    msg_put_raw(out, &v, sizeof(v));
+  }
+
+
+  void msg_put_u32(std::string &out, uint32_t v)
+  {
+    msg_put_raw(out, &v, sizeof(v));
+  }
+
+
+  void msg_put_str(std::string &out, const std::string &s)
+  {
+    if(s.size() > UINT16_MAX)
+      throw srv_error("String of " + std::to_string(s.size()) + " bytes is too long for a message.");
+    msg_put_u16(out, s.size());
+    out.append(s);
+  }
+
+
+  void msg_put_val(std::string &out, const Page::value_t &val)
+  {
+    msg_put_u8(out, val.type);
+    switch(val.type)
+    {
+      case Page::RTYPE_NULL:
+        break;
+      case Page::RTYPE_SHORT:
+        msg_put_raw(out, &val.s, sizeof(val.s));
+        break;
+      case Page::RTYPE_INT:
+        msg_put_raw(out, &val.i, sizeof(val.i));
+        break;
+      case Page::RTYPE_DOUBLE:
+        msg_put_raw(out, &val.d, sizeof(val.d));
+        break;
+      case Page::RTYPE_STRING:
+        msg_put_u16(out, val.str.len);
+        out.append(val.str.ptr, val.str.len);
+        break;
+      default:
+        throw srv_error("Value of unknown type " + std::to_string(val.type) + ".");
+    }
+  }
+
+
+  BYTE msg_get_u8(msg_reader_t &in)
+  {
+    return *msg_get_raw(in, 1);
+  }
+
+
+  uint16_t msg_get_u16(msg_reader_t &in)
+  {
+    uint16_t v;
+    memcpy(&v, msg_get_raw(in, sizeof(v)), sizeof(v));
+    return v;
+  }
+
+
+  uint32_t msg_get_u32(msg_reader_t &in)
+  {
+    uint32_t v;
+    memcpy(&v, msg_get_raw(in, sizeof(v)), sizeof(v));
+    return v;
+  }
+
+
+  std::string msg_get_str(msg_reader_t &in)
+  {
+    uint16_t len = msg_get_u16(in);
+    return std::string(reinterpret_cast<const char*>(msg_get_raw(in, len)), len);
+  }
+
+
+  Page::value_t msg_get_val(msg_reader_t &in)
+  {
+    BYTE type = msg_get_u8(in);
+    switch(type)
+    {
+      case Page::RTYPE_NULL:
+        return Page::val_null();
+      case Page::RTYPE_SHORT:
+      {
+        int16_t v;
+        memcpy(&v, msg_get_raw(in, sizeof(v)), sizeof(v));
+        return Page::val_short(v);
+      }
+      case Page::RTYPE_INT:
+      {
+        int32_t v;
+        memcpy(&v, msg_get_raw(in, sizeof(v)), sizeof(v));
+        return Page::val_int(v);
+      }
+      case Page::RTYPE_DOUBLE:
+      {
+        double v;
+        memcpy(&v, msg_get_raw(in, sizeof(v)), sizeof(v));
+        return Page::val_double(v);
+      }
+      case Page::RTYPE_STRING:
+      {
+        uint16_t len = msg_get_u16(in);
+        return Page::val_str(reinterpret_cast<const char*>(msg_get_raw(in, len)), len);
+      }
+      default:
+        throw srv_error("Value of unknown type " + std::to_string(type) + ".");
+    }
+  }
+
+
+  int msg_connect(const std::string &path)
+  {
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if(path.size() >= sizeof(addr.sun_path))
+      throw srv_error("Socket path \"" + path + "\" is too long.");
+    strcpy(addr.sun_path, path.c_str());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd < 0)
+      throw srv_error(std::string("socket(): ") + strerror(errno));
+    if(connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0)
+    {
+      int err = errno;
+      close(fd);
+      throw srv_error("No server at \"" + path + "\": " + strerror(err));
+    }
+    return fd;
+  }
+
+
+  void msg_send_all(int fd, const char* buf, size_t len)
+  {
+    while(len > 0)
+    {
+      ssize_t sent = send(fd, buf, len, MSG_NOSIGNAL);
+      if(sent > 0)
+      {
+        buf += sent;
+        len -= sent;
+      }
+      else if(sent < 0 && errno == EINTR)
+        continue;
+      else if(sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) // the peer is behind on reading: wait for room
+      {
+        pollfd pfd = {fd, POLLOUT, 0};
+        poll(&pfd, 1, -1);
+      }
+      else
+        throw srv_error(std::string("send(): ") + strerror(errno));
+    }
+  }
+
+
+  bool msg_fill(msg_inbox_t &inbox)
+  {
+    const size_t chunk = 1 << 16;
+    if(inbox.off > 0) // drop the frames already taken
+    {
+      inbox.buf.erase(0, inbox.off);
+      inbox.off = 0;
+    }
+    size_t have = inbox.buf.size();
+    inbox.buf.resize(have + chunk);
+    while(true)
+    {
+      ssize_t n = recv(inbox.fd, &inbox.buf[have], chunk, 0);
+      if(n < 0 && errno == EINTR)
+        continue;
+      inbox.buf.resize(have + std::max<ssize_t>(n, 0));
+      if(n > 0)
+        return true;
+      if(n == 0)
+        return false;
+      if(errno == EAGAIN || errno == EWOULDBLOCK)
+        return true;
+      throw srv_error(std::string("recv(): ") + strerror(errno));
+    }
+  }
+
+
+  bool msg_next_frame(msg_inbox_t &inbox, msg_reader_t &body)
+  {
+    uint32_t len;
+    const BYTE* at = reinterpret_cast<const BYTE*>(inbox.buf.data()) + inbox.off;
+    if(!msg_frame_ready(at, inbox.buf.size() - inbox.off, len))
+      return false;
+    body.pos = at + SRV_FRAME_HEADER;
+    body.end = body.pos + len;
+    inbox.off += SRV_FRAME_HEADER + len;
+    return true;
+  }
+
+
+  bool msg_recv_frame(msg_inbox_t &inbox, msg_reader_t &body)
+  {
+    while(!msg_next_frame(inbox, body))
+      if(!msg_fill(inbox))
+        return false;
+    return true;
+  }
+}
@@ -0,0 +1,158 @@
+/**************************************************************************************************
+* Filename:   protocol.h
+* Details:    Defines the binary protocol spoken between the server ("server.h") and its clients
+*             over a Unix domain socket, and the helpers both ends encode and decode it with.
+**************************************************************************************************/
+
+/*************************************************************************************************
+  Every message is a frame: a uint32_t length, then that many bytes of body. A request's body is
+  |tag|op|payload| and its response's is |tag|status|payload|. <tag> is any uint32_t the client
+  picks, handed back with the response; <status> is SRV_OK, or SRV_ERROR with the error's text as
+  the payload. Numbers are in the host's byte order, both ends being on the same host.
+
+  A client need not wait for a response before sending its next request. The requests of one
+  connection run one after the other, in the order they were sent, and their responses come back
+  in that order; requests on different connections run side by side.
+
+  Payloads are built from:
+
+    str    |uint16_t len|len bytes|
+    val    |type|...|, <type> being an RTYPE_* of "paging.h": nothing follows RTYPE_NULL, an
+           int16_t follows RTYPE_SHORT, an int32_t RTYPE_INT, a double RTYPE_DOUBLE and a str
+           RTYPE_STRING
+    rows   |uint16_t ncols|uint32_t nrows|nrows * ncols vals|
+
+  Request payloads, and what their response carries:
+
+    SRV_CREATE_TABLE  |str table|uint8_t pax|uint16_t ncols|ncols * |str col|uint16_t type|uint16_t size||
+                      -> nothing
+    SRV_CREATE_INDEX  |str index|str table|str col|uint8_t hash|
+                      -> nothing
+    SRV_INSERT        |str table|uint16_t ncols|ncols * str col|uint32_t nrows|nrows * ncols vals|
+                      -> |uint32_t rows inserted|
+    SRV_SCAN          |str table|uint16_t npreds|npreds * |str col|uint8_t op|val||uint16_t nproj|
+                      |nproj * str col|uint8_t flags|uint32_t limit|
+                      -> rows, at most <limit> of them (0 = no limit) ; with SRV_SCAN_COUNT, no
+                         columns and <nrows> the number that match
+    SRV_LOOKUP        |str table|str col|val key|uint16_t nproj|nproj * str col|
+                      -> rows whose <col> equals <key>, found through an index on <col> if the
+                         table has one
+
+  No projected columns (<nproj> = 0) projects every column. An insert runs in a transaction of its
+  own, so a batch that fails leaves none of its rows behind.
+*************************************************************************************************/
+
+/********************************************* GUARD *********************************************/
+
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+/***************************************** HEADER FILES ******************************************/
+
+#include "../paging/paging.h"
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+/******************************************* CONSTANTS *******************************************/
+
+namespace Server
+{
+  /* Request ops */
+  const BYTE SRV_CREATE_TABLE = 1;
+  const BYTE SRV_CREATE_INDEX = 2;
+  const BYTE SRV_INSERT = 3;
+  const BYTE SRV_SCAN = 4;
+  const BYTE SRV_LOOKUP = 5;
+
+  /* Response statuses */
+  const BYTE SRV_OK = 0;
+  const BYTE SRV_ERROR = 1;
+
+  const BYTE SRV_SCAN_COUNT = 1; // <flags> of SRV_SCAN: count the matching rows instead of sending them
+
+  const uint32_t SRV_MAX_FRAME = 1u << 26; // longest body either end accepts
+  const size_t SRV_FRAME_HEADER = sizeof(uint32_t); // the length in front of each body
+}
+
+/************************************** IMPLEMENT STRUCTURES *************************************/
+
+namespace Server
+{
+  /************************************* DEFINE SERVER ERROR *************************************/
+
+  class srv_error : public std::runtime_error
+  {
+    public:
+      srv_error(std::string what) : std::runtime_error(what) {}
+      srv_error(const char *what) : std::runtime_error(what) {}
+  };
+
+  /* Structure for decoding a body: the bytes left to read */
+  struct msg_reader_t
+  {
+    const BYTE* pos;
+    const BYTE* end;
+  };
+
+  /* Structure for the bytes read off a socket, many frames per "recv()" */
+  struct msg_inbox_t
+  {
+    int fd = -1;
+    std::string buf;
+    size_t off = 0; // where the first frame not taken yet starts in <buf>
+  };
+}
+
+namespace Server
+{
+  /************************************* FUNCTION PROTOTYPES *************************************/
+
+  /* Append the start of a frame to <out>: room for its length, then <tag> and <code> (an op or a status). Returns where the
+     frame starts, to hand to "msg_frame_end()" */
+  size_t msg_frame_begin(std::string &out, uint32_t tag, BYTE code);
+
+  /* Fill in the length of the frame begun at <start>, now that its body has been appended */
+  void msg_frame_end(std::string &out, size_t start);
+
+  /* Whether the <len> bytes at <buf> start with a whole frame, and if so the length of its body. Throws a <srv_error> for a
+     frame longer than SRV_MAX_FRAME */
+  bool msg_frame_ready(const BYTE* buf, size_t len, uint32_t &body_len);
+
+  void msg_put_u8(std::string &out, BYTE v);
+  void msg_put_u16(std::string &out, uint16_t v);
+  void msg_put_u32(std::string &out, uint32_t v);
+
+  /* Throws a <srv_error> for a string longer than a str's uint16_t length can hold */
+  void msg_put_str(std::string &out, const std::string &s);
+
+  void msg_put_val(std::string &out, const Page::value_t &val);
+
+  /* Each reads the next item of the body, throwing a <srv_error> if the body ends first */
+  BYTE msg_get_u8(msg_reader_t &in);
+  uint16_t msg_get_u16(msg_reader_t &in);
+  uint32_t msg_get_u32(msg_reader_t &in);
+  std::string msg_get_str(msg_reader_t &in);
+
+  /* A string value points into the body, and stays valid for as long as it does */
+  Page::value_t msg_get_val(msg_reader_t &in);
+
+  /* Connect to the server's socket ; throws a <srv_error> if no server is listening there */
+  int msg_connect(const std::string &path);
+
+  /* Send all of <buf> on a socket, waiting for room when it is non-blocking ; throws a <srv_error> if the peer is gone */
+  void msg_send_all(int fd, const char* buf, size_t len);
+
+  /* Read what the socket has into the inbox, once ; false when the peer hung up. A non-blocking socket with nothing to
+     read returns true, having read nothing */
+  bool msg_fill(msg_inbox_t &inbox);
+
+  /* Take the body of the next frame already read into the inbox, if it is whole ; it stays valid until "msg_fill()" */
+  bool msg_next_frame(msg_inbox_t &inbox, msg_reader_t &body);
+
+  /* Take the body of the next frame from a blocking socket, reading until it is whole ; false when the peer hung up */
+  bool msg_recv_frame(msg_inbox_t &inbox, msg_reader_t &body);
+}
+
+#endif // PROTOCOL_H
@@ -0,0 +1,573 @@
+/**************************************************************************************************
+* Filename:   server.cpp
+* Details:    Implements the server declared in "server.h": the connection thread, the work queue
+*             and the pool of workers that run the requests.
+**************************************************************************************************/
+
+/****************************************** HEADER FILES *****************************************/
+
+#include "server.h"
+#include "../buffer_mgr/buffer_mgr.h"
+#include "../index_mgr/index_mgr.h"
+#include "../lock_mgr/lock_mgr.h"
+#include "../table_mgr/table_scan.h"
+#include "../table_mgr/transaction.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <memory>
+#include <mutex>
+#include <poll.h>
+#include <shared_mutex>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+
+/************************************** IMPLEMENT STRUCTURES *************************************/
+
+namespace Server
+{
+  /* Structure for one client connection */
+  struct srv_conn_t
+  {
+    msg_inbox_t inbox; // read by the connection thread only
+    std::mutex mutex; // guards the members below
+    std::string pending; // whole request frames waiting for a worker, back to back
+    size_t num_pending = 0;
+    bool queued = false; // on the work queue, or being served by a worker
+    bool throttled = false; // not read from until a worker catches up
+
+    ~srv_conn_t()
+    {
+      close(inbox.fd);
+    }
+  };
+
+  typedef std::shared_ptr<srv_conn_t> srv_conn_ptr; // the connection thread holds it until the client hangs up, and a worker while serving it
+}
+
+/**************************************** GLOBAL VARIABLES ***************************************/
+
+namespace Server
+{
+  static std::atomic<bool> stopping(false);
+  static int wake_pipe[2] = {-1, -1}; // written to by "srv_stop()" and by workers catching up, to wake the connection thread
+
+  /* The work queue: connections with requests waiting */
+  static std::mutex queue_mutex;
+  static std::condition_variable queue_cv;
+  static std::deque<srv_conn_ptr> queue;
+  static bool queue_done = false;
+}
+
+/************************************ FUNCTION IMPLEMENTATIONS ***********************************/
+
+namespace Server
+{
+  static void srv_wake()
+  {
+    if(write(wake_pipe[1], "", 1) < 0) {} // a full pipe will wake the thread all the same
+  }
+
+
+  void srv_stop()
+  {
+    stopping = true;
+    if(wake_pipe[1] >= 0)
+      srv_wake();
+  }
+
+
+  static void srv_enqueue(const srv_conn_ptr &conn)
+  {
+    {
+      std::lock_guard<std::mutex> lock(queue_mutex);
+      queue.push_back(conn);
+    }
+    queue_cv.notify_one();
+  }
+
+
+  /* Wait for a connection to serve ; false once the server is stopping */
+  static bool srv_dequeue(srv_conn_ptr &conn)
+  {
+    std::unique_lock<std::mutex> lock(queue_mutex);
+    queue_cv.wait(lock, [] { return queue_done || !queue.empty(); });
+    if(queue_done)
+      return false;
+    conn = std::move(queue.front());
+    queue.pop_front();
+    return true;
+  }
+
+
+  /*************************************** REQUESTS ******************************************/
+
+  static std::vector<std::string> srv_get_names(msg_reader_t &in)
+  {
+    std::vector<std::string> names(msg_get_u16(in));
+    for(std::string &name : names)
+      name = msg_get_str(in);
+    return names;
+  }
+
+
+  static void srv_create_table(file_descriptor_t &dbfile, msg_reader_t &in)
+  {
+    std::string table = msg_get_str(in);
+    bool pax = msg_get_u8(in) != 0;
+    std::vector<Table::col_def_t> cols(msg_get_u16(in));
+    for(Table::col_def_t &col : cols)
+    {
+      col.name = msg_get_str(in);
+      col.type = msg_get_u16(in);
+      col.size = msg_get_u16(in);
+    }
+    Table::create_table(dbfile, table, cols, pax ? Table::DB_TYPE_PAX : Table::DB_TYPE_ROWS);
+  }
+
+
+  static void srv_create_index(file_descriptor_t &dbfile, msg_reader_t &in)
+  {
+    std::string index = msg_get_str(in);
+    std::string table = msg_get_str(in);
+    std::string col = msg_get_str(in);
+    if(msg_get_u8(in) != 0)
+      Index::create_hash_index(dbfile, index, table, col);
+    else
+      Index::create_index(dbfile, index, table, col);
+  }
+
+
+  /* The rows point into the request, which outlives the insert */
+  static void srv_insert(file_descriptor_t &dbfile, msg_reader_t &in, std::string &out)
+  {
+    std::string table = msg_get_str(in);
+    std::vector<std::string> cols = srv_get_names(in);
+    uint32_t nrows = msg_get_u32(in);
+    if(cols.empty())
+      throw srv_error("An insert needs at least one column.");
+    if((uint64_t)nrows * cols.size() > (uint64_t)(in.end - in.pos)) // each value takes a byte at least
+      throw srv_error("Message ends before its last row.");
+
+    std::vector<Table::row_t> rows(nrows, Table::row_t(cols.size()));
+    for(Table::row_t &row : rows)
+      for(Page::value_t &val : row)
+        val = msg_get_val(in);
+
+    Table::insert_stmt_t stmt;
+    Table::prepare_insert(dbfile, table, cols, stmt);
+    msg_put_u32(out, Table::insert_rows(dbfile, stmt, rows));
+  }
+
+
+  /* Append the rows of a scan, or just how many there are, to the response begun at <start> */
+  static void srv_scan_rows(file_descriptor_t &dbfile, const std::string &table, const std::vector<Table::scan_pred_t> &preds,
+                            const std::vector<std::string> &proj, bool count, uint32_t limit, std::string &out, size_t start)
+  {
+    if(count)
+    {
+      size_t n = Table::pscan_count(dbfile, table, preds, 1);
+      msg_put_u16(out, 0);
+      msg_put_u32(out, limit != 0 ? std::min<size_t>(n, limit) : n);
+      return;
+    }
+
+    Table::scan_cursor_t cur;
+    Table::row_t row;
+    Table::RID rid;
+    Table::scan_open(dbfile, table, preds, proj, cur);
+    msg_put_u16(out, cur.proj.size());
+    size_t at = out.size();
+    msg_put_u32(out, 0); // filled in once the rows are in
+    uint32_t n = 0;
+    try
+    {
+      while((limit == 0 || n < limit) && Table::scan_next(cur, row, rid))
+      {
+        for(const Page::value_t &val : row)
+          msg_put_val(out, val);
+        n++;
+        if(out.size() - start > SRV_MAX_FRAME)
+          throw srv_error("The result is too long for one response ; scan it with a limit.");
+      }
+    }
+    catch(...)
+    {
+      Table::scan_close(cur);
+      throw;
+    }
+    Table::scan_close(cur);
+    memcpy(&out[at], &n, sizeof(n));
+  }
+
+
+  static void srv_scan(file_descriptor_t &dbfile, msg_reader_t &in, std::string &out, size_t start)
+  {
+    std::string table = msg_get_str(in);
+    std::vector<Table::scan_pred_t> preds(msg_get_u16(in));
+    for(Table::scan_pred_t &pred : preds)
+    {
+      pred.col = msg_get_str(in);
+      pred.op = msg_get_u8(in);
+      pred.val = msg_get_val(in);
+      if(pred.op > Table::SCAN_GE)
+        throw srv_error("Unknown comparison " + std::to_string(pred.op) + " on \"" + pred.col + "\".");
+    }
+    std::vector<std::string> proj = srv_get_names(in);
+    BYTE flags = msg_get_u8(in);
+    uint32_t limit = msg_get_u32(in);
+    srv_scan_rows(dbfile, table, preds, proj, (flags & SRV_SCAN_COUNT) != 0, limit, out, start);
+  }
+
+
+  /* The index to look up <col> in, a hash index over a B+tree ; nullptr if there is none */
+  static const Table::index_def_t* srv_pick_index(const std::vector<Table::index_def_t> &indexes, const std::string &col)
+  {
+    const Table::index_def_t* pick = nullptr;
+    for(const Table::index_def_t &idx : indexes)
+      if(idx.column == col && (pick == nullptr || idx.type == Table::DB_TYPE_HASH))
+        pick = &idx;
+    return pick;
+  }
+
+
+  static void srv_lookup(file_descriptor_t &dbfile, msg_reader_t &in, std::string &out, size_t start)
+  {
+    std::string table = msg_get_str(in);
+    std::string col = msg_get_str(in);
+    Page::value_t key = msg_get_val(in);
+    std::vector<std::string> proj = srv_get_names(in);
+
+    std::vector<Table::index_def_t> indexes;
+    Index::find_indexes(dbfile, table, indexes);
+    const Table::index_def_t* pick = srv_pick_index(indexes, col);
+    if(pick == nullptr) // no index on the column: a scan finds the rows
+    {
+      srv_scan_rows(dbfile, table, {{col, Table::SCAN_EQ, key, 0}}, proj, false, 0, out, start);
+      return;
+    }
+
+    /* Index pages have no latches: S on the table keeps its writers out while the index is read, and the index's "#master"
+       row is read again under it, for a root a writer split before letting go */
+    Table::index_def_t idx = *pick;
+    Table::txn_scope_t scope(dbfile);
+    Table::table_descriptor_t td;
+    Table::read_table_descriptor(dbfile, table, td);
+    Lock_mgr::lock_table(scope.txn->xid, td.lock_id, Lock_mgr::LOCK_S);
+    Table::RID master_rid;
+    Table::master_table_row_t master = Table::master_lookup(dbfile, idx.name, master_rid);
+    idx.root = master.first_page;
+    idx.first_leaf = master.last_page;
+    std::vector<Table::RID> rids;
+    if(idx.type == Table::DB_TYPE_HASH)
+      Index::hx_lookup(dbfile, idx, key, rids);
+    else
+      Index::bt_lookup(dbfile, idx, key, rids);
+
+    std::sort(td.col_types.begin(), td.col_types.end(), [](const Table::column_type_t &a, const Table::column_type_t &b) { return a.ord < b.ord; });
+    std::vector<uint16_t> cols;
+    for(const std::string &name : proj)
+      cols.push_back(Table::tbl_col_index(td, name));
+    if(proj.empty())
+      for(uint16_t c = 0; c < td.col_types.size(); c++)
+        cols.push_back(c);
+
+    msg_put_u16(out, cols.size());
+    size_t at = out.size();
+    msg_put_u32(out, 0);
+    uint32_t n = 0;
+    Table::snapshot_t snap;
+    Table::snapshot_open(snap, scope.txn->xid);
+    std::string rec;
+    Table::row_t row;
+    for(Table::RID rid : rids)
+    {
+      if(!Table::mvcc_may_see(snap, rid)) // an old version, hidden without reading its page
+        continue;
+      void* page = Buffer_mgr::buf_pin(dbfile, rid.page_id);
+      bool visible;
+      {
+        std::shared_lock<std::shared_mutex> latch(Buffer_mgr::buf_latch(rid.page_id));
+        visible = Table::mvcc_visible(snap, page, rid);
+      }
+      if(!visible)
+      {
+        Buffer_mgr::buf_unpin(rid.page_id);
+        continue;
+      }
+      try
+      {
+        Table::read_row(dbfile, rid, rec, row);
+      }
+      catch(...)
+      {
+        Buffer_mgr::buf_unpin(rid.page_id);
+        Table::snapshot_close(snap);
+        throw;
+      }
+      for(uint16_t c : cols)
+        msg_put_val(out, row[c]);
+      Buffer_mgr::buf_unpin(rid.page_id);
+      n++;
+    }
+    Table::snapshot_close(snap);
+    memcpy(&out[at], &n, sizeof(n));
+  }
+
+
+  /* Run one request and append its response to <out> ; an error becomes the response */
+  static void srv_handle(file_descriptor_t &dbfile, msg_reader_t in, std::string &out)
+  {
+    size_t start = out.size();
+    uint32_t tag = 0;
+    try
+    {
+      tag = msg_get_u32(in);
+      BYTE op = msg_get_u8(in);
+      msg_frame_begin(out, tag, SRV_OK);
+      switch(op)
+      {
+        case SRV_CREATE_TABLE:
+          srv_create_table(dbfile, in);
+          break;
+        case SRV_CREATE_INDEX:
+          srv_create_index(dbfile, in);
+          break;
+        case SRV_INSERT:
+          srv_insert(dbfile, in, out);
+          break;
+        case SRV_SCAN:
+          srv_scan(dbfile, in, out, start);
+          break;
+        case SRV_LOOKUP:
+          srv_lookup(dbfile, in, out, start);
+          break;
+        default:
+          throw srv_error("Unknown request op " + std::to_string(op) + ".");
+      }
+    }
+    catch(const std::exception &e)
+    {
+      out.resize(start);
+      msg_frame_begin(out, tag, SRV_ERROR);
+      msg_put_str(out, std::string(e.what()).substr(0, UINT16_MAX)); // the text of an error about a long name is cut short
+    }
+    msg_frame_end(out, start);
+  }
+
+
+  /**************************************** WORKERS ******************************************/
+
+  static void srv_worker(file_descriptor_t &dbfile)
+  {
+    std::string work; // the requests taken off a connection ; swapped with its <pending>, so both keep their capacity
+    std::string out;
+    srv_conn_ptr conn;
+    while(srv_dequeue(conn))
+    {
+      {
+        std::lock_guard<std::mutex> lock(conn->mutex);
+        work.swap(conn->pending);
+        conn->num_pending = 0;
+      }
+
+      out.clear();
+      const BYTE* at = reinterpret_cast<const BYTE*>(work.data());
+      const BYTE* end = at + work.size();
+      uint32_t len;
+      while(at < end && msg_frame_ready(at, end - at, len)) // the connection thread only queues whole frames
+      {
+        srv_handle(dbfile, {at + SRV_FRAME_HEADER, at + SRV_FRAME_HEADER + len}, out);
+        at += SRV_FRAME_HEADER + len;
+      }
+      work.clear();
+
+      try
+      {
+        msg_send_all(conn->inbox.fd, out.data(), out.size());
+      }
+      catch(const srv_error &) {} // the client is gone ; the connection thread sees it hang up
+
+      bool again, wake;
+      {
+        std::lock_guard<std::mutex> lock(conn->mutex);
+        again = conn->num_pending > 0;
+        conn->queued = again;
+        wake = conn->throttled;
+      }
+      if(again)
+        srv_enqueue(conn);
+      if(wake)
+        srv_wake();
+      conn.reset();
+    }
+  }
+
+
+  /*************************************** CONNECTIONS ***************************************/
+
+  static int srv_listen(const std::string &path)
+  {
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if(path.size() >= sizeof(addr.sun_path))
+      throw srv_error("Socket path \"" + path + "\" is too long.");
+    strcpy(addr.sun_path, path.c_str());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(fd < 0)
+      throw srv_error(std::string("socket(): ") + strerror(errno));
+    unlink(path.c_str()); // left behind by a server that did not stop cleanly
+    if(bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(fd, SOMAXCONN) != 0)
+    {
+      int err = errno;
+      close(fd);
+      throw srv_error("Cannot listen at \"" + path + "\": " + strerror(err));
+    }
+    return fd;
+  }
+
+
+  /* Queue the whole requests the connection has sent ; false when it hung up or broke the protocol */
+  static bool srv_read(const srv_conn_ptr &conn)
+  {
+    msg_inbox_t &inbox = conn->inbox;
+    bool open;
+    size_t from, count = 0;
+    try
+    {
+      open = msg_fill(inbox);
+      from = inbox.off;
+      msg_reader_t body;
+      while(msg_next_frame(inbox, body))
+        count++;
+    }
+    catch(const srv_error &)
+    {
+      return false;
+    }
+    if(count == 0)
+      return open;
+
+    bool wake_worker;
+    {
+      std::lock_guard<std::mutex> lock(conn->mutex);
+      conn->pending.append(inbox.buf, from, inbox.off - from);
+      conn->num_pending += count;
+      wake_worker = !conn->queued;
+      conn->queued = true;
+    }
+    if(wake_worker)
+      srv_enqueue(conn);
+    return open;
+  }
+
+
+  /* The connection thread: accept connections and read their requests until the server stops */
+  static void srv_serve(int listen_fd)
+  {
+    std::unordered_map<int, srv_conn_ptr> conns;
+    std::vector<pollfd> pfds;
+    std::vector<srv_conn_ptr> polled;
+    char drain[256];
+
+    while(!stopping)
+    {
+      pfds.assign({{listen_fd, POLLIN, 0}, {wake_pipe[0], POLLIN, 0}});
+      polled.clear();
+      for(auto &entry : conns)
+      {
+        srv_conn_t &conn = *entry.second;
+        bool throttled;
+        {
+          std::lock_guard<std::mutex> lock(conn.mutex);
+          throttled = conn.throttled = conn.num_pending >= SRV_MAX_QUEUED;
+        }
+        pfds.push_back({entry.first, static_cast<short>(throttled ? 0 : POLLIN), 0}); // a hangup is reported all the same
+        polled.push_back(entry.second);
+      }
+
+      if(poll(pfds.data(), pfds.size(), -1) < 0)
+      {
+        if(errno == EINTR)
+          continue;
+        throw srv_error(std::string("poll(): ") + strerror(errno));
+      }
+
+      if(pfds[1].revents != 0)
+        while(read(wake_pipe[0], drain, sizeof(drain)) > 0) {}
+
+      if(pfds[0].revents != 0)
+      {
+        int fd;
+        while((fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+        {
+          srv_conn_ptr conn = std::make_shared<srv_conn_t>();
+          conn->inbox.fd = fd;
+          conns[fd] = conn;
+        }
+      }
+
+      for(size_t i = 0; i < polled.size(); i++)
+        if(pfds[i + 2].revents != 0 && !srv_read(polled[i]))
+          conns.erase(pfds[i + 2].fd); // closed once no worker holds it either
+    }
+  }
+
+
+  void srv_run(file_descriptor_t &dbfile, const srv_config_t &cfg)
+  {
+    int listen_fd = srv_listen(cfg.socket_path);
+    if(pipe2(wake_pipe, O_NONBLOCK | O_CLOEXEC) != 0)
+    {
+      close(listen_fd);
+      throw srv_error(std::string("pipe(): ") + strerror(errno));
+    }
+    queue_done = false;
+
+    unsigned nworkers = cfg.workers != 0 ? cfg.workers : std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::thread> workers;
+    for(unsigned w = 0; w < nworkers; w++)
+      workers.emplace_back(srv_worker, std::ref(dbfile));
+
+    std::string error;
+    try
+    {
+      srv_serve(listen_fd);
+    }
+    catch(const std::exception &e)
+    {
+      error = e.what();
+    }
+
+    /* Workers finish the connection they are serving ; requests still queued are dropped with their connections */
+    {
+      std::lock_guard<std::mutex> lock(queue_mutex);
+      queue_done = true;
+      queue.clear();
+    }
+    queue_cv.notify_all();
+    for(std::thread &worker : workers)
+      worker.join();
+
+    close(listen_fd);
+    unlink(cfg.socket_path.c_str());
+    for(int &fd : wake_pipe)
+    {
+      close(fd);
+      fd = -1;
+    }
+    stopping = false;
+    if(!error.empty())
+      throw srv_error(error);
+  }
+}
@@ -0,0 +1,64 @@
+/**************************************************************************************************
+* Filename:   server.h
+* Details:    Defines the API for serving one DB file to many client processes over a Unix domain
+*             socket, speaking the protocol of "protocol.h".
+**************************************************************************************************/
+
+/*************************************************************************************************
+  One thread waits on the listening socket and every connection with "poll()". It reads whatever
+  a connection has sent, cuts it into whole requests, queues them on the connection, and puts the
+  connection on the work queue unless it is already there.
+
+  A fixed pool of workers takes connections off the work queue. A worker runs every request
+  queued on its connection, one after the other, appending the responses to one buffer that it
+  sends with one "send()", then puts the connection back at the end of the queue if more requests
+  came in meanwhile. Requests of one connection thus run in order and never on two workers at
+  once, while a client that sends many before reading any gets many answers per wakeup. A
+  connection with SRV_MAX_QUEUED requests waiting is not read from until a worker catches up.
+
+  Every worker reads and writes through the one buffer pool of "buffer_mgr.h", and each request
+  runs in a transaction of its own ("transaction.h") on its worker. Scans read through a snapshot
+  and take no locks. A lookup through an index holds S on the table while it reads the index,
+  whose pages have no latches: writers to an indexed table hold X on it (see "table_mgr.cpp").
+*************************************************************************************************/
+
+/********************************************* GUARD *********************************************/
+
+#ifndef SERVER_H
+#define SERVER_H
+
+/***************************************** HEADER FILES ******************************************/
+
+#include "protocol.h"
+
+/******************************************* CONSTANTS *******************************************/
+
+namespace Server
+{
+  const size_t SRV_MAX_QUEUED = 256; // requests of one connection waiting for a worker before it is read no more
+}
+
+/************************************** IMPLEMENT STRUCTURES *************************************/
+
+namespace Server
+{
+  /* Structure for how to run the server */
+  struct srv_config_t
+  {
+    std::string socket_path;
+    unsigned workers = 4; // 0 = one per core
+  };
+}
+
+namespace Server
+{
+  /************************************* FUNCTION PROTOTYPES *************************************/
+
+  /* Listen at <cfg.socket_path> and serve <dbfile> until "srv_stop()" ; throws a <srv_error> if the socket cannot be set up */
+  void srv_run(file_descriptor_t &dbfile, const srv_config_t &cfg);
+
+  /* Make "srv_run()" return once the requests being run have been answered ; safe to call from a signal handler */
+  void srv_stop();
+}
+
+#endif // SERVER_H
@@ -0,0 +1,580 @@
+/**************************************************************************************************
+* Filename:   aggregate.cpp
+* Details:    Implements the hash aggregation declared in "aggregate.h".
+**************************************************************************************************/
+
+/****************************************** HEADER FILES *****************************************/
+
+#include "aggregate.h"
+#include "temp_pages.h"
+
+#include <algorithm>
+#include <mutex>
+#include <thread>
+
+/************************************** IMPLEMENT STRUCTURES *************************************/
+
+namespace Table
+{
+  /* Structure for the running state of one aggregate in one group */
+  struct agg_acc_t
+  {
+    int64_t count; // values seen (rows, for "COUNT(*)")
+    int64_t sum;
+    Page::value_t ext; // the MIN or MAX so far, RTYPE_NULL until the first value
+  };
+
+  /* Structure for one group of an <agg_table_t> */
+  struct agg_group_t
+  {
+    const BYTE* key; // in the table's arena
+    uint16_t len;
+    uint64_t hash;
+  };
+
+  /* Structure that holds one set of partial groups: an open-addressing table of group numbers, probed linearly */
+  struct agg_table_t
+  {
+    std::vector<uint32_t> slots; // group number + 1, 0 for an empty slot ; the size is a power of 2
+    std::vector<agg_group_t> groups;
+    std::vector<agg_acc_t> accs; // <naggs> per group, in group order
+    agg_arena_t arena;
+  };
+
+  /* Structure for what every worker needs to know about the query */
+  struct agg_plan_t
+  {
+    std::vector<BYTE> group_types; // TBL_TYPE_* of each GROUP BY column, which is batch column <i> of the projection
+    std::vector<BYTE> fns;
+    std::vector<int> agg_col; // position of each aggregate's column in the projection, -1 for "COUNT(*)"
+  };
+
+  /* Structure for the groups spilled to temp pages, shared by the workers */
+  struct agg_spill_t
+  {
+    std::mutex mutex;
+    std::vector<uint16_t> pages[AGG_PARTITIONS]; // the last page of each partition is the one being filled
+    bool any = false;
+  };
+}
+
+/************************************ FUNCTION IMPLEMENTATIONS ***********************************/
+
+namespace Table
+{
+  const size_t AGG_BLOCK_SIZE = 64 * 1024;
+  const uint16_t AGG_MIN_SLOTS = 64;
+
+
+  BYTE* agg_alloc(agg_arena_t &arena, size_t size)
+  {
+    size = (size + 7) & ~size_t(7);
+    if(arena.used + size > arena.block_size)
+    {
+      arena.block_size = std::max(AGG_BLOCK_SIZE, size);
+      arena.blocks.emplace_back(new BYTE[arena.block_size]);
+      arena.total += arena.block_size;
+      arena.used = 0;
+    }
+    BYTE* mem = arena.blocks.back().get() + arena.used;
+    arena.used += size;
+    return mem;
+  }
+
+
+  void agg_clear(agg_arena_t &arena)
+  {
+    arena.blocks.clear();
+    arena.used = 0;
+    arena.total = 0;
+    arena.block_size = 0;
+  }
+
+
+  /* FNV-1a over the encoded key, then a final mix so both the low bits (slots) and the high bits (partitions) are good */
+  static uint64_t agg_hash(const BYTE* key, uint16_t len)
+  {
+    uint64_t h = 14695981039346656037ULL;
+    for(uint16_t i = 0; i < len; i++)
+      h = (h ^ key[i]) * 1099511628211ULL;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+  }
+
+
+  /* Bytes a table holds, checked against the memory budget */
+  static size_t agg_mem(const agg_table_t &table)
+  {
+    return table.slots.capacity() * sizeof(uint32_t) + table.groups.capacity() * sizeof(agg_group_t)
+         + table.accs.capacity() * sizeof(agg_acc_t) + table.arena.total;
+  }
+
+
+  static void agg_reset(agg_table_t &table)
+  {
+    std::vector<uint32_t>().swap(table.slots);
+    std::vector<agg_group_t>().swap(table.groups);
+    std::vector<agg_acc_t>().swap(table.accs);
+    agg_clear(table.arena);
+  }
+
+
+  /* Double the slots and put every group back */
+  static void agg_grow(agg_table_t &table)
+  {
+    size_t num_slots = std::max<size_t>(AGG_MIN_SLOTS, table.slots.size() * 2);
+    table.slots.assign(num_slots, 0);
+    for(uint32_t g = 0; g < table.groups.size(); g++)
+    {
+      size_t slot = table.groups[g].hash & (num_slots - 1);
+      while(table.slots[slot] != 0)
+        slot = (slot + 1) & (num_slots - 1);
+      table.slots[slot] = g + 1;
+    }
+  }
+
+
+  /* The group number of an encoded key, adding the group (with its key copied to the arena) if it is new */
+  static uint32_t agg_find_group(agg_table_t &table, size_t naggs, const BYTE* key, uint16_t len, uint64_t hash)
+  {
+    if(table.slots.empty())
+      agg_grow(table);
+
+    size_t mask = table.slots.size() - 1;
+    size_t slot = hash & mask;
+    while(table.slots[slot] != 0)
+    {
+      const agg_group_t &group = table.groups[table.slots[slot] - 1];
+      if(group.hash == hash && group.len == len && memcmp(group.key, key, len) == 0)
+        return table.slots[slot] - 1;
+      slot = (slot + 1) & mask;
+    }
+
+    BYTE* copy = len ? agg_alloc(table.arena, len) : nullptr;
+    if(len)
+      memcpy(copy, key, len);
+    uint32_t g = table.groups.size();
+    table.groups.push_back({copy, len, hash});
+    table.accs.resize(table.accs.size() + naggs, agg_acc_t{0, 0, Page::val_null()});
+    table.slots[slot] = g + 1;
+
+    if(table.groups.size() * 2 > table.slots.size()) // keep the load under one half, so probes stay short
+      agg_grow(table);
+    return g;
+  }
+
+
+  /* Three-way comparison of two non-NULL values of one column */
+  static int agg_cmp(const Page::value_t &a, const Page::value_t &b)
+  {
+    if(a.type == Page::RTYPE_SHORT)
+      return (a.s > b.s) - (a.s < b.s);
+    if(a.type == Page::RTYPE_INT)
+      return (a.i > b.i) - (a.i < b.i);
+    int cmp = memcmp(a.str.ptr, b.str.ptr, std::min(a.str.len, b.str.len));
+    return cmp != 0 ? cmp : (a.str.len > b.str.len) - (a.str.len < b.str.len);
+  }
+
+
+  /* Make <val> the MIN or MAX of <acc> if it beats the one there ; strings are copied to <arena>, since <val> does not
+     outlive the batch (or spill page) it came from */
+  static void agg_update_ext(agg_acc_t &acc, BYTE fn, const Page::value_t &val, agg_arena_t &arena)
+  {
+    if(acc.ext.type != Page::RTYPE_NULL)
+    {
+      int cmp = agg_cmp(val, acc.ext);
+      if((fn == AGG_MIN && cmp >= 0) || (fn == AGG_MAX && cmp <= 0))
+        return;
+    }
+    acc.ext = val;
+    if(val.type == Page::RTYPE_STRING && val.str.len > 0)
+    {
+      char* copy = reinterpret_cast<char*>(agg_alloc(arena, val.str.len));
+      memcpy(copy, val.str.ptr, val.str.len);
+      acc.ext.str.ptr = copy;
+    }
+  }
+
+
+  /* Fold the partial state <src> into <dst> */
+  static void agg_merge_acc(agg_acc_t &dst, const agg_acc_t &src, BYTE fn, agg_arena_t &arena)
+  {
+    dst.count += src.count;
+    dst.sum += src.sum;
+    if((fn == AGG_MIN || fn == AGG_MAX) && src.ext.type != Page::RTYPE_NULL)
+      agg_update_ext(dst, fn, src.ext, arena);
+  }
+
+
+  /* Encode a row's GROUP BY values back-to-back: a NULL flag byte, then 2 bytes for a SHORT, 4 for an INT, or the length
+     and bytes of a string. Returns the key length */
+  static uint16_t agg_encode_key(const vscan_cursor_t &cur, size_t ngroup, uint16_t r, std::vector<BYTE> &key)
+  {
+    size_t len = 0;
+    for(size_t c = 0; c < ngroup; c++)
+    {
+      const Page::vec_column_t &col = cur.batch.cols[cur.proj_col[c]];
+      size_t need = len + 1 + sizeof(uint16_t) + (col.nulls[r] || col.type != Page::RTYPE_STRING ? sizeof(int32_t) : col.str_lens[r]);
+      if(key.size() < need)
+        key.resize(need * 2);
+      key[len++] = col.nulls[r];
+      if(col.nulls[r])
+        continue;
+      if(col.type == Page::RTYPE_SHORT)
+      {
+        memcpy(&key[len], &col.shorts[r], sizeof(int16_t));
+        len += sizeof(int16_t);
+      }
+      else if(col.type == Page::RTYPE_INT)
+      {
+        memcpy(&key[len], &col.ints[r], sizeof(int32_t));
+        len += sizeof(int32_t);
+      }
+      else
+      {
+        memcpy(&key[len], &col.str_lens[r], sizeof(uint16_t));
+        memcpy(&key[len + sizeof(uint16_t)], col.strs[r], col.str_lens[r]);
+        len += sizeof(uint16_t) + col.str_lens[r];
+      }
+    }
+    if(len > UINT16_MAX)
+      throw table_error("GROUP BY key is too long.");
+    return len;
+  }
+
+
+  /* Fold the selected rows of a batch into a worker's table */
+  static void agg_add_batch(agg_table_t &table, const agg_plan_t &plan, const vscan_cursor_t &cur, std::vector<BYTE> &key)
+  {
+    size_t ngroup = plan.group_types.size();
+    size_t naggs = plan.fns.size();
+    for(uint16_t i = 0; i < cur.num_sel; i++)
+    {
+      uint16_t r = cur.sel[i];
+      uint16_t len = agg_encode_key(cur, ngroup, r, key);
+      uint32_t g = agg_find_group(table, naggs, key.data(), len, agg_hash(key.data(), len));
+
+      agg_acc_t* accs = &table.accs[g * naggs];
+      for(size_t a = 0; a < naggs; a++)
+      {
+        if(plan.agg_col[a] < 0)
+        {
+          accs[a].count++;
+          continue;
+        }
+        const Page::vec_column_t &col = cur.batch.cols[cur.proj_col[plan.agg_col[a]]];
+        if(col.nulls[r])
+          continue;
+        accs[a].count++;
+        if(plan.fns[a] == AGG_SUM || plan.fns[a] == AGG_AVG)
+          accs[a].sum += col.type == Page::RTYPE_SHORT ? col.shorts[r] : col.ints[r];
+        else if(plan.fns[a] == AGG_MIN || plan.fns[a] == AGG_MAX)
+          agg_update_ext(accs[a], plan.fns[a], vscan_value(cur, plan.agg_col[a], r), table.arena);
+      }
+    }
+  }
+
+
+  /* Fold every group of <src> into <dst> */
+  static void agg_merge_table(agg_table_t &dst, const agg_table_t &src, const agg_plan_t &plan)
+  {
+    size_t naggs = plan.fns.size();
+    for(uint32_t s = 0; s < src.groups.size(); s++)
+    {
+      const agg_group_t &group = src.groups[s];
+      uint32_t g = agg_find_group(dst, naggs, group.key, group.len, group.hash);
+      for(size_t a = 0; a < naggs; a++)
+        agg_merge_acc(dst.accs[g * naggs + a], src.accs[s * naggs + a], plan.fns[a], dst.arena);
+    }
+  }
+
+
+  /***************************************** SPILLING ******************************************/
+
+  /* Serialize a group as one record: |size|key_len|key|per aggregate: count|sum|ext type|ext value| */
+  static void agg_pack_group(std::string &rec, const agg_table_t &table, uint32_t g, size_t naggs)
+  {
+    const agg_group_t &group = table.groups[g];
+    rec.resize(sizeof(uint16_t));
+    rec.append(reinterpret_cast<const char*>(&group.len), sizeof(uint16_t));
+    rec.append(reinterpret_cast<const char*>(group.key), group.len);
+    for(size_t a = 0; a < naggs; a++)
+    {
+      const agg_acc_t &acc = table.accs[g * naggs + a];
+      rec.append(reinterpret_cast<const char*>(&acc.count), sizeof(int64_t));
+      rec.append(reinterpret_cast<const char*>(&acc.sum), sizeof(int64_t));
+      rec.push_back(acc.ext.type);
+      if(acc.ext.type == Page::RTYPE_SHORT)
+        rec.append(reinterpret_cast<const char*>(&acc.ext.s), sizeof(int16_t));
+      else if(acc.ext.type == Page::RTYPE_INT)
+        rec.append(reinterpret_cast<const char*>(&acc.ext.i), sizeof(int32_t));
+      else if(acc.ext.type == Page::RTYPE_STRING)
+      {
+        rec.append(reinterpret_cast<const char*>(&acc.ext.str.len), sizeof(uint16_t));
+        rec.append(acc.ext.str.ptr, acc.ext.str.len);
+      }
+    }
+    if(rec.size() + sizeof(uint16_t) > Page::PG_INITIAL_BYTES - sizeof(uint16_t))
+      throw table_error("A group is too large to spill to a page.");
+    Page::rec_finish(rec);
+  }
+
+
+  /* Fold a record written by "agg_pack_group()" into <table> */
+  static void agg_unpack_group(agg_table_t &table, const BYTE* rec, const agg_plan_t &plan)
+  {
+    size_t naggs = plan.fns.size();
+    const BYTE* p = rec + sizeof(uint16_t);
+    uint16_t len;
+    memcpy(&len, p, sizeof(uint16_t));
+    p += sizeof(uint16_t);
+    uint32_t g = agg_find_group(table, naggs, p, len, agg_hash(p, len));
+    p += len;
+
+    for(size_t a = 0; a < naggs; a++)
+    {
+      agg_acc_t acc;
+      memcpy(&acc.count, p, sizeof(int64_t));
+      memcpy(&acc.sum, p + sizeof(int64_t), sizeof(int64_t));
+      p += 2 * sizeof(int64_t);
+      acc.ext = Page::val_null();
+      BYTE type = *p++;
+      if(type == Page::RTYPE_SHORT)
+      {
+        int16_t s;
+        memcpy(&s, p, sizeof(int16_t));
+        acc.ext = Page::val_short(s);
+        p += sizeof(int16_t);
+      }
+      else if(type == Page::RTYPE_INT)
+      {
+        int32_t i;
+        memcpy(&i, p, sizeof(int32_t));
+        acc.ext = Page::val_int(i);
+        p += sizeof(int32_t);
+      }
+      else if(type == Page::RTYPE_STRING)
+      {
+        uint16_t slen;
+        memcpy(&slen, p, sizeof(uint16_t));
+        acc.ext = Page::val_str(reinterpret_cast<const char*>(p + sizeof(uint16_t)), slen); // copied by the merge
+        p += sizeof(uint16_t) + slen;
+      }
+      agg_merge_acc(table.accs[g * naggs + a], acc, plan.fns[a], table.arena);
+    }
+  }
+
+
+  /* Write every group of <table> to the temp pages of its partition, then empty the table */
+  static void agg_spill(file_descriptor_t &dbfile, agg_table_t &table, const agg_plan_t &plan, agg_spill_t &spill)
+  {
+    std::lock_guard<std::mutex> guard(spill.mutex);
+    spill.any = true;
+    std::string rec;
+    for(uint32_t g = 0; g < table.groups.size(); g++)
+    {
+      agg_pack_group(rec, table, g, plan.fns.size());
+      uint16_t part = table.groups[g].hash >> 60; // the top bits, since the slots use the low ones
+      tmp_add_record(dbfile, spill.pages[part], reinterpret_cast<const BYTE*>(rec.data()));
+    }
+    agg_reset(table);
+  }
+
+
+  /* Drop the temp pages of every partition */
+  static void agg_free_spill(file_descriptor_t &dbfile, agg_spill_t &spill)
+  {
+    for(std::vector<uint16_t> &pages : spill.pages)
+      tmp_free(dbfile, pages);
+  }
+
+
+
+  /****************************************** RESULTS ******************************************/
+
+  /* Turn each group of <table> into a result row ; strings are copied to the result's arena */
+  static void agg_emit(const agg_table_t &table, const agg_plan_t &plan, agg_result_t &result)
+  {
+    size_t ngroup = plan.group_types.size();
+    size_t naggs = plan.fns.size();
+    for(uint32_t g = 0; g < table.groups.size(); g++)
+    {
+      const agg_group_t &group = table.groups[g];
+      BYTE* key = group.len ? agg_alloc(result.arena, group.len) : nullptr;
+      if(group.len)
+        memcpy(key, group.key, group.len);
+
+      row_t row;
+      row.reserve(ngroup + naggs);
+      const BYTE* p = key;
+      for(size_t c = 0; c < ngroup; c++)
+      {
+        if(*p++)
+        {
+          row.push_back(Page::val_null());
+          continue;
+        }
+        if(plan.group_types[c] == TBL_TYPE_SHORT)
+        {
+          int16_t s;
+          memcpy(&s, p, sizeof(int16_t));
+          row.push_back(Page::val_short(s));
+          p += sizeof(int16_t);
+        }
+        else if(plan.group_types[c] == TBL_TYPE_INT)
+        {
+          int32_t i;
+          memcpy(&i, p, sizeof(int32_t));
+          row.push_back(Page::val_int(i));
+          p += sizeof(int32_t);
+        }
+        else
+        {
+          uint16_t len;
+          memcpy(&len, p, sizeof(uint16_t));
+          row.push_back(Page::val_str(reinterpret_cast<const char*>(p + sizeof(uint16_t)), len));
+          p += sizeof(uint16_t) + len;
+        }
+      }
+
+      for(size_t a = 0; a < naggs; a++)
+      {
+        const agg_acc_t &acc = table.accs[g * naggs + a];
+        switch(plan.fns[a])
+        {
+          case AGG_COUNT:
+            row.push_back(Page::val_int(acc.count));
+            break;
+          case AGG_SUM:
+            row.push_back(acc.count ? Page::val_double(acc.sum) : Page::val_null());
+            break;
+          case AGG_AVG:
+            row.push_back(acc.count ? Page::val_double(double(acc.sum) / acc.count) : Page::val_null());
+            break;
+          default:
+          {
+            Page::value_t val = acc.ext;
+            if(val.type == Page::RTYPE_STRING && val.str.len > 0)
+            {
+              char* copy = reinterpret_cast<char*>(agg_alloc(result.arena, val.str.len));
+              memcpy(copy, val.str.ptr, val.str.len);
+              val.str.ptr = copy;
+            }
+            row.push_back(val);
+          }
+        }
+      }
+      result.rows.push_back(row);
+    }
+  }
+
+
+  /* Resolve the GROUP BY and aggregated columns, and the projection the scan is opened with */
+  static void agg_plan(file_descriptor_t &dbfile, const std::string &table_name, const std::vector<std::string> &group_cols,
+                       const std::vector<agg_spec_t> &aggs, agg_plan_t &plan, std::vector<std::string> &proj_cols)
+  {
+    table_descriptor_t td;
+    read_table_descriptor(dbfile, table_name, td);
+    std::sort(td.col_types.begin(), td.col_types.end(), [](const column_type_t &a, const column_type_t &b) { return a.ord < b.ord; });
+
+    proj_cols = group_cols;
+    for(const std::string &col : group_cols)
+      plan.group_types.push_back(td.col_types[tbl_col_index(td, col)].type);
+
+    for(const agg_spec_t &spec : aggs)
+    {
+      if(spec.fn > AGG_AVG)
+        throw table_error("Unknown aggregate function on column \"" + spec.col + "\".");
+      plan.fns.push_back(spec.fn);
+      if(spec.col.empty())
+      {
+        if(spec.fn != AGG_COUNT)
+          throw table_error("Only COUNT can be taken over rows rather than a column.");
+        plan.agg_col.push_back(-1);
+        continue;
+      }
+
+      uint16_t type = td.col_types[tbl_col_index(td, spec.col)].type;
+      if((spec.fn == AGG_SUM || spec.fn == AGG_AVG) && type != TBL_TYPE_SHORT && type != TBL_TYPE_INT)
+        throw table_error("Cannot take SUM or AVG of column \"" + spec.col + "\".");
+      plan.agg_col.push_back(proj_cols.size());
+      proj_cols.push_back(spec.col);
+    }
+  }
+
+
+  size_t aggregate(file_descriptor_t &dbfile, const std::string &table_name, const std::vector<scan_pred_t> &preds,
+                   const std::vector<std::string> &group_cols, const std::vector<agg_spec_t> &aggs, agg_result_t &result,
+                   unsigned nthreads, size_t mem_budget)
+  {
+    result.rows.clear();
+    agg_clear(result.arena);
+    if(nthreads == 0)
+      nthreads = std::max(1u, std::thread::hardware_concurrency());
+
+    agg_plan_t plan;
+    std::vector<std::string> proj_cols;
+    agg_plan(dbfile, table_name, group_cols, aggs, plan, proj_cols);
+
+    /* One table and key buffer per worker, so batches are folded in without locking */
+    std::vector<agg_table_t> tables(nthreads);
+    std::vector<std::vector<BYTE>> keys(nthreads, std::vector<BYTE>(64));
+    size_t worker_budget = mem_budget / nthreads;
+    agg_spill_t spill;
+
+    try
+    {
+      pscan_run(dbfile, table_name, preds, proj_cols, nthreads, [&](unsigned worker, const vscan_cursor_t &cur)
+      {
+        agg_add_batch(tables[worker], plan, cur, keys[worker]);
+        if(agg_mem(tables[worker]) > worker_budget)
+          agg_spill(dbfile, tables[worker], plan, spill);
+      });
+
+      if(spill.any)
+      {
+        /* Every partial group is on disk now ; each partition then fits in memory on its own (a partition that is still
+           over budget is merged anyway) */
+        for(agg_table_t &table : tables)
+        {
+          if(!table.groups.empty())
+            agg_spill(dbfile, table, plan, spill);
+        }
+        for(uint16_t part = 0; part < AGG_PARTITIONS; part++)
+        {
+          tmp_read(dbfile, spill.pages[part], [&](const BYTE* rec) { agg_unpack_group(tables[0], rec, plan); });
+          agg_emit(tables[0], plan, result);
+          agg_reset(tables[0]);
+        }
+        agg_free_spill(dbfile, spill);
+      }
+      else
+      {
+        for(unsigned w = 1; w < nthreads; w++)
+        {
+          agg_merge_table(tables[0], tables[w], plan);
+          agg_reset(tables[w]);
+        }
+        agg_emit(tables[0], plan, result);
+      }
+    }
+    catch(...)
+    {
+      agg_free_spill(dbfile, spill);
+      throw;
+    }
+
+    /* Without GROUP BY there is always one row, even for no records */
+    if(group_cols.empty() && result.rows.empty())
+    {
+      agg_table_t empty;
+      agg_find_group(empty, plan.fns.size(), nullptr, 0, agg_hash(nullptr, 0));
+      agg_emit(empty, plan, result);
+    }
+    return result.rows.size();
+  }
+}
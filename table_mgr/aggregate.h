@@ -0,0 +1,94 @@
+/**************************************************************************************************
+* Filename:   aggregate.h
+* Details:    Defines the API for aggregating a table's records in the engine: COUNT, SUM, MIN, MAX
+*             and AVG, over the whole table or per group of GROUP BY values.
+**************************************************************************************************/
+
+/*************************************************************************************************
+  An aggregation runs on top of a parallel scan ("pscan_run()"), so predicates are pushed down and
+  only the grouping and aggregated columns are decoded. Each worker keeps its own partial groups
+  in an open-addressing hash table (linear probing) ; a group's key, its GROUP BY values encoded
+  back-to-back, lives in the worker's arena. The partials are merged once every worker is done.
+
+  Groups are held to a memory budget. A worker that goes over it spills its partial groups to temp
+  pages taken from the page file, split into AGG_PARTITIONS partitions by hash, and starts again
+  with an empty table. If anything was spilled, the rest is spilled as well, and each partition is
+  then merged on its own, so only one partition's groups are in memory at a time. The temp pages
+  go back on the free list at the end.
+*************************************************************************************************/
+
+/********************************************* GUARD *********************************************/
+
+#ifndef AGGREGATE_H
+#define AGGREGATE_H
+
+/***************************************** HEADER FILES ******************************************/
+
+#include "table_scan.h"
+
+#include <memory>
+
+/******************************************* CONSTANTS *******************************************/
+
+namespace Table
+{
+  /* Aggregate functions for <agg_spec_t> */
+  const BYTE AGG_COUNT = 0; // of non-NULL values, or of rows when the column is empty ("COUNT(*)")
+  const BYTE AGG_SUM = 1;
+  const BYTE AGG_MIN = 2;
+  const BYTE AGG_MAX = 3;
+  const BYTE AGG_AVG = 4;
+
+  const size_t AGG_MEM_BUDGET = 64 * 1024 * 1024; // default bytes of groups held in memory, across all workers
+  const uint16_t AGG_PARTITIONS = 16; // spilled groups are split this many ways by hash
+}
+
+/************************************** IMPLEMENT STRUCTURES *************************************/
+
+namespace Table
+{
+  /* Structure for one aggregate: <fn> over the column <col> */
+  struct agg_spec_t
+  {
+    BYTE fn;
+    std::string col; // empty only for AGG_COUNT, to count rows
+  };
+
+  /* Structure that hands out memory from large blocks ; nothing is freed until the arena is cleared */
+  struct agg_arena_t
+  {
+    std::vector<std::unique_ptr<BYTE[]>> blocks;
+    size_t block_size = 0; // bytes in the last block
+    size_t used = 0; // bytes taken from the last block
+    size_t total = 0; // bytes in all of the blocks
+  };
+
+  /* Structure that holds the result of "aggregate()" */
+  struct agg_result_t
+  {
+    std::vector<row_t> rows; // one per group: its GROUP BY values, then one value per aggregate
+    agg_arena_t arena; // the strings in <rows> point in here
+  };
+}
+
+namespace Table
+{
+  /************************************* FUNCTION PROTOTYPES *************************************/
+
+  /* Aggregate the records that match <preds>, per group of <group_cols> values (one group for the whole table when there
+     are none), on <nthreads> scan workers. COUNT comes back as an INT, SUM and AVG as a DOUBLE, MIN and MAX with the
+     column's type ; an aggregate over no values is NULL (COUNT is 0). Groups come back in no particular order. The buffer pool
+     must be able to pin one page per worker, and two more to spill. Throws a <table_error> for an unknown function, or
+     for SUM or AVG over a string column. Returns the number of groups */
+  size_t aggregate(file_descriptor_t &dbfile, const std::string &table_name, const std::vector<scan_pred_t> &preds,
+                   const std::vector<std::string> &group_cols, const std::vector<agg_spec_t> &aggs, agg_result_t &result,
+                   unsigned nthreads = 1, size_t mem_budget = AGG_MEM_BUDGET);
+
+  /* Take <size> bytes from the arena, 8-byte aligned */
+  BYTE* agg_alloc(agg_arena_t &arena, size_t size);
+
+  /* Give back every block of the arena */
+  void agg_clear(agg_arena_t &arena);
+}
+
+#endif // AGGREGATE_H
@@ -0,0 +1,447 @@
+/**************************************************************************************************
+* Filename:   bulk_load.cpp
+* Details:    Bulk loading of a table from a CSV or binary row file. The file is streamed in chunks;
+*             each chunk is split at row boundaries among worker threads, every worker packs its rows
+*             into whole table page images, and the images are written to the table's next pages (the
+*             rest of its last extent, then new extents) directly with "Buffer_mgr::buf_write_run()".
+*             "#master" is updated once at the end. The rows join the thread's transaction, or are one
+*             of their own: they are created under its id before the pages are linked, so a scan that
+*             began earlier never sees them, and an abort only has to restore the pages that link them.
+**************************************************************************************************/
+
+/****************************************** HEADER FILES *****************************************/
+
+#include "table_mgr.h"
+#include "mvcc.h"
+#include "transaction.h"
+#include "../buffer_mgr/buffer_mgr.h"
+#include "../index_mgr/index_mgr.h"
+#include "../lock_mgr/lock_mgr.h"
+#include "../paging/pax_page.h"
+
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+
+/******************************************* CONSTANTS *******************************************/
+
+namespace Table
+{
+  const size_t TBL_BULK_CHUNK = 16 * 1024 * 1024; // bytes of the input file handled per round of workers
+}
+
+/************************************ FUNCTION IMPLEMENTATIONS ***********************************/
+
+namespace Table
+{
+  /* What one worker produces from its slice of a chunk */
+  struct bulk_slice_t
+  {
+    const char* begin;
+    const char* end;
+    std::vector<table_page_t> pages;
+    size_t num_rows;
+    std::exception_ptr error;
+  };
+
+
+  /* Parse a whole signed decimal number from [begin, end) without copying it to a string */
+  static bool bulk_parse_long(const char* begin, const char* end, long &num)
+  {
+    bool neg = false;
+    if(begin < end && (*begin == '-' || *begin == '+'))
+      neg = (*begin++ == '-');
+    if(begin == end || end - begin > 10)
+      return false;
+
+    num = 0;
+    for(; begin < end; begin++)
+    {
+      if(*begin < '0' || *begin > '9')
+        return false;
+      num = num * 10 + (*begin - '0');
+    }
+    if(neg)
+      num = -num;
+    return true;
+  }
+
+
+  static Page::value_t bulk_parse_value(const column_type_t &col, const char* begin, const char* end)
+  {
+    if(begin == end)
+      return Page::val_null();
+    if(col.type == TBL_TYPE_VCHAR)
+      return tbl_check_value(col, Page::val_str(begin, end - begin));
+
+    long num;
+    if(!bulk_parse_long(begin, end, num))
+      throw table_error("Value \"" + std::string(begin, end) + "\" is not a number for column \"" + col.name + "\".");
+    if(col.type == TBL_TYPE_SHORT && num >= INT16_MIN && num <= INT16_MAX)
+      return Page::val_short(num);
+    if(col.type == TBL_TYPE_INT && num >= INT32_MIN && num <= INT32_MAX)
+      return Page::val_int(num);
+    throw table_error("Value \"" + std::string(begin, end) + "\" is out of range for column \"" + col.name + "\".");
+  }
+
+
+  /* Add a packed record to the last page image, starting a new image (laid out for the table) when it does not fit */
+  static void bulk_add_record(const table_descriptor_t &td, std::vector<table_page_t> &pages, const BYTE* rec)
+  {
+    uint16_t size = ((const Page::record_t*)rec)->size;
+    if(td.type == DB_TYPE_PAX)
+    {
+      if(pages.empty() || Page::pax_full(&pages.back()))
+      {
+        pages.emplace_back();
+        tbl_init_pax_page(&pages.back(), td.col_types);
+      }
+      Page::pax_add_record(&pages.back(), rec);
+      return;
+    }
+
+    if(sizeof(uint16_t) + size > Page::PG_INITIAL_BYTES - sizeof(uint16_t)) // would not fit in an empty table page
+      throw table_error("Record is too long to fit in a page.");
+
+    if(pages.empty() || pages.back().free_bytes < sizeof(uint16_t) + size)
+    {
+      pages.emplace_back();
+      tbl_init_page(&pages.back());
+    }
+    Page::pg_add_record((void*)&pages.back(), (void*)rec, size);
+  }
+
+
+  static void bulk_pack_csv(const table_descriptor_t &td, bulk_slice_t &slice)
+  {
+    const std::vector<column_type_t> &cols = td.col_types;
+    Page::rec_builder_t rec; // reused for every row
+    Page::rb_reserve(rec, tbl_max_record_size(cols));
+    const char* line = slice.begin;
+    while(line < slice.end)
+    {
+      const char* eol = std::find(line, slice.end, '\n');
+      const char* stop = (eol > line && eol[-1] == '\r') ? eol - 1 : eol;
+      if(stop == line) // skip blank lines
+      {
+        line = eol + 1;
+        continue;
+      }
+
+      Page::rb_begin(rec);
+      const char* field = line;
+      for(size_t i = 0; i < cols.size(); i++)
+      {
+        if(field > stop)
+          throw table_error("Row has fewer values than the table has columns.");
+        const char* comma = std::find(field, stop, ',');
+        Page::rb_packval(rec, bulk_parse_value(cols[i], field, comma));
+        field = comma + 1;
+      }
+      if(field <= stop)
+        throw table_error("Row has more values than the table has columns.");
+      Page::rb_finish(rec);
+
+      bulk_add_record(td, slice.pages, Page::rb_data(rec));
+      slice.num_rows++;
+      line = eol + 1;
+    }
+  }
+
+
+  static void bulk_pack_binary(const table_descriptor_t &td, bulk_slice_t &slice)
+  {
+    const std::vector<column_type_t> &cols = td.col_types;
+    uint16_t size;
+    for(const char* where = slice.begin; where < slice.end; where += size)
+    {
+      /* Check every field of the record against the table's columns, where it lies in the chunk */
+      size = *(const uint16_t*)where;
+      unsigned short next = sizeof(uint16_t);
+      for(size_t i = 0; i < cols.size(); i++)
+      {
+        if(next >= size)
+          throw table_error("Record has fewer fields than the table has columns.");
+
+        /* The type word and the field's width are checked before it is unpacked, so a corrupt one never reads past the
+           record ; the widths are added in a wider type than <next>, so a long string cannot wrap it */
+        size_t left = size - next;
+        uint16_t type = 0;
+        if(left >= sizeof(uint16_t))
+          memcpy(&type, where + next, sizeof(type));
+        bool known = type == Page::RTYPE_NULL || type == Page::RTYPE_SHORT || type == Page::RTYPE_INT || type == Page::RTYPE_DOUBLE ||
+                     type >= Page::RTYPE_STRING;
+        size_t width = sizeof(uint16_t) + (type >= Page::RTYPE_STRING ? type - Page::RTYPE_STRING : type);
+        if(left < sizeof(uint16_t) || !known || width > left)
+          throw table_error("Record field does not match column \"" + cols[i].name + "\".");
+
+        Page::value_t val = Page::rec_upackval((void*)where, next);
+        if(tbl_check_value(cols[i], val).type != val.type)
+          throw table_error("Record field does not match column \"" + cols[i].name + "\".");
+      }
+      if(next != size)
+        throw table_error("Record has more fields than the table has columns.");
+
+      bulk_add_record(td, slice.pages, (const BYTE*)where);
+      slice.num_rows++;
+    }
+  }
+
+
+  /* Length of the longest prefix of [begin, end) that holds only whole rows */
+  static size_t bulk_whole_rows(const char* begin, const char* end, BYTE format, bool at_eof)
+  {
+    if(format == TBL_BULK_CSV)
+    {
+      if(at_eof)
+        return end - begin;
+      const char* last = end;
+      while(last > begin && last[-1] != '\n')
+        last--;
+      return last - begin;
+    }
+
+    const char* where = begin;
+    while(end - where >= (long)sizeof(uint16_t))
+    {
+      uint16_t size = *(const uint16_t*)where;
+      if(size < sizeof(uint16_t))
+        throw table_error("Corrupt record size in bulk load file.");
+      if(end - where < size)
+        break;
+      where += size;
+    }
+    if(at_eof && where != end)
+      throw table_error("Bulk load file ends in the middle of a record.");
+    return where - begin;
+  }
+
+
+  /* Split [begin, end) into at most <n> slices that each hold whole rows */
+  static void bulk_split(const char* begin, const char* end, BYTE format, unsigned n, std::vector<bulk_slice_t> &slices)
+  {
+    slices.clear();
+    size_t target = (end - begin) / n + 1;
+    while(begin < end)
+    {
+      const char* cut = begin + std::min<size_t>(target, end - begin);
+      if(format == TBL_BULK_CSV)
+      {
+        cut = std::find(cut, end, '\n');
+        cut = (cut == end) ? end : cut + 1;
+      }
+      else
+      {
+        const char* where = begin;
+        while(where < cut)
+          where += *(const uint16_t*)where;
+        cut = where;
+      }
+
+      bulk_slice_t slice;
+      slice.begin = begin;
+      slice.end = cut;
+      slice.num_rows = 0;
+      slices.push_back(std::move(slice));
+      begin = cut;
+    }
+  }
+
+
+  /* The rows of a load, as one transaction ("bulk_load()" does the work) */
+  static size_t bulk_load_rows(file_descriptor_t &dbfile, const std::string &table_name, std::ifstream &inf, BYTE format,
+                               unsigned nthreads, txn_id_t xid);
+
+
+  size_t bulk_load(file_descriptor_t &dbfile, const std::string &table_name, const char fname[], BYTE format, unsigned nthreads)
+  {
+    if(format != TBL_BULK_CSV && format != TBL_BULK_BINARY)
+      throw table_error("Unknown bulk load format.");
+    if(nthreads == 0)
+      nthreads = std::max(1u, std::thread::hardware_concurrency());
+
+    std::ifstream inf(fname, std::ios::in | std::ios::binary);
+    if(!inf)
+      throw table_error("Cannot open bulk load file.");
+
+    txn_scope_t scope(dbfile);
+    return bulk_load_rows(dbfile, table_name, inf, format, nthreads, scope.txn->xid);
+  }
+
+
+  static size_t bulk_load_rows(file_descriptor_t &dbfile, const std::string &table_name, std::ifstream &inf, BYTE format,
+                               unsigned nthreads, txn_id_t xid)
+  {
+    /* A load adds too many rows to lock one by one: it takes the whole table, and reads where the table ends once it has it */
+    table_descriptor_t td;
+    {
+      table_descriptor_t before;
+      read_table_descriptor(dbfile, table_name, before);
+      Lock_mgr::lock_table(xid, before.lock_id, Lock_mgr::LOCK_X);
+    }
+    read_table_descriptor(dbfile, table_name, td);
+    std::vector<column_type_t> &cols = td.col_types;
+    std::sort(cols.begin(), cols.end(), [](const column_type_t &a, const column_type_t &b) { return a.ord < b.ord; });
+    std::vector<index_def_t> indexes;
+    Index::find_indexes(dbfile, table_name, indexes);
+
+    /* The last page written is held back until the page that follows it is known */
+    table_page_t pending;
+    uint16_t pending_id = 0;
+    uint16_t first_new = 0;
+    size_t total_rows = 0;
+    pg_locations_t loc = td; // where the load has got to ; "#master" still has <td>
+
+    std::vector<char> chunk;
+    size_t carry = 0; // bytes of a partial row left over from the previous chunk
+    std::vector<bulk_slice_t> slices;
+    std::vector<std::thread> workers;
+    std::vector<uint16_t> page_ids;
+    bool at_eof = false;
+    while(!at_eof)
+    {
+      /* Read the next chunk after whatever partial row is left over */
+      chunk.resize(carry + TBL_BULK_CHUNK);
+      inf.read(chunk.data() + carry, TBL_BULK_CHUNK);
+      size_t len = carry + inf.gcount();
+      at_eof = inf.eof();
+      size_t whole = bulk_whole_rows(chunk.data(), chunk.data() + len, format, at_eof);
+      if(whole == 0 && !at_eof)
+      {
+        carry = len; // no complete row yet, read more
+        continue;
+      }
+
+      /* Pack the slices in parallel */
+      bulk_split(chunk.data(), chunk.data() + whole, format, nthreads, slices);
+      workers.clear();
+      for(size_t i = 0; i < slices.size(); i++)
+      {
+        workers.emplace_back([&td, &slices, format, i]() {
+          try
+          {
+            if(format == TBL_BULK_CSV)
+              bulk_pack_csv(td, slices[i]);
+            else
+              bulk_pack_binary(td, slices[i]);
+          }
+          catch(...)
+          {
+            slices[i].error = std::current_exception();
+          }
+        });
+      }
+      for(std::thread &w : workers)
+        w.join();
+
+      size_t num_pages = 0;
+      for(bulk_slice_t &slice : slices)
+      {
+        if(slice.error)
+          std::rethrow_exception(slice.error);
+        num_pages += slice.pages.size();
+        total_rows += slice.num_rows;
+      }
+
+      /* Keep any partial row for the next chunk */
+      carry = len - whole;
+      memmove(chunk.data(), chunk.data() + whole, carry);
+      if(num_pages == 0)
+        continue;
+
+      /* Gather the images in chain order, link them, and write each run of consecutive ids at once */
+      tbl_take_pages(dbfile, loc, num_pages, page_ids);
+      std::vector<table_page_t> images;
+      images.reserve(num_pages);
+      for(bulk_slice_t &slice : slices)
+      {
+        images.insert(images.end(), slice.pages.begin(), slice.pages.end());
+        std::vector<table_page_t>().swap(slice.pages);
+      }
+
+      if(pending_id != 0)
+      {
+        pending.next_page = page_ids[0];
+        Buffer_mgr::buf_write_run(dbfile, pending_id, 1, &pending);
+      }
+      else
+        first_new = page_ids[0];
+
+      for(size_t i = 0; i < num_pages; i++)
+      {
+        uint16_t num_recs = Page::pax_is_pax(&images[i]) ? reinterpret_cast<Page::pax_header_t*>(&images[i])->num_rows
+                                                         : *PG_NUM_RECORDS_PTR(&images[i]);
+        mvcc_created(xid, {page_ids[i], 0}, num_recs);
+      }
+      for(size_t i = 0; i + 1 < num_pages; i++)
+        images[i].next_page = page_ids[i + 1];
+      pending = images[num_pages - 1];
+      pending_id = page_ids[num_pages - 1];
+
+      for(size_t i = 0; i + 1 < num_pages; )
+      {
+        size_t run = i + 1;
+        while(run + 1 < num_pages && page_ids[run] == page_ids[run - 1] + 1)
+          run++;
+        Buffer_mgr::buf_write_run(dbfile, page_ids[i], run - i, &images[i]);
+        i = run;
+      }
+
+      /* Index the loaded records straight from the images (rows of a PAX image are put back together first) */
+      std::string pax_rec;
+      for(index_def_t &idx : indexes)
+      {
+        for(size_t i = 0; i < num_pages; i++)
+        {
+          uint16_t next = 0;
+          uint16_t rec_id = 0;
+          RID rid;
+          rid.page_id = page_ids[i];
+          if(td.type == DB_TYPE_PAX)
+          {
+            for(rid.rec_id = 0; Page::pax_get_record(&images[i], rid.rec_id, pax_rec); rid.rec_id++)
+              Index::idx_insert_record(dbfile, idx, (const BYTE*)pax_rec.data(), rid);
+            continue;
+          }
+          for(BYTE* rec; (rec = Page::next_record(&images[i], next)) != nullptr; rec_id = next)
+          {
+            rid.rec_id = rec_id;
+            Index::idx_insert_record(dbfile, idx, rec, rid);
+          }
+        }
+      }
+    }
+
+    if(pending_id == 0)
+      return 0;
+
+    /* The last page of the load ends the table's chain */
+    pending.next_page = 0;
+    Buffer_mgr::buf_write_run(dbfile, pending_id, 1, &pending);
+
+    /* Link the loaded pages after the table's current last page, then update "#master" once */
+    if(td.last_page != 0)
+    {
+      txn_touch(dbfile, td.last_page);
+      table_page_t* old_last = static_cast<table_page_t*>(Buffer_mgr::buf_pin(dbfile, td.last_page));
+      {
+        std::unique_lock<std::shared_mutex> latch(Buffer_mgr::buf_latch(td.last_page));
+        old_last->next_page = first_new;
+      }
+      Buffer_mgr::buf_write(dbfile, td.last_page);
+      Buffer_mgr::buf_unpin(td.last_page);
+    }
+
+    RID rid;
+    master_table_row_t mtr = master_lookup(dbfile, table_name, rid);
+    mtr.first_page = loc.first_page;
+    mtr.last_page = pending_id;
+    mtr.extent_page = loc.extent_page;
+    write_updated_master_row(dbfile, mtr, rid);
+
+    return total_rows;
+  }
+}
@@ -0,0 +1,415 @@
+/**************************************************************************************************
+* Filename:   external_sort.cpp
+* Details:    Implements the external merge sort declared in "external_sort.h".
+**************************************************************************************************/
+
+/****************************************** HEADER FILES *****************************************/
+
+#include "external_sort.h"
+#include "temp_pages.h"
+#include "../buffer_mgr/buffer_mgr.h"
+
+#include <algorithm>
+#include <memory>
+
+/************************************ FUNCTION IMPLEMENTATIONS ***********************************/
+
+namespace Table
+{
+  const uint16_t SORT_HEADER = 2 * sizeof(uint16_t); // |size|key_len| in front of each record
+
+
+  static uint16_t sort_rec_size(const BYTE* rec)
+  {
+    return reinterpret_cast<const Page::record_t*>(rec)->size;
+  }
+
+
+  static uint16_t sort_key_len(const BYTE* rec)
+  {
+    uint16_t len;
+    memcpy(&len, rec + sizeof(uint16_t), sizeof(uint16_t));
+    return len;
+  }
+
+
+  /* Compare the keys of two records: bytes first, then length */
+  static int sort_cmp(const BYTE* a, const BYTE* b)
+  {
+    uint16_t la = sort_key_len(a), lb = sort_key_len(b);
+    int cmp = memcmp(a + SORT_HEADER, b + SORT_HEADER, std::min(la, lb));
+    return cmp != 0 ? cmp : (la > lb) - (la < lb);
+  }
+
+
+  /* Bytes the records in memory take, checked against the budget */
+  static size_t sort_mem(const sorter_t &sorter)
+  {
+    return sorter.data.size() + sorter.offsets.size() * sizeof(size_t);
+  }
+
+
+  static void sort_in_memory(sorter_t &sorter)
+  {
+    const BYTE* data = sorter.data.data();
+    std::sort(sorter.offsets.begin(), sorter.offsets.end(), [data](size_t a, size_t b) { return sort_cmp(data + a, data + b) < 0; });
+  }
+
+
+  /* Sort the records in memory and write them out as a new run */
+  static void sort_write_run(sorter_t &sorter)
+  {
+    sort_in_memory(sorter);
+    sorter.runs.emplace_back();
+    for(size_t off : sorter.offsets)
+      tmp_add_record(*sorter.dbfile, sorter.runs.back(), sorter.data.data() + off);
+    sorter.data.clear();
+    sorter.offsets.clear();
+  }
+
+
+  /***************************************** MERGING *******************************************/
+
+  /* Front record of a reader, or null once its run is used up */
+  static const BYTE* sort_front(const sort_reader_t &reader)
+  {
+    return reader.pos < reader.offsets.size() ? reader.buf.data() + reader.offsets[reader.pos] : nullptr;
+  }
+
+
+  /* Refill a reader whose buffer is used up with the records of its next SORT_READ_AHEAD pages. The pages are read in as
+     runs of consecutive ids, and copied off so no page of the run stays pinned between calls */
+  static void sort_fill(file_descriptor_t &dbfile, sort_reader_t &reader)
+  {
+    reader.buf.clear();
+    reader.offsets.clear();
+    reader.pos = 0;
+    size_t end = std::min(reader.pages.size(), reader.next_page + SORT_READ_AHEAD);
+    for(size_t p = reader.next_page; p < end; )
+    {
+      size_t q = p + 1;
+      while(q < end && reader.pages[q] == reader.pages[q - 1] + 1)
+        q++;
+      Buffer_mgr::buf_prefetch(dbfile, reader.pages[p], q - p);
+      p = q;
+    }
+
+    std::vector<uint16_t> pages(reader.pages.begin() + reader.next_page, reader.pages.begin() + end);
+    tmp_read(dbfile, pages, [&reader](const BYTE* rec) {
+      reader.offsets.push_back(reader.buf.size());
+      reader.buf.insert(reader.buf.end(), rec, rec + sort_rec_size(rec));
+    });
+    reader.next_page = end;
+  }
+
+
+  /* True if reader <a> goes before reader <b>: a used-up run goes last, and equal keys go by reader */
+  static bool sort_before(const sorter_t &sorter, uint32_t a, uint32_t b)
+  {
+    const BYTE* ra = sort_front(sorter.readers[a]);
+    const BYTE* rb = sort_front(sorter.readers[b]);
+    if(ra == nullptr || rb == nullptr)
+      return rb == nullptr && (ra != nullptr || a < b);
+    int cmp = sort_cmp(ra, rb);
+    return cmp != 0 ? cmp < 0 : a < b;
+  }
+
+
+  /* Set up readers and the loser tree over <runs>. Leaf <i> of the tree is reader <i>, at position k + i of an implicit
+     complete tree whose internal node <n> has children 2n and 2n + 1 */
+  static void sort_start_merge(sorter_t &sorter, std::vector<std::vector<uint16_t>> &runs)
+  {
+    size_t k = runs.size();
+    sorter.readers.assign(k, sort_reader_t());
+    for(size_t i = 0; i < k; i++)
+    {
+      sorter.readers[i].pages.swap(runs[i]);
+      sorter.readers[i].next_page = 0;
+      sort_fill(*sorter.dbfile, sorter.readers[i]);
+    }
+
+    std::vector<uint32_t> winners(2 * k);
+    sorter.losers.assign(k, 0);
+    for(size_t i = 0; i < k; i++)
+      winners[k + i] = i;
+    for(size_t n = k - 1; n >= 1; n--)
+    {
+      uint32_t a = winners[2 * n], b = winners[2 * n + 1];
+      bool a_first = sort_before(sorter, a, b);
+      winners[n] = a_first ? a : b;
+      sorter.losers[n] = a_first ? b : a;
+    }
+    sorter.winner = k > 1 ? winners[1] : 0;
+  }
+
+
+  /* Move the winning reader past its front record, then replay its path to the root */
+  static void sort_advance(sorter_t &sorter)
+  {
+    uint32_t w = sorter.winner;
+    sort_reader_t &reader = sorter.readers[w];
+    if(++reader.pos == reader.offsets.size() && reader.next_page < reader.pages.size())
+      sort_fill(*sorter.dbfile, reader);
+
+    size_t k = sorter.readers.size();
+    for(size_t n = (k + w) / 2; n >= 1; n /= 2)
+    {
+      if(sort_before(sorter, sorter.losers[n], w))
+        std::swap(sorter.losers[n], w);
+    }
+    sorter.winner = w;
+  }
+
+
+  /* Drop the readers and free the pages of the runs they were merging */
+  static void sort_end_merge(sorter_t &sorter)
+  {
+    for(sort_reader_t &reader : sorter.readers)
+      tmp_free(*sorter.dbfile, reader.pages);
+    sorter.readers.clear();
+    sorter.losers.clear();
+  }
+
+
+  /* Merge groups of runs into longer runs until there are few enough to merge with one reader buffer each in the budget */
+  static void sort_reduce_runs(sorter_t &sorter)
+  {
+    size_t fan_in = std::max<size_t>(2, sorter.mem_budget / (SORT_READ_AHEAD * PAGE_SIZE));
+    while(sorter.runs.size() > fan_in)
+    {
+      std::vector<std::vector<uint16_t>> group(sorter.runs.begin(), sorter.runs.begin() + fan_in);
+      sorter.runs.erase(sorter.runs.begin(), sorter.runs.begin() + fan_in);
+      sort_start_merge(sorter, group);
+
+      std::vector<uint16_t> merged;
+      while(const BYTE* rec = sort_front(sorter.readers[sorter.winner]))
+      {
+        tmp_add_record(*sorter.dbfile, merged, rec);
+        sort_advance(sorter);
+      }
+      sort_end_merge(sorter);
+      sorter.runs.push_back(merged); // last, so every run gets merged once before any is merged again
+    }
+  }
+
+
+  /****************************************** SORTER *******************************************/
+
+  void sort_open(file_descriptor_t &dbfile, sorter_t &sorter, size_t mem_budget)
+  {
+    sorter.dbfile = &dbfile;
+    sorter.mem_budget = mem_budget;
+    sorter.data.clear();
+    sorter.offsets.clear();
+    sorter.runs.clear();
+    sorter.readers.clear();
+    sorter.losers.clear();
+    sorter.winner = 0;
+    sorter.next_mem = 0;
+    sorter.merging = false;
+    sorter.started = false;
+  }
+
+
+  void sort_add(sorter_t &sorter, const BYTE* key, uint16_t key_len, const BYTE* payload, uint16_t payload_len)
+  {
+    size_t size = SORT_HEADER + key_len + payload_len;
+    if(sizeof(uint16_t) + size > Page::PG_INITIAL_BYTES - sizeof(uint16_t))
+      throw table_error("A record is too large to sort.");
+
+    if(!sorter.offsets.empty() && sort_mem(sorter) + size + sizeof(size_t) > sorter.mem_budget)
+      sort_write_run(sorter);
+
+    uint16_t header[2] = {static_cast<uint16_t>(size), key_len};
+    sorter.offsets.push_back(sorter.data.size());
+    const BYTE* head = reinterpret_cast<const BYTE*>(header);
+    sorter.data.insert(sorter.data.end(), head, head + SORT_HEADER);
+    sorter.data.insert(sorter.data.end(), key, key + key_len);
+    sorter.data.insert(sorter.data.end(), payload, payload + payload_len);
+  }
+
+
+  void sort_finish(sorter_t &sorter)
+  {
+    sorter.merging = true;
+    sorter.started = false;
+    if(sorter.runs.empty())
+    {
+      sort_in_memory(sorter);
+      sorter.next_mem = 0;
+      return;
+    }
+
+    if(!sorter.offsets.empty())
+      sort_write_run(sorter);
+    std::vector<BYTE>().swap(sorter.data); // the readers' buffers take its place
+    std::vector<size_t>().swap(sorter.offsets);
+    sort_reduce_runs(sorter);
+    sort_start_merge(sorter, sorter.runs);
+    sorter.runs.clear();
+  }
+
+
+  bool sort_next(sorter_t &sorter, const BYTE* &key, uint16_t &key_len, const BYTE* &payload, uint16_t &payload_len)
+  {
+    if(!sorter.merging)
+      throw table_error("The sort is not finished.");
+
+    const BYTE* rec;
+    if(sorter.readers.empty())
+    {
+      if(sorter.started)
+        sorter.next_mem++;
+      rec = sorter.next_mem < sorter.offsets.size() ? sorter.data.data() + sorter.offsets[sorter.next_mem] : nullptr;
+    }
+    else
+    {
+      if(sorter.started)
+        sort_advance(sorter);
+      rec = sort_front(sorter.readers[sorter.winner]);
+    }
+    sorter.started = true;
+    if(rec == nullptr)
+      return false;
+
+    key_len = sort_key_len(rec);
+    key = rec + SORT_HEADER;
+    payload = key + key_len;
+    payload_len = sort_rec_size(rec) - SORT_HEADER - key_len;
+    return true;
+  }
+
+
+  void sort_close(sorter_t &sorter)
+  {
+    sort_end_merge(sorter);
+    for(std::vector<uint16_t> &run : sorter.runs)
+      tmp_free(*sorter.dbfile, run);
+    sort_open(*sorter.dbfile, sorter, sorter.mem_budget);
+    std::vector<BYTE>().swap(sorter.data);
+    std::vector<size_t>().swap(sorter.offsets);
+  }
+
+
+  void sort_norm_key(std::string &key, const Page::value_t &val, bool desc)
+  {
+    size_t start = key.size();
+    if(val.type == Page::RTYPE_NULL)
+      key.push_back(0);
+    else if(val.type == Page::RTYPE_SHORT)
+    {
+      uint16_t u = static_cast<uint16_t>(val.s) ^ 0x8000;
+      key.push_back(1);
+      key.push_back(u >> 8);
+      key.push_back(u & 0xff);
+    }
+    else if(val.type == Page::RTYPE_INT)
+    {
+      uint32_t u = static_cast<uint32_t>(val.i) ^ 0x80000000u;
+      key.push_back(1);
+      for(int shift = 24; shift >= 0; shift -= 8)
+        key.push_back((u >> shift) & 0xff);
+    }
+    else if(val.type == Page::RTYPE_STRING)
+    {
+      key.push_back(1);
+      for(uint16_t i = 0; i < val.str.len; i++)
+      {
+        key.push_back(val.str.ptr[i]);
+        if(val.str.ptr[i] == 0)
+          key.push_back(1);
+      }
+      key.push_back(0);
+      key.push_back(0);
+    }
+    else
+      throw table_error("Cannot sort on a value of this type.");
+
+    if(desc)
+    {
+      for(size_t i = start; i < key.size(); i++)
+        key[i] = ~key[i];
+    }
+  }
+
+
+  /***************************************** ORDER BY ******************************************/
+
+  void order_open(file_descriptor_t &dbfile, const std::string &table_name, const std::vector<scan_pred_t> &preds,
+                  const std::vector<order_key_t> &order_by, const std::vector<std::string> &proj_cols, order_cursor_t &cur,
+                  size_t mem_budget)
+  {
+    /* Scan the ORDER BY columns, then the projected ones (every column when there are none, as for "scan_open()") */
+    std::vector<std::string> cols;
+    for(const order_key_t &key : order_by)
+      cols.push_back(key.col);
+    if(proj_cols.empty())
+    {
+      table_descriptor_t td;
+      read_table_descriptor(dbfile, table_name, td);
+      std::sort(td.col_types.begin(), td.col_types.end(), [](const column_type_t &a, const column_type_t &b) { return a.ord < b.ord; });
+      for(const column_type_t &col : td.col_types)
+        cols.push_back(col.name);
+    }
+    else
+      cols.insert(cols.end(), proj_cols.begin(), proj_cols.end());
+
+    vscan_cursor_t* vcur = new vscan_cursor_t; // a batch is too large for the stack
+    std::unique_ptr<vscan_cursor_t> cleanup(vcur);
+    vscan_open(dbfile, table_name, preds, cols, *vcur);
+    sort_open(dbfile, cur.sorter, mem_budget);
+
+    std::string key, payload;
+    try
+    {
+      while(vscan_next(*vcur))
+      {
+        for(uint16_t i = 0; i < vcur->num_sel; i++)
+        {
+          uint16_t r = vcur->sel[i];
+          key.clear();
+          for(uint16_t k = 0; k < order_by.size(); k++)
+            sort_norm_key(key, vscan_value(*vcur, k, r), order_by[k].desc);
+          payload.clear();
+          for(uint16_t p = order_by.size(); p < cols.size(); p++)
+            Page::rec_packval(payload, vscan_value(*vcur, p, r));
+          if(key.size() > UINT16_MAX || payload.size() > UINT16_MAX)
+            throw table_error("A row is too large to sort.");
+          sort_add(cur.sorter, reinterpret_cast<const BYTE*>(key.data()), key.size(), reinterpret_cast<const BYTE*>(payload.data()),
+                   payload.size());
+        }
+      }
+      sort_finish(cur.sorter);
+    }
+    catch(...)
+    {
+      vscan_close(*vcur);
+      sort_close(cur.sorter);
+      throw;
+    }
+  }
+
+
+  bool order_next(order_cursor_t &cur, row_t &row)
+  {
+    const BYTE* key;
+    const BYTE* payload;
+    uint16_t key_len, payload_len;
+    if(!sort_next(cur.sorter, key, key_len, payload, payload_len))
+    {
+      sort_close(cur.sorter);
+      return false;
+    }
+
+    row.clear();
+    for(unsigned short next = 0; next < payload_len; )
+      row.push_back(Page::rec_upackval(const_cast<BYTE*>(payload), next));
+    return true;
+  }
+
+
+  void order_close(order_cursor_t &cur)
+  {
+    sort_close(cur.sorter);
+  }
+}
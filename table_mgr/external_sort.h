@@ -0,0 +1,125 @@
+/**************************************************************************************************
+* Filename:   external_sort.h
+* Details:    Defines the API for sorting more records than fit in memory, and the ORDER BY cursor
+*             built on it.
+**************************************************************************************************/
+
+/*************************************************************************************************
+  A sorter takes records of |normalized key|payload|. A normalized key is built so that comparing
+  two keys is a "memcmp()" of their bytes (the shorter key first when one is a prefix of the
+  other), whatever the column types and directions in it ; see "sort_norm_key()".
+
+  Records are gathered in memory up to the memory budget, then sorted and written out as a run
+  of temp pages (see "temp_pages.h"), and so on. Once every record is in, a loser tree merges the
+  runs: each run is read SORT_READ_AHEAD pages at a time into a buffer of its own, and the tree
+  finds the next record in log2(runs) key comparisons. When there are more runs than the budget
+  has buffers for, groups of runs are merged into longer runs first. A sort that never went over
+  budget is just sorted in memory.
+
+  A record (with its key) must fit in a page. Records with equal keys come back in no particular
+  order.
+
+  The ORDER BY cursor ("order_*") sorts the rows of a scan this way: the key is made of the ORDER
+  BY columns, and the payload is the packed projected columns.
+*************************************************************************************************/
+
+/********************************************* GUARD *********************************************/
+
+#ifndef EXTERNAL_SORT_H
+#define EXTERNAL_SORT_H
+
+/***************************************** HEADER FILES ******************************************/
+
+#include "table_scan.h"
+
+/******************************************* CONSTANTS *******************************************/
+
+namespace Table
+{
+  const size_t SORT_MEM_BUDGET = 64 * 1024 * 1024; // default bytes of records held in memory
+  const uint16_t SORT_READ_AHEAD = 4; // pages each run reads at a time during a merge
+}
+
+/************************************** IMPLEMENT STRUCTURES *************************************/
+
+namespace Table
+{
+  /* Structure for the part of a run being merged: its pages, and the records of the last pages read */
+  struct sort_reader_t
+  {
+    std::vector<uint16_t> pages;
+    size_t next_page; // the next page of <pages> to read
+    std::vector<BYTE> buf; // records copied off the pages, back to back
+    std::vector<size_t> offsets; // where each record of <buf> starts
+    size_t pos; // the record of <offsets> at the front of the run (== offsets.size() when the buffer is used up)
+  };
+
+  /* Structure that holds the state of a sort */
+  struct sorter_t
+  {
+    file_descriptor_t* dbfile;
+    size_t mem_budget;
+    std::vector<BYTE> data; // records in memory: |size|key_len|key|payload|, back to back
+    std::vector<size_t> offsets; // where each record of <data> starts, sorted once the run is complete
+    std::vector<std::vector<uint16_t>> runs; // temp pages of each run written out
+    std::vector<sort_reader_t> readers; // one per run being merged
+    std::vector<uint32_t> losers; // the loser tree over <readers>: node <n> holds the reader that lost there
+    uint32_t winner; // reader at the front of the merge
+    size_t next_mem; // the next record of <offsets>, when no run was written out
+    bool merging; // "sort_finish()" was called
+    bool started; // "sort_next()" has returned a record, which the next call moves past
+  };
+
+  /* Structure for one ORDER BY column */
+  struct order_key_t
+  {
+    std::string col;
+    bool desc;
+  };
+
+  /* Structure that holds the state of an open ORDER BY cursor */
+  struct order_cursor_t
+  {
+    sorter_t sorter;
+  };
+}
+
+namespace Table
+{
+  /************************************* FUNCTION PROTOTYPES *************************************/
+
+  /* Start an empty sort */
+  void sort_open(file_descriptor_t &dbfile, sorter_t &sorter, size_t mem_budget = SORT_MEM_BUDGET);
+
+  /* Add a record ; throws a <table_error> if it is larger than a page */
+  void sort_add(sorter_t &sorter, const BYTE* key, uint16_t key_len, const BYTE* payload, uint16_t payload_len);
+
+  /* No more records: sort what is in memory, and start the merge if runs were written out */
+  void sort_finish(sorter_t &sorter);
+
+  /* The next record in key order ; the pointers stay valid until the next call. Returns false at the end */
+  bool sort_next(sorter_t &sorter, const BYTE* &key, uint16_t &key_len, const BYTE* &payload, uint16_t &payload_len);
+
+  /* Give back the sort's memory and temp pages ; the sorter can be opened again */
+  void sort_close(sorter_t &sorter);
+
+  /* Append the normalized form of <val> to <key>: a byte that puts NULLs first, then a SHORT or INT as big-endian with the
+     sign bit flipped, or the bytes of a string with 0x00 written as 0x00 0x01 and a 0x00 0x00 at the end. Every byte of it
+     is inverted when <desc> is set */
+  void sort_norm_key(std::string &key, const Page::value_t &val, bool desc = false);
+
+  /* Sort the records of the table that match <preds> by <order_by>, and position the cursor before the first one ; an empty
+     <proj_cols> projects every column */
+  void order_open(file_descriptor_t &dbfile, const std::string &table_name, const std::vector<scan_pred_t> &preds,
+                  const std::vector<order_key_t> &order_by, const std::vector<std::string> &proj_cols, order_cursor_t &cur,
+                  size_t mem_budget = SORT_MEM_BUDGET);
+
+  /* Unpack the projected columns of the next row in order into <row> ; strings are valid until the next call. Returns false
+     (and closes the cursor) when there are no more rows */
+  bool order_next(order_cursor_t &cur, row_t &row);
+
+  /* Close the cursor, if it was not run to the end */
+  void order_close(order_cursor_t &cur);
+}
+
+#endif // EXTERNAL_SORT_H
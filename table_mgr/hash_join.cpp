@@ -0,0 +1,367 @@
+/**************************************************************************************************
+* Filename:   hash_join.cpp
+* Details:    Implements the hash join declared in "hash_join.h".
+**************************************************************************************************/
+
+/****************************************** HEADER FILES *****************************************/
+
+#include "hash_join.h"
+#include "temp_pages.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+/************************************** IMPLEMENT STRUCTURES *************************************/
+
+namespace Table
+{
+  /* Structure for one worker's rows and scratch space ; padded so workers do not share cache lines */
+  struct alignas(64) join_worker_t
+  {
+    std::vector<BYTE> data; // packed rows, back to back
+    std::vector<size_t> offsets; // where each row starts in <data>
+    std::vector<uint64_t> hashes; // of each row's key
+    std::string rec;
+    row_t build_row;
+    row_t probe_row;
+    size_t matches = 0;
+  };
+
+  /* Structure for the build rows in memory: chains of rows per bucket, linked by position */
+  struct join_table_t
+  {
+    std::vector<uint32_t> heads; // first row + 1 of each bucket's chain, 0 for none ; the size is a power of 2
+    std::vector<uint32_t> next; // next row + 1 in the same chain
+    std::vector<const BYTE*> recs;
+    std::vector<uint64_t> hashes;
+  };
+
+  /* Structure for the rows written to temp pages, shared by the workers */
+  struct join_spill_t
+  {
+    std::mutex mutex;
+    std::vector<uint16_t> pages[2][JOIN_PARTITIONS]; // build rows, then probe rows, of each partition
+  };
+}
+
+/************************************ FUNCTION IMPLEMENTATIONS ***********************************/
+
+namespace Table
+{
+  const BYTE JOIN_BUILD = 0;
+  const BYTE JOIN_PROBE = 1;
+
+
+  /* Hash of a non-NULL key: numbers as an int32, so SHORT and INT keys hash alike, and strings by their bytes ; mixed
+     so that both the low bits (buckets) and the high bits (partitions) are good */
+  static uint64_t join_hash(const Page::value_t &key)
+  {
+    uint64_t h = 14695981039346656037ULL;
+    if(key.type == Page::RTYPE_STRING)
+    {
+      for(uint16_t i = 0; i < key.str.len; i++)
+        h = (h ^ static_cast<BYTE>(key.str.ptr[i])) * 1099511628211ULL;
+    }
+    else
+      h = (h ^ static_cast<uint32_t>(key.type == Page::RTYPE_SHORT ? key.s : key.i)) * 1099511628211ULL;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+  }
+
+
+  static bool join_key_eq(const Page::value_t &a, const Page::value_t &b)
+  {
+    if(a.type == Page::RTYPE_STRING)
+      return a.str.len == b.str.len && memcmp(a.str.ptr, b.str.ptr, a.str.len) == 0;
+    return (a.type == Page::RTYPE_SHORT ? a.s : a.i) == (b.type == Page::RTYPE_SHORT ? b.s : b.i);
+  }
+
+
+  /* The key of a packed row */
+  static Page::value_t join_rec_key(const BYTE* rec)
+  {
+    unsigned short next = sizeof(uint16_t);
+    return Page::rec_upackval(const_cast<BYTE*>(rec), next);
+  }
+
+
+  /* Unpack the columns of a packed row, after its key */
+  static void join_rec_row(const BYTE* rec, row_t &row)
+  {
+    Page::rec_upackrow(const_cast<BYTE*>(rec), row);
+    row.erase(row.begin());
+  }
+
+
+  /* Pack each selected row of a batch whose key is not NULL into a worker's rows ; projected column 0 is the key */
+  static void join_add_batch(join_worker_t &w, const vscan_cursor_t &cur, size_t nproj)
+  {
+    for(uint16_t i = 0; i < cur.num_sel; i++)
+    {
+      uint16_t r = cur.sel[i];
+      Page::value_t key = vscan_value(cur, 0, r);
+      if(key.type == Page::RTYPE_NULL)
+        continue;
+      Page::rec_begin(w.rec);
+      for(uint16_t p = 0; p <= nproj; p++)
+        Page::rec_packval(w.rec, vscan_value(cur, p, r));
+      if(w.rec.size() > Page::PG_INITIAL_BYTES - 2 * sizeof(uint16_t))
+        throw table_error("A row is too large to join.");
+      Page::rec_finish(w.rec);
+
+      w.offsets.push_back(w.data.size());
+      w.hashes.push_back(join_hash(key));
+      w.data.insert(w.data.end(), w.rec.begin(), w.rec.end());
+    }
+  }
+
+
+  /* Move a worker's rows to the temp pages of their partitions */
+  static void join_flush(file_descriptor_t &dbfile, join_worker_t &w, BYTE side, join_spill_t &spill)
+  {
+    std::lock_guard<std::mutex> guard(spill.mutex);
+    for(size_t i = 0; i < w.offsets.size(); i++)
+      tmp_add_record(dbfile, spill.pages[side][w.hashes[i] >> (64 - JOIN_PARTITION_BITS)], w.data.data() + w.offsets[i]);
+    w.data.clear();
+    w.offsets.clear();
+    w.hashes.clear();
+  }
+
+
+  /* Drop the temp pages of both inputs */
+  static void join_free_spill(file_descriptor_t &dbfile, join_spill_t &spill)
+  {
+    for(uint16_t part = 0; part < JOIN_PARTITIONS; part++)
+    {
+      tmp_free(dbfile, spill.pages[JOIN_BUILD][part]);
+      tmp_free(dbfile, spill.pages[JOIN_PROBE][part]);
+    }
+  }
+
+
+  /* Chain the rows of <workers> into <table> ; the rows stay where they are */
+  static void join_build(join_table_t &table, std::vector<join_worker_t> &workers)
+  {
+    table.recs.clear();
+    table.hashes.clear();
+    for(join_worker_t &w : workers)
+    {
+      for(size_t i = 0; i < w.offsets.size(); i++)
+      {
+        table.recs.push_back(w.data.data() + w.offsets[i]);
+        table.hashes.push_back(w.hashes[i]);
+      }
+    }
+
+    size_t num_buckets = 16;
+    while(num_buckets < table.recs.size())
+      num_buckets *= 2;
+    table.heads.assign(num_buckets, 0);
+    table.next.assign(table.recs.size(), 0);
+    for(uint32_t r = 0; r < table.recs.size(); r++)
+    {
+      uint32_t &head = table.heads[table.hashes[r] & (num_buckets - 1)];
+      table.next[r] = head;
+      head = r + 1;
+    }
+  }
+
+
+  /* Hand each build row whose key equals <key> to the consumer, along with the probe row already in <w.probe_row> */
+  static void join_probe(const join_table_t &table, const Page::value_t &key, uint64_t hash, join_worker_t &w, unsigned worker,
+                         bool build_is_left, const join_consumer_t &consume)
+  {
+    for(uint32_t r = table.heads[hash & (table.heads.size() - 1)]; r != 0; r = table.next[r - 1])
+    {
+      if(table.hashes[r - 1] != hash || !join_key_eq(join_rec_key(table.recs[r - 1]), key))
+        continue;
+      join_rec_row(table.recs[r - 1], w.build_row);
+      w.matches++;
+      if(build_is_left)
+        consume(worker, w.build_row, w.probe_row);
+      else
+        consume(worker, w.probe_row, w.build_row);
+    }
+  }
+
+
+  /* Run <work> on <nthreads> workers, the calling thread being worker 0, and rethrow the first error */
+  static void join_parallel(unsigned nthreads, const std::function<void(unsigned worker)> &work)
+  {
+    std::vector<std::exception_ptr> errors(nthreads);
+    auto guarded = [&](unsigned self) {
+      try
+      {
+        work(self);
+      }
+      catch(...)
+      {
+        errors[self] = std::current_exception();
+      }
+    };
+
+    std::vector<std::thread> threads;
+    for(unsigned w = 1; w < nthreads; w++)
+      threads.emplace_back(guarded, w);
+    guarded(0);
+    for(std::thread &t : threads)
+      t.join();
+    for(std::exception_ptr &error : errors)
+    {
+      if(error)
+        std::rethrow_exception(error);
+    }
+  }
+
+
+  /* Join one partition: its build rows into a hash table, then its probe rows against it */
+  static void join_partition(file_descriptor_t &dbfile, join_spill_t &spill, uint16_t part, join_worker_t &w, unsigned worker,
+                             bool build_is_left, const join_consumer_t &consume)
+  {
+    std::vector<join_worker_t> build(1); // the rows are copied off the pages, which are only pinned while they are read
+    tmp_read(dbfile, spill.pages[JOIN_BUILD][part], [&build](const BYTE* rec) {
+      uint16_t size = reinterpret_cast<const Page::record_t*>(rec)->size;
+      build[0].offsets.push_back(build[0].data.size());
+      build[0].hashes.push_back(join_hash(join_rec_key(rec)));
+      build[0].data.insert(build[0].data.end(), rec, rec + size);
+    });
+    if(build[0].offsets.empty())
+      return;
+
+    join_table_t table;
+    join_build(table, build);
+    tmp_read(dbfile, spill.pages[JOIN_PROBE][part], [&](const BYTE* rec) {
+      Page::value_t key = join_rec_key(rec);
+      join_rec_row(rec, w.probe_row);
+      join_probe(table, key, join_hash(key), w, worker, build_is_left, consume);
+    });
+  }
+
+
+  /* Check that the join columns are both numbers or both strings */
+  static void join_check_keys(file_descriptor_t &dbfile, const join_input_t &left, const join_input_t &right)
+  {
+    bool numeric[2];
+    const join_input_t* inputs[2] = {&left, &right};
+    for(int s = 0; s < 2; s++)
+    {
+      table_descriptor_t td;
+      read_table_descriptor(dbfile, inputs[s]->table, td);
+      std::sort(td.col_types.begin(), td.col_types.end(), [](const column_type_t &a, const column_type_t &b) { return a.ord < b.ord; });
+      uint16_t type = td.col_types[tbl_col_index(td, inputs[s]->key_col)].type;
+      numeric[s] = type == TBL_TYPE_SHORT || type == TBL_TYPE_INT;
+    }
+    if(numeric[0] != numeric[1])
+      throw table_error("Cannot join \"" + left.table + "." + left.key_col + "\" with \"" + right.table + "." + right.key_col + "\".");
+  }
+
+
+  /* Pages of a table, to pick the smaller input */
+  static size_t join_num_pages(file_descriptor_t &dbfile, const std::string &table_name)
+  {
+    table_descriptor_t td;
+    read_table_descriptor(dbfile, table_name, td);
+    std::vector<extent_t> runs;
+    tbl_extent_runs(dbfile, td, runs);
+    size_t n = 0;
+    for(const extent_t &run : runs)
+      n += run.count;
+    return n;
+  }
+
+
+  size_t hash_join(file_descriptor_t &dbfile, const join_input_t &left, const join_input_t &right, const join_consumer_t &consume,
+                   unsigned nthreads, size_t mem_budget)
+  {
+    if(nthreads == 0)
+      nthreads = std::max(1u, std::thread::hardware_concurrency());
+    join_check_keys(dbfile, left, right);
+
+    bool build_is_left = join_num_pages(dbfile, left.table) <= join_num_pages(dbfile, right.table);
+    const join_input_t &build = build_is_left ? left : right;
+    const join_input_t &probe = build_is_left ? right : left;
+    std::vector<std::string> build_cols = {build.key_col}, probe_cols = {probe.key_col};
+    build_cols.insert(build_cols.end(), build.proj_cols.begin(), build.proj_cols.end());
+    probe_cols.insert(probe_cols.end(), probe.proj_cols.begin(), probe.proj_cols.end());
+
+    std::vector<join_worker_t> workers(nthreads);
+    join_spill_t spill;
+    std::atomic<size_t> build_bytes(0);
+    std::atomic<bool> spilling(false);
+
+    try
+    {
+      /* Build: gather the rows, and once they are over budget, send them to the partitions after every batch */
+      pscan_run(dbfile, build.table, build.preds, build_cols, nthreads, [&](unsigned worker, const vscan_cursor_t &cur)
+      {
+        join_worker_t &w = workers[worker];
+        size_t before = w.data.size() + w.offsets.size() * 2 * sizeof(uint64_t);
+        join_add_batch(w, cur, build.proj_cols.size());
+        size_t after = w.data.size() + w.offsets.size() * 2 * sizeof(uint64_t);
+        if(!spilling && (build_bytes += after - before) > mem_budget)
+          spilling = true;
+        if(spilling)
+          join_flush(dbfile, w, JOIN_BUILD, spill);
+      });
+
+      if(!spilling)
+      {
+        /* Probe the one table in memory as the larger input is scanned */
+        join_table_t table;
+        join_build(table, workers);
+        pscan_run(dbfile, probe.table, probe.preds, probe_cols, nthreads, [&](unsigned worker, const vscan_cursor_t &cur)
+        {
+          join_worker_t &w = workers[worker];
+          w.probe_row.resize(probe.proj_cols.size());
+          for(uint16_t i = 0; i < cur.num_sel; i++)
+          {
+            uint16_t r = cur.sel[i];
+            Page::value_t key = vscan_value(cur, 0, r);
+            if(key.type == Page::RTYPE_NULL)
+              continue;
+            for(uint16_t p = 0; p < probe.proj_cols.size(); p++)
+              w.probe_row[p] = vscan_value(cur, p + 1, r);
+            join_probe(table, key, join_hash(key), w, worker, build_is_left, consume);
+          }
+        });
+      }
+      else
+      {
+        for(join_worker_t &w : workers)
+          join_flush(dbfile, w, JOIN_BUILD, spill);
+        pscan_run(dbfile, probe.table, probe.preds, probe_cols, nthreads, [&](unsigned worker, const vscan_cursor_t &cur)
+        {
+          join_add_batch(workers[worker], cur, probe.proj_cols.size());
+          join_flush(dbfile, workers[worker], JOIN_PROBE, spill);
+        });
+
+        /* Partitions are independent, so workers take the next one left until there are none ; a partition still over
+           budget is joined in memory anyway */
+        std::atomic<uint16_t> next_part(0);
+        join_parallel(std::min<unsigned>(nthreads, JOIN_PARTITIONS), [&](unsigned worker)
+        {
+          for(uint16_t part = next_part++; part < JOIN_PARTITIONS; part = next_part++)
+            join_partition(dbfile, spill, part, workers[worker], worker, build_is_left, consume);
+        });
+      }
+    }
+    catch(...)
+    {
+      join_free_spill(dbfile, spill);
+      throw;
+    }
+    join_free_spill(dbfile, spill);
+
+    size_t matches = 0;
+    for(join_worker_t &w : workers)
+      matches += w.matches;
+    return matches;
+  }
+}
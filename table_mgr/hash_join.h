@@ -0,0 +1,67 @@
+/**************************************************************************************************
+* Filename:   hash_join.h
+* Details:    Defines the API for joining two tables on equal column values with a hash join.
+**************************************************************************************************/
+
+/*************************************************************************************************
+  A hash join reads the smaller of its two inputs (by pages) into an in-memory hash table, keyed
+  on the join column, then runs a parallel scan ("pscan_run()") of the larger input that probes
+  the table with each row. Rows are held packed as records: |size|key|column|column|...|.
+
+  When the build input grows past the memory budget, the join turns into a grace hash join: the
+  build rows, and then every probe row, are written to temp pages split into JOIN_PARTITIONS
+  partitions by the hash of their key, so rows with equal keys land in the same partition. Each
+  partition is then joined on its own, in memory, and the partitions are shared out among the
+  workers. The temp pages go back on the free list at the end.
+
+  SHORT and INT join columns join with each other, compared as integers. A NULL key never matches.
+*************************************************************************************************/
+
+/********************************************* GUARD *********************************************/
+
+#ifndef HASH_JOIN_H
+#define HASH_JOIN_H
+
+/***************************************** HEADER FILES ******************************************/
+
+#include "table_scan.h"
+
+/******************************************* CONSTANTS *******************************************/
+
+namespace Table
+{
+  const size_t JOIN_MEM_BUDGET = 64 * 1024 * 1024; // default bytes of build rows held in memory
+  const uint16_t JOIN_PARTITION_BITS = 4; // top bits of the key hash that pick a partition
+  const uint16_t JOIN_PARTITIONS = 1 << JOIN_PARTITION_BITS;
+}
+
+/************************************** IMPLEMENT STRUCTURES *************************************/
+
+namespace Table
+{
+  /* Structure for one input of a join: the records of <table> that match <preds>, joined on <key_col> */
+  struct join_input_t
+  {
+    std::string table;
+    std::vector<scan_pred_t> preds;
+    std::string key_col;
+    std::vector<std::string> proj_cols; // the columns handed to the consumer, in order
+  };
+}
+
+namespace Table
+{
+  /************************************* FUNCTION PROTOTYPES *************************************/
+
+  /* Called for each pair of rows whose keys are equal ; <left> and <right> hold the projected columns of each input, and
+     their strings are valid until the call returns. <worker> is in [0, nthreads), and calls for one worker never overlap */
+  typedef std::function<void(unsigned worker, const row_t &left, const row_t &right)> join_consumer_t;
+
+  /* Join <left> and <right> on <nthreads> workers (0 = one per core), handing every matching pair to <consume>, in no
+     particular order. The buffer pool must be able to pin one page per worker, and two more to spill. Throws a
+     <table_error> if the join columns are a string and a number. Returns the number of pairs */
+  size_t hash_join(file_descriptor_t &dbfile, const join_input_t &left, const join_input_t &right, const join_consumer_t &consume,
+                   unsigned nthreads = 1, size_t mem_budget = JOIN_MEM_BUDGET);
+}
+
+#endif // HASH_JOIN_H
@@ -0,0 +1,496 @@
+/**************************************************************************************************
+* Filename:   mvcc.cpp
+* Details:    Implements the transactions, snapshots and version store declared in "mvcc.h".
+**************************************************************************************************/
+
+/****************************************** HEADER FILES *****************************************/
+
+#include "mvcc.h"
+
+#include <algorithm>
+#include <mutex>
+#include <set>
+#include <shared_mutex>
+#include <unordered_map>
+
+/************************************** IMPLEMENT STRUCTURES *************************************/
+
+namespace Table
+{
+  /* Structure for records <first> to <first> + <count> - 1 of a page, all created by <xmin> */
+  struct version_run_t
+  {
+    uint16_t first;
+    uint16_t count;
+    txn_id_t xmin; // TXN_NONE once its transaction aborted
+    bool reported; // an aborted run already put on the dead list
+  };
+
+  /* Structure for a record deleted by <xmax> */
+  struct version_del_t
+  {
+    uint16_t rec_id;
+    txn_id_t xmax;
+    bool reported; // already put on the dead list
+  };
+
+  /* Structure for the versions of one page's records */
+  struct page_versions_t
+  {
+    std::vector<version_run_t> runs; // in the order they were created
+    std::vector<version_del_t> dels;
+  };
+
+  /* Structure for one partition of the version store */
+  struct mvcc_partition_t
+  {
+    std::shared_mutex mutex;
+    std::unordered_map<uint16_t, page_versions_t> pages;
+  };
+}
+
+/**************************************** GLOBAL VARIABLES ***************************************/
+
+namespace Table
+{
+  static std::mutex txn_mutex; // guards the transaction and snapshot bookkeeping below ; never held with a partition's
+  static txn_id_t next_xid = 1;
+  static std::set<txn_id_t> active_xids;
+  static std::multiset<txn_id_t> snapshot_xmins;
+  static std::unordered_map<txn_id_t, std::vector<uint16_t>> touched_pages; // per running transaction, for an abort
+
+  static mvcc_partition_t partitions[MVCC_PARTITIONS];
+
+  static std::mutex gc_mutex; // one collection at a time ; guards the two below
+  static txn_id_t gc_horizon = 0; // the horizon of the last collection
+  static std::vector<RID> dead_rids;
+}
+
+/************************************ FUNCTION IMPLEMENTATIONS ***********************************/
+
+namespace Table
+{
+  static inline mvcc_partition_t &mvcc_partition(uint16_t page_id)
+  {
+    return partitions[page_id % MVCC_PARTITIONS];
+  }
+
+
+  /* Note that <xid> has versions on the page, so an abort finds them */
+  static void mvcc_touch(txn_id_t xid, uint16_t page_id)
+  {
+    std::lock_guard<std::mutex> guard(txn_mutex);
+    std::vector<uint16_t> &pages = touched_pages[xid];
+    if(pages.empty() || pages.back() != page_id)
+      pages.push_back(page_id);
+  }
+
+
+  txn_id_t mvcc_horizon()
+  {
+    std::lock_guard<std::mutex> guard(txn_mutex);
+    txn_id_t horizon = next_xid;
+    if(!active_xids.empty())
+      horizon = std::min(horizon, *active_xids.begin());
+    if(!snapshot_xmins.empty())
+      horizon = std::min(horizon, *snapshot_xmins.begin());
+    return horizon;
+  }
+
+
+  txn_id_t mvcc_begin()
+  {
+    std::lock_guard<std::mutex> guard(txn_mutex);
+    txn_id_t xid = next_xid++;
+    active_xids.insert(xid);
+    return xid;
+  }
+
+
+  void mvcc_commit(txn_id_t xid)
+  {
+    {
+      std::lock_guard<std::mutex> guard(txn_mutex);
+      active_xids.erase(xid);
+      touched_pages.erase(xid);
+    }
+    mvcc_gc();
+  }
+
+
+  void mvcc_abort(txn_id_t xid, bool restored)
+  {
+    std::vector<uint16_t> pages;
+    {
+      std::lock_guard<std::mutex> guard(txn_mutex);
+      auto it = touched_pages.find(xid);
+      if(it != touched_pages.end())
+      {
+        pages.swap(it->second);
+        touched_pages.erase(it);
+      }
+    }
+
+    /* Still running, so no snapshot sees its versions yet: changing them is invisible to readers */
+    std::sort(pages.begin(), pages.end());
+    pages.erase(std::unique(pages.begin(), pages.end()), pages.end());
+    for(uint16_t page_id : pages)
+    {
+      mvcc_partition_t &part = mvcc_partition(page_id);
+      std::unique_lock<std::shared_mutex> lock(part.mutex);
+      auto it = part.pages.find(page_id);
+      if(it == part.pages.end())
+        continue;
+      std::vector<version_run_t> &runs = it->second.runs;
+      if(restored)
+        runs.erase(std::remove_if(runs.begin(), runs.end(), [xid](const version_run_t &run) { return run.xmin == xid; }),
+                   runs.end());
+      for(version_run_t &run : runs)
+      {
+        if(run.xmin == xid)
+          run.xmin = TXN_NONE;
+      }
+      std::vector<version_del_t> &dels = it->second.dels;
+      dels.erase(std::remove_if(dels.begin(), dels.end(), [xid](const version_del_t &del) { return del.xmax == xid; }),
+                 dels.end());
+      if(runs.empty() && dels.empty())
+        part.pages.erase(it);
+    }
+
+    {
+      std::lock_guard<std::mutex> guard(txn_mutex);
+      active_xids.erase(xid);
+    }
+    mvcc_gc();
+  }
+
+
+  void snapshot_open(snapshot_t &snap, txn_id_t own)
+  {
+    std::lock_guard<std::mutex> guard(txn_mutex);
+    snap.xmax = next_xid;
+    snap.active.assign(active_xids.begin(), active_xids.end());
+    snap.xmin = snap.active.empty() ? snap.xmax : snap.active.front();
+    snap.own = own;
+    snap.open = true;
+    snapshot_xmins.insert(snap.xmin);
+  }
+
+
+  void snapshot_close(snapshot_t &snap)
+  {
+    if(!snap.open)
+      return;
+    {
+      std::lock_guard<std::mutex> guard(txn_mutex);
+      snapshot_xmins.erase(snapshot_xmins.find(snap.xmin));
+    }
+    snap.open = false;
+    mvcc_gc();
+  }
+
+
+  bool mvcc_sees(const snapshot_t &snap, txn_id_t xid)
+  {
+    if(xid == TXN_NONE)
+      return false;
+    if(xid == snap.own)
+      return true;
+    if(xid >= snap.xmax)
+      return false;
+    if(xid < snap.xmin)
+      return true;
+    return !std::binary_search(snap.active.begin(), snap.active.end(), xid);
+  }
+
+
+  void mvcc_created(txn_id_t xid, RID rid, uint16_t count)
+  {
+    if(count == 0)
+      return;
+    mvcc_partition_t &part = mvcc_partition(rid.page_id);
+    bool new_run = false;
+    {
+      std::unique_lock<std::shared_mutex> lock(part.mutex);
+      std::vector<version_run_t> &runs = part.pages[rid.page_id].runs;
+      if(!runs.empty() && runs.back().xmin == xid && runs.back().first + runs.back().count == rid.rec_id)
+        runs.back().count += count;
+      else
+      {
+        runs.push_back({rid.rec_id, count, xid, false});
+        new_run = true;
+      }
+    }
+    if(new_run)
+      mvcc_touch(xid, rid.page_id);
+  }
+
+
+  bool mvcc_deleted(txn_id_t xid, RID rid)
+  {
+    mvcc_partition_t &part = mvcc_partition(rid.page_id);
+    {
+      std::unique_lock<std::shared_mutex> lock(part.mutex);
+      std::vector<version_del_t> &dels = part.pages[rid.page_id].dels;
+      for(const version_del_t &del : dels)
+      {
+        if(del.rec_id == rid.rec_id)
+          return del.xmax == xid;
+      }
+      dels.push_back({rid.rec_id, xid, false});
+    }
+    mvcc_touch(xid, rid.page_id);
+    return true;
+  }
+
+
+  void mvcc_page_vis(const snapshot_t &snap, const void* page, uint16_t page_id, uint16_t num_recs, page_vis_t &vis)
+  {
+    vis.num_recs = num_recs;
+    mvcc_partition_t &part = mvcc_partition(page_id);
+    std::shared_lock<std::shared_mutex> lock(part.mutex);
+    auto it = part.pages.find(page_id);
+    if(it == part.pages.end()) // only the records marked deleted before a restart are hidden
+    {
+      vis.all = true;
+      for(uint16_t rec_id = 0; rec_id < num_recs; rec_id++)
+      {
+        if(!Page::pg_is_deleted(page, rec_id))
+          continue;
+        if(vis.all)
+          vis.vis.assign(num_recs, 1);
+        vis.all = false;
+        vis.vis[rec_id] = 0;
+      }
+      return;
+    }
+
+    /* 2 for a record marked deleted whose deleter the snapshot does not see, so it is not taken for one marked before a restart */
+    vis.all = false;
+    vis.vis.assign(num_recs, 1);
+    for(const version_run_t &run : it->second.runs)
+    {
+      if(run.first >= num_recs || mvcc_sees(snap, run.xmin))
+        continue;
+      uint16_t end = std::min<uint32_t>(num_recs, (uint32_t)run.first + run.count);
+      std::fill(vis.vis.begin() + run.first, vis.vis.begin() + end, 0);
+    }
+    for(const version_del_t &del : it->second.dels)
+    {
+      if(del.rec_id >= num_recs)
+        continue;
+      if(mvcc_sees(snap, del.xmax))
+        vis.vis[del.rec_id] = 0;
+      else if(vis.vis[del.rec_id] != 0)
+        vis.vis[del.rec_id] = 2;
+    }
+    for(uint16_t rec_id = 0; rec_id < num_recs; rec_id++)
+    {
+      if(vis.vis[rec_id] == 2)
+        vis.vis[rec_id] = 1;
+      else if(vis.vis[rec_id] != 0 && Page::pg_is_deleted(page, rec_id))
+        vis.vis[rec_id] = 0;
+    }
+  }
+
+
+  /* What the version store says of the record at <rid>: hidden from the snapshot (0), seen with a deletion it holds (1), or
+     seen unless the record is marked deleted on its page (2) */
+  static int mvcc_store_vis(const snapshot_t &snap, RID rid)
+  {
+    mvcc_partition_t &part = mvcc_partition(rid.page_id);
+    std::shared_lock<std::shared_mutex> lock(part.mutex);
+    auto it = part.pages.find(rid.page_id);
+    if(it == part.pages.end())
+      return 2;
+    for(const version_run_t &run : it->second.runs)
+    {
+      if(rid.rec_id >= run.first && rid.rec_id < run.first + run.count && !mvcc_sees(snap, run.xmin))
+        return 0;
+    }
+    for(const version_del_t &del : it->second.dels)
+    {
+      if(del.rec_id == rid.rec_id)
+        return mvcc_sees(snap, del.xmax) ? 0 : 1;
+    }
+    return 2;
+  }
+
+
+  bool mvcc_visible(const snapshot_t &snap, const void* page, RID rid)
+  {
+    int vis = mvcc_store_vis(snap, rid);
+    return vis == 1 || (vis == 2 && !Page::pg_is_deleted(page, rid.rec_id));
+  }
+
+
+  bool mvcc_may_see(const snapshot_t &snap, RID rid)
+  {
+    return mvcc_store_vis(snap, rid) != 0;
+  }
+
+
+  bool mvcc_has_deletion(RID rid)
+  {
+    mvcc_partition_t &part = mvcc_partition(rid.page_id);
+    std::shared_lock<std::shared_mutex> lock(part.mutex);
+    auto it = part.pages.find(rid.page_id);
+    if(it == part.pages.end())
+      return false;
+    for(const version_del_t &del : it->second.dels)
+    {
+      if(del.rec_id == rid.rec_id)
+        return true;
+    }
+    return false;
+  }
+
+
+  bool mvcc_created_by(txn_id_t xid, RID rid)
+  {
+    mvcc_partition_t &part = mvcc_partition(rid.page_id);
+    std::shared_lock<std::shared_mutex> lock(part.mutex);
+    auto it = part.pages.find(rid.page_id);
+    if(it == part.pages.end())
+      return false;
+    for(const version_run_t &run : it->second.runs)
+    {
+      if(rid.rec_id >= run.first && rid.rec_id < run.first + run.count)
+        return run.xmin == xid;
+    }
+    return false;
+  }
+
+
+  void mvcc_gc()
+  {
+    std::lock_guard<std::mutex> guard(gc_mutex);
+    txn_id_t horizon = mvcc_horizon();
+    if(horizon == gc_horizon)
+      return;
+    gc_horizon = horizon;
+
+    /* Below the horizon every transaction has finished, and every snapshot sees it: a run it created is as good as
+       no version at all, and a record it deleted is gone for everyone. Aborted runs and dead records stay, invisible,
+       until "mvcc_reclaimed()" says their space is reused */
+    for(mvcc_partition_t &part : partitions)
+    {
+      std::unique_lock<std::shared_mutex> lock(part.mutex);
+      for(auto it = part.pages.begin(); it != part.pages.end(); )
+      {
+        std::vector<version_run_t> &runs = it->second.runs;
+        for(version_run_t &run : runs)
+        {
+          if(run.xmin != TXN_NONE || run.reported)
+            continue;
+          for(uint16_t i = 0; i < run.count; i++)
+            dead_rids.push_back({it->first, (uint16_t)(run.first + i)});
+          run.reported = true;
+        }
+        runs.erase(std::remove_if(runs.begin(), runs.end(), [horizon](const version_run_t &run) {
+                     return run.xmin != TXN_NONE && run.xmin < horizon;
+                   }), runs.end());
+        for(version_del_t &del : it->second.dels)
+        {
+          if(!del.reported && del.xmax < horizon)
+          {
+            dead_rids.push_back({it->first, del.rec_id});
+            del.reported = true;
+          }
+        }
+        if(runs.empty() && it->second.dels.empty())
+          it = part.pages.erase(it);
+        else
+          ++it;
+      }
+    }
+  }
+
+
+  void mvcc_take_dead(std::vector<RID> &dead)
+  {
+    std::lock_guard<std::mutex> guard(gc_mutex);
+    dead.swap(dead_rids);
+    dead_rids.clear();
+  }
+
+
+  void mvcc_take_dead(std::vector<RID> &dead, const std::vector<uint16_t> &page_ids)
+  {
+    std::lock_guard<std::mutex> guard(gc_mutex);
+    dead.clear();
+    size_t kept = 0;
+    for(const RID &rid : dead_rids)
+    {
+      if(std::binary_search(page_ids.begin(), page_ids.end(), rid.page_id))
+        dead.push_back(rid);
+      else
+        dead_rids[kept++] = rid;
+    }
+    dead_rids.resize(kept);
+  }
+
+
+  void mvcc_unreclaimed(const std::vector<RID> &rids)
+  {
+    std::lock_guard<std::mutex> guard(gc_mutex);
+    dead_rids.insert(dead_rids.end(), rids.begin(), rids.end());
+  }
+
+
+  void mvcc_reclaimed(const std::vector<RID> &rids)
+  {
+    for(const RID &rid : rids)
+    {
+      mvcc_partition_t &part = mvcc_partition(rid.page_id);
+      std::unique_lock<std::shared_mutex> lock(part.mutex);
+      auto it = part.pages.find(rid.page_id);
+      if(it == part.pages.end())
+        continue;
+      std::vector<version_run_t> &runs = it->second.runs;
+      for(size_t i = 0; i < runs.size(); i++)
+      {
+        version_run_t &run = runs[i];
+        if(run.xmin != TXN_NONE || rid.rec_id < run.first || rid.rec_id >= run.first + run.count)
+          continue;
+        /* Split the aborted run around the record */
+        version_run_t tail = {(uint16_t)(rid.rec_id + 1), (uint16_t)(run.first + run.count - rid.rec_id - 1),
+                              TXN_NONE, run.reported};
+        run.count = rid.rec_id - run.first;
+        if(tail.count > 0)
+          runs.push_back(tail);
+        break;
+      }
+      runs.erase(std::remove_if(runs.begin(), runs.end(), [](const version_run_t &run) { return run.count == 0; }),
+                 runs.end());
+      std::vector<version_del_t> &dels = it->second.dels;
+      dels.erase(std::remove_if(dels.begin(), dels.end(), [&rid](const version_del_t &del) {
+                   return del.reported && del.rec_id == rid.rec_id;
+                 }), dels.end());
+      if(runs.empty() && dels.empty())
+        part.pages.erase(it);
+    }
+  }
+
+
+  mvcc_stats_t mvcc_stats()
+  {
+    mvcc_stats_t stats = {};
+    for(mvcc_partition_t &part : partitions)
+    {
+      std::shared_lock<std::shared_mutex> lock(part.mutex);
+      stats.pages += part.pages.size();
+      for(const auto &pv : part.pages)
+      {
+        for(const version_run_t &run : pv.second.runs)
+          (run.xmin == TXN_NONE ? stats.dead : stats.created) += run.count;
+        for(const version_del_t &del : pv.second.dels)
+          (del.reported ? stats.dead : stats.deleted)++;
+      }
+    }
+    std::lock_guard<std::mutex> guard(txn_mutex);
+    stats.active = active_xids.size();
+    stats.snapshots = snapshot_xmins.size();
+    return stats;
+  }
+}
@@ -0,0 +1,170 @@
+/**************************************************************************************************
+* Filename:   mvcc.h
+* Details:    Defines the API for multi-version concurrency control: transaction ids, snapshots, and
+*             the versions that say which transaction created and deleted each record.
+**************************************************************************************************/
+
+/*************************************************************************************************
+  Every write runs as a transaction with an id from one increasing counter. A reader takes a
+  snapshot when it starts: the ids that had not finished by then are its <active> list, and it
+  sees the changes of every other transaction below <xmax>, and no others, for as long as it runs.
+  So a scan that overlaps an insert sees none of the insert's rows until the insert commits, and
+  a scan that started before the commit never does, without a reader ever waiting for a writer.
+
+  Records are stored once, on their page, with no ids in them. The ids live beside them in a
+  version store kept in memory: per page, the runs of records each transaction created, and the
+  records a transaction deleted. A record with no version is visible to everyone. Versions are
+  kept only while some snapshot could still tell them apart: once a record's creator is older than
+  every open snapshot and every running transaction, its version is dropped ("mvcc_gc()"), and a
+  record whose deleter is that old is dead to everyone and handed over to be reclaimed. So the
+  store only holds the rows written recently, and scans of pages it has nothing for pay nothing.
+
+  A transaction that aborts leaves the records it created visible to no one, and its deletions
+  undone. The store is split into MVCC_PARTITIONS by page id, each with its own lock, so inserts
+  and scans of different pages do not meet at one mutex.
+
+  Nothing of the store is written to the file, but every deletion is: whoever records one here
+  also marks the record deleted on its page ("Page::pg_mark_deleted()", see "delete_rows()"),
+  under the page's latch and after "txn_touch()", so the mark goes to the file with the page and
+  an abort takes it off again. The record stays where it is and is still read: while the store
+  holds its deletion, that decides which snapshots see it, and a marked record the store holds
+  nothing for was deleted before a restart and is seen by no one. So after a restart the deleted
+  records stay deleted, every other record on a page is simply visible, and only the ids of the
+  records written since are lost, which no snapshot needs any more.
+
+  An update is the deletion of the old version and the creation of a new one, never a change in
+  place ("pg_modify_record()"), so a reader still finds the version its snapshot sees ; only a
+  record its own transaction created, which no one else sees yet, may be changed in place (see
+  "table_modify.h").
+
+  Readers see whole records only: a page's records are read under its buffer latch (see
+  "buffer_mgr.h"), which writers hold while they change the page.
+*************************************************************************************************/
+
+/********************************************* GUARD *********************************************/
+
+#ifndef MVCC_H
+#define MVCC_H
+
+/***************************************** HEADER FILES ******************************************/
+
+#include "table_mgr.h"
+
+/******************************************* CONSTANTS *******************************************/
+
+namespace Table
+{
+  typedef uint32_t txn_id_t;
+
+  const txn_id_t TXN_NONE = 0; // no transaction: a version no snapshot sees, or a reader with no writes of its own
+  const uint16_t MVCC_PARTITIONS = 16; // the version store is split by page id into this many partitions
+}
+
+/************************************** IMPLEMENT STRUCTURES *************************************/
+
+namespace Table
+{
+  /* Structure for the transactions a reader sees: every one below <xmax> that is not in <active>, and its own */
+  struct snapshot_t
+  {
+    txn_id_t xmin = TXN_NONE; // transactions below this had all finished when the snapshot was taken
+    txn_id_t xmax = TXN_NONE; // the first transaction id not handed out yet
+    std::vector<txn_id_t> active; // ids in [xmin, xmax) still running, sorted
+    txn_id_t own = TXN_NONE; // the transaction reading, whose changes it sees (TXN_NONE for a plain reader)
+    bool open = false;
+  };
+
+  /* Structure for which records of one page a snapshot sees */
+  struct page_vis_t
+  {
+    uint16_t num_recs = 0; // records on the page when it was looked at ; any added later are not seen
+    bool all = true; // the page has no versions: the first <num_recs> records are all seen
+    std::vector<BYTE> vis; // otherwise, 1 for each record seen
+  };
+
+  /* Structure for what the version store holds, see "mvcc_stats()" */
+  struct mvcc_stats_t
+  {
+    size_t pages; // pages with versions
+    size_t created; // records whose creator some snapshot may not see
+    size_t deleted; // records deleted by a transaction some snapshot may not see
+    size_t dead; // records dead to everyone, waiting to be reclaimed
+    size_t active; // running transactions
+    size_t snapshots; // open snapshots
+  };
+}
+
+namespace Table
+{
+  /************************************* FUNCTION PROTOTYPES *************************************/
+
+  /* Start a transaction that writes ; returns its id */
+  txn_id_t mvcc_begin();
+
+  /* Make the transaction's changes visible to every snapshot taken from now on */
+  void mvcc_commit(txn_id_t xid);
+
+  /* End the transaction without its changes: the records it created are seen by no one, and its deletions are undone.
+     With <restored>, the caller has put the pages it changed back as they were, so those records are gone and their
+     versions are dropped rather than left for reclaiming */
+  void mvcc_abort(txn_id_t xid, bool restored = false);
+
+  /* Take a snapshot of the transactions that have committed so far ; <own> is the reading transaction, if it writes too */
+  void snapshot_open(snapshot_t &snap, txn_id_t own = TXN_NONE);
+
+  /* Release the snapshot, so versions only it needed can be dropped ; closing a closed snapshot does nothing */
+  void snapshot_close(snapshot_t &snap);
+
+  /* True if the snapshot sees the changes of <xid> */
+  bool mvcc_sees(const snapshot_t &snap, txn_id_t xid);
+
+  /* Record that <xid> created the record at <rid>, and the <count> - 1 after it on the page ; call it before the records can
+     be reached, with the page latched */
+  void mvcc_created(txn_id_t xid, RID rid, uint16_t count = 1);
+
+  /* Record that <xid> deleted the record at <rid>. False, with nothing changed, if another transaction deleted it first
+     (and has not aborted): the caller has a write conflict. The caller marks the record deleted on its page as well, see
+     above */
+  bool mvcc_deleted(txn_id_t xid, RID rid);
+
+  /* Fill <vis> for the first <num_recs> records of <page> (row or PAX), as the snapshot sees them ; call it with the page
+     latched */
+  void mvcc_page_vis(const snapshot_t &snap, const void* page, uint16_t page_id, uint16_t num_recs, page_vis_t &vis);
+
+  /* True if the snapshot sees the record at <rid>, whose page is <page> ; call it with the page latched */
+  bool mvcc_visible(const snapshot_t &snap, const void* page, RID rid);
+
+  /* False if the version store alone hides the record at <rid> from the snapshot, so its page need not be read ; if true, only
+     "mvcc_visible()" can tell whether it was marked deleted before a restart */
+  bool mvcc_may_see(const snapshot_t &snap, RID rid);
+
+  /* True if the store holds a deletion of the record at <rid> ; a record marked deleted on its page that it holds none for was
+     deleted before a restart, and is dead to everyone */
+  bool mvcc_has_deletion(RID rid);
+
+  /* True if <xid>, still running, created the record at <rid>: no other snapshot sees it until <xid> commits */
+  bool mvcc_created_by(txn_id_t xid, RID rid);
+
+  /* The oldest transaction some open or future snapshot may not see: every reader that started before a transaction below it
+     has finished, so nothing it took out of a table's reach is reached any more */
+  txn_id_t mvcc_horizon();
+
+  /* Drop the versions every open and future snapshot agrees on, and move records dead to everyone to the dead list */
+  void mvcc_gc();
+
+  /* Take the records on the dead list ; the caller reclaims their space. They stay invisible until then */
+  void mvcc_take_dead(std::vector<RID> &dead);
+
+  /* Same, for the dead records on the pages <page_ids> (sorted) only ; the others stay on the list */
+  void mvcc_take_dead(std::vector<RID> &dead, const std::vector<uint16_t> &page_ids);
+
+  /* Put taken records whose space could not be reclaimed yet back on the dead list */
+  void mvcc_unreclaimed(const std::vector<RID> &rids);
+
+  /* Forget the versions of dead records whose space has been reclaimed (their directory slots are now unused) */
+  void mvcc_reclaimed(const std::vector<RID> &rids);
+
+  mvcc_stats_t mvcc_stats();
+}
+
+#endif // MVCC_H
@@ -9,89 +9,536 @@
 /****************************************** HEADER FILES *****************************************/
 
 #include "table_mgr.h"
+#include "table_scan.h"
+#include "mvcc.h"
+#include "transaction.h"
 #include "../buffer_mgr/buffer_mgr.h"
+#include "../lock_mgr/lock_mgr.h"
+#include "../index_mgr/index_mgr.h"
+#include "../paging/pax_page.h"
+#include "../paging/record_view.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <mutex>
+#include <shared_mutex>
+
+/**************************************** GLOBAL VARIABLES ***************************************/
+
+namespace Table
+{
+  /* Held while the free list, a table's extents or the catalog is changed, so writers on several threads take pages and
+     update "#master" one at a time. It is short, like a latch: record and page locks are what writers hold to commit */
+  static std::recursive_mutex alloc_mutex;
+}
+
+/************************************** IMPLEMENT STRUCTURES *************************************/
+
+namespace Table
+{
+  /* Structure held while the free list, an extent list or the catalog is changed: the write's transaction (one of its own if
+     none is running) with the catalog lock, which it keeps until it ends, and then <alloc_mutex>. The lock is taken first, as
+     no lock is waited for holding the mutex ; nested guards find both held already */
+  struct tbl_alloc_guard_t
+  {
+    explicit tbl_alloc_guard_t(file_descriptor_t &dbfile) : scope(dbfile)
+    {
+      Lock_mgr::lock_table(scope.txn->xid, TXN_CATALOG_LOCK, Lock_mgr::LOCK_X);
+      alloc = std::unique_lock<std::recursive_mutex>(alloc_mutex);
+    }
+
+    txn_scope_t scope;
+    std::unique_lock<std::recursive_mutex> alloc;
+  };
+
+  /* Structure holding a pin on a page while it is in scope, so another thread's read cannot replace it ; a latch taken after
+     it is let go before the pin */
+  struct tbl_pin_t
+  {
+    tbl_pin_t(file_descriptor_t &dbfile, uint16_t page_id) : page_id(page_id), page(Buffer_mgr::buf_pin(dbfile, page_id)) {}
+    ~tbl_pin_t() { Buffer_mgr::buf_unpin(page_id); }
+    tbl_pin_t(const tbl_pin_t &) = delete;
+    tbl_pin_t &operator=(const tbl_pin_t &) = delete;
+
+    uint16_t page_id;
+    void* page;
+  };
+}
 
 /************************************ FUNCTION IMPLEMENTATIONS ***********************************/
 
 namespace Table
 {
-  void insert_into(file_descriptor_t &dbfile, const std::string &table_name, std::vector<colval_t> values)
+  /* Unpack a "#master" record: |name|fp|lp|type|xp|def| */
+  static void tbl_unpack_master_row(BYTE* rec, master_table_row_t &mtr)
   {
-    std::cout << "\nAdding record to table \"" << table_name << "\"..." << std::endl;
+    Page::record_view_t view;
+    Page::rv_open(view, rec);
+    std::string_view name = Page::rv_str(view, 0), def = Page::rv_str(view, 5);
+    mtr.name.assign(name.data(), name.size());
+    mtr.first_page = Page::rv_short(view, 1);
+    mtr.last_page = Page::rv_short(view, 2);
+    mtr.type = Page::rv_short(view, 3);
+    mtr.extent_page = Page::rv_short(view, 4);
+    mtr.def.assign(def.data(), def.size());
+  }
 
-    RID rid;
-    void* mstr_page = (void*)Buffer_mgr::buf_read(dbfile, TBL_MASTER_PAGE);
-    master_table_row_t mtr = master_find_table(table_name, mstr_page, rid);
 
-    table_descriptor_t td;
-    read_table_descriptor(dbfile, table_name, td);
+  /* Unpack a "#columns" record: |tname|colname|ord|type|size| */
+  static column_type_t tbl_unpack_col_type(BYTE* rec)
+  {
+    Page::record_view_t view;
+    Page::rv_open(view, rec);
+    std::string_view name = Page::rv_str(view, 1);
+    column_type_t ct;
+    ct.name.assign(name.data(), name.size());
+    ct.ord = Page::rv_short(view, 2);
+    ct.type = Page::rv_short(view, 3);
+    ct.max_size = Page::rv_short(view, 4);
+    return ct;
+  }
 
-    pg_locations_t pgl;
-    pgl.name = td.name;
-    pgl.first_page = td.first_page;
-    pgl.last_page = td.last_page;
 
-    std::string rec;
-    Page::rec_begin(rec);
+  /* True if the record's first field is the string <name> ; compared in place, without unpacking */
+  static bool tbl_first_field_is(const BYTE* rec, const std::string &name)
+  {
+    uint16_t type = *(const uint16_t*)(rec + sizeof(uint16_t));
+    return type - Page::RTYPE_STRING == name.size() && memcmp(rec + 2 * sizeof(uint16_t), name.data(), name.size()) == 0;
+  }
+
 
+  /* Minipage type and width of each column (sorted by <ord>) of a PAX table */
+  static void tbl_pax_fields(const std::vector<column_type_t> &cols, std::vector<BYTE> &types, std::vector<uint16_t> &widths)
+  {
+    types.clear();
+    widths.clear();
+    for(const column_type_t &col : cols)
+    {
+      if(col.type == TBL_TYPE_SHORT)
+        widths.push_back(sizeof(int16_t));
+      else if(col.type == TBL_TYPE_INT)
+        widths.push_back(sizeof(int32_t));
+      else if(col.type == TBL_TYPE_VCHAR)
+        widths.push_back(col.max_size);
+      else
+        throw table_error("Column \"" + col.name + "\" has an unknown type.");
+      types.push_back(col.type == TBL_TYPE_VCHAR ? Page::RTYPE_STRING : col.type);
+    }
+  }
+
+
+  /* Fill in the definition of a catalog hash index ; it has no "#master" row of its own */
+  static void tbl_catalog_def(uint16_t slot, uint16_t root, index_def_t &idx)
+  {
+    idx.name = (slot == TBL_META_MASTER_IDX) ? "#master.name" : "#columns.tname";
+    idx.table = (slot == TBL_META_MASTER_IDX) ? TBL_MASTER_NAME : TBL_COLUMN_NAME;
+    idx.column = (slot == TBL_META_MASTER_IDX) ? "name" : "tname";
+    idx.col = 0;
+    idx.key_type = TBL_TYPE_VCHAR;
+    idx.key_size = sizeof(uint16_t) + TBL_NAME_SIZE;
+    idx.type = DB_TYPE_HASH;
+    idx.root = root;
+    idx.first_leaf = root;
+    idx.master_rid.page_id = 0;
+    idx.master_rid.rec_id = 0;
+  }
+
+
+  /* The catalog hash index kept in header slot <slot> ; false for a file formatted without one */
+  static bool tbl_catalog_index(file_descriptor_t &dbfile, uint16_t slot, index_def_t &idx)
+  {
+    uint16_t root;
+    {
+      tbl_pin_t pin(dbfile, TBL_HEADER_PAGE);
+      root = static_cast<Page::Page_header_t*>(pin.page)->meta[slot];
+    }
+    if(root == 0)
+      return false;
+    tbl_catalog_def(slot, root, idx);
+    return true;
+  }
+
+
+  void insert_into(file_descriptor_t &dbfile, const std::string &table_name, const std::vector<colval_t> &values)
+  {
+    std::vector<std::string> col_names;
+    std::vector<std::vector<std::string>> rows(1);
     for(int v = 0; v < values.size(); v++)
     {
-      for(int i = 0; i < td.col_types.size(); i++)
+      col_names.push_back(values[v].first);
+      rows[0].push_back(values[v].second);
+    }
+
+    /* A single row is just a batch of one */
+    insert_stmt_t stmt;
+    prepare_insert(dbfile, table_name, col_names, stmt);
+    insert_batch(dbfile, stmt, rows);
+  }
+
+
+  void prepare_insert(file_descriptor_t &dbfile, const std::string &table_name, const std::vector<std::string> &col_names, insert_stmt_t &stmt)
+  {
+    stmt.td = table_descriptor_t();
+    read_table_descriptor(dbfile, table_name, stmt.td);
+
+    /* Records are packed in <ord> order, no matter what order the values are given in */
+    std::vector<column_type_t> &cols = stmt.td.col_types;
+    std::sort(cols.begin(), cols.end(), [](const column_type_t &a, const column_type_t &b) { return a.ord < b.ord; });
+
+    stmt.val_idx.assign(cols.size(), -1);
+    for(int v = 0; v < col_names.size(); v++)
+    {
+      bool found = false;
+      for(int i = 0; i < cols.size(); i++)
       {
-        if(values[v].first == td.col_types[i].name) // if we find the proper column
+        if(col_names[v] == cols[i].name) // if we find the proper column
         {
-          if(td.col_types[i].type == Page::RTYPE_STRING) // the column datatype is a string
-          {
-            Page::rec_packstr(rec, values[v].second);
-            std::cout << "string: " << values[v].second << std::endl;
-            break;
-          }
-          else if(td.col_types[i].type == Page::RTYPE_SHORT) // if the type is a short
-          {
-            std::stringstream ss;
-            int16_t col_short;
-            ss << values[v].second;
-            ss >> col_short;
-            Page::rec_packshort(rec, col_short);
-            std::cout << "short: " << col_short << std::endl;
-            break;
-          }
-          else if(td.col_types[i].type == Page::RTYPE_INT) // if the type is an int
+          stmt.val_idx[i] = v;
+          found = true;
+          break;
+        }
+      }
+      if(!found)
+        throw table_error("Column \"" + col_names[v] + "\" not found in table \"" + table_name + "\".");
+    }
+
+    Index::find_indexes(dbfile, table_name, stmt.indexes);
+    Page::rb_reserve(stmt.rec, tbl_max_record_size(cols));
+  }
+
+
+  /* True if a record of <size> bytes can go on the page, whichever layout it has */
+  static bool tbl_page_has_room(void* page, uint16_t size)
+  {
+    if(Page::pax_is_pax(page))
+      return !Page::pax_full(page);
+    return static_cast<table_page_t*>(page)->free_bytes >= sizeof(uint16_t) + size;
+  }
+
+
+  /* Lock the table's last page (page 0 while it has none) for <xid>, and bring <td>'s locations up to date: another writer
+     may have moved the last page on since <td> was read, or while we waited for the lock */
+  static void tbl_lock_last_page(file_descriptor_t &dbfile, table_descriptor_t &td, txn_id_t xid)
+  {
+    while(true)
+    {
+      RID rid;
+      pg_locations_t loc = master_lookup(dbfile, td.name, rid);
+      td.first_page = loc.first_page;
+      td.last_page = loc.last_page;
+      td.extent_page = loc.extent_page;
+      if(Lock_mgr::lock_mode_page(xid, td.lock_id, td.last_page) == Lock_mgr::LOCK_X)
+        return;
+      Lock_mgr::lock_page(xid, td.lock_id, td.last_page, Lock_mgr::LOCK_X);
+    }
+  }
+
+
+  /* The page the table's next record goes on: its last page if there is room, else a new one laid out for the table. The
+     page is locked for <xid> until it commits, so writers to one table fill its pages one at a time */
+  static uint16_t tbl_page_for(file_descriptor_t &dbfile, table_descriptor_t &td, uint16_t size, txn_id_t xid)
+  {
+    tbl_lock_last_page(dbfile, td, xid);
+    if(td.type != DB_TYPE_PAX)
+    {
+      uint16_t pg_id = rec_find_free(dbfile, td, size);
+      Lock_mgr::lock_page(xid, td.lock_id, pg_id, Lock_mgr::LOCK_X); // held already, unless the table moved on to a new page
+      return pg_id;
+    }
+    if(td.last_page != 0)
+    {
+      tbl_pin_t pin(dbfile, td.last_page);
+      std::shared_lock<std::shared_mutex> latch(Buffer_mgr::buf_latch(td.last_page)); // another writer may be filling it
+      if(tbl_page_has_room(pin.page, size))
+        return td.last_page;
+    }
+
+    extend_table(dbfile, td); // formats a row page, which is laid out again here
+    Lock_mgr::lock_page(xid, td.lock_id, td.last_page, Lock_mgr::LOCK_X);
+    txn_touch(dbfile, td.last_page);
+    void* page = Buffer_mgr::buf_pin(dbfile, td.last_page);
+    {
+      std::unique_lock<std::shared_mutex> latch(Buffer_mgr::buf_latch(td.last_page)); // a scan may already have reached it
+      tbl_init_pax_page(page, td.col_types);
+    }
+    Buffer_mgr::buf_write(dbfile, td.last_page);
+    Buffer_mgr::buf_unpin(td.last_page);
+    return td.last_page;
+  }
+
+
+  /* Shared by "insert_batch()" and "insert_rows()": pack each row into the statement's record builder and fill pages back-to-back.
+     The rows join the thread's transaction, or are one of their own, so a scan sees all of them or none and an error undoes the
+     ones added before it ; each is added under its page's latch */
+  template <typename Row>
+  static size_t tbl_fill_pages(file_descriptor_t &dbfile, insert_stmt_t &stmt, const std::vector<Row> &rows)
+  {
+    if(rows.empty())
+      return 0;
+
+    Page::rec_builder_t &rec = stmt.rec;
+    uint16_t pg_id = 0; // the page currently being filled
+    table_page_t* page = nullptr;
+    txn_scope_t scope(dbfile);
+    txn_id_t xid = scope.txn->xid;
+
+    try
+    {
+      /* Index pages have no latches, and are undone by restoring them whole: writers to an indexed table take turns with X.
+         The indexes are found again under the lock, for roots split by the writer before and for any index built since
+         "prepare_insert()" */
+      Lock_mgr::lock_table(xid, stmt.td.lock_id, stmt.indexes.empty() ? Lock_mgr::LOCK_IX : Lock_mgr::LOCK_X);
+      Index::find_indexes(dbfile, stmt.td.name, stmt.indexes);
+      if(!stmt.indexes.empty())
+        Lock_mgr::lock_table(xid, stmt.td.lock_id, Lock_mgr::LOCK_X);
+      for(size_t r = 0; r < rows.size(); r++)
+      {
+        tbl_pack_row(rec, stmt, rows[r]);
+        uint16_t size = Page::rb_size(rec);
+        if(sizeof(uint16_t) + size > Page::PG_INITIAL_BYTES - sizeof(uint16_t)) // would not fit in an empty table page
+          throw table_error("Record is too long to fit in a page.");
+
+        if(page == nullptr || !tbl_page_has_room(page, size)) // if the record does not fit in the current page
+        {
+          if(page != nullptr)
           {
-            std::stringstream ss;
-            int col_int;
-            ss << values[v].second;
-            ss >> col_int;
-            Page::rec_packint(rec, col_int);
-            std::cout << "int: " << col_int << std::endl;
-            break;
+            Buffer_mgr::buf_write(dbfile, pg_id); // done filling this page, so mark it dirty once
+            Buffer_mgr::buf_unpin(pg_id);
+            page = nullptr;
           }
+          pg_id = tbl_page_for(dbfile, stmt.td, size, xid);
+          txn_touch(dbfile, pg_id);
+          page = static_cast<table_page_t*>(Buffer_mgr::buf_pin(dbfile, pg_id)); // pinned, so index updates cannot evict it while it is filled
+        }
+        RID rid;
+        rid.page_id = pg_id;
+        {
+          std::unique_lock<std::shared_mutex> latch(Buffer_mgr::buf_latch(pg_id));
+          if(stmt.td.type == DB_TYPE_PAX)
+            rid.rec_id = Page::pax_add_record((void*)page, Page::rb_data(rec));
+          else
+            rid.rec_id = Page::pg_add_record((void*)page, Page::rb_data(rec), size);
+          mvcc_created(xid, rid);
         }
+        for(index_def_t &idx : stmt.indexes)
+          Index::idx_insert_record(dbfile, idx, Page::rb_data(rec), rid);
+      }
+    }
+    catch(...)
+    {
+      if(page != nullptr)
+      {
+        Buffer_mgr::buf_write(dbfile, pg_id);
+        Buffer_mgr::buf_unpin(pg_id);
       }
+      throw; // the scope aborts its own transaction ; a caller's decides for itself
     }
 
-    Page::rec_finish(rec);
-    std::cout << "Record Length: " << rec.length() << std::endl;
+    Buffer_mgr::buf_write(dbfile, pg_id);
+    Buffer_mgr::buf_unpin(pg_id);
+    return rows.size();
+  }
+
+
+  size_t insert_batch(file_descriptor_t &dbfile, insert_stmt_t &stmt, const std::vector<std::vector<std::string>> &rows)
+  {
+    return tbl_fill_pages(dbfile, stmt, rows);
+  }
+
+
+  size_t insert_rows(file_descriptor_t &dbfile, insert_stmt_t &stmt, const std::vector<row_t> &rows)
+  {
+    return tbl_fill_pages(dbfile, stmt, rows);
+  }
+
+
+  void read_row(file_descriptor_t &dbfile, RID rid, std::string &rec, row_t &row)
+  {
+    tbl_pin_t pin(dbfile, rid.page_id);
+    void* page = pin.page;
+    std::shared_lock<std::shared_mutex> latch(Buffer_mgr::buf_latch(rid.page_id)); // a writer may be adding to the page
+    if(Page::pax_is_pax(page)) // the row is put back together from the minipages
+    {
+      if(!Page::pax_get_record(page, rid.rec_id, rec))
+        throw table_error("No record at the given RID.");
+      Page::rec_upackrow((void*)rec.data(), row);
+      return;
+    }
+    if(rid.rec_id >= *PG_NUM_RECORDS_PTR(page) || PG_DIRECTORY(page)[rid.rec_id] == Page::PG_REC_UNUSED)
+      throw table_error("No record at the given RID.");
+
+    uint16_t size;
+    void* ref = Page::rec_get_ref(page, rid.rec_id, size);
+    rec.assign((const char*)ref, size); // keeps its capacity, so a reused <rec> does not allocate
+    Page::rec_upackrow((void*)rec.data(), row);
+  }
+
+
+  void delete_rows(file_descriptor_t &dbfile, const std::vector<RID> &rids)
+  {
+    txn_scope_t scope(dbfile);
+    txn_id_t xid = scope.txn->xid;
+    for(size_t first = 0; first < rids.size(); )
+    {
+      uint16_t page_id = rids[first].page_id;
+      size_t end = first + 1;
+      while(end < rids.size() && rids[end].page_id == page_id)
+        end++;
+
+      txn_touch(dbfile, page_id); // the marks go with an abort
+      void* page = Buffer_mgr::buf_pin(dbfile, page_id);
+      bool conflict = false;
+      try
+      {
+        std::unique_lock<std::shared_mutex> latch(Buffer_mgr::buf_latch(page_id));
+        for(size_t r = first; r < end && !conflict; r++)
+        {
+          conflict = !mvcc_deleted(xid, rids[r]);
+          if(!conflict)
+            Page::pg_mark_deleted(page, rids[r].rec_id);
+        }
+      }
+      catch(...)
+      {
+        Buffer_mgr::buf_write(dbfile, page_id);
+        Buffer_mgr::buf_unpin(page_id);
+        throw;
+      }
+      Buffer_mgr::buf_write(dbfile, page_id);
+      Buffer_mgr::buf_unpin(page_id);
+      if(conflict)
+        throw table_error("A row was deleted by another transaction.");
+      first = end;
+    }
+  }
+
+
+  void tbl_pack_row(Page::rec_builder_t &rec, const insert_stmt_t &stmt, const std::vector<std::string> &row)
+  {
+    Page::rb_begin(rec);
+    for(int i = 0; i < stmt.td.col_types.size(); i++)
+    {
+      int v = stmt.val_idx[i];
+      if(v < 0 || v >= row.size()) // column was not supplied
+        Page::rb_packnull(rec);
+      else
+        Page::rb_packval(rec, tbl_parse_value(stmt.td.col_types[i], row[v]));
+    }
+    Page::rb_finish(rec);
+  }
+
+
+  void tbl_pack_row(Page::rec_builder_t &rec, const insert_stmt_t &stmt, const row_t &row)
+  {
+    Page::rb_begin(rec);
+    for(int i = 0; i < stmt.td.col_types.size(); i++)
+    {
+      int v = stmt.val_idx[i];
+      if(v < 0 || v >= row.size()) // column was not supplied
+        Page::rb_packnull(rec);
+      else
+        Page::rb_packval(rec, tbl_check_value(stmt.td.col_types[i], row[v]));
+    }
+    Page::rb_finish(rec);
+  }
 
-    uint16_t pg_loc = rec_find_free(dbfile, pgl, rec.length());
-    std::cout << "On Page: " << pg_loc << std::endl;
 
-    void* add_rec_page = (void*)Buffer_mgr::buf_read(dbfile, pg_loc);
-    uint16_t rec_idx = Page::pg_add_record(add_rec_page, (void*)rec.data(), rec.length());
-    Buffer_mgr::buf_write(dbfile, pg_loc);
-    std::cout << "Record Index: " << rec_idx << std::endl << std::endl;
+  size_t tbl_max_record_size(const std::vector<column_type_t> &cols)
+  {
+    size_t size = sizeof(uint16_t);
+    for(const column_type_t &col : cols)
+    {
+      size += sizeof(uint16_t);
+      if(col.type == TBL_TYPE_VCHAR)
+        size += col.max_size;
+      else if(col.type == TBL_TYPE_SHORT)
+        size += sizeof(int16_t);
+      else
+        size += sizeof(int32_t);
+    }
+    return size;
+  }
+
+
+  Page::value_t tbl_parse_value(const column_type_t &col, const std::string &str)
+  {
+    if(col.type == TBL_TYPE_VCHAR)
+      return tbl_check_value(col, Page::val_str(str));
+
+    /* The whole string must be a number that is in range for the column */
+    const char* begin = str.c_str();
+    char* end;
+    errno = 0;
+    long num = strtol(begin, &end, 10);
+    if(end == begin || *end != '\0' || errno == ERANGE)
+      throw table_error("Value \"" + str + "\" is not a number for column \"" + col.name + "\".");
+
+    if(col.type == TBL_TYPE_SHORT)
+    {
+      if(num < INT16_MIN || num > INT16_MAX)
+        throw table_error("Value \"" + str + "\" is out of range for column \"" + col.name + "\".");
+      return Page::val_short(num);
+    }
+    if(col.type == TBL_TYPE_INT)
+    {
+      if(num < INT32_MIN || num > INT32_MAX)
+        throw table_error("Value \"" + str + "\" is out of range for column \"" + col.name + "\".");
+      return Page::val_int(num);
+    }
+    throw table_error("Column \"" + col.name + "\" has an unknown type.");
+  }
+
+
+  Page::value_t tbl_check_value(const column_type_t &col, const Page::value_t &val)
+  {
+    if(val.type == Page::RTYPE_NULL)
+      return val;
+
+    if(col.type == TBL_TYPE_VCHAR && val.type == Page::RTYPE_STRING)
+    {
+      if(val.str.len > col.max_size)
+        throw table_error("String is longer than column \"" + col.name + "\" allows.");
+      return val;
+    }
+    if(col.type == TBL_TYPE_SHORT && val.type == Page::RTYPE_SHORT)
+      return val;
+    if(col.type == TBL_TYPE_INT && val.type == Page::RTYPE_INT)
+      return val;
+    if(col.type == TBL_TYPE_INT && val.type == Page::RTYPE_SHORT)
+      return Page::val_int(val.s);
+
+    throw table_error("Value type does not match column \"" + col.name + "\".");
   }
 
 
   void print_master(file_descriptor_t &dbfile)
   {
-    return;
+    print_table(dbfile, TBL_MASTER_NAME);
   }
 
 
   void print_table(file_descriptor_t &dbfile, const std::string &table_name)
   {
-    return;
+    scan_cursor_t cur;
+    scan_open(dbfile, table_name, {}, {}, cur);
+
+    std::cout << "TABLE: " << table_name << std::endl << "  ";
+    for(const column_type_t &col : cur.td.col_types)
+      std::cout << "|" << col.name;
+    std::cout << "|" << std::endl;
+
+    row_t row;
+    RID rid;
+    size_t num_rows = 0;
+    while(scan_next(cur, row, rid))
+    {
+      std::cout << "  ";
+      for(const Page::value_t &val : row)
+        std::cout << "|" << val;
+      std::cout << "|" << std::endl;
+      num_rows++;
+    }
+    std::cout << "(" << num_rows << " rows)" << std::endl;
   }
 
 
@@ -105,16 +552,25 @@ namespace Table
 
     /* Create "#master" table page with one entry for "#columns" table */
     table_page_t* mstr_page = static_cast<table_page_t*>(Buffer_mgr::buf_read(dbfile, TBL_MASTER_PAGE));
-    mstr_page->next_page = 0;
-    mstr_page->free_bytes -= sizeof(uint16_t); // so that page directory will never point to the next_page
+    tbl_init_page(mstr_page);
     Buffer_mgr::buf_write(dbfile, TBL_MASTER_PAGE);
 
     /* Create empty "#columns" table page */
     table_page_t* cols_page = static_cast<table_page_t*>(Buffer_mgr::buf_read(dbfile, TBL_COLUMNS_PAGE));
-    cols_page->free_bytes -= sizeof(uint16_t); // skip the next_page bytes
-    cols_page->next_page = 0;
+    tbl_init_page(cols_page); // skip the next_page bytes
     Buffer_mgr::buf_write(dbfile, TBL_COLUMNS_PAGE);
 
+    /* Hash indexes on "#master" names and "#columns" table names, so finding a table costs the same however many there are */
+    for(uint16_t slot : {TBL_META_MASTER_IDX, TBL_META_COLUMNS_IDX})
+    {
+      index_def_t idx;
+      tbl_catalog_def(slot, 0, idx);
+      Index::hx_create(dbfile, idx);
+      Page::Page_header_t* header = static_cast<Page::Page_header_t*>(Buffer_mgr::buf_read(dbfile, TBL_HEADER_PAGE));
+      header->meta[slot] = idx.root;
+      Buffer_mgr::buf_write(dbfile, TBL_HEADER_PAGE);
+    }
+
     struct triple {
       std::string name;
       uint16_t type;
@@ -127,6 +583,7 @@ namespace Table
                    {"fp", TBL_TYPE_SHORT, 1},
                    {"lp", TBL_TYPE_SHORT, 1},
                    {"type", TBL_TYPE_SHORT, 1},
+                   {"xp", TBL_TYPE_SHORT, 1},
                    {"def", TBL_TYPE_VCHAR, 40}};
 
     table_descriptor_t mstr_td;
@@ -136,7 +593,7 @@ namespace Table
     int mstr_count = 0;
     for (auto each : mstr)
     {
-      // |"name"|"fp"|"lp"|"type"|"def"|
+      // |"name"|"fp"|"lp"|"type"|"xp"|"def"|
       column_type_t mstr_ct;
       mstr_ct.name = each.name; // column name
       mstr_ct.ord = mstr_count;
@@ -175,31 +632,31 @@ namespace Table
   }
 
 
-  void create_table(file_descriptor_t &dbfile, const std::string &tname, const std::vector<col_def_t> &cols)
+  void create_table(file_descriptor_t &dbfile, const std::string &tname, const std::vector<col_def_t> &cols, uint16_t type)
   {
-    /* Get free page list with format: |numpgs|pg|pg|pg|pg| */
-    Page_file::page_free_t* pgfree = static_cast<Page_file::page_free_t*>(Buffer_mgr::buf_read(dbfile, Page_file::PGF_PAGES_FREE_ID));
-    
-    if(pgfree->size == 0) // if the free pages list is empty
-      throw table_error("No free pages available.");
-
-    /* Get the last page_id in the list of free pages, and then delete it from the list */
-    uint16_t free_page_id = pgfree->free[pgfree->size - 1];
-    pgfree->size--;
-
-    Buffer_mgr::buf_write(dbfile, Page_file::PGF_PAGES_FREE_ID); // Buffer the free pages page to maintain the buffer pool
-
-    /* Create a new master table row for the new table */
+    tbl_alloc_guard_t alloc(dbfile);
+    RID rid;
+    if(tname.empty() || tname.size() > TBL_NAME_SIZE)
+      throw table_error("Table name must be 1 to 40 characters.");
+    if(!master_lookup(dbfile, tname, rid).name.empty())
+      throw table_error("Table \"" + tname + "\" already exists.");
+    if(type != DB_TYPE_ROWS && type != DB_TYPE_PAX)
+      throw table_error("Unknown table type.");
+    if(cols.empty())
+      throw table_error("Table \"" + tname + "\" needs at least one column.");
+
+    /* The table takes no pages until its first record is added (see "extend_table()") */
     master_table_row_t new_mtr;
     new_mtr.name = tname;
-    new_mtr.first_page = free_page_id;
-    new_mtr.last_page = free_page_id;
+    new_mtr.first_page = 0;
+    new_mtr.last_page = 0;
 
     /* Pack all of the new table data and write to "#master" and "#columns" */
     table_descriptor_t create_td;
     create_td.name = new_mtr.name;
     create_td.first_page = new_mtr.first_page;
     create_td.last_page = new_mtr.last_page;
+    create_td.type = type;
     int cols_count = 0;
     for (auto each : cols)
     {
@@ -212,6 +669,14 @@ namespace Table
       create_td.col_types.push_back(cols_ct);
       cols_count++;
     }
+    if(type == DB_TYPE_PAX)
+    {
+      std::vector<BYTE> types;
+      std::vector<uint16_t> widths;
+      tbl_pax_fields(create_td.col_types, types, widths);
+      if(Page::pax_capacity(types, widths) == 0)
+        throw table_error("Columns of table \"" + tname + "\" are too wide for a PAX page.");
+    }
     write_new_table_descriptor(dbfile, create_td);
   }
 
@@ -220,8 +685,9 @@ namespace Table
   {
     if (location.last_page > 0) // if at least one page has been allocated...
     {
-      table_page_t* last_page = static_cast<table_page_t*>(Buffer_mgr::buf_read(dbfile, location.last_page)); // read last page allocated
-      if (last_page->free_bytes >= sizeof(uint16_t) + size) // if enough space in the last page for the record
+      tbl_pin_t pin(dbfile, location.last_page); // pin last page allocated
+      std::shared_lock<std::shared_mutex> latch(Buffer_mgr::buf_latch(location.last_page));
+      if (static_cast<table_page_t*>(pin.page)->free_bytes >= sizeof(uint16_t) + size) // if enough space in the last page for the record
       {
         return location.last_page; // return the last page
       }
@@ -242,197 +708,506 @@ namespace Table
   }
 
 
-  master_table_row_t master_find_table(std::string tname, void* page, RID &rid)
+  master_table_row_t master_find_table(const std::string &tname, void* page, RID &rid, uint16_t page_id)
   {
     Page::Page_t* mstr_page = (Page::Page_t*)page;
     uint16_t* offset_arr = PG_DIRECTORY(page); // pointer to the beginning of the page directory
-    uint16_t* mstr_nxt_page = (uint16_t*)page; // next page in the master table linked list
 
     master_table_row_t mtr;
-    for(int i = 0; i < mstr_page->dir_size; i++)
+    for(uint16_t i = 0; i < mstr_page->dir_size; i++)
     {
-      bool found = false;
-      std::string cur_tname = ""; // empty sting to store each table name
-      std::string cur_def = ""; // empty string to store each definition
-      int16_t u = sizeof(uint16_t); // u = 2 ; for easy traversal of the current master record
+      if(offset_arr[i] == Page::PG_REC_UNUSED)
+        continue;
+      BYTE* rec = (BYTE*)page + offset_arr[i];
+      if(!tbl_first_field_is(rec, tname)) // not the table we were looking for, try the next one
+        continue;
+
+      tbl_unpack_master_row(rec, mtr);
+      rid.page_id = page_id;
+      rid.rec_id = i;
+      break; // stop searching
+    }
 
-      uint16_t* cur_rec_len = (uint16_t*)((BYTE*)page + offset_arr[i]); // length of the current master record
-      uint16_t* tname_val = (uint16_t*)((BYTE*)page + offset_arr[i] + u); // table name length + 9
-      BYTE* tname_str = (BYTE*)((BYTE*)page + offset_arr[i] + (2*u)); // pointer to the beginning of the table name
+    return mtr;
+  }
 
-      int tname_len = (*tname_val - Page::RTYPE_STRING);
-      for(int j = 0; j < tname_len; j++) // loop through every character in the table name
-      {
-        cur_tname += *(tname_str + j); // append every character in the table name
-      }
 
-      if(tname == cur_tname) // if current table name matches
-        found = true; // found the table that we were looking for
-      else
+  master_table_row_t master_lookup(file_descriptor_t &dbfile, const std::string &tname, RID &rid)
+  {
+    master_table_row_t mtr;
+    index_def_t idx;
+    if(tbl_catalog_index(dbfile, TBL_META_MASTER_IDX, idx))
+    {
+      if(tname.size() > TBL_NAME_SIZE) // too long to have been created
+        return mtr;
+      std::vector<RID> rids;
+      Index::hx_lookup(dbfile, idx, Page::val_str(tname), rids);
+      if(!rids.empty())
       {
-        continue; // not the table we were looking for, try the next one
+        rid = rids[0];
+        tbl_pin_t pin(dbfile, rid.page_id);
+        std::shared_lock<std::shared_mutex> latch(Buffer_mgr::buf_latch(rid.page_id));
+        tbl_unpack_master_row((BYTE*)pin.page + PG_DIRECTORY(pin.page)[rid.rec_id], mtr);
       }
+      return mtr;
+    }
 
-      uint16_t* cur_first_page = (uint16_t*)((BYTE*)page + offset_arr[i] + (2*u) + tname_len + u); // pointer to the <first_page>
-      uint16_t* cur_last_page = (uint16_t*)((BYTE*)page + offset_arr[i] + (2*u) + tname_len + (3*u)); // pointer to <last_page>
-      uint16_t* cur_type = (uint16_t*)((BYTE*)page + offset_arr[i] + (2*u) + tname_len + (5*u)); // pointer to <type>
-      uint16_t* def_val = (uint16_t*)((BYTE*)page + offset_arr[i] + (2*u) + tname_len + (6*u)); // <def> length + 9
-      BYTE* def_str = (BYTE*)((BYTE*)page + offset_arr[i] + (2*u) + tname_len + (7*u)); // pointer to <def>
+    /* No catalog index: walk every page of "#master" */
+    for(uint16_t page_id = TBL_MASTER_PAGE; page_id != 0; )
+    {
+      tbl_pin_t pin(dbfile, page_id);
+      std::shared_lock<std::shared_mutex> latch(Buffer_mgr::buf_latch(page_id));
+      mtr = master_find_table(tname, pin.page, rid, page_id);
+      if(!mtr.name.empty())
+        return mtr;
+      page_id = static_cast<table_page_t*>(pin.page)->next_page;
+    }
+    return mtr;
+  }
 
-      int def_len = (*def_val - Page::RTYPE_STRING);
-      for(int k = 0; k < def_len; k++) // loop through every character in <def>
-      {
-        cur_def += *(def_str + k); // append every character in <def>
-      }
 
-      if(found)
+  void read_table_descriptor(file_descriptor_t &dbfile, const std::string &table_name, table_descriptor_t &table_descr)
+  {
+    RID rid;
+    master_table_row_t mstr_row = master_lookup(dbfile, table_name, rid);
+    if(mstr_row.name.empty())
+      throw table_error("Table \"" + table_name + "\" not found.");
+
+    table_descr.name = mstr_row.name;
+    table_descr.lock_id = ((uint32_t)rid.page_id << 16) | rid.rec_id;
+    table_descr.first_page = mstr_row.first_page;
+    table_descr.last_page = mstr_row.last_page;
+    table_descr.extent_page = mstr_row.extent_page;
+    table_descr.type = mstr_row.type;
+
+    index_def_t idx;
+    if(tbl_catalog_index(dbfile, TBL_META_COLUMNS_IDX, idx))
+    {
+      /* Straight to the table's own "#columns" rows */
+      std::vector<RID> rids;
+      Index::hx_lookup(dbfile, idx, Page::val_str(table_name), rids);
+      for(RID col_rid : rids)
       {
-        mtr.name = cur_tname;
-        mtr.first_page = *cur_first_page;
-        mtr.last_page = *cur_last_page;
-        mtr.type = *cur_type;
-        mtr.def = cur_def;
-        rid.page_id = 1; // I AM NOT LOOPING THROUGH ALL OF THE PAGES OF "#master" YET
-        rid.rec_id = i;
-        break; // stop searching
+        tbl_pin_t pin(dbfile, col_rid.page_id);
+        std::shared_lock<std::shared_mutex> latch(Buffer_mgr::buf_latch(col_rid.page_id));
+        table_descr.col_types.push_back(tbl_unpack_col_type((BYTE*)pin.page + PG_DIRECTORY(pin.page)[col_rid.rec_id]));
       }
-      else
+    }
+    else
+    {
+      /* No catalog index: walk every "#columns" page for the table's rows */
+      for(uint16_t page_id = TBL_COLUMNS_PAGE; page_id != 0; )
       {
-        throw table_error("Table name not found in #master table.");
+        tbl_pin_t pin(dbfile, page_id);
+        void* page = pin.page;
+        std::shared_lock<std::shared_mutex> latch(Buffer_mgr::buf_latch(page_id));
+        uint16_t* offset_arr = PG_DIRECTORY(page);
+        for(uint16_t i = 0; i < ((Page::Page_t*)page)->dir_size; i++)
+        {
+          if(offset_arr[i] != Page::PG_REC_UNUSED && tbl_first_field_is((BYTE*)page + offset_arr[i], table_name))
+            table_descr.col_types.push_back(tbl_unpack_col_type((BYTE*)page + offset_arr[i]));
+        }
+        page_id = static_cast<table_page_t*>(page)->next_page;
       }
     }
 
-    return mtr;
+    std::vector<column_type_t> &cols = table_descr.col_types;
+    std::sort(cols.begin(), cols.end(), [](const column_type_t &a, const column_type_t &b) { return a.ord < b.ord; });
   }
 
 
-  void read_table_descriptor(file_descriptor_t &dbfile, const std::string &table_name, table_descriptor_t &table_descr)
+  void extend_table(file_descriptor_t &pfile, pg_locations_t &location)
   {
-    int16_t u = sizeof(uint16_t); // u = 2 ; for easy traversal of the current record
+    tbl_alloc_guard_t alloc(pfile);
+    uint16_t old_last = location.last_page;
+    std::vector<uint16_t> page_ids;
+    tbl_take_pages(pfile, location, 1, page_ids);
+    uint16_t new_page_id = page_ids[0];
+
+    /* Format the new page as an empty table page ; its <next_page> is 0 because it's now the last page in the table.
+       It is formatted before it is linked, so a scan following the list never reaches it unformatted */
+    txn_touch(pfile, new_page_id);
+    table_page_t* new_page = static_cast<table_page_t*>(Buffer_mgr::buf_pin(pfile, new_page_id));
+    tbl_init_page(new_page);
+    Buffer_mgr::buf_write(pfile, new_page_id);
+    Buffer_mgr::buf_unpin(new_page_id);
+
+    /* If the table had at least one table page already allocated, add the new page to the end of the table linked list */
+    if (old_last != 0)
+    {
+      txn_touch(pfile, old_last);
+      table_page_t* old_last_page = static_cast<table_page_t*>(Buffer_mgr::buf_pin(pfile, old_last));
+      {
+        std::unique_lock<std::shared_mutex> latch(Buffer_mgr::buf_latch(old_last));
+        old_last_page->next_page = new_page_id;
+      }
+      Buffer_mgr::buf_write(pfile, old_last);
+      Buffer_mgr::buf_unpin(old_last);
+    }
+
+    /* Must change record in master table that holds last page (a catalog being bootstrapped may not have its row yet) */
     RID rid;
+    master_table_row_t mtr = master_lookup(pfile, location.name, rid);
+    if(mtr.name.empty())
+      return;
+    mtr.first_page = location.first_page;
+    mtr.last_page = location.last_page;
+    mtr.extent_page = location.extent_page;
+    write_updated_master_row(pfile, mtr, rid);
+  }
 
-    void* mstr_page = (void*)Buffer_mgr::buf_read(dbfile, TBL_MASTER_PAGE); // read the first page in the "#master" table
-    master_table_row_t mstr_row = master_find_table(table_name, mstr_page, rid); // assumes that you find the master row, would throw error otherwise
 
-    table_descr.name = mstr_row.name;
-    table_descr.first_page = mstr_row.first_page;
-    table_descr.last_page = mstr_row.last_page;
+  void tbl_page_map(file_descriptor_t &dbfile, const pg_locations_t &location, std::vector<uint16_t> &page_ids)
+  {
+    std::vector<extent_t> runs;
+    tbl_extent_runs(dbfile, location, runs);
+    page_ids.clear();
+    for(const extent_t &run : runs)
+    {
+      for(uint16_t i = 0; i < run.count; i++)
+        page_ids.push_back(run.first + i);
+    }
+  }
 
-    void* cols_page = (void*)Buffer_mgr::buf_read(dbfile, TBL_COLUMNS_PAGE); // read the first "#columns" page
-    while(true)
+
+  void tbl_extent_runs(file_descriptor_t &dbfile, const pg_locations_t &location, std::vector<extent_t> &runs)
+  {
+    runs.clear();
+    if(location.extent_page == 0) // no extent list: walk the chain and merge consecutive ids
     {
-      Page::Page_t* alt_cols_page = (Page::Page_t*)cols_page;
-      uint16_t* cols_nxt_page = (uint16_t*)cols_page; // next page in the master table linked list
+      for(uint16_t page_id = location.first_page; page_id != 0; )
+      {
+        if(!runs.empty() && runs.back().first + runs.back().count == page_id)
+          runs.back().count++;
+        else
+          runs.push_back({page_id, 1});
+        uint16_t next = static_cast<table_page_t*>(Buffer_mgr::buf_pin(dbfile, page_id))->next_page;
+        Buffer_mgr::buf_unpin(page_id);
+        page_id = next;
+      }
+      return;
+    }
 
-      for(int i = 0; i < alt_cols_page->dir_size; i++) //loop through all records in the current columns page
+    /* Pinned while it is read, so no other thread's read can replace it */
+    extent_page_t* ep = static_cast<extent_page_t*>(Buffer_mgr::buf_pin(dbfile, location.extent_page));
+    for(uint16_t e = 0; e < ep->num_extents; e++)
+    {
+      extent_t run = ep->extents[e];
+      if(location.last_page >= run.first && location.last_page < run.first + run.count) // the rest is not handed out yet
       {
-        std::string cur_tname = "";
-        std::string cur_cname = "";
+        run.count = location.last_page - run.first + 1;
+        runs.push_back(run);
+        break;
+      }
+      runs.push_back(run);
+    }
+    Buffer_mgr::buf_unpin(location.extent_page);
+  }
 
-        uint16_t* offset_arr = PG_DIRECTORY(cols_page); // get the list of offsets for the current "#columns" page
-        uint16_t* tname_val = (uint16_t*)((BYTE*)cols_page + offset_arr[i] + u); // next page in the master table linked list
-        BYTE* tname_str = (BYTE*)((BYTE*)cols_page + offset_arr[i] + (2*u)); // pointer to the beginning of the table name
 
-        int tname_len = (*tname_val - Page::RTYPE_STRING);
-        for(int j = 0; j < tname_len; j++) // loop through every character in the table name
-        {
-          cur_tname += *(tname_str + j); // append every character in the table name
-        }
+  /* Take a new extent for the table and record it, starting its extent list first if it has none ; returns the extent */
+  static extent_t tbl_add_extent(file_descriptor_t &dbfile, pg_locations_t &location, uint16_t need)
+  {
+    if(location.extent_page == 0)
+    {
+      /* A table that already has pages (a catalog) records them as its first extents */
+      std::vector<extent_t> runs;
+      tbl_extent_runs(dbfile, location, runs);
+      std::vector<uint16_t> ids;
+      tbl_alloc_pages(dbfile, 1, ids);
+      txn_touch(dbfile, ids[0]);
+      extent_page_t* ep = static_cast<extent_page_t*>(Buffer_mgr::buf_pin(dbfile, ids[0]));
+      memset((void*)ep, 0, sizeof(extent_page_t));
+      for(const extent_t &run : runs)
+        ep->extents[ep->num_extents++] = run;
+      Buffer_mgr::buf_write(dbfile, ids[0]);
+      Buffer_mgr::buf_unpin(ids[0]);
+      location.extent_page = ids[0];
+    }
 
-        if(cur_tname == table_name) // if the table name matches
-        {
-          /* Then unpack all of the data: name, ord, type, and max_size */
-          uint16_t* cname_val = (uint16_t*)((BYTE*)cols_page + offset_arr[i] + (2*u) + tname_len);
-          BYTE* cname_str = (BYTE*)((BYTE*)cols_page + offset_arr[i] + (2*u) + tname_len + u); // pointer to the beginning of <cname>
+    /* Each extent is about as large as the whole table so far, so the number of extents grows slowly */
+    extent_page_t* ep = static_cast<extent_page_t*>(Buffer_mgr::buf_pin(dbfile, location.extent_page));
+    uint32_t total = 0;
+    for(uint16_t e = 0; e < ep->num_extents; e++)
+      total += ep->extents[e].count;
+    Buffer_mgr::buf_unpin(location.extent_page); // taking the extent reads the free list, which may replace it
+    uint16_t want = std::max<uint32_t>(TBL_EXTENT_MIN, std::min<uint32_t>(TBL_EXTENT_MAX, std::max<uint32_t>(total, need)));
+
+    extent_t ext = tbl_alloc_extent(dbfile, want);
+    txn_touch(dbfile, location.extent_page);
+    ep = static_cast<extent_page_t*>(Buffer_mgr::buf_pin(dbfile, location.extent_page));
+    extent_t* last = ep->num_extents ? &ep->extents[ep->num_extents - 1] : nullptr;
+    if(last != nullptr && last->first + last->count == ext.first) // right after the last extent, so it just grows
+      last->count += ext.count;
+    else if(ep->num_extents == sizeof(ep->extents) / sizeof(extent_t))
+    {
+      Buffer_mgr::buf_unpin(location.extent_page);
+      throw table_error("Table \"" + location.name + "\" has too many extents.");
+    }
+    else
+      ep->extents[ep->num_extents++] = ext;
+    Buffer_mgr::buf_write(dbfile, location.extent_page);
+    Buffer_mgr::buf_unpin(location.extent_page);
+    return ext;
+  }
 
-          int cname_len = (*cname_val - Page::RTYPE_STRING);
-          for(int k = 0; k < cname_len; k++) // loop through every character in <cname>
-          {
-            cur_cname += *(cname_str + k); // append every character in the <cname>
-          }
 
-          uint16_t* cur_ord = (uint16_t*)((BYTE*)cols_page + offset_arr[i] + (2*u) + tname_len + u + cname_len + u); // get the current record <ord>
-          uint16_t* cur_type = (uint16_t*)((BYTE*)cols_page + offset_arr[i] + (2*u) + tname_len + u + cname_len + (3*u)); // get the current record <type>
-          uint16_t* cur_mxsz = (uint16_t*)((BYTE*)cols_page + offset_arr[i] + (2*u) + tname_len + u + cname_len + (5*u)); // get the current record <max_size>
-
-          /* Populate <table_descr> with all of the unpacked values */
-          column_type_t cur_ct;
-          cur_ct.name = cur_cname;
-          cur_ct.ord = *cur_ord;
-          cur_ct.type = *cur_type;
-          cur_ct.max_size = *cur_mxsz;
-          table_descr.col_types.push_back(cur_ct);
-        }
-        else
-          continue; // go to the next record in "#columns" 
-      }
-      if(*cols_nxt_page == 0) // if last page in the "#columns" table
+  void tbl_take_pages(file_descriptor_t &dbfile, pg_locations_t &location, uint16_t count, std::vector<uint16_t> &page_ids)
+  {
+    tbl_alloc_guard_t alloc(dbfile);
+    page_ids.clear();
+    while(page_ids.size() < count)
+    {
+      /* Bump through whatever is left of the last extent */
+      extent_t last = {0, 0};
+      if(location.extent_page != 0)
       {
-        break; // break out of the while loop because we have already read the last page in the table
+        extent_page_t* ep = static_cast<extent_page_t*>(Buffer_mgr::buf_pin(dbfile, location.extent_page));
+        if(ep->num_extents > 0)
+          last = ep->extents[ep->num_extents - 1];
+        Buffer_mgr::buf_unpin(location.extent_page);
       }
-      else
+      uint32_t end = last.first + last.count;
+      if(location.last_page == 0 || location.last_page < last.first || location.last_page + 1 >= end)
       {
-        void* cols_page = (void*)Buffer_mgr::buf_read(dbfile, (int)(*cols_nxt_page)); // read the next "#columns" page
+        extent_t ext = tbl_add_extent(dbfile, location, count - page_ids.size());
+        page_ids.push_back(ext.first);
+        if(location.first_page == 0)
+          location.first_page = ext.first;
+        location.last_page = ext.first;
+        continue;
       }
+      while(page_ids.size() < count && location.last_page + 1 < end)
+        page_ids.push_back(++location.last_page);
     }
+    txn_fresh(page_ids);
   }
 
 
-  void extend_table(file_descriptor_t &pfile, pg_locations_t &location)
+  extent_t tbl_alloc_extent(file_descriptor_t &dbfile, uint16_t want)
   {
+    tbl_alloc_guard_t alloc(dbfile);
     /* Get free page list with format: |numpgs|pg|pg|pg|pg| */
-    Page_file::page_free_t* pgfree = static_cast<Page_file::page_free_t*>(Buffer_mgr::buf_read(pfile, Page_file::PGF_PAGES_FREE_ID));
-    
-    if (pgfree->size == 0) // if the free pages list is empty
+    txn_touch(dbfile, Page_file::PGF_PAGES_FREE_ID);
+    Page_file::page_free_t* pgfree = static_cast<Page_file::page_free_t*>(Buffer_mgr::buf_pin(dbfile, Page_file::PGF_PAGES_FREE_ID));
+    if(pgfree->size == 0)
+    {
+      Buffer_mgr::buf_unpin(Page_file::PGF_PAGES_FREE_ID);
       throw table_error("No free pages available.");
+    }
 
-    /* Get the last page_id in the list of free pages, and then delete it from the list */
-    uint16_t free_page_id = pgfree->free[pgfree->size - 1];
-    pgfree->size--;
+    std::vector<uint16_t> ids(pgfree->free, pgfree->free + pgfree->size);
+    std::sort(ids.begin(), ids.end());
+    extent_t best = {0, 0};
+    for(size_t i = 0; i < ids.size(); )
+    {
+      size_t j = i + 1;
+      while(j < ids.size() && ids[j] == ids[j - 1] + 1)
+        j++;
+      if(j - i > best.count)
+        best = {ids[i], (uint16_t)std::min<size_t>(j - i, want)};
+      if(best.count == want)
+        break;
+      i = j;
+    }
 
-    // Buffer the free pages page to maintain the buffer pool
-    Buffer_mgr::buf_write(pfile, Page_file::PGF_PAGES_FREE_ID);
+    /* Drop the extent's ids from the list, keeping the others in their order */
+    uint16_t kept = 0;
+    for(uint16_t i = 0; i < pgfree->size; i++)
+    {
+      if(pgfree->free[i] < best.first || pgfree->free[i] >= best.first + best.count)
+        pgfree->free[kept++] = pgfree->free[i];
+    }
+    pgfree->size = kept;
+    Buffer_mgr::buf_write(dbfile, Page_file::PGF_PAGES_FREE_ID);
+    Buffer_mgr::buf_unpin(Page_file::PGF_PAGES_FREE_ID);
+    return best;
+  }
 
-    /* If the table had at least one table page already allocated, add the new page to the end of the table linked list */
-    if (location.last_page != 0)
+
+  void tbl_alloc_pages(file_descriptor_t &dbfile, uint16_t count, std::vector<uint16_t> &page_ids)
+  {
+    tbl_alloc_guard_t alloc(dbfile);
+    /* Get free page list with format: |numpgs|pg|pg|pg|pg| */
+    txn_touch(dbfile, Page_file::PGF_PAGES_FREE_ID);
+    Page_file::page_free_t* pgfree = static_cast<Page_file::page_free_t*>(Buffer_mgr::buf_pin(dbfile, Page_file::PGF_PAGES_FREE_ID));
+
+    if(pgfree->size < count)
     {
-      table_page_t* old_last = static_cast<table_page_t*>(Buffer_mgr::buf_read(pfile, location.last_page));
-      old_last->next_page = free_page_id;
-      Buffer_mgr::buf_write(pfile, location.last_page);
+      Buffer_mgr::buf_unpin(Page_file::PGF_PAGES_FREE_ID);
+      throw table_error("Not enough free pages available.");
     }
 
-    /* Set the table's last page <next_page> to 0 (because it's now the last page in the table) */
-    table_page_t* new_page = static_cast<table_page_t*>(Buffer_mgr::buf_read(pfile, free_page_id));
-    new_page->next_page = 0;
+    /* Take the last <count> page ids off the list ; for a freshly formatted file these are already consecutive */
+    page_ids.assign(pgfree->free + pgfree->size - count, pgfree->free + pgfree->size);
+    pgfree->size -= count;
+    Buffer_mgr::buf_write(dbfile, Page_file::PGF_PAGES_FREE_ID);
+    Buffer_mgr::buf_unpin(Page_file::PGF_PAGES_FREE_ID);
 
-    /* Correctly format the directory for the new page. This is breaking the layering and should be handled in the "paging" layer */
-    uint16_t* dir = PG_DIRECTORY(new_page);
-    dir[0] = 0;
-    new_page->dir_size = 1;
-    new_page->free_bytes -= sizeof(new_page->dir_size) + sizeof(uint16_t);
+    std::sort(page_ids.begin(), page_ids.end());
+    txn_fresh(page_ids);
+  }
 
-    /* Update the master table to reflect that the table has a new last page */
-    if (location.last_page == 0) // if no pages have yet been allocated for the table
-      location.first_page = location.last_page = free_page_id; 
-    else // if one or more pages have already been allocated to the table
-      location.last_page = free_page_id;
 
-    /* Buffer the new page that was added as the table's last page to maintain the buffer pool */
-    Buffer_mgr::buf_write(pfile, free_page_id);
+  void tbl_unlink_pages(file_descriptor_t &dbfile, pg_locations_t &location, const std::vector<uint16_t> &page_ids)
+  {
+    tbl_alloc_guard_t alloc(dbfile);
+    std::vector<uint16_t> chain, gone(page_ids), left;
+    tbl_page_map(dbfile, location, chain);
+    std::sort(gone.begin(), gone.end());
+
+    /* Link the page before each run of removed pages to the page after it */
+    uint16_t prev = 0; // the last page kept so far
+    bool relink = false;
+    for(size_t i = 0; i <= chain.size(); i++)
+    {
+      uint16_t page_id = i < chain.size() ? chain[i] : 0;
+      if(page_id != 0 && std::binary_search(gone.begin(), gone.end(), page_id))
+      {
+        relink = true;
+        continue;
+      }
+      if(relink && prev != 0)
+      {
+        txn_touch(dbfile, prev);
+        table_page_t* page = static_cast<table_page_t*>(Buffer_mgr::buf_pin(dbfile, prev));
+        {
+          std::unique_lock<std::shared_mutex> latch(Buffer_mgr::buf_latch(prev)); // a scan may be reading it
+          page->next_page = page_id;
+        }
+        Buffer_mgr::buf_write(dbfile, prev);
+        Buffer_mgr::buf_unpin(prev);
+      }
+      relink = false;
+      if(page_id != 0)
+        left.push_back(page_id);
+      prev = page_id;
+    }
+    uint16_t old_last = location.last_page;
+    location.first_page = left.empty() ? 0 : left.front();
+    location.last_page = left.empty() ? 0 : left.back();
+
+    if(location.extent_page != 0)
+    {
+      /* The rest of the last extent stays the table's only while the last page is still the one before it */
+      std::vector<uint16_t> unused;
+      extent_page_t* ep = static_cast<extent_page_t*>(Buffer_mgr::buf_pin(dbfile, location.extent_page));
+      extent_t last = ep->num_extents > 0 ? ep->extents[ep->num_extents - 1] : extent_t{0, 0};
+      Buffer_mgr::buf_unpin(location.extent_page);
+      if(old_last >= last.first && old_last < last.first + last.count)
+      {
+        for(uint32_t id = old_last + 1; id < (uint32_t)last.first + last.count; id++)
+          unused.push_back(id);
+      }
+
+      std::vector<extent_t> runs;
+      for(uint16_t page_id : left)
+      {
+        if(!runs.empty() && runs.back().first + runs.back().count == page_id)
+          runs.back().count++;
+        else
+          runs.push_back({page_id, 1});
+      }
+      if(!unused.empty() && location.last_page == old_last)
+      {
+        runs.back().count += unused.size();
+        unused.clear();
+      }
+      if(runs.size() > sizeof(ep->extents) / sizeof(extent_t))
+        throw table_error("Table \"" + location.name + "\" has too many extents.");
+
+      txn_touch(dbfile, location.extent_page);
+      ep = static_cast<extent_page_t*>(Buffer_mgr::buf_pin(dbfile, location.extent_page));
+      ep->num_extents = runs.size();
+      std::copy(runs.begin(), runs.end(), ep->extents);
+      Buffer_mgr::buf_write(dbfile, location.extent_page);
+      Buffer_mgr::buf_unpin(location.extent_page);
+      if(!unused.empty()) // never handed out, so no reader can be on them
+        tbl_free_pages(dbfile, unused);
+    }
 
-    /* Must change record in master table that holds last page */
-    void* page = Buffer_mgr::buf_read(pfile, TBL_MASTER_PAGE); // get "#master |rec1|...|recN|E|F|"
     RID rid;
-    master_table_row_t mtr = master_find_table(location.name, page, rid);
+    master_table_row_t mtr = master_lookup(dbfile, location.name, rid);
+    if(mtr.name.empty())
+      throw table_error("Table \"" + location.name + "\" not found.");
     mtr.first_page = location.first_page;
     mtr.last_page = location.last_page;
-    write_updated_master_row(pfile, mtr, rid);
+    mtr.extent_page = location.extent_page;
+    write_updated_master_row(dbfile, mtr, rid);
+  }
+
+
+  void tbl_free_pages(file_descriptor_t &dbfile, const std::vector<uint16_t> &page_ids)
+  {
+    tbl_alloc_guard_t alloc(dbfile);
+    txn_touch(dbfile, Page_file::PGF_PAGES_FREE_ID);
+    Page_file::page_free_t* pgfree = static_cast<Page_file::page_free_t*>(Buffer_mgr::buf_pin(dbfile, Page_file::PGF_PAGES_FREE_ID));
+    if(pgfree->size + page_ids.size() > sizeof(pgfree->free) / sizeof(uint16_t))
+    {
+      Buffer_mgr::buf_unpin(Page_file::PGF_PAGES_FREE_ID);
+      throw table_error("The free pages list is full.");
+    }
+
+    /* Pushed in descending order, so the lowest ids come off the list first */
+    std::vector<uint16_t> ids(page_ids);
+    std::sort(ids.begin(), ids.end(), std::greater<uint16_t>());
+    for(uint16_t id : ids)
+      pgfree->free[pgfree->size++] = id;
+    Buffer_mgr::buf_write(dbfile, Page_file::PGF_PAGES_FREE_ID);
+    Buffer_mgr::buf_unpin(Page_file::PGF_PAGES_FREE_ID);
+  }
+
+
+  void tbl_init_page(table_page_t* page)
+  {
+    memset((void*)page, 0, sizeof(table_page_t));
+    page->free_bytes = Page::PG_INITIAL_BYTES - sizeof(uint16_t); // so that page directory will never point to the next_page
+  }
+
+
+  void tbl_init_pax_page(void* page, const std::vector<column_type_t> &cols)
+  {
+    std::vector<BYTE> types;
+    std::vector<uint16_t> widths;
+    tbl_pax_fields(cols, types, widths);
+    Page::pax_init_page(page, types, widths);
+  }
+
+
+  /* Append a packed row to the last page of "#master" or "#columns", extending the catalog when that page is full */
+  static RID tbl_append_catalog_row(file_descriptor_t &dbfile, const std::string &catalog, const std::string &rec)
+  {
+    tbl_alloc_guard_t alloc(dbfile);
+    RID rid;
+    pg_locations_t pgl = master_lookup(dbfile, catalog, rid);
+    if(pgl.name.empty()) // the catalog's own row is not written yet while formatting
+    {
+      pgl.name = catalog;
+      pgl.first_page = pgl.last_page = (catalog == TBL_MASTER_NAME) ? TBL_MASTER_PAGE : TBL_COLUMNS_PAGE;
+    }
+
+    table_page_t* page = static_cast<table_page_t*>(Buffer_mgr::buf_pin(dbfile, pgl.last_page));
+    if(page->free_bytes < sizeof(uint16_t) + rec.size())
+    {
+      Buffer_mgr::buf_unpin(pgl.last_page);
+      extend_table(dbfile, pgl);
+      page = static_cast<table_page_t*>(Buffer_mgr::buf_pin(dbfile, pgl.last_page));
+    }
+    rid.page_id = pgl.last_page;
+    txn_touch(dbfile, rid.page_id);
+    {
+      std::unique_lock<std::shared_mutex> latch(Buffer_mgr::buf_latch(rid.page_id));
+      rid.rec_id = Page::pg_add_record((void*)page, (void*)rec.data(), rec.size());
+    }
+    Buffer_mgr::buf_write(dbfile, rid.page_id);
+    Buffer_mgr::buf_unpin(rid.page_id);
+    return rid;
   }
 
 
   void write_new_table_descriptor(file_descriptor_t &dbfile, const table_descriptor_t &td)
   {
-    std::string mstr_str; // empty master string for packing data
+    tbl_alloc_guard_t alloc(dbfile);
     std::string cols_str; // empty columns string for packing data
 
     /* Create a new <master_table_row> and assign all the appropriate values from <td> */
@@ -440,86 +1215,75 @@ namespace Table
     mtr.name = td.name; // the name for the new table (<tname>)
     mtr.first_page = td.first_page;
     mtr.last_page = td.last_page;
-    mtr.type = 0;
+    mtr.type = td.type;
+    mtr.extent_page = td.extent_page;
     mtr.def = "0";
 
-    // I AM NOT LOOPING THROUGH THE LINKED LIST YET TO FIND THE LAST PAGE BEFORE READING AND CHECKING THE FREE BYTES
-    /* Create record in "#master" for the new table and write to buffer */
-    Page::Page_t* mstr_page = static_cast<Page::Page_t*>(Buffer_mgr::buf_read(dbfile, TBL_MASTER_PAGE)); // get "#master |rec1|...|recN|E|F|"
-    tbl_pack_master_row(mstr_str, mtr);
+    /* Create record in "#master" for the new table */
+    write_new_master_row(dbfile, mtr);
 
-    // CANNOT EXTEND THE MASTER TABLE IF THERE ARE NO RECORDS FOR IT IN "#master" or "#columns"
-    if(mstr_str.size() > mstr_page->free_bytes) // if record cannot fit in original "#master" page (page 1)
-    {
-      pg_locations_t mstr_pgl; // create new empty <page_locations_t> for master
-      mstr_pgl.name = td.name; // the name for the new table (<tname>)
-      mstr_pgl.first_page = td.first_page;
-      mstr_pgl.last_page = td.last_page;
-      extend_table(dbfile, mstr_pgl); // extend the master table
-      Page::Page_t* ext_mstr_page = static_cast<Page::Page_t*>(Buffer_mgr::buf_read(dbfile, mstr_pgl.last_page)); // read the last page in "#master"
-      Page::pg_add_record((void*)ext_mstr_page, (void*)mstr_str.data(), mstr_str.size()); // add record to "#master" last page
-      Buffer_mgr::buf_write(dbfile, mstr_pgl.last_page); // write "#master" last page to buffer
-    }
-    else // new record can fit in the original "#master" page
-    {
-      Page::pg_add_record((void*)mstr_page, (void*)mstr_str.data(), mstr_str.size());
-      Buffer_mgr::buf_write(dbfile, TBL_MASTER_PAGE);
-    }
-
-    // I AM NOT LOOPING THROUGH THE LINKED LIST YET TO FIND THE LAST PAGE BEFORE READING AND CHECKING THE FREE BYTES
-    /* Create records in "#columns" for all of the unique columns in the new table and write to buffer */
-    Page::Page_t* cols_page = static_cast<Page::Page_t*>(Buffer_mgr::buf_read(dbfile, TBL_COLUMNS_PAGE)); // get "#columns |rec1|...|recN|E|F|"
+    /* Create records in "#columns" for all of the unique columns in the new table, and index each one by table name */
+    index_def_t idx;
+    bool indexed = tbl_catalog_index(dbfile, TBL_META_COLUMNS_IDX, idx);
     for(int i = 0; i < td.col_types.size(); i++) // loop through all of the column types in the vector
     {
       tbl_pack_col_type(cols_str, mtr.name, td.col_types[i]);
-
-      if(cols_str.size() > cols_page->free_bytes) // if record cannot fit in "#columns"
-      {
-        /* Create a new <page_locations_t> and assign the appropriate values from <td> */
-        pg_locations_t cols_pgl;
-        cols_pgl.name = td.name; // the name for the new table (<tname>)
-        cols_pgl.first_page = td.first_page;
-        cols_pgl.last_page = td.last_page;
-        extend_table(dbfile, cols_pgl); 
-        Page::Page_t* ext_cols_page = static_cast<Page::Page_t*>(Buffer_mgr::buf_read(dbfile, cols_pgl.last_page));
-        Page::pg_add_record((void*)ext_cols_page, (void*)cols_str.data(), cols_str.size());
-        Buffer_mgr::buf_write(dbfile, cols_pgl.last_page);
-      }
-      else
-      {
-        Page::pg_add_record((void*)cols_page, (void*)cols_str.data(), cols_str.size());
-      } 
+      RID rid = tbl_append_catalog_row(dbfile, TBL_COLUMN_NAME, cols_str);
+      if(indexed)
+        Index::hx_insert(dbfile, idx, Page::val_str(td.name), rid);
     }
-
-    Buffer_mgr::buf_write(dbfile, TBL_COLUMNS_PAGE);
   }
 
   
+  RID write_new_master_row(file_descriptor_t &dbfile, const master_table_row_t &mtr)
+  {
+    tbl_alloc_guard_t alloc(dbfile);
+    std::string mstr_str; // empty master string for packing data
+    tbl_pack_master_row(mstr_str, mtr);
+    RID rid = tbl_append_catalog_row(dbfile, TBL_MASTER_NAME, mstr_str);
+
+    index_def_t idx;
+    if(tbl_catalog_index(dbfile, TBL_META_MASTER_IDX, idx))
+      Index::hx_insert(dbfile, idx, Page::val_str(mtr.name), rid);
+    return rid;
+  }
+
+
   void write_updated_master_row(file_descriptor_t &dbfile, const master_table_row_t &td, RID rid)
   {
+    tbl_alloc_guard_t alloc(dbfile);
     int16_t u = sizeof(uint16_t); // u = 2 ; for easy traversal of the current master record
-    void* mstr_page = (void*)Buffer_mgr::buf_read(dbfile, rid.page_id);
+    txn_touch(dbfile, rid.page_id);
+    void* mstr_page = (void*)Buffer_mgr::buf_pin(dbfile, rid.page_id);
+    std::unique_lock<std::shared_mutex> latch(Buffer_mgr::buf_latch(rid.page_id)); // readers of the row see it before or after
     uint16_t* offset_arr = PG_DIRECTORY(mstr_page); // pointer to the beginning of the page directory
 
+    uint16_t* update_first_page = (uint16_t*)((BYTE*)mstr_page + offset_arr[rid.rec_id] + (2*u) + (td.name).length() + u); // pointer to <first_page>
     uint16_t* update_last_page = (uint16_t*)((BYTE*)mstr_page + offset_arr[rid.rec_id] + (2*u) + (td.name).length() + (3*u)); // pointer to <last_page>
     uint16_t* update_type = (uint16_t*)((BYTE*)mstr_page + offset_arr[rid.rec_id] + (2*u) + (td.name).length() + (5*u)); // pointer to <type>
+    uint16_t* update_extent_page = (uint16_t*)((BYTE*)mstr_page + offset_arr[rid.rec_id] + (2*u) + (td.name).length() + (7*u)); // pointer to <xp>
 
+    *update_first_page = td.first_page; // assign updated value to the pointer location at <first_page>
     *update_last_page = td.last_page; // assign updated value to the pointer location at <last_page>
     *update_type = td.type; // assign updated value to the pointer location at <type>
+    *update_extent_page = td.extent_page; // assign updated value to the pointer location at <xp>
     // NOT UPDATING THE DEFINITION YET
+    latch.unlock();
 
     Buffer_mgr::buf_write(dbfile, rid.page_id);
+    Buffer_mgr::buf_unpin(rid.page_id);
   }
 
 
   void tbl_pack_master_row(std::string &rec, const master_table_row_t &row)
   {
-    /* The "#master" page format: |name|fp|lp|type|def| */
+    /* The "#master" page format: |name|fp|lp|type|xp|def| */
     Page::rec_begin(rec);
     Page::rec_packstr(rec, row.name);
     Page::rec_packshort(rec, row.first_page);
     Page::rec_packshort(rec, row.last_page);
     Page::rec_packshort(rec, row.type);
+    Page::rec_packshort(rec, row.extent_page);
     Page::rec_packstr(rec, row.def);
     Page::rec_finish(rec);
   }
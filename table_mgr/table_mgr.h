@@ -16,13 +16,21 @@
 /*************************************************************************************************
   The catalog is made up of a header page (0), "#master" page (1), a "#columns" page (2), and a free page list (3)
 
-  A record/row in the "#master" page follows the format: |type|name|fp|lp|def|
-    Every unique table only has one record in the "#master" page
+  A record/row in the "#master" page follows the format: |name|fp|lp|type|xp|def|
+    Every unique table only has one record in the "#master" page ; <xp> is its extent list page
   
   A record/row in the "#columns" page follows the format: |tname|colname|ord|type|size|
     Every unique table has many records in the "#columns" page because a table can have many columns in it
 *************************************************************************************************/
 
+/*************************************************************************************************
+  A table's pages are handed out from extents: runs of consecutive pages taken off the free list
+  together. The extents are recorded in order on the table's extent list page, and the page chain
+  runs through them in that order. A new page is the one after <lp> while the last extent has
+  room ; only when it is used up is a new extent taken, sized to the table (TBL_EXTENT_MIN to
+  TBL_EXTENT_MAX pages). A table takes no pages at all until its first record is added.
+*************************************************************************************************/
+
 /********************************************* GUARD *********************************************/
 
 #ifndef TABLE_MANAGER_H
@@ -31,6 +39,7 @@
 /***************************************** HEADER FILES ******************************************/
 
 #include "../paging/paging.h"
+#include "../paging/record_builder.h"
 
 #include <climits>
 #include <cstdint>
@@ -66,12 +75,28 @@ namespace Table
     uint16_t max_size;
   };
 
-  /* Structure that collects the first 3 variables from a record in the "#master" page */
+  /* Structure that collects the page locations from a record in the "#master" page */
   struct pg_locations_t
   {
     std::string name;
     uint16_t first_page;
     uint16_t last_page;
+    uint16_t extent_page = 0; // the table's extent list (0 until it has one)
+  };
+
+  /* Structure for one extent: <count> consecutive pages starting at <first> */
+  struct extent_t
+  {
+    uint16_t first;
+    uint16_t count;
+  };
+
+  /* Structure that formats a table's extent list page */
+  struct extent_page_t
+  {
+    uint16_t num_extents;
+    uint16_t unused;
+    extent_t extents[(PAGE_SIZE - 2 * sizeof(uint16_t)) / sizeof(extent_t)];
   };
 
   /* Structure that collects the last 2 variables from a record in the "#master" page ; also inherits from <pg_locations_t> */
@@ -86,6 +111,8 @@ namespace Table
   struct table_descriptor_t : public pg_locations_t
   {
     std::vector<column_type_t> col_types;
+    uint16_t type = 0; // DB_TYPE_ROWS or DB_TYPE_PAX, from the table's "#master" row
+    uint32_t lock_id = 0; // names the table to the lock manager: the RID of its "#master" row, which never moves
   };
 
   /* Structure that holds data necessary for creating a new table */
@@ -95,6 +122,31 @@ namespace Table
     uint16_t type;
     uint16_t size;
   };
+
+  /* Structure that describes an index, as recorded in its "#master" row: |name|fp=root|lp=first leaf|type|def="table.column"|
+     (a hash index keeps its directory page in both <fp> and <lp>) */
+  struct index_def_t
+  {
+    std::string name;
+    std::string table;
+    std::string column;
+    uint16_t col; // position of the indexed column in the table's records (by <ord>)
+    uint16_t key_type; // TBL_TYPE_* of the indexed column
+    uint16_t key_size; // bytes of one key in an index page
+    uint16_t type; // DB_TYPE_* of the index
+    uint16_t root; // B+tree root, or hash directory page
+    uint16_t first_leaf;
+    RID master_rid; // the index's row in "#master"
+  };
+
+  /* Structure that holds an insert whose column order has been resolved once, so that many rows can be packed without catalog lookups */
+  struct insert_stmt_t
+  {
+    table_descriptor_t td; // columns are kept sorted by <ord>, which is the order they are packed in
+    std::vector<int> val_idx; // for each column, the index of its value in a row (-1 if the column is not supplied)
+    std::vector<index_def_t> indexes; // every index on the table, kept up to date by the insert
+    Page::rec_builder_t rec; // each row is packed here, in an arena sized for the widest row the table allows
+  };
 }
 
 /******************************************* CONSTANTS *******************************************/
@@ -103,6 +155,16 @@ namespace Table
 {
   const uint16_t TBL_TYPE_VCHAR = 9;
   const uint16_t TBL_TYPE_SHORT = 2;
+  const uint16_t TBL_TYPE_INT = 4;
+
+  const uint16_t TBL_HEADER_PAGE = 0;
+  const uint16_t TBL_META_MASTER_IDX = 0; // header <meta> slot: directory page of the hash index on "#master" names
+  const uint16_t TBL_META_COLUMNS_IDX = 1; // header <meta> slot: directory page of the hash index on "#columns" table names
+  const uint16_t TBL_META_VAC_LIMBO = 2; // header <meta> slot: the list of pages vacuums took out of tables, not freed yet ("vacuum.h")
+  const uint16_t TBL_NAME_SIZE = 40; // longest table (or index) name
+
+  const uint16_t TBL_EXTENT_MIN = 8; // pages in a table's first extent
+  const uint16_t TBL_EXTENT_MAX = 64; // a table's extents double in size up to this many pages
 
   const char TBL_MASTER_NAME[] = "#master";
   const uint16_t TBL_MASTER_PAGE = 1;
@@ -110,7 +172,14 @@ namespace Table
   const char TBL_COLUMN_NAME[] = "#columns";
   const uint16_t TBL_COLUMNS_PAGE = 2;
 
+  const uint16_t DB_TYPE_ROWS = 0; // a "#master" row with this <type> is a table stored in row pages
   const uint16_t DB_TYPE_TABLE = 1;
+  const uint16_t DB_TYPE_BTREE = 2; // a "#master" row with this <type> is a B+tree index
+  const uint16_t DB_TYPE_HASH = 3; // a "#master" row with this <type> is an extendible hash index
+  const uint16_t DB_TYPE_PAX = 4; // a "#master" row with this <type> is a table stored in PAX pages (see "pax_page.h")
+
+  const BYTE TBL_BULK_CSV = 0; // one row per line, values in column order separated by ',' ; an empty value is NULL
+  const BYTE TBL_BULK_BINARY = 1; // records back-to-back, each built with "Page::rec_begin()" ... "Page::rec_finish()"
 
   //const BYTE TBL_MOD_MASTER = 0x1;
   //const BYTE TBL_MOD_TYPE = 0x2;
@@ -121,6 +190,7 @@ namespace Table
 namespace Table
 {
   typedef std::pair<std::string, std::string> colval_t; // used for the "insert_into()" function
+  typedef std::vector<Page::value_t> row_t; // one typed value per column, used for "insert_rows()" and "read_row()"
 }
 
 namespace Table
@@ -137,7 +207,42 @@ namespace Table
 
   /************************************* FUNCTION PROTOTYPES *************************************/
 
-  void insert_into(file_descriptor_t &dbfile, const std::string &table_name, std::vector<colval_t> values);
+  void insert_into(file_descriptor_t &dbfile, const std::string &table_name, const std::vector<colval_t> &values);
+
+  /* Resolve the columns named in <col_names> against the table's "#columns" records ; rows given to "insert_batch()" list values in this order */
+  void prepare_insert(file_descriptor_t &dbfile, const std::string &table_name, const std::vector<std::string> &col_names, insert_stmt_t &stmt);
+
+  /* Pack every row back-to-back into the table's pages, marking each touched page dirty once ; returns the number of rows inserted */
+  size_t insert_batch(file_descriptor_t &dbfile, insert_stmt_t &stmt, const std::vector<std::vector<std::string>> &rows);
+
+  /* Load every row in the file <fname> (see TBL_BULK_*) into the table. Rows are parsed and packed into whole pages by <nthreads>
+     workers, and the pages are written straight to the DB file, bypassing the buffer pool ; returns the number of rows loaded */
+  size_t bulk_load(file_descriptor_t &dbfile, const std::string &table_name, const char fname[], BYTE format, unsigned nthreads);
+
+  /* Same as "insert_batch()", but the values are already typed, so nothing is parsed */
+  size_t insert_rows(file_descriptor_t &dbfile, insert_stmt_t &stmt, const std::vector<row_t> &rows);
+
+  /* Copy the record at <rid> into <rec> and unpack its values into <row> ; string values point into <rec>. The page is pinned
+     and latched while it is copied, so the caller must not hold its latch */
+  void read_row(file_descriptor_t &dbfile, RID rid, std::string &rec, row_t &row);
+
+  /* Delete the rows at <rids> in the calling thread's transaction (or one of its own), which holds X on their table: each is
+     recorded in the version store and marked deleted on its page (see "mvcc.h"), one latch and one dirty mark per run of RIDs
+     on the same page ; throws a <table_error> if another transaction deleted one first */
+  void delete_rows(file_descriptor_t &dbfile, const std::vector<RID> &rids);
+
+  /* Pack one row of <stmt> into <rec> in column order, with a NULL for every column that is not supplied */
+  void tbl_pack_row(Page::rec_builder_t &rec, const insert_stmt_t &stmt, const std::vector<std::string> &row);
+  void tbl_pack_row(Page::rec_builder_t &rec, const insert_stmt_t &stmt, const row_t &row);
+
+  /* Bytes of the largest record the columns allow: every string at its <max_size>, and every number as wide as it gets */
+  size_t tbl_max_record_size(const std::vector<column_type_t> &cols);
+
+  /* Parse <str> as a value of the column's type ; throws a <table_error> if it is not a valid value for that column */
+  Page::value_t tbl_parse_value(const column_type_t &col, const std::string &str);
+
+  /* Throws a <table_error> if <val> cannot be stored in the column ; returns the value as stored (shorts widen to ints) */
+  Page::value_t tbl_check_value(const column_type_t &col, const Page::value_t &val);
 
   void print_master(file_descriptor_t &dbfile); 
   
@@ -146,7 +251,9 @@ namespace Table
   /* Bootstrapper for tables. Creates #master and #columns */
   void tbl_format(const char fname[], uint16_t npages);
 
-  void create_table(file_descriptor_t &dbfile, const std::string &tname, const std::vector<col_def_t> &cols);
+  /* Create an empty table of at least one column ; <type> picks its page layout, DB_TYPE_ROWS or DB_TYPE_PAX (one minipage
+     per column, for tables that are mostly scanned on a few columns) */
+  void create_table(file_descriptor_t &dbfile, const std::string &tname, const std::vector<col_def_t> &cols, uint16_t type = DB_TYPE_ROWS);
 
   /* Iterate through allocated pages for a table and find the first page that has enough free bytes to contain a record of given size */
   uint16_t rec_find_free(file_descriptor_t &dbfile, pg_locations_t &location, uint16_t size);
@@ -154,17 +261,57 @@ namespace Table
   /* Allocate a free page by removing it from the free pages list and adding it to the end of this table's linked list */
   uint16_t extend(table_descriptor_t td);
 
-  master_table_row_t master_find_table(std::string tname, void* page, RID &rid);
+  /* Find a table's row on one "#master" page ; the returned row has an empty name if it is not there */
+  master_table_row_t master_find_table(const std::string &tname, void* page, RID &rid, uint16_t page_id = TBL_MASTER_PAGE);
+
+  /* Find a table's row anywhere in "#master", through the catalog hash index when the file has one ; empty name if there is none */
+  master_table_row_t master_lookup(file_descriptor_t &dbfile, const std::string &tname, RID &rid);
 
+  /* Read a table's "#master" row and its columns, sorted by <ord> ; throws a <table_error> if there is no such table */
   void read_table_descriptor(file_descriptor_t &dbfile, const std::string &table_name, table_descriptor_t &table_descr);
 
   void extend_table(file_descriptor_t &pfile, pg_locations_t &location);
 
+  /* Every page of the table, in chain order */
+  void tbl_page_map(file_descriptor_t &dbfile, const pg_locations_t &location, std::vector<uint16_t> &page_ids);
+
+  /* The table's pages as runs of consecutive ids, in chain order, up to its last page */
+  void tbl_extent_runs(file_descriptor_t &dbfile, const pg_locations_t &location, std::vector<extent_t> &runs);
+
+  /* Hand out the next <count> pages of the table, in chain order: the rest of its last extent first, then new extents.
+     The pages are neither formatted nor linked ; <location.last_page> (and <first_page> for an empty table) move to them */
+  void tbl_take_pages(file_descriptor_t &dbfile, pg_locations_t &location, uint16_t count, std::vector<uint16_t> &page_ids);
+
+  /* Remove a run of up to <want> consecutive pages from the free pages list: the lowest run that is long enough, or else
+     the longest one there is */
+  extent_t tbl_alloc_extent(file_descriptor_t &dbfile, uint16_t want);
+
+  /* Remove <count> pages from the free pages list ; <page_ids> comes back sorted so that runs of ids can be written sequentially */
+  void tbl_alloc_pages(file_descriptor_t &dbfile, uint16_t count, std::vector<uint16_t> &page_ids);
+
+  /* Take pages out of the table: the page before each one is linked past it, the extent list is rewritten as the runs of the
+     pages left, and "#master" is updated. The pages keep their own <next_page>, so a scan already on one still finds its way
+     back into the chain ; the caller frees them once no reader can be there (see "vacuum.h"). If the last page moves, the
+     pages of the last extent not handed out yet go straight back on the free list */
+  void tbl_unlink_pages(file_descriptor_t &dbfile, pg_locations_t &location, const std::vector<uint16_t> &page_ids);
+
+  /* Put pages back on the free pages list ; their contents are left as they are */
+  void tbl_free_pages(file_descriptor_t &dbfile, const std::vector<uint16_t> &page_ids);
+
+  /* Format a page as an empty table page, with the <next_page> bytes kept out of the record area */
+  void tbl_init_page(table_page_t* page);
+
+  /* Lay out a page as an empty PAX page for the table's columns (sorted by <ord>) */
+  void tbl_init_pax_page(void* page, const std::vector<column_type_t> &cols);
+
   /* Create master record and append to "#master" and for each in <col_types>, create column record and append to "#columns" */
   void write_new_table_descriptor(file_descriptor_t &dbfile, const table_descriptor_t &td);
 
   void write_updated_master_row(file_descriptor_t &dbfile, const master_table_row_t &td, RID rid);
 
+  /* Append a row to "#master" ; returns where it was written */
+  RID write_new_master_row(file_descriptor_t &dbfile, const master_table_row_t &mtr);
+
   void tbl_pack_master_row(std::string &rec, const master_table_row_t &row);
 
   void tbl_pack_col_type(std::string &rec, const std::string &tname, const column_type_t &colt);
@@ -0,0 +1,280 @@
+/**************************************************************************************************
+* Filename:   table_modify.cpp
+* Details:    Implements the deletes and updates declared in "table_modify.h".
+**************************************************************************************************/
+
+/****************************************** HEADER FILES *****************************************/
+
+#include "table_modify.h"
+#include "transaction.h"
+#include "../buffer_mgr/buffer_mgr.h"
+#include "../lock_mgr/lock_mgr.h"
+#include "../index_mgr/index_mgr.h"
+
+#include <algorithm>
+#include <mutex>
+#include <shared_mutex>
+
+/************************************** IMPLEMENT STRUCTURES *************************************/
+
+namespace Table
+{
+  /* Structure for a matching row: its RID, and where its new version is packed */
+  struct mod_row_t
+  {
+    RID rid;
+    size_t at; // offset in <tbl_update_t.recs>
+  };
+
+  /* Structure for an update in progress */
+  struct tbl_update_t
+  {
+    file_descriptor_t* dbfile;
+    txn_id_t xid;
+    insert_stmt_t stmt; // every column, in <ord> order
+    std::vector<std::pair<uint16_t, Page::value_t>> sets; // position of each column set, and its value as stored
+    std::vector<bool> index_set; // for each of <stmt.indexes>, true if it is on a column the update sets
+    bool reindex = false; // true if any is
+    std::vector<mod_row_t> rows; // in the order the scan found them, so page by page
+    std::vector<BYTE> recs; // the new versions, back to back
+    std::vector<size_t> moved; // those that go to the table's last pages
+    modify_stats_t stats;
+  };
+}
+
+/************************************ FUNCTION IMPLEMENTATIONS ***********************************/
+
+namespace Table
+{
+  /* Lock the table for the running transaction ; writers to a table with indexes take X anyway (see "table_mgr.cpp"), and a
+     delete or update takes it whatever the table has, so no one deletes the rows it matched under it */
+  static void tbl_lock_modify(file_descriptor_t &dbfile, txn_id_t xid, const std::string &table_name, table_descriptor_t &td)
+  {
+    read_table_descriptor(dbfile, table_name, td);
+    Lock_mgr::lock_table(xid, td.lock_id, Lock_mgr::LOCK_X);
+  }
+
+
+  modify_stats_t delete_where(file_descriptor_t &dbfile, const std::string &table_name, const std::vector<scan_pred_t> &preds)
+  {
+    modify_stats_t stats;
+    txn_scope_t scope(dbfile);
+    table_descriptor_t td;
+    tbl_lock_modify(dbfile, scope.txn->xid, table_name, td);
+    if(td.col_types.empty()) // files older than the check in "create_table()" may hold a table with no columns, and no rows
+      return stats;
+
+    /* The matching rows are gathered first, so each page is latched and marked dirty once for all of its rows */
+    scan_cursor_t cur;
+    scan_open(dbfile, table_name, preds, {td.col_types[0].name}, cur); // one column, which is never looked at
+    row_t row;
+    RID rid;
+    std::vector<RID> rids;
+    try
+    {
+      while(scan_next(cur, row, rid))
+        rids.push_back(rid);
+    }
+    catch(...)
+    {
+      scan_close(cur);
+      throw;
+    }
+    delete_rows(dbfile, rids);
+    stats.rows = rids.size();
+    for(size_t r = 0; r < rids.size(); r++)
+      stats.pages += r == 0 || rids[r].page_id != rids[r - 1].page_id;
+    return stats;
+  }
+
+
+  /* Gather the rows that match and pack their new versions, before any is written: a new version the scan reached would be
+     matched again */
+  static void tbl_update_gather(tbl_update_t &upd, const std::string &table_name, const std::vector<scan_pred_t> &preds)
+  {
+    scan_cursor_t cur;
+    scan_open(*upd.dbfile, table_name, preds, {}, cur); // every column, in the order the statement packs them
+    row_t row;
+    RID rid;
+    try
+    {
+      while(scan_next(cur, row, rid))
+      {
+        for(const std::pair<uint16_t, Page::value_t> &set : upd.sets)
+          row[set.first] = set.second;
+        tbl_pack_row(upd.stmt.rec, upd.stmt, row);
+        upd.rows.push_back({rid, upd.recs.size()});
+        const BYTE* rec = Page::rb_data(upd.stmt.rec);
+        upd.recs.insert(upd.recs.end(), rec, rec + Page::rb_size(upd.stmt.rec));
+      }
+    }
+    catch(...)
+    {
+      scan_close(cur);
+      throw;
+    }
+  }
+
+
+  /* Update the rows <first> ... <end> - 1 of <upd.rows>, which are all on one row page, under a single latch and marking the
+     page dirty once ; the new versions that do not fit on it are left in <upd.moved>. Index entries are added after the
+     latch is released, as index pages are changed under the table lock alone */
+  static void tbl_update_page(tbl_update_t &upd, size_t first, size_t end)
+  {
+    struct index_fix_t
+    {
+      RID rid;
+      size_t at; // the new version, in <upd.recs>
+      size_t old_at; // the version rewritten in place, in <old> (SIZE_MAX for a version added to the page)
+    };
+
+    file_descriptor_t &dbfile = *upd.dbfile;
+    uint16_t page_id = upd.rows[first].rid.page_id;
+    std::vector<index_fix_t> fixes;
+    std::vector<BYTE> old;
+    bool changed = false;
+
+    txn_touch(dbfile, page_id);
+    table_page_t* page = static_cast<table_page_t*>(Buffer_mgr::buf_pin(dbfile, page_id));
+    try
+    {
+      {
+        std::unique_lock<std::shared_mutex> latch(Buffer_mgr::buf_latch(page_id));
+        bool alone = Buffer_mgr::buf_pin_count(page_id) == 1; // no scan is reading the page's records without the latch
+        for(size_t r = first; r < end; r++)
+        {
+          const mod_row_t &row = upd.rows[r];
+          BYTE* rec = upd.recs.data() + row.at;
+          uint16_t size = ((Page::record_t*)rec)->size;
+
+          if(alone && mvcc_created_by(upd.xid, row.rid))
+          {
+            uint16_t old_size;
+            const BYTE* old_rec = (const BYTE*)Page::rec_get_ref(page, row.rid.rec_id, old_size);
+            if(size <= old_size + page->free_bytes)
+            {
+              if(upd.reindex)
+              {
+                fixes.push_back({row.rid, row.at, old.size()});
+                old.insert(old.end(), old_rec, old_rec + old_size);
+              }
+              Page::pg_modify_record(page, rec, row.rid.rec_id);
+              upd.stats.in_place++;
+              changed = true;
+              continue;
+            }
+          }
+
+          if(!mvcc_deleted(upd.xid, row.rid))
+            throw table_error("A row of table \"" + upd.stmt.td.name + "\" was deleted by another transaction.");
+          Page::pg_mark_deleted(page, row.rid.rec_id); // so the old version stays deleted after a restart
+          changed = true;
+          if(page->free_bytes >= sizeof(uint16_t) + size)
+          {
+            RID to = {page_id, Page::pg_add_record((void*)page, (void*)rec, size)};
+            mvcc_created(upd.xid, to);
+            fixes.push_back({to, row.at, SIZE_MAX});
+            upd.stats.same_page++;
+          }
+          else
+          {
+            upd.moved.push_back(row.at);
+            upd.stats.moved++;
+          }
+        }
+      }
+
+      for(const index_fix_t &fix : fixes)
+      {
+        for(size_t i = 0; i < upd.stmt.indexes.size(); i++)
+        {
+          index_def_t &idx = upd.stmt.indexes[i];
+          if(fix.old_at != SIZE_MAX)
+          {
+            if(!upd.index_set[i]) // rewritten in place with the same key
+              continue;
+            Index::idx_delete_record(dbfile, idx, old.data() + fix.old_at, fix.rid);
+          }
+          Index::idx_insert_record(dbfile, idx, upd.recs.data() + fix.at, fix.rid);
+        }
+      }
+    }
+    catch(...)
+    {
+      if(changed)
+        Buffer_mgr::buf_write(dbfile, page_id);
+      Buffer_mgr::buf_unpin(page_id);
+      throw; // the transaction is aborted, and the page restored with it
+    }
+    if(changed)
+    {
+      Buffer_mgr::buf_write(dbfile, page_id);
+      upd.stats.pages++;
+    }
+    Buffer_mgr::buf_unpin(page_id);
+  }
+
+
+  modify_stats_t update_where(file_descriptor_t &dbfile, const std::string &table_name, const std::vector<scan_pred_t> &preds,
+                              const std::vector<set_col_t> &sets)
+  {
+    txn_scope_t scope(dbfile);
+    tbl_update_t upd;
+    upd.dbfile = &dbfile;
+    upd.xid = scope.txn->xid;
+    {
+      table_descriptor_t td;
+      tbl_lock_modify(dbfile, upd.xid, table_name, td);
+      std::sort(td.col_types.begin(), td.col_types.end(), [](const column_type_t &a, const column_type_t &b) { return a.ord < b.ord; });
+      std::vector<std::string> names;
+      for(const column_type_t &col : td.col_types)
+        names.push_back(col.name);
+      prepare_insert(dbfile, table_name, names, upd.stmt); // under the lock, so its indexes are the current ones
+    }
+    upd.index_set.assign(upd.stmt.indexes.size(), false);
+    for(const set_col_t &set : sets)
+    {
+      uint16_t col = tbl_col_index(upd.stmt.td, set.col);
+      upd.sets.push_back({col, tbl_check_value(upd.stmt.td.col_types[col], set.val)});
+      for(size_t i = 0; i < upd.stmt.indexes.size(); i++)
+      {
+        if(upd.stmt.indexes[i].col == col)
+          upd.index_set[i] = upd.reindex = true;
+      }
+    }
+
+    tbl_update_gather(upd, table_name, preds);
+    for(size_t first = 0; first < upd.rows.size(); )
+    {
+      size_t end = first + 1;
+      while(end < upd.rows.size() && upd.rows[end].rid.page_id == upd.rows[first].rid.page_id)
+        end++;
+      if(upd.stmt.td.type == DB_TYPE_PAX) // PAX pages hold no records to rewrite or add to one by one
+      {
+        std::vector<RID> rids;
+        for(size_t r = first; r < end; r++)
+        {
+          rids.push_back(upd.rows[r].rid);
+          upd.moved.push_back(upd.rows[r].at);
+          upd.stats.moved++;
+        }
+        delete_rows(dbfile, rids);
+        upd.stats.pages++;
+      }
+      else
+        tbl_update_page(upd, first, end);
+      first = end;
+    }
+
+    /* The rest go to the last pages in one batch, each page filled and marked dirty once ; their values point into <upd.recs> */
+    if(!upd.moved.empty())
+    {
+      std::vector<row_t> rows(upd.moved.size());
+      for(size_t m = 0; m < upd.moved.size(); m++)
+        Page::rec_upackrow((void*)(upd.recs.data() + upd.moved[m]), rows[m]);
+      insert_rows(dbfile, upd.stmt, rows);
+    }
+    upd.stats.rows = upd.rows.size();
+    return upd.stats;
+  }
+}
@@ -0,0 +1,75 @@
+/**************************************************************************************************
+* Filename:   table_modify.h
+* Details:    Defines the API for deleting and updating the rows of a table that match predicates.
+**************************************************************************************************/
+
+/*************************************************************************************************
+  Both run a scan of the table with the predicates of "table_scan.h", in the calling thread's
+  transaction (or one of their own), holding X on the table. The matching rows are gathered
+  first and changed after the scan is done, so rows an update writes are never matched again.
+
+  A delete records its deletions in the version store and marks the rows deleted on their pages
+  ("delete_rows()"), each page latched and marked dirty once, so they stay deleted after a
+  restart ; the space goes back once a vacuum reclaims it ("vacuum.h").
+
+  An update goes through the matching rows a page at a time, taking the page's latch once and
+  marking it dirty once for all of its rows:
+
+    in place   a row the transaction created itself, which no one else sees yet, is rewritten
+               where it is ("Page::pg_modify_record()"), if the page has room for it and no one
+               else has the page pinned (a scan reads records without the latch).
+    same page  any other row is deleted (and marked deleted on the page, as a delete does), and
+               its new version added to the same page while there is room: it stays near its
+               neighbours, and no other page is written.
+    moved      the rest are added to the table's last pages, in one batch ("insert_rows()").
+
+  Index entries are added for every new version (and changed for a row rewritten in place when
+  one of its indexed columns is set) ; entries for old versions stay until a vacuum removes them,
+  and index readers skip them by their snapshot.
+*************************************************************************************************/
+
+/********************************************* GUARD *********************************************/
+
+#ifndef TABLE_MODIFY_H
+#define TABLE_MODIFY_H
+
+/***************************************** HEADER FILES ******************************************/
+
+#include "table_scan.h"
+
+/************************************** IMPLEMENT STRUCTURES *************************************/
+
+namespace Table
+{
+  /* Structure for one column an update sets: <col> = <val> */
+  struct set_col_t
+  {
+    std::string col;
+    Page::value_t val; // a string value must stay valid until the update returns
+  };
+
+  /* Structure for what a delete or an update did */
+  struct modify_stats_t
+  {
+    size_t rows = 0; // rows deleted or updated
+    size_t in_place = 0; // rows rewritten where they were
+    size_t same_page = 0; // new versions added to the page of the old one
+    size_t moved = 0; // new versions added to the table's last pages
+    size_t pages = 0; // pages changed, each marked dirty once (the last pages the moved rows went to are not counted)
+  };
+}
+
+namespace Table
+{
+  /************************************* FUNCTION PROTOTYPES *************************************/
+
+  /* Delete every row of the table that matches all of <preds> ; throws a <table_error> if another transaction deleted one first */
+  modify_stats_t delete_where(file_descriptor_t &dbfile, const std::string &table_name, const std::vector<scan_pred_t> &preds);
+
+  /* Set the columns of <sets> in every row of the table that matches all of <preds> ; throws a <table_error> if a column or
+     value does not fit the table, or another transaction deleted a row first */
+  modify_stats_t update_where(file_descriptor_t &dbfile, const std::string &table_name, const std::vector<scan_pred_t> &preds,
+                              const std::vector<set_col_t> &sets);
+}
+
+#endif // TABLE_MODIFY_H
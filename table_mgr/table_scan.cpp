@@ -0,0 +1,683 @@
+/**************************************************************************************************
+* Filename:   table_scan.cpp
+* Details:    Implements the table scan cursor declared in "table_scan.h".
+**************************************************************************************************/
+
+/****************************************** HEADER FILES *****************************************/
+
+#include "table_scan.h"
+#include "transaction.h"
+#include "../buffer_mgr/buffer_mgr.h"
+#include "../paging/pax_page.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+
+/************************************ FUNCTION IMPLEMENTATIONS ***********************************/
+
+namespace Table
+{
+  /* The transaction a scan reads as: the calling thread's, whose own changes it sees, or none */
+  static inline txn_id_t tbl_scan_own()
+  {
+    txn_t* txn = txn_current();
+    return txn != nullptr ? txn->xid : TXN_NONE;
+  }
+
+
+  /* Turn a three-way comparison into the result of <op> */
+  static inline bool tbl_cmp_result(int cmp, BYTE op)
+  {
+    switch(op)
+    {
+      case SCAN_EQ: return cmp == 0;
+      case SCAN_NE: return cmp != 0;
+      case SCAN_LT: return cmp < 0;
+      case SCAN_LE: return cmp <= 0;
+      case SCAN_GT: return cmp > 0;
+      default: return cmp >= 0;
+    }
+  }
+
+
+  /* Read the table's columns sorted by <ord>, resolve each predicate's and projected column's position, and check predicate types */
+  static void tbl_resolve_scan(file_descriptor_t &dbfile, const std::string &table_name, const std::vector<scan_pred_t> &preds,
+                               const std::vector<std::string> &proj_cols, table_descriptor_t &td,
+                               std::vector<scan_pred_t> &resolved, std::vector<uint16_t> &proj)
+  {
+    td = table_descriptor_t();
+    read_table_descriptor(dbfile, table_name, td);
+    std::vector<column_type_t> &cols = td.col_types;
+    std::sort(cols.begin(), cols.end(), [](const column_type_t &a, const column_type_t &b) { return a.ord < b.ord; });
+
+    resolved = preds;
+    for(scan_pred_t &pred : resolved)
+    {
+      pred.idx = tbl_col_index(td, pred.col);
+      bool numeric_col = cols[pred.idx].type == TBL_TYPE_SHORT || cols[pred.idx].type == TBL_TYPE_INT;
+      bool numeric_val = pred.val.type == Page::RTYPE_SHORT || pred.val.type == Page::RTYPE_INT;
+      if(pred.op > SCAN_GE)
+        throw table_error("Unknown comparison in predicate on column \"" + pred.col + "\".");
+      if(numeric_col != numeric_val || (!numeric_col && pred.val.type != Page::RTYPE_STRING))
+        throw table_error("Predicate value type does not match column \"" + pred.col + "\".");
+    }
+
+    /* Evaluate predicates in field order, so a record is given up on at the first one that fails */
+    std::stable_sort(resolved.begin(), resolved.end(), [](const scan_pred_t &a, const scan_pred_t &b) { return a.idx < b.idx; });
+
+    proj.clear();
+    if(proj_cols.empty())
+    {
+      for(uint16_t i = 0; i < cols.size(); i++)
+        proj.push_back(i);
+    }
+    else
+    {
+      for(const std::string &name : proj_cols)
+        proj.push_back(tbl_col_index(td, name));
+    }
+  }
+
+
+  /* Pin the page a cursor moves to ; on the first page of one of the table's runs, read the whole run ahead first */
+  static void* tbl_scan_pin(file_descriptor_t &dbfile, const std::vector<extent_t> &runs, size_t &next_run, uint16_t page_id)
+  {
+    if(page_id == 0)
+      return nullptr;
+    while(next_run < runs.size() && runs[next_run].first + runs[next_run].count <= page_id && runs[next_run].first != page_id)
+      next_run++;
+    if(next_run < runs.size() && runs[next_run].first == page_id)
+      Buffer_mgr::buf_prefetch(dbfile, page_id, runs[next_run++].count);
+    return Buffer_mgr::buf_pin(dbfile, page_id);
+  }
+
+
+  /* True if record <rec_id> of the page was there when <vis> was taken and the snapshot sees it */
+  static inline bool tbl_vis_sees(const page_vis_t &vis, uint16_t rec_id)
+  {
+    return rec_id < vis.num_recs && (vis.all || vis.vis[rec_id]);
+  }
+
+
+  /* Which records of a page the snapshot sees, taken under the page's latch */
+  static void tbl_page_vis(const snapshot_t &snap, void* page, uint16_t page_id, page_vis_t &vis)
+  {
+    if(page == nullptr)
+      return;
+    std::shared_lock<std::shared_mutex> latch(Buffer_mgr::buf_latch(page_id));
+    uint16_t num_recs = Page::pax_is_pax(page) ? reinterpret_cast<Page::pax_header_t*>(page)->num_rows
+                                              : *PG_NUM_RECORDS_PTR(page);
+    mvcc_page_vis(snap, page, page_id, num_recs, vis);
+  }
+
+
+  /* The page after this one in the table, read under its latch since an insert may be linking one */
+  static uint16_t tbl_next_page(void* page, uint16_t page_id)
+  {
+    std::shared_lock<std::shared_mutex> latch(Buffer_mgr::buf_latch(page_id));
+    return static_cast<table_page_t*>(page)->next_page;
+  }
+
+
+  /* The cursor has just pinned a page: under the page's latch, point its column views at the page if that is a PAX page, or
+     copy its directory, and note which of its records the snapshot sees */
+  static void tbl_scan_arrive(scan_cursor_t &cur)
+  {
+    if(cur.page == nullptr)
+      return;
+    std::shared_lock<std::shared_mutex> latch(Buffer_mgr::buf_latch(cur.page_id));
+    cur.pax = Page::pax_is_pax(cur.page);
+    uint16_t num_recs;
+    if(cur.pax)
+    {
+      for(uint16_t f = 0; f <= cur.last_field; f++)
+        Page::cv_open(cur.pax_cols[f], cur.page, f);
+      num_recs = Page::cv_count(cur.pax_cols[0]);
+    }
+    else
+    {
+      num_recs = *PG_NUM_RECORDS_PTR(cur.page);
+      const uint16_t* dir = PG_DIRECTORY(cur.page);
+      cur.dir.assign(dir, dir + num_recs);
+    }
+    mvcc_page_vis(cur.snap, cur.page, cur.page_id, num_recs, cur.vis);
+  }
+
+
+  void scan_open(file_descriptor_t &dbfile, const std::string &table_name, const std::vector<scan_pred_t> &preds,
+                 const std::vector<std::string> &proj_cols, scan_cursor_t &cur)
+  {
+    cur.dbfile = &dbfile;
+    snapshot_close(cur.snap); // a cursor opened again without being closed
+    snapshot_open(cur.snap, tbl_scan_own()); // before the table's pages are looked up, see "vacuum.h"
+    try
+    {
+      tbl_resolve_scan(dbfile, table_name, preds, proj_cols, cur.td, cur.preds, cur.proj);
+    }
+    catch(...)
+    {
+      snapshot_close(cur.snap);
+      throw;
+    }
+
+    /* The scan only deals with positions from here on */
+    cur.last_field = 0;
+    for(const scan_pred_t &pred : cur.preds)
+      cur.last_field = std::max(cur.last_field, pred.idx);
+    for(uint16_t idx : cur.proj)
+      cur.last_field = std::max(cur.last_field, idx);
+    cur.field_offsets.assign(cur.last_field + 1, 0);
+
+    tbl_extent_runs(dbfile, cur.td, cur.runs);
+    cur.next_run = 0;
+    cur.page_id = cur.td.first_page;
+    cur.page = tbl_scan_pin(dbfile, cur.runs, cur.next_run, cur.page_id);
+    cur.next_rec = 0;
+    cur.pax_cols.resize(cur.last_field + 1);
+    tbl_scan_arrive(cur);
+    if(cur.page == nullptr)
+      snapshot_close(cur.snap);
+  }
+
+
+  /* The next matching row of a PAX page, read off its minipages through the cursor's column views ; false when the page
+     has no more rows */
+  static bool tbl_pax_next(scan_cursor_t &cur, row_t &row, RID &rid)
+  {
+    const std::vector<Page::column_view_t> &cols = cur.pax_cols;
+    uint16_t num_rows = Page::cv_count(cols[0]);
+    while(cur.next_rec < num_rows)
+    {
+      uint16_t rec_id = cur.next_rec++;
+      if(!tbl_vis_sees(cur.vis, rec_id) || !Page::cv_is_live(cols[0], rec_id))
+        continue;
+      bool match = true;
+      for(size_t p = 0; p < cur.preds.size() && match; p++)
+        match = tbl_eval_value(Page::cv_value(cols[cur.preds[p].idx], rec_id), cur.preds[p].op, cur.preds[p].val);
+      if(!match)
+        continue;
+
+      row.resize(cur.proj.size());
+      for(size_t i = 0; i < cur.proj.size(); i++)
+        row[i] = Page::cv_value(cols[cur.proj[i]], rec_id);
+      rid.page_id = cur.page_id;
+      rid.rec_id = rec_id;
+      return true;
+    }
+    return false;
+  }
+
+
+  bool scan_next(scan_cursor_t &cur, row_t &row, RID &rid)
+  {
+    while(cur.page_id != 0)
+    {
+      if(cur.pax && tbl_pax_next(cur, row, rid))
+        return true;
+      if(cur.pax || cur.next_rec >= cur.vis.num_recs) // done with this page, so move the pin to the next page in the table
+      {
+        uint16_t next_page = tbl_next_page(cur.page, cur.page_id);
+        Buffer_mgr::buf_unpin(cur.page_id);
+        cur.page_id = next_page;
+        cur.page = tbl_scan_pin(*cur.dbfile, cur.runs, cur.next_run, next_page);
+        cur.next_rec = 0;
+        tbl_scan_arrive(cur);
+        continue;
+      }
+      uint16_t rec_id = cur.next_rec++;
+      if(cur.dir[rec_id] == Page::PG_REC_UNUSED || !tbl_vis_sees(cur.vis, rec_id)) // deleted, or not in the snapshot
+        continue;
+      BYTE* rec = (BYTE*)cur.page + Page::pg_rec_offset(cur.dir[rec_id]);
+
+      /* Walk the fields, testing each predicate as soon as its field is reached */
+      uint16_t rec_size = ((Page::record_t*)rec)->size;
+      uint16_t offset = sizeof(uint16_t);
+      size_t p = 0;
+      bool match = true;
+      for(uint16_t f = 0; f <= cur.last_field && match; f++)
+      {
+        if(offset >= rec_size) // record has fewer fields than the table has columns
+        {
+          match = false;
+          break;
+        }
+        cur.field_offsets[f] = offset;
+        for(; p < cur.preds.size() && cur.preds[p].idx == f; p++)
+        {
+          if(!tbl_eval_pred(rec + offset, cur.preds[p].op, cur.preds[p].val))
+          {
+            match = false;
+            break;
+          }
+        }
+        uint16_t type = *(uint16_t*)(rec + offset);
+        offset += sizeof(uint16_t) + (type >= Page::RTYPE_STRING ? type - Page::RTYPE_STRING : type);
+      }
+      if(!match)
+        continue;
+
+      /* Only now unpack the projected columns */
+      row.resize(cur.proj.size());
+      for(size_t i = 0; i < cur.proj.size(); i++)
+      {
+        unsigned short next = cur.field_offsets[cur.proj[i]];
+        row[i] = Page::rec_upackval(rec, next);
+      }
+      rid.page_id = cur.page_id;
+      rid.rec_id = rec_id;
+      return true;
+    }
+    snapshot_close(cur.snap);
+    return false;
+  }
+
+
+  void scan_close(scan_cursor_t &cur)
+  {
+    if(cur.page_id != 0)
+      Buffer_mgr::buf_unpin(cur.page_id);
+    cur.page_id = 0;
+    cur.page = nullptr;
+    snapshot_close(cur.snap);
+  }
+
+
+  /* Resolve a vectorized scan and lay out its batch, without positioning it on any page */
+  static void tbl_vscan_prepare(file_descriptor_t &dbfile, const std::string &table_name, const std::vector<scan_pred_t> &preds,
+                                const std::vector<std::string> &proj_cols, vscan_cursor_t &cur)
+  {
+    cur.dbfile = &dbfile;
+    std::vector<uint16_t> proj;
+    tbl_resolve_scan(dbfile, table_name, preds, proj_cols, cur.td, cur.preds, proj);
+
+    /* Every column a predicate or the projection needs is decoded once into the batch */
+    std::vector<uint16_t> fields;
+    auto batch_col = [&fields](uint16_t idx) -> uint16_t {
+      auto it = std::find(fields.begin(), fields.end(), idx);
+      if(it != fields.end())
+        return it - fields.begin();
+      fields.push_back(idx);
+      return fields.size() - 1;
+    };
+    cur.pred_col.clear();
+    for(const scan_pred_t &pred : cur.preds)
+      cur.pred_col.push_back(batch_col(pred.idx));
+    cur.proj_col.clear();
+    for(uint16_t idx : proj)
+      cur.proj_col.push_back(batch_col(idx));
+    Page::vec_init_batch(cur.batch, fields);
+
+    tbl_extent_runs(dbfile, cur.td, cur.runs);
+    cur.next_run = 0;
+    cur.num_sel = 0;
+    cur.page_id = 0;
+    cur.page = nullptr;
+    cur.next_rec = 0;
+  }
+
+
+  void vscan_open(file_descriptor_t &dbfile, const std::string &table_name, const std::vector<scan_pred_t> &preds,
+                  const std::vector<std::string> &proj_cols, vscan_cursor_t &cur)
+  {
+    snapshot_close(cur.snap);
+    snapshot_open(cur.snap, tbl_scan_own()); // as in "scan_open()"
+    try
+    {
+      tbl_vscan_prepare(dbfile, table_name, preds, proj_cols, cur);
+    }
+    catch(...)
+    {
+      snapshot_close(cur.snap);
+      throw;
+    }
+    cur.page_id = cur.td.first_page;
+    cur.page = tbl_scan_pin(dbfile, cur.runs, cur.next_run, cur.page_id);
+    tbl_page_vis(cur.snap, cur.page, cur.page_id, cur.vis);
+    if(cur.page == nullptr)
+      snapshot_close(cur.snap);
+  }
+
+
+  /* Narrow <mask> to the rows whose numeric column value satisfies <op> <val>, as one range check */
+  static void tbl_vec_filter_num(const Page::vec_column_t &col, uint16_t n, BYTE op, const Page::value_t &val, BYTE* mask)
+  {
+    int64_t v = (val.type == Page::RTYPE_SHORT) ? val.s : val.i;
+    int64_t min = (col.type == Page::RTYPE_SHORT) ? INT16_MIN : INT32_MIN;
+    int64_t max = (col.type == Page::RTYPE_SHORT) ? INT16_MAX : INT32_MAX;
+    int64_t lo = min, hi = max;
+    bool negate = false;
+    switch(op)
+    {
+      case SCAN_EQ: lo = hi = v; break;
+      case SCAN_NE: lo = hi = v; negate = true; break;
+      case SCAN_LT: hi = v - 1; break;
+      case SCAN_LE: hi = v; break;
+      case SCAN_GT: lo = v + 1; break;
+      default: lo = v; break;
+    }
+
+    /* Clamp to what the column can hold ; an empty range matches nothing (or everything when negated) */
+    lo = std::max(lo, min);
+    hi = std::min(hi, max);
+    if(lo > hi)
+    {
+      if(!negate)
+        memset(mask, 0, n);
+      return;
+    }
+    if(col.type == Page::RTYPE_SHORT)
+      Page::vec_filter_i16(col.shorts, n, lo, hi, negate, mask);
+    else
+      Page::vec_filter_i32(col.ints, n, lo, hi, negate, mask);
+  }
+
+
+  /* Apply the snapshot and the predicates to the batch just decoded and build its selection vector */
+  static void tbl_filter_batch(vscan_cursor_t &cur)
+  {
+    uint16_t n = cur.batch.count;
+    if(cur.vis.all && (n == 0 || cur.batch.rec_ids[n - 1] < cur.vis.num_recs))
+      memset(cur.mask, 1, n);
+    else
+    {
+      for(uint16_t i = 0; i < n; i++)
+        cur.mask[i] = tbl_vis_sees(cur.vis, cur.batch.rec_ids[i]);
+    }
+    for(size_t p = 0; p < cur.preds.size(); p++)
+    {
+      const Page::vec_column_t &col = cur.batch.cols[cur.pred_col[p]];
+      const scan_pred_t &pred = cur.preds[p];
+      for(uint16_t i = 0; i < n; i++) // NULLs never match
+        cur.mask[i] &= !col.nulls[i];
+      if(col.type == Page::RTYPE_SHORT || col.type == Page::RTYPE_INT)
+        tbl_vec_filter_num(col, n, pred.op, pred.val, cur.mask);
+      else if(col.type == Page::RTYPE_STRING)
+      {
+        for(uint16_t i = 0; i < n; i++)
+        {
+          if(!cur.mask[i])
+            continue;
+          int cmp = memcmp(col.strs[i], pred.val.str.ptr, std::min(col.str_lens[i], pred.val.str.len));
+          if(cmp == 0)
+            cmp = (col.str_lens[i] > pred.val.str.len) - (col.str_lens[i] < pred.val.str.len);
+          cur.mask[i] = tbl_cmp_result(cmp, pred.op);
+        }
+      }
+    }
+    cur.num_sel = Page::vec_mask_to_sel(cur.mask, n, cur.sel);
+  }
+
+
+  /* Decode the next batch of the pinned page under its latch, stopping at the records the snapshot was taken on */
+  static uint16_t tbl_vscan_decode(vscan_cursor_t &cur)
+  {
+    if(cur.next_rec >= cur.vis.num_recs)
+      return 0;
+    std::shared_lock<std::shared_mutex> latch(Buffer_mgr::buf_latch(cur.page_id));
+    return Page::vec_decode_page(cur.page, cur.next_rec, cur.batch);
+  }
+
+
+  bool vscan_next(vscan_cursor_t &cur)
+  {
+    while(cur.page_id != 0)
+    {
+      if(tbl_vscan_decode(cur) == 0) // done with this page
+      {
+        uint16_t next_page = tbl_next_page(cur.page, cur.page_id);
+        Buffer_mgr::buf_unpin(cur.page_id);
+        cur.page_id = next_page;
+        cur.page = tbl_scan_pin(*cur.dbfile, cur.runs, cur.next_run, next_page);
+        cur.next_rec = 0;
+        tbl_page_vis(cur.snap, cur.page, cur.page_id, cur.vis);
+        continue;
+      }
+      tbl_filter_batch(cur);
+      return true;
+    }
+    cur.num_sel = 0;
+    snapshot_close(cur.snap);
+    return false;
+  }
+
+
+  void vscan_close(vscan_cursor_t &cur)
+  {
+    if(cur.page_id != 0)
+      Buffer_mgr::buf_unpin(cur.page_id);
+    cur.page_id = 0;
+    cur.page = nullptr;
+    snapshot_close(cur.snap);
+  }
+
+
+  Page::value_t vscan_value(const vscan_cursor_t &cur, uint16_t proj, uint16_t row)
+  {
+    const Page::vec_column_t &col = cur.batch.cols[cur.proj_col[proj]];
+    if(col.nulls[row])
+      return Page::val_null();
+    if(col.type == Page::RTYPE_SHORT)
+      return Page::val_short(col.shorts[row]);
+    if(col.type == Page::RTYPE_INT)
+      return Page::val_int(col.ints[row]);
+    return Page::val_str(col.strs[row], col.str_lens[row]);
+  }
+
+
+  /* Structure for the page range a parallel scan worker still has to do: positions [begin, end) of the page map */
+  struct pscan_range_t
+  {
+    std::mutex lock;
+    size_t begin = 0;
+    size_t end = 0;
+  };
+
+
+  /* Take the back half of the largest range left into <ranges[self]> ; false when there is nothing left anywhere */
+  static bool pscan_steal(std::vector<pscan_range_t> &ranges, unsigned self)
+  {
+    while(true)
+    {
+      unsigned victim = self;
+      size_t most = 0;
+      for(unsigned w = 0; w < ranges.size(); w++)
+      {
+        std::lock_guard<std::mutex> guard(ranges[w].lock);
+        if(ranges[w].end - ranges[w].begin > most)
+        {
+          most = ranges[w].end - ranges[w].begin;
+          victim = w;
+        }
+      }
+      if(most == 0)
+        return false;
+
+      size_t begin, end;
+      {
+        std::lock_guard<std::mutex> guard(ranges[victim].lock);
+        size_t left = ranges[victim].end - ranges[victim].begin;
+        if(left == 0) // drained since it was picked, look again
+          continue;
+        end = ranges[victim].end;
+        begin = end - (left + 1) / 2;
+        ranges[victim].end = begin;
+      }
+      std::lock_guard<std::mutex> guard(ranges[self].lock);
+      ranges[self].begin = begin;
+      ranges[self].end = end;
+      return true;
+    }
+  }
+
+
+  size_t pscan_run(file_descriptor_t &dbfile, const std::string &table_name, const std::vector<scan_pred_t> &preds,
+                   const std::vector<std::string> &proj_cols, unsigned nthreads, const pscan_consumer_t &consume)
+  {
+    if(nthreads == 0)
+      nthreads = std::max(1u, std::thread::hardware_concurrency());
+
+    vscan_cursor_t proto;
+    snapshot_open(proto.snap, tbl_scan_own()); // one snapshot for every worker, each reading through its own copy
+    try
+    {
+      tbl_vscan_prepare(dbfile, table_name, preds, proj_cols, proto);
+    }
+    catch(...)
+    {
+      snapshot_close(proto.snap);
+      throw;
+    }
+    std::vector<uint16_t> pages;
+    for(const extent_t &run : proto.runs)
+    {
+      for(uint16_t i = 0; i < run.count; i++)
+        pages.push_back(run.first + i);
+    }
+    nthreads = std::max<size_t>(1, std::min<size_t>(nthreads, pages.size()));
+
+    /* Start every worker on an equal share of the pages */
+    std::vector<pscan_range_t> ranges(nthreads);
+    for(unsigned w = 0; w < nthreads; w++)
+    {
+      ranges[w].begin = pages.size() * w / nthreads;
+      ranges[w].end = pages.size() * (w + 1) / nthreads;
+    }
+
+    std::vector<std::exception_ptr> errors(nthreads);
+    std::atomic<bool> failed(false);
+    auto work = [&](unsigned self) {
+      try
+      {
+        vscan_cursor_t cur = proto;
+        while(!failed)
+        {
+          size_t pos;
+          {
+            std::lock_guard<std::mutex> guard(ranges[self].lock);
+            pos = ranges[self].begin < ranges[self].end ? ranges[self].begin++ : SIZE_MAX;
+          }
+          if(pos == SIZE_MAX)
+          {
+            if(!pscan_steal(ranges, self))
+              break;
+            continue;
+          }
+
+          cur.page_id = pages[pos];
+          cur.page = Buffer_mgr::buf_pin(dbfile, cur.page_id);
+          cur.next_rec = 0;
+          try
+          {
+            tbl_page_vis(cur.snap, cur.page, cur.page_id, cur.vis);
+            while(tbl_vscan_decode(cur) > 0)
+            {
+              tbl_filter_batch(cur);
+              consume(self, cur);
+            }
+          }
+          catch(...)
+          {
+            Buffer_mgr::buf_unpin(cur.page_id);
+            throw;
+          }
+          Buffer_mgr::buf_unpin(cur.page_id);
+        }
+      }
+      catch(...)
+      {
+        errors[self] = std::current_exception();
+        failed = true;
+      }
+    };
+
+    std::vector<std::thread> workers;
+    for(unsigned w = 1; w < nthreads; w++)
+      workers.emplace_back(work, w);
+    work(0); // the calling thread is worker 0
+    for(std::thread &t : workers)
+      t.join();
+    snapshot_close(proto.snap);
+    for(std::exception_ptr &error : errors)
+    {
+      if(error)
+        std::rethrow_exception(error);
+    }
+    return pages.size();
+  }
+
+
+  size_t pscan_count(file_descriptor_t &dbfile, const std::string &table_name, const std::vector<scan_pred_t> &preds, unsigned nthreads)
+  {
+    if(nthreads == 0)
+      nthreads = std::max(1u, std::thread::hardware_concurrency());
+
+    /* One padded counter per worker, summed once every worker is done */
+    struct alignas(64) partial_t { size_t count = 0; };
+    std::vector<partial_t> partials(nthreads);
+    pscan_run(dbfile, table_name, preds, {}, nthreads, [&partials](unsigned worker, const vscan_cursor_t &cur) {
+      partials[worker].count += cur.num_sel;
+    });
+
+    size_t total = 0;
+    for(const partial_t &p : partials)
+      total += p.count;
+    return total;
+  }
+
+
+  uint16_t tbl_col_index(const table_descriptor_t &td, const std::string &col_name)
+  {
+    for(uint16_t i = 0; i < td.col_types.size(); i++)
+    {
+      if(td.col_types[i].name == col_name)
+        return i;
+    }
+    throw table_error("Column \"" + col_name + "\" not found in table \"" + td.name + "\".");
+  }
+
+
+  bool tbl_eval_pred(const BYTE* field, BYTE op, const Page::value_t &val)
+  {
+    uint16_t type = *(const uint16_t*)field;
+    const BYTE* data = field + sizeof(uint16_t);
+
+    if(type == Page::RTYPE_SHORT || type == Page::RTYPE_INT)
+    {
+      int32_t lhs = (type == Page::RTYPE_SHORT) ? *(const int16_t*)data : *(const int32_t*)data;
+      int32_t rhs = (val.type == Page::RTYPE_SHORT) ? val.s : val.i;
+      return tbl_cmp_result((lhs > rhs) - (lhs < rhs), op);
+    }
+    if(type >= Page::RTYPE_STRING)
+    {
+      uint16_t len = type - Page::RTYPE_STRING;
+      int cmp = memcmp(data, val.str.ptr, std::min(len, val.str.len));
+      if(cmp == 0)
+        cmp = (len > val.str.len) - (len < val.str.len);
+      return tbl_cmp_result(cmp, op);
+    }
+    return false; // NULL (or a double, which no column type stores)
+  }
+
+
+  bool tbl_eval_value(const Page::value_t &field, BYTE op, const Page::value_t &val)
+  {
+    if(field.type == Page::RTYPE_SHORT || field.type == Page::RTYPE_INT)
+    {
+      int32_t lhs = (field.type == Page::RTYPE_SHORT) ? field.s : field.i;
+      int32_t rhs = (val.type == Page::RTYPE_SHORT) ? val.s : val.i;
+      return tbl_cmp_result((lhs > rhs) - (lhs < rhs), op);
+    }
+    if(field.type == Page::RTYPE_STRING)
+    {
+      int cmp = memcmp(field.str.ptr, val.str.ptr, std::min(field.str.len, val.str.len));
+      if(cmp == 0)
+        cmp = (field.str.len > val.str.len) - (field.str.len < val.str.len);
+      return tbl_cmp_result(cmp, op);
+    }
+    return false; // NULL
+  }
+}
@@ -0,0 +1,170 @@
+/**************************************************************************************************
+* Filename:   table_scan.h
+* Details:    Defines the API for scanning a table's records with a cursor.
+**************************************************************************************************/
+
+/*************************************************************************************************
+  A scan walks the table's linked list of pages through <next_page>, and the live records of each
+  page through "Page::next_record()", skipping directory entries marked PG_REC_UNUSED. The page
+  under the cursor stays pinned in the buffer pool.
+
+  Predicates are evaluated on the raw record bytes as the fields are walked, so a record that does
+  not match is never unpacked. Only the projected columns of a matching record are unpacked. A PAX
+  page is read the same way through a column view of each field ("record_view.h"), straight off its
+  minipages, so no row is put back together as a record.
+
+  A vectorized scan ("vscan_*") instead decodes up to VEC_BATCH_SIZE records of a page at a time
+  into one array per column, filters SHORT/INT columns with the SIMD kernels of "vec_batch.h", and
+  hands back the batch with a selection vector of the rows that match.
+
+  Every scan reads through a snapshot ("mvcc.h") taken when it is opened, so it sees the rows of
+  the inserts that had committed by then and no others, however long it runs. When the cursor
+  reaches a page it takes the page's latch just long enough to note how many records the page
+  has, which of them the snapshot sees (records marked deleted on the page included, see
+  "mvcc.h"), and (for "scan_next()") a copy of the directory; records
+  never move while the page is pinned (a vacuum only compacts pages no one else has pinned), so
+  the rest of the page is read without the latch while inserts go on adding records past the ones
+  noted. The snapshot is taken before the table's pages are looked up, which keeps pages a vacuum
+  takes out of the table from being reused under the scan ("vacuum.h").
+
+  A parallel scan ("pscan_*") runs the same batches on a pool of workers. The table's page map is
+  split into one contiguous range per worker ; a worker whose range runs out steals the back half
+  of the largest range left. Each worker hands its batches to a consumer along with its worker
+  number, so results can be gathered per worker and merged at the end without locking.
+*************************************************************************************************/
+
+/********************************************* GUARD *********************************************/
+
+#ifndef TABLE_SCAN_H
+#define TABLE_SCAN_H
+
+/***************************************** HEADER FILES ******************************************/
+
+#include "table_mgr.h"
+#include "mvcc.h"
+#include "../paging/vec_batch.h"
+#include "../paging/record_view.h"
+
+#include <functional>
+
+/******************************************* CONSTANTS *******************************************/
+
+namespace Table
+{
+  /* Comparison operators for <scan_pred_t> */
+  const BYTE SCAN_EQ = 0;
+  const BYTE SCAN_NE = 1;
+  const BYTE SCAN_LT = 2;
+  const BYTE SCAN_LE = 3;
+  const BYTE SCAN_GT = 4;
+  const BYTE SCAN_GE = 5;
+}
+
+/************************************** IMPLEMENT STRUCTURES *************************************/
+
+namespace Table
+{
+  /* Structure for one predicate: <col> <op> <val>. A NULL column value never matches */
+  struct scan_pred_t
+  {
+    std::string col;
+    BYTE op;
+    Page::value_t val; // a string value must stay valid for as long as the scan is open
+    uint16_t idx; // the column's position in the record, set by "scan_open()"
+  };
+
+  /* Structure that holds the state of an open scan */
+  struct scan_cursor_t
+  {
+    file_descriptor_t* dbfile;
+    table_descriptor_t td; // columns sorted by <ord>
+    std::vector<scan_pred_t> preds;
+    std::vector<uint16_t> proj; // positions of the projected columns, in output order
+    uint16_t last_field; // the scan never walks past this field of a record
+    uint16_t page_id; // the pinned page under the cursor (0 when the scan is done)
+    void* page;
+    uint16_t next_rec; // directory index of the next record to look at
+    std::vector<extent_t> runs; // the table's runs of consecutive pages, each read ahead when the cursor reaches it
+    size_t next_run;
+    std::vector<uint16_t> field_offsets; // where each field of the current record starts
+    std::vector<Page::column_view_t> pax_cols; // views of fields 0 ... <last_field> of the pinned page, when it is a PAX page
+    bool pax; // the pinned page is a PAX page
+    std::vector<uint16_t> dir; // the pinned row page's directory, as it was when the cursor reached the page
+    snapshot_t snap; // open until the scan ends or is closed
+    page_vis_t vis; // the records of the pinned page the snapshot sees
+  };
+
+  /* Structure that holds the state of an open vectorized scan */
+  struct vscan_cursor_t
+  {
+    file_descriptor_t* dbfile;
+    table_descriptor_t td; // columns sorted by <ord>
+    std::vector<scan_pred_t> preds;
+    std::vector<uint16_t> pred_col; // batch column of each predicate
+    std::vector<uint16_t> proj_col; // batch column of each projected column, in output order
+    Page::vec_batch_t batch;
+    BYTE mask[Page::VEC_BATCH_SIZE];
+    uint16_t sel[Page::VEC_BATCH_SIZE]; // batch positions of the rows that match
+    uint16_t num_sel;
+    uint16_t page_id; // the pinned page the batch was decoded from (0 when the scan is done)
+    void* page;
+    uint16_t next_rec;
+    std::vector<extent_t> runs; // as in <scan_cursor_t>
+    size_t next_run;
+    snapshot_t snap; // as in <scan_cursor_t>
+    page_vis_t vis;
+  };
+}
+
+namespace Table
+{
+  /************************************* FUNCTION PROTOTYPES *************************************/
+
+  /* Position a cursor before the first record of the table ; an empty <proj_cols> projects every column */
+  void scan_open(file_descriptor_t &dbfile, const std::string &table_name, const std::vector<scan_pred_t> &preds,
+                 const std::vector<std::string> &proj_cols, scan_cursor_t &cur);
+
+  /* Advance to the next matching record and unpack its projected columns into <row>. String values point into the
+     pinned page (or the cursor, for a PAX table) and stay valid until the next call. Returns false (and unpins the last page)
+     when there are no more records */
+  bool scan_next(scan_cursor_t &cur, row_t &row, RID &rid);
+
+  /* Unpin the page under the cursor and release the snapshot, if the scan was not run to the end */
+  void scan_close(scan_cursor_t &cur);
+
+  /* Same as "scan_open()", for a vectorized scan */
+  void vscan_open(file_descriptor_t &dbfile, const std::string &table_name, const std::vector<scan_pred_t> &preds,
+                  const std::vector<std::string> &proj_cols, vscan_cursor_t &cur);
+
+  /* Decode and filter the next batch. Projected column j of selected row <cur.sel[i]> is in <cur.batch.cols[cur.proj_col[j]]>,
+     and strings point into the pinned page until the next call. Batches may have no selected rows. Returns false at the end */
+  bool vscan_next(vscan_cursor_t &cur);
+
+  void vscan_close(vscan_cursor_t &cur);
+
+  /* Projected column <proj> of batch row <row> as a value ; a string points into the pinned page, as in the batch */
+  Page::value_t vscan_value(const vscan_cursor_t &cur, uint16_t proj, uint16_t row);
+
+  /* Called by a parallel scan worker for each batch it filters ; <worker> is in [0, nthreads). The batch is read as after
+     "vscan_next()", and calls for one worker never overlap */
+  typedef std::function<void(unsigned worker, const vscan_cursor_t &cur)> pscan_consumer_t;
+
+  /* Scan the table on <nthreads> workers (0 = one per core), the calling thread being worker 0. The buffer pool must be able
+     to pin one page per worker. Returns the number of pages scanned */
+  size_t pscan_run(file_descriptor_t &dbfile, const std::string &table_name, const std::vector<scan_pred_t> &preds,
+                   const std::vector<std::string> &proj_cols, unsigned nthreads, const pscan_consumer_t &consume);
+
+  /* Number of records that match <preds>, counted per worker and summed */
+  size_t pscan_count(file_descriptor_t &dbfile, const std::string &table_name, const std::vector<scan_pred_t> &preds, unsigned nthreads);
+
+  /* Position of the named column in <td> (sorted by <ord>) ; throws a <table_error> if there is no such column */
+  uint16_t tbl_col_index(const table_descriptor_t &td, const std::string &col_name);
+
+  /* Compare a packed field against a value ; false when the field is NULL */
+  bool tbl_eval_pred(const BYTE* field, BYTE op, const Page::value_t &val);
+
+  /* Same as "tbl_eval_pred()" for a field already unpacked into <field> */
+  bool tbl_eval_value(const Page::value_t &field, BYTE op, const Page::value_t &val);
+}
+
+#endif // TABLE_SCAN_H
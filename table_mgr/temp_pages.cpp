@@ -0,0 +1,98 @@
+/**************************************************************************************************
+* Filename:   temp_pages.cpp
+* Details:    Implements the temp pages declared in "temp_pages.h".
+**************************************************************************************************/
+
+/****************************************** HEADER FILES *****************************************/
+
+#include "temp_pages.h"
+#include "../buffer_mgr/buffer_mgr.h"
+
+/************************************ FUNCTION IMPLEMENTATIONS ***********************************/
+
+namespace Table
+{
+  /* Take one page off the free list and format it as an empty table page, left pinned. The free list page is pinned
+     meanwhile, since other threads may be reading pages into the pool */
+  static uint16_t tmp_new_page(file_descriptor_t &dbfile, void* &page)
+  {
+    std::vector<uint16_t> ids;
+    Buffer_mgr::buf_pin(dbfile, Page_file::PGF_PAGES_FREE_ID);
+    try
+    {
+      tbl_alloc_pages(dbfile, 1, ids);
+    }
+    catch(...)
+    {
+      Buffer_mgr::buf_unpin(Page_file::PGF_PAGES_FREE_ID);
+      throw;
+    }
+    Buffer_mgr::buf_unpin(Page_file::PGF_PAGES_FREE_ID);
+
+    page = Buffer_mgr::buf_pin(dbfile, ids[0]);
+    tbl_init_page(static_cast<table_page_t*>(page));
+    Buffer_mgr::buf_write(dbfile, ids[0]);
+    return ids[0];
+  }
+
+
+  void tmp_add_record(file_descriptor_t &dbfile, std::vector<uint16_t> &pages, const BYTE* rec)
+  {
+    uint16_t size = reinterpret_cast<const Page::record_t*>(rec)->size;
+    if(sizeof(uint16_t) + size > Page::PG_INITIAL_BYTES - sizeof(uint16_t))
+      throw table_error("A record is too large for a temp page.");
+
+    uint16_t page_id = 0;
+    void* page = nullptr;
+    if(!pages.empty())
+    {
+      page_id = pages.back();
+      page = Buffer_mgr::buf_pin(dbfile, page_id);
+      if(static_cast<table_page_t*>(page)->free_bytes < sizeof(uint16_t) + size)
+      {
+        Buffer_mgr::buf_unpin(page_id);
+        page_id = 0;
+      }
+    }
+    if(page_id == 0)
+    {
+      page_id = tmp_new_page(dbfile, page);
+      pages.push_back(page_id);
+    }
+
+    Page::pg_add_record(page, const_cast<BYTE*>(rec), size);
+    Buffer_mgr::buf_write(dbfile, page_id);
+    Buffer_mgr::buf_unpin(page_id);
+  }
+
+
+  void tmp_read(file_descriptor_t &dbfile, const std::vector<uint16_t> &pages, const std::function<void(const BYTE* rec)> &visit)
+  {
+    for(uint16_t page_id : pages)
+    {
+      void* page = Buffer_mgr::buf_pin(dbfile, page_id);
+      try
+      {
+        uint16_t next = 0;
+        while(const BYTE* rec = Page::next_record(page, next))
+          visit(rec);
+      }
+      catch(...)
+      {
+        Buffer_mgr::buf_unpin(page_id);
+        throw;
+      }
+      Buffer_mgr::buf_unpin(page_id);
+    }
+  }
+
+
+  void tmp_free(file_descriptor_t &dbfile, std::vector<uint16_t> &pages)
+  {
+    for(uint16_t page_id : pages)
+      Buffer_mgr::discard(page_id);
+    if(!pages.empty())
+      tbl_free_pages(dbfile, pages);
+    pages.clear();
+  }
+}
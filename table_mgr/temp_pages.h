@@ -0,0 +1,41 @@
+/**************************************************************************************************
+* Filename:   temp_pages.h
+* Details:    Defines the API for temp pages: row pages an operator takes off the free list to hold
+*             records it cannot keep in memory, and puts back when it is done.
+**************************************************************************************************/
+
+/*************************************************************************************************
+  A run of temp pages is just the list of its page ids ; the pages are not linked and belong to no
+  table, so they never show up in "#master". Records are added to the last page of the run, and a
+  page is added when it is full. Each page is pinned while it is written or read, so other threads
+  reading pages into the pool cannot replace it underneath. The functions are not thread-safe on
+  their own: callers that share a run serialize access to it.
+*************************************************************************************************/
+
+/********************************************* GUARD *********************************************/
+
+#ifndef TEMP_PAGES_H
+#define TEMP_PAGES_H
+
+/***************************************** HEADER FILES ******************************************/
+
+#include "table_mgr.h"
+
+#include <functional>
+
+namespace Table
+{
+  /************************************* FUNCTION PROTOTYPES *************************************/
+
+  /* Append a record built with "Page::rec_begin()"/"Page::rec_finish()" to the run ; throws a <table_error> if it is
+     larger than a page */
+  void tmp_add_record(file_descriptor_t &dbfile, std::vector<uint16_t> &pages, const BYTE* rec);
+
+  /* Call <visit> for each record of the run, in the order they were added ; a record stays valid until <visit> returns */
+  void tmp_read(file_descriptor_t &dbfile, const std::vector<uint16_t> &pages, const std::function<void(const BYTE* rec)> &visit);
+
+  /* Drop the run's pages from the buffer pool without writing them, put them back on the free list, and empty <pages> */
+  void tmp_free(file_descriptor_t &dbfile, std::vector<uint16_t> &pages);
+}
+
+#endif // TEMP_PAGES_H
@@ -0,0 +1,142 @@
+/**************************************************************************************************
+* Filename:   transaction.cpp
+* Details:    Implements the transactions and page undo declared in "transaction.h".
+**************************************************************************************************/
+
+/****************************************** HEADER FILES *****************************************/
+
+#include "transaction.h"
+#include "../buffer_mgr/buffer_mgr.h"
+#include "../lock_mgr/lock_mgr.h"
+
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <shared_mutex>
+
+/******************************************* CONSTANTS *******************************************/
+
+namespace Table
+{
+  const size_t TXN_FRESH = SIZE_MAX; // in <undo_at>: a page the transaction took for itself, with nothing to restore
+}
+
+/**************************************** GLOBAL VARIABLES ***************************************/
+
+namespace Table
+{
+  static thread_local txn_t* current_txn = nullptr;
+}
+
+/************************************ FUNCTION IMPLEMENTATIONS ***********************************/
+
+namespace Table
+{
+  /* Forget the transaction's page copies, keeping the buffers for the next one, and take it off its thread */
+  static void txn_end(txn_t &txn)
+  {
+    txn.undo_at.clear();
+    txn.undo.clear();
+    txn.open = false;
+    if(current_txn == &txn)
+      current_txn = nullptr;
+  }
+
+
+  void txn_begin(file_descriptor_t &dbfile, txn_t &txn)
+  {
+    if(current_txn != nullptr || txn.open)
+      throw table_error("A transaction is already running on this thread.");
+    txn.xid = mvcc_begin();
+    txn.dbfile = &dbfile;
+    txn.open = true;
+    current_txn = &txn;
+  }
+
+
+  void txn_commit(txn_t &txn)
+  {
+    if(!txn.open)
+      throw table_error("No transaction is running.");
+    mvcc_commit(txn.xid);
+    Lock_mgr::lock_release_all(txn.xid);
+    txn_end(txn);
+  }
+
+
+  void txn_abort(txn_t &txn)
+  {
+    if(!txn.open)
+      throw table_error("No transaction is running.");
+
+    /* Every page restored is still locked by the transaction, so only readers can be looking at it */
+    file_descriptor_t &dbfile = *txn.dbfile;
+    for(const auto &entry : txn.undo_at)
+    {
+      if(entry.second == TXN_FRESH)
+        continue;
+      void* page = Buffer_mgr::buf_pin(dbfile, entry.first);
+      {
+        std::unique_lock<std::shared_mutex> latch(Buffer_mgr::buf_latch(entry.first));
+        memcpy(page, txn.undo.data() + entry.second, PAGE_SIZE);
+      }
+      Buffer_mgr::buf_write(dbfile, entry.first);
+      Buffer_mgr::buf_unpin(entry.first);
+    }
+
+    mvcc_abort(txn.xid, true);
+    Lock_mgr::lock_release_all(txn.xid);
+    txn_end(txn);
+  }
+
+
+  txn_t* txn_current()
+  {
+    return current_txn;
+  }
+
+
+  void txn_touch(file_descriptor_t &dbfile, uint16_t page_id)
+  {
+    txn_t* txn = current_txn;
+    if(txn == nullptr || txn->undo_at.count(page_id) != 0)
+      return;
+
+    /* Only this transaction changes the page, so its bytes can be copied without the latch */
+    const BYTE* page = static_cast<const BYTE*>(Buffer_mgr::buf_pin(dbfile, page_id));
+    txn->undo_at[page_id] = txn->undo.size();
+    txn->undo.insert(txn->undo.end(), page, page + PAGE_SIZE);
+    Buffer_mgr::buf_unpin(page_id);
+  }
+
+
+  void txn_fresh(const std::vector<uint16_t> &page_ids)
+  {
+    txn_t* txn = current_txn;
+    if(txn == nullptr)
+      return;
+    for(uint16_t page_id : page_ids)
+      txn->undo_at.emplace(page_id, TXN_FRESH); // a page changed and freed earlier in the transaction keeps its copy
+  }
+
+
+  txn_scope_t::txn_scope_t(file_descriptor_t &dbfile) : txn(current_txn), uncaught(std::uncaught_exceptions())
+  {
+    if(txn == nullptr)
+    {
+      txn_begin(dbfile, own);
+      txn = &own;
+    }
+  }
+
+
+  txn_scope_t::~txn_scope_t()
+  {
+    if(txn != &own || !own.open)
+      return;
+    if(std::uncaught_exceptions() > uncaught)
+      txn_abort(own);
+    else
+      txn_commit(own);
+  }
+}
@@ -0,0 +1,105 @@
+/**************************************************************************************************
+* Filename:   transaction.h
+* Details:    Defines the API for transactions: a group of inserts, loads and table or index
+*             creations that commit together, or are undone together by restoring the bytes of
+*             every page they changed.
+**************************************************************************************************/
+
+/*************************************************************************************************
+  A transaction is begun on a thread, and every write made on that thread until it commits or
+  aborts is part of it. A write made with no transaction running runs in one of its own, begun
+  and ended around it (see "txn_scope_t"): it commits if the write returns, and is aborted if the
+  write throws, so a failure halfway through "extend_table()" no longer leaves pages taken off the
+  free list that "#master" knows nothing about.
+
+  Undo is physical. The first time a transaction changes a page, whoever changes it calls
+  "txn_touch()" first, which keeps a copy of the page's bytes; an abort writes each copy back,
+  free list, extent lists and catalog pages included, and then drops the versions of the records
+  the transaction created (see "mvcc.h"). Pages the transaction took for itself, off the free list or
+  a table's extent, need no copy: once the pages that lead to them are restored, nothing does. A commit
+  just forgets the copies, so committing once per batch costs little more than the batch.
+
+  Restoring a whole page is only right if no one else changed it meanwhile, so a transaction holds
+  a lock on every page it changes until it ends: X on the pages it fills, IX on their table (X on a
+  table with indexes, whose pages it may change anywhere; see "table_mgr.cpp"), and X on
+  TXN_CATALOG_LOCK once it changes the free list, an extent list or the catalog. Writers that extend tables therefore take turns at the catalog, one transaction at a
+  time. Readers take no locks: they may see "#master" and "#columns" rows of a transaction that
+  has not committed yet, though never its records.
+
+  A transaction's worker threads must not take pages of their own (temp pages, for one) while it
+  holds the catalog lock: they would wait for it to end.
+*************************************************************************************************/
+
+/********************************************* GUARD *********************************************/
+
+#ifndef TRANSACTION_H
+#define TRANSACTION_H
+
+/***************************************** HEADER FILES ******************************************/
+
+#include "mvcc.h"
+
+#include <unordered_map>
+
+/******************************************* CONSTANTS *******************************************/
+
+namespace Table
+{
+  const uint32_t TXN_CATALOG_LOCK = 0; // the lock manager's name for the free list, extent lists and catalog ; no table's lock_id
+}
+
+/************************************** IMPLEMENT STRUCTURES *************************************/
+
+namespace Table
+{
+  /* Structure for a transaction, see "txn_begin()" ; reuse one across transactions to keep its buffers */
+  struct txn_t
+  {
+    txn_id_t xid = TXN_NONE;
+    file_descriptor_t* dbfile = nullptr;
+    std::unordered_map<uint16_t, size_t> undo_at; // page id -> offset of the page's bytes in <undo>, or SIZE_MAX if it was free
+    std::vector<BYTE> undo; // the pages' bytes before the transaction first changed them, back to back
+    bool open = false;
+  };
+
+  /* Structure for a write that runs in the calling thread's transaction, or in one of its own when none is running: that one
+     commits when the scope ends normally, and is aborted when it ends by an exception */
+  struct txn_scope_t
+  {
+    explicit txn_scope_t(file_descriptor_t &dbfile);
+    ~txn_scope_t();
+    txn_scope_t(const txn_scope_t &) = delete;
+    txn_scope_t &operator=(const txn_scope_t &) = delete;
+
+    txn_t* txn; // the transaction the write runs in
+    txn_t own;
+    int uncaught; // exceptions already in flight when the scope began
+  };
+}
+
+namespace Table
+{
+  /************************************* FUNCTION PROTOTYPES *************************************/
+
+  /* Begin a transaction on the calling thread ; throws a <table_error> if one is already running on it */
+  void txn_begin(file_descriptor_t &dbfile, txn_t &txn);
+
+  /* Make the transaction's changes visible to the snapshots taken from now on, and release its locks */
+  void txn_commit(txn_t &txn);
+
+  /* Undo every change of the transaction, restoring each page it changed, and release its locks */
+  void txn_abort(txn_t &txn);
+
+  /* The transaction running on the calling thread, or nullptr */
+  txn_t* txn_current();
+
+  /* Keep the page's bytes for an abort, the first time the calling thread's transaction is about to change it ; call it before
+     taking the page's latch. Does nothing with no transaction running */
+  void txn_touch(file_descriptor_t &dbfile, uint16_t page_id);
+
+  /* Note pages the calling thread's transaction just took off the free list or a table's extent: an abort has nothing to
+     restore on them */
+  void txn_fresh(const std::vector<uint16_t> &page_ids);
+}
+
+#endif // TRANSACTION_H
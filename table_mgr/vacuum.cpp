@@ -0,0 +1,590 @@
+/**************************************************************************************************
+* Filename:   vacuum.cpp
+* Details:    Implements the table vacuum declared in "vacuum.h".
+**************************************************************************************************/
+
+/****************************************** HEADER FILES *****************************************/
+
+#include "vacuum.h"
+#include "transaction.h"
+#include "../buffer_mgr/buffer_mgr.h"
+#include "../lock_mgr/lock_mgr.h"
+#include "../index_mgr/index_mgr.h"
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+
+/************************************** IMPLEMENT STRUCTURES *************************************/
+
+namespace Table
+{
+  /* Structure for pages one step took out of a table, waiting for the readers that may be on them */
+  struct vac_limbo_t
+  {
+    file_descriptor_t* dbfile;
+    txn_id_t xid; // the step that took them out ; they are free once every reader older than it is done
+    std::vector<uint16_t> pages;
+    std::vector<RID> dead; // the records left on them, which keep their versions until then
+  };
+
+  /* Structure for the page that lists, in the file, every page taken out of a table and not freed yet (header <meta> slot
+     TBL_META_VAC_LIMBO). No snapshot outlives the program, so the pages an earlier run of it listed are free to go */
+  struct vac_limbo_page_t
+  {
+    uint64_t run; // the run of the program that listed the pages
+    uint16_t size;
+    uint16_t pages[(PAGE_SIZE - sizeof(uint64_t)) / sizeof(uint16_t) - 1];
+  };
+  static_assert(sizeof(vac_limbo_page_t) <= PAGE_SIZE, "the waiting pages list must fit in a page");
+
+  /* Structure for what one step holds and leaves behind */
+  struct vac_work_t
+  {
+    txn_id_t xid;
+    table_descriptor_t td;
+    std::vector<index_def_t> indexes;
+    std::vector<uint16_t> live; // the table's pages, sorted
+    std::vector<RID> taken; // dead records taken off the dead list
+    std::vector<RID> reclaimed; // those removed from their pages
+    std::vector<RID> left; // those left for later
+    std::vector<uint16_t> unlinked;
+    std::vector<RID> unlinked_dead; // those on the pages taken out
+  };
+}
+
+/**************************************** GLOBAL VARIABLES ***************************************/
+
+namespace Table
+{
+  static std::mutex limbo_mutex; // guards <limbo>
+  static std::vector<vac_limbo_t> limbo;
+
+  /* This run of the program, as written in <vac_limbo_page_t.run> (never 0, which a new list starts with) */
+  static const uint64_t vac_run = ((uint64_t)std::random_device()() << 32 | std::random_device()()) | 1;
+}
+
+/************************************ FUNCTION IMPLEMENTATIONS ***********************************/
+
+namespace Table
+{
+  /* True if the page is still one of the table's */
+  static inline bool vac_has_page(const vac_work_t &work, uint16_t page_id)
+  {
+    return std::binary_search(work.live.begin(), work.live.end(), page_id);
+  }
+
+
+  /* Lock the table for the step and read where its pages are now, and its indexes */
+  static void vac_lock(vacuum_t &vac, vac_work_t &work)
+  {
+    file_descriptor_t &dbfile = *vac.dbfile;
+    {
+      table_descriptor_t before;
+      read_table_descriptor(dbfile, vac.table, before);
+      Lock_mgr::lock_table(work.xid, before.lock_id, Lock_mgr::LOCK_X);
+    }
+    read_table_descriptor(dbfile, vac.table, work.td);
+    Index::find_indexes(dbfile, vac.table, work.indexes);
+    tbl_page_map(dbfile, work.td, work.live);
+    std::sort(work.live.begin(), work.live.end());
+  }
+
+
+  /* Reclaim the dead records of the next VAC_STEP_PAGES pages of the pass, and take out the pages left with no records. Page
+     changes that cannot be undone while a scan reads the page come last, after everything that may throw */
+  static void vac_reclaim(vacuum_t &vac, vac_work_t &work)
+  {
+    file_descriptor_t &dbfile = *vac.dbfile;
+    std::vector<uint16_t> step; // in chain order
+    while(vac.next < vac.pages.size() && step.size() < VAC_STEP_PAGES)
+    {
+      uint16_t page_id = vac.pages[vac.next++];
+      if(vac_has_page(work, page_id))
+        step.push_back(page_id);
+    }
+    std::vector<uint16_t> sorted(step);
+    std::sort(sorted.begin(), sorted.end());
+    mvcc_take_dead(work.taken, sorted);
+    std::sort(work.taken.begin(), work.taken.end(), [](const RID &a, const RID &b) {
+      return a.page_id != b.page_id ? a.page_id < b.page_id : a.rec_id < b.rec_id;
+    });
+
+    struct vac_page_t
+    {
+      uint16_t page_id;
+      table_page_t* page;
+      std::vector<RID> dead;
+    };
+    std::vector<vac_page_t> compact;
+    size_t pinned = 0; // the first pages of <step>
+    try
+    {
+      for(uint16_t page_id : step)
+      {
+        vac_page_t vp;
+        vp.page_id = page_id;
+        vp.page = static_cast<table_page_t*>(Buffer_mgr::buf_pin(dbfile, page_id));
+        pinned++;
+        auto first = std::lower_bound(work.taken.begin(), work.taken.end(), page_id, [](const RID &rid, uint16_t id) {
+          return rid.page_id < id;
+        });
+        for(auto it = first; it != work.taken.end() && it->page_id == page_id; ++it)
+          vp.dead.push_back(*it);
+
+        /* No one but the step writes to the table, so its pages are read without their latch. Records marked deleted that the
+           version store knows nothing of were deleted before a restart, and are dead too */
+        uint16_t* dir = PG_DIRECTORY(vp.page);
+        size_t taken = vp.dead.size();
+        for(uint16_t rec_id = 0; rec_id < vp.page->dir_size; rec_id++)
+        {
+          RID rid = {page_id, rec_id};
+          if(Page::pg_is_deleted(vp.page, rec_id) && !mvcc_has_deletion(rid) &&
+             !std::binary_search(vp.dead.begin(), vp.dead.begin() + taken, rid, [](const RID &a, const RID &b) {
+               return a.rec_id < b.rec_id;
+             }))
+            vp.dead.push_back(rid);
+        }
+        std::inplace_merge(vp.dead.begin(), vp.dead.begin() + taken, vp.dead.end(), [](const RID &a, const RID &b) {
+          return a.rec_id < b.rec_id;
+        });
+        bool empty = true;
+        for(uint16_t rec_id = 0; rec_id < vp.page->dir_size && empty; rec_id++)
+        {
+          empty = dir[rec_id] == Page::PG_REC_UNUSED ||
+                  std::binary_search(vp.dead.begin(), vp.dead.end(), RID{page_id, rec_id}, [](const RID &a, const RID &b) {
+                    return a.rec_id < b.rec_id;
+                  });
+        }
+        if(empty)
+        {
+          work.unlinked.push_back(page_id);
+          work.unlinked_dead.insert(work.unlinked_dead.end(), vp.dead.begin(), vp.dead.end());
+        }
+        else if(vp.dead.empty())
+          continue;
+        else if(Buffer_mgr::buf_pin_count(page_id) > 1) // a scan is on it ; looked at again under the latch below
+        {
+          work.left.insert(work.left.end(), vp.dead.begin(), vp.dead.end());
+          vac.stats.busy++;
+          continue;
+        }
+        else
+          compact.push_back(vp);
+
+        for(const RID &rid : vp.dead)
+        {
+          const BYTE* rec = (const BYTE*)vp.page + Page::pg_rec_offset(dir[rid.rec_id]);
+          for(const index_def_t &idx : work.indexes)
+            Index::idx_delete_record(dbfile, idx, rec, rid);
+        }
+      }
+
+      if(!work.unlinked.empty())
+      {
+        tbl_unlink_pages(dbfile, work.td, work.unlinked);
+        vac.stats.unlinked += work.unlinked.size();
+      }
+
+      /* Compacting moves the page's records: only if no one else has it pinned, checked under the latch that keeps them out */
+      for(vac_page_t &vp : compact)
+      {
+        txn_touch(dbfile, vp.page_id);
+        std::unique_lock<std::shared_mutex> latch(Buffer_mgr::buf_latch(vp.page_id));
+        if(Buffer_mgr::buf_pin_count(vp.page_id) > 1)
+        {
+          latch.unlock();
+          work.left.insert(work.left.end(), vp.dead.begin(), vp.dead.end()); // their index entries are gone, which is fine
+          vac.stats.busy++;
+          continue;
+        }
+        for(const RID &rid : vp.dead)
+          Page::pg_del_record(vp.page, rid.rec_id);
+        latch.unlock();
+        Buffer_mgr::buf_write(dbfile, vp.page_id);
+        work.reclaimed.insert(work.reclaimed.end(), vp.dead.begin(), vp.dead.end());
+        vac.stats.reclaimed += vp.dead.size();
+      }
+    }
+    catch(...)
+    {
+      for(size_t i = 0; i < pinned; i++)
+        Buffer_mgr::buf_unpin(step[i]);
+      throw;
+    }
+    for(size_t i = 0; i < pinned; i++)
+      Buffer_mgr::buf_unpin(step[i]);
+    vac.stats.reclaimed += work.unlinked_dead.size();
+  }
+
+
+  /* Move the live records of up to VAC_STEP_PAGES pages at the back of the table into room at the front */
+  static void vac_compact(vacuum_t &vac, vac_work_t &work)
+  {
+    file_descriptor_t &dbfile = *vac.dbfile;
+    uint16_t head_id = 0; // the pinned page records are moving to
+    table_page_t* head = nullptr;
+    bool head_touched = false;
+    uint16_t tail_id = 0;
+    table_page_t* tail = nullptr;
+    snapshot_t snap;
+    page_vis_t vis;
+    std::vector<uint16_t> dir;
+    std::vector<RID> froms; // the records moved off the tail page
+
+    auto release_head = [&]() {
+      if(head == nullptr)
+        return;
+      if(head_touched)
+        Buffer_mgr::buf_write(dbfile, head_id);
+      Buffer_mgr::buf_unpin(head_id);
+      head = nullptr;
+      head_touched = false;
+    };
+
+    try
+    {
+      for(uint16_t moved_off = 0; moved_off < VAC_STEP_PAGES && vac.head < vac.tail; vac.tail--)
+      {
+        tail_id = vac.pages[vac.tail];
+        if(!vac_has_page(work, tail_id))
+          continue;
+
+        /* The records every new snapshot sees are the live ones: nothing else writes to the table while the step has it */
+        tail = static_cast<table_page_t*>(Buffer_mgr::buf_pin(dbfile, tail_id));
+        {
+          std::shared_lock<std::shared_mutex> latch(Buffer_mgr::buf_latch(tail_id));
+          uint16_t num_recs = tail->dir_size;
+          dir.assign(PG_DIRECTORY(tail), PG_DIRECTORY(tail) + num_recs);
+          snapshot_open(snap, work.xid);
+          mvcc_page_vis(snap, tail, tail_id, num_recs, vis);
+          snapshot_close(snap);
+        }
+
+        bool moved = false;
+        for(uint16_t rec_id = 0; rec_id < dir.size() && vac.head < vac.tail; rec_id++)
+        {
+          if(dir[rec_id] == Page::PG_REC_UNUSED || !(vis.all || vis.vis[rec_id]))
+            continue;
+          const BYTE* rec = (const BYTE*)tail + Page::pg_rec_offset(dir[rec_id]);
+          uint16_t size = ((const Page::record_t*)rec)->size;
+
+          /* The first page from the front with room for it */
+          while(vac.head < vac.tail)
+          {
+            uint16_t page_id = vac.pages[vac.head];
+            if(head == nullptr && vac_has_page(work, page_id))
+            {
+              head_id = page_id;
+              head = static_cast<table_page_t*>(Buffer_mgr::buf_pin(dbfile, head_id));
+            }
+            if(head != nullptr && head->free_bytes >= sizeof(uint16_t) + size)
+              break;
+            release_head();
+            vac.head++;
+          }
+          if(vac.head >= vac.tail)
+            break;
+
+          if(!head_touched)
+          {
+            txn_touch(dbfile, head_id);
+            head_touched = true;
+          }
+          RID from = {tail_id, rec_id}, to = {head_id, 0};
+          {
+            std::unique_lock<std::shared_mutex> latch(Buffer_mgr::buf_latch(head_id)); // a scan may be reading it
+            to.rec_id = Page::pg_add_record((void*)head, (void*)rec, size);
+            mvcc_created(work.xid, to);
+          }
+          froms.push_back(from);
+          for(index_def_t &idx : work.indexes)
+            Index::idx_insert_record(dbfile, idx, rec, to);
+          vac.remap.push_back({from, to});
+          vac.stats.moved++;
+          moved = true;
+        }
+        delete_rows(dbfile, froms); // marked on the tail page, so a restart does not bring them back beside their copies
+        froms.clear();
+        Buffer_mgr::buf_unpin(tail_id);
+        tail = nullptr;
+        if(moved)
+          vac.emptied.push_back(tail_id);
+        moved_off++;
+      }
+    }
+    catch(...)
+    {
+      snapshot_close(snap);
+      if(tail != nullptr)
+        Buffer_mgr::buf_unpin(tail_id);
+      release_head();
+      throw;
+    }
+    release_head();
+  }
+
+
+  /* Start the next pass once this one is done */
+  static void vac_next_phase(vacuum_t &vac, const vac_work_t &work)
+  {
+    if(vac.phase == VAC_RECLAIM && vac.next >= vac.pages.size())
+    {
+      tbl_page_map(*vac.dbfile, work.td, vac.pages);
+      vac.phase = VAC_COMPACT;
+      vac.head = 0;
+      vac.tail = vac.pages.empty() ? 0 : vac.pages.size() - 1;
+    }
+    if(vac.phase == VAC_COMPACT && vac.head >= vac.tail)
+    {
+      vac.pages.assign(vac.emptied.rbegin(), vac.emptied.rend()); // they were emptied from the back
+      vac.next = 0;
+      vac.phase = VAC_TRIM;
+    }
+    if(vac.phase == VAC_TRIM && vac.next >= vac.pages.size())
+    {
+      std::vector<uint16_t> pages;
+      tbl_page_map(*vac.dbfile, work.td, pages);
+      vac.stats.pages_after = pages.size();
+      vac.phase = VAC_DONE;
+    }
+  }
+
+
+  void vacuum_begin(file_descriptor_t &dbfile, const std::string &table_name, vacuum_t &vac)
+  {
+    table_descriptor_t td;
+    read_table_descriptor(dbfile, table_name, td);
+    if(!table_name.empty() && table_name[0] == '#')
+      throw table_error("The catalog \"" + table_name + "\" cannot be vacuumed.");
+    if(td.type != DB_TYPE_ROWS && td.type != DB_TYPE_TABLE)
+      throw table_error("\"" + table_name + "\" is not a table stored in row pages, so it cannot be vacuumed.");
+
+    vac.dbfile = &dbfile;
+    vac.table = table_name;
+    vac.phase = VAC_RECLAIM;
+    tbl_page_map(dbfile, td, vac.pages);
+    vac.next = 0;
+    vac.head = 0;
+    vac.tail = 0;
+    vac.emptied.clear();
+    vac.remap.clear();
+    vac.stats = vacuum_stats_t();
+    vac.stats.pages_before = vac.pages.size();
+    vac.stats.pages_after = vac.pages.size();
+    if(vac.pages.empty())
+      vac.phase = VAC_DONE;
+  }
+
+
+  /* The page of the waiting pages list, made when <make> is set and the file has none yet ; 0 if there is none. The pages an
+     earlier run listed are freed first. Called in the transaction that changes the list, which takes TXN_CATALOG_LOCK */
+  static uint16_t vac_limbo_list(file_descriptor_t &dbfile, bool make)
+  {
+    Lock_mgr::lock_table(txn_current()->xid, TXN_CATALOG_LOCK, Lock_mgr::LOCK_X);
+    uint16_t list_id = static_cast<Page::Page_header_t*>(Buffer_mgr::buf_pin(dbfile, TBL_HEADER_PAGE))->meta[TBL_META_VAC_LIMBO];
+    Buffer_mgr::buf_unpin(TBL_HEADER_PAGE);
+    if(list_id == 0)
+    {
+      if(!make)
+        return 0;
+      std::vector<uint16_t> ids;
+      tbl_alloc_pages(dbfile, 1, ids);
+      list_id = ids[0];
+      txn_touch(dbfile, list_id);
+      vac_limbo_page_t* list = static_cast<vac_limbo_page_t*>(Buffer_mgr::buf_pin(dbfile, list_id));
+      memset((void*)list, 0, sizeof(vac_limbo_page_t));
+      list->run = vac_run;
+      Buffer_mgr::buf_write(dbfile, list_id);
+      Buffer_mgr::buf_unpin(list_id);
+
+      txn_touch(dbfile, TBL_HEADER_PAGE);
+      static_cast<Page::Page_header_t*>(Buffer_mgr::buf_pin(dbfile, TBL_HEADER_PAGE))->meta[TBL_META_VAC_LIMBO] = list_id;
+      Buffer_mgr::buf_write(dbfile, TBL_HEADER_PAGE);
+      Buffer_mgr::buf_unpin(TBL_HEADER_PAGE);
+      return list_id;
+    }
+
+    vac_limbo_page_t* list = static_cast<vac_limbo_page_t*>(Buffer_mgr::buf_pin(dbfile, list_id));
+    uint64_t run = list->run;
+    std::vector<uint16_t> left(list->pages, list->pages + list->size);
+    Buffer_mgr::buf_unpin(list_id);
+    if(run == vac_run)
+      return list_id;
+
+    if(!left.empty())
+      tbl_free_pages(dbfile, left);
+    txn_touch(dbfile, list_id);
+    list = static_cast<vac_limbo_page_t*>(Buffer_mgr::buf_pin(dbfile, list_id));
+    list->run = vac_run;
+    list->size = 0;
+    Buffer_mgr::buf_write(dbfile, list_id);
+    Buffer_mgr::buf_unpin(list_id);
+    return list_id;
+  }
+
+
+  /* True if the file's waiting pages list was written by an earlier run, so its pages can be freed ; read without the lock,
+     which "vac_limbo_list()" checks again under */
+  static bool vac_limbo_stale(file_descriptor_t &dbfile)
+  {
+    uint16_t list_id = static_cast<Page::Page_header_t*>(Buffer_mgr::buf_pin(dbfile, TBL_HEADER_PAGE))->meta[TBL_META_VAC_LIMBO];
+    Buffer_mgr::buf_unpin(TBL_HEADER_PAGE);
+    if(list_id == 0)
+      return false;
+    bool stale = static_cast<vac_limbo_page_t*>(Buffer_mgr::buf_pin(dbfile, list_id))->run != vac_run;
+    Buffer_mgr::buf_unpin(list_id);
+    return stale;
+  }
+
+
+  /* Add the pages a step took out to the waiting pages list, in the step's transaction */
+  static void vac_limbo_add(file_descriptor_t &dbfile, const std::vector<uint16_t> &pages)
+  {
+    uint16_t list_id = vac_limbo_list(dbfile, true);
+    txn_touch(dbfile, list_id);
+    vac_limbo_page_t* list = static_cast<vac_limbo_page_t*>(Buffer_mgr::buf_pin(dbfile, list_id));
+    if(list->size + pages.size() > sizeof(list->pages) / sizeof(uint16_t))
+    {
+      Buffer_mgr::buf_unpin(list_id);
+      throw table_error("Too many pages wait for old snapshots to close before they are freed.");
+    }
+    std::copy(pages.begin(), pages.end(), list->pages + list->size);
+    list->size += pages.size();
+    Buffer_mgr::buf_write(dbfile, list_id);
+    Buffer_mgr::buf_unpin(list_id);
+  }
+
+
+  /* Take the pages <gone> (sorted) off the waiting pages list */
+  static void vac_limbo_drop(file_descriptor_t &dbfile, uint16_t list_id, const std::vector<uint16_t> &gone)
+  {
+    txn_touch(dbfile, list_id);
+    vac_limbo_page_t* list = static_cast<vac_limbo_page_t*>(Buffer_mgr::buf_pin(dbfile, list_id));
+    uint16_t kept = 0;
+    for(uint16_t i = 0; i < list->size; i++)
+    {
+      if(!std::binary_search(gone.begin(), gone.end(), list->pages[i]))
+        list->pages[kept++] = list->pages[i];
+    }
+    list->size = kept;
+    Buffer_mgr::buf_write(dbfile, list_id);
+    Buffer_mgr::buf_unpin(list_id);
+  }
+
+
+  bool vacuum_step(vacuum_t &vac)
+  {
+    if(vac.phase == VAC_DONE)
+      return false;
+    if(txn_current() != nullptr)
+      throw table_error("A vacuum runs transactions of its own, so it cannot run inside one.");
+
+    file_descriptor_t &dbfile = *vac.dbfile;
+    vacuum_release(dbfile);
+    mvcc_gc();
+
+    vac_work_t work;
+    try
+    {
+      txn_scope_t scope(dbfile);
+      work.xid = scope.txn->xid;
+      vac_lock(vac, work);
+      if(vac.phase == VAC_COMPACT)
+        vac_compact(vac, work);
+      else
+        vac_reclaim(vac, work);
+      vac_next_phase(vac, work);
+      if(!work.unlinked.empty())
+        vac_limbo_add(dbfile, work.unlinked); // listed in the file too, so they are freed even if the program ends first
+    }
+    catch(...)
+    {
+      mvcc_unreclaimed(work.taken); // the step was undone, so they are all still on their pages
+      throw;
+    }
+
+    /* Committed: the records removed are gone for good, and the pages taken out wait for their readers */
+    mvcc_reclaimed(work.reclaimed);
+    mvcc_unreclaimed(work.left);
+    if(!work.unlinked.empty())
+    {
+      std::lock_guard<std::mutex> guard(limbo_mutex);
+      limbo.push_back({&dbfile, work.xid, work.unlinked, work.unlinked_dead});
+    }
+    vac.stats.steps++;
+    if(vac.phase == VAC_DONE)
+      vacuum_release(dbfile);
+    return vac.phase != VAC_DONE;
+  }
+
+
+  vacuum_stats_t vacuum_table(file_descriptor_t &dbfile, const std::string &table_name)
+  {
+    vacuum_t vac;
+    vacuum_begin(dbfile, table_name, vac);
+    while(vacuum_step(vac))
+      ;
+    return vac.stats;
+  }
+
+
+  size_t vacuum_release(file_descriptor_t &dbfile)
+  {
+    std::vector<vac_limbo_t> ready;
+    size_t waiting = 0;
+    {
+      std::lock_guard<std::mutex> guard(limbo_mutex);
+      txn_id_t horizon = mvcc_horizon();
+      size_t kept = 0;
+      for(size_t e = 0; e < limbo.size(); e++)
+      {
+        vac_limbo_t &entry = limbo[e];
+        if(entry.dbfile == &dbfile && entry.xid < horizon)
+          ready.push_back(std::move(entry));
+        else
+        {
+          if(entry.dbfile == &dbfile)
+            waiting += entry.pages.size();
+          if(kept != e) // moving an entry onto itself would empty it
+            limbo[kept] = std::move(entry);
+          kept++;
+        }
+      }
+      limbo.resize(kept);
+    }
+    if(ready.empty() && !vac_limbo_stale(dbfile))
+      return waiting;
+
+    std::vector<uint16_t> pages;
+    std::vector<RID> dead;
+    for(const vac_limbo_t &entry : ready)
+    {
+      pages.insert(pages.end(), entry.pages.begin(), entry.pages.end());
+      dead.insert(dead.end(), entry.dead.begin(), entry.dead.end());
+    }
+    std::sort(pages.begin(), pages.end());
+    mvcc_reclaimed(dead); // no one reads the pages now ; their versions must be gone before the pages are handed out again
+    try
+    {
+      txn_scope_t scope(dbfile);
+      uint16_t list_id = vac_limbo_list(dbfile, false); // frees what an earlier run left waiting
+      if(!pages.empty())
+      {
+        if(list_id != 0)
+          vac_limbo_drop(dbfile, list_id, pages);
+        tbl_free_pages(dbfile, pages);
+      }
+    }
+    catch(...)
+    {
+      std::lock_guard<std::mutex> guard(limbo_mutex);
+      for(vac_limbo_t &entry : ready)
+        limbo.push_back(std::move(entry));
+      throw;
+    }
+    return waiting;
+  }
+}
@@ -0,0 +1,125 @@
+/**************************************************************************************************
+* Filename:   vacuum.h
+* Details:    Defines the API for vacuuming a table: reclaiming the space of its dead records,
+*             packing its live records into fewer pages, and giving the pages it no longer needs
+*             back to the free pages list, while the table stays in use.
+**************************************************************************************************/
+
+/*************************************************************************************************
+  A record deleted by a transaction every snapshot sees is dead ("mvcc.h"), but its bytes stay on
+  its page, and a page stays in the table's chain however few records it holds. A vacuum works
+  through the table in three passes:
+
+    reclaim  the dead records of each page are removed from the table's indexes and from the page
+             ("Page::pg_del_record()"), as are the records marked deleted on it before a restart,
+             which the version store no longer knows of. A page left with no records at all is
+             taken out of the chain instead ("tbl_unlink_pages()").
+    compact  records move from the pages at the back of the chain into room on the pages at the
+             front, until the two meet. A move is an update ("mvcc.h"): the record is deleted from
+             its page and a copy created on the other, and every index gets an entry for the copy.
+             Each move is listed in <vacuum_t.remap>, for anyone else holding on to RIDs.
+    trim     the pages records moved off are reclaimed again: once no snapshot can still see the
+             records that left them, they are empty and taken out of the chain.
+
+  The vacuum runs in steps of at most VAC_STEP_PAGES pages, each one a transaction of its own that
+  holds X on the table. Inserts and index lookups wait for a step at most, and scans, which take
+  no locks, go on throughout. Scans read pages without their latch, so a page is only compacted
+  when no one else has it pinned (see "Buffer_mgr::buf_pin_count()"); otherwise its dead records
+  are left for a later vacuum.
+
+  A page taken out of the chain may still be under a scan that started before, or about to be
+  reached by one that read the table's pages before it was taken out. So it waits, with the
+  records on it, until every snapshot open at the time has closed ("mvcc_horizon()"), and only
+  then goes back on the free list (scans take their snapshot before they look the table up).
+  "vacuum_release()" frees what has waited long enough ; each step calls it. The waiting pages are
+  also listed in the file (header <meta> slot TBL_META_VAC_LIMBO), in the step that takes them
+  out: no snapshot outlives the program, so the first release after a restart frees every page
+  the list still holds.
+
+  Records that were deleted but that some snapshot still sees are not dead yet, and stay where
+  they are, as do the pages they are on: a vacuum run while old snapshots are open leaves more for
+  the next one. PAX tables and the catalogs are not vacuumed.
+*************************************************************************************************/
+
+/********************************************* GUARD *********************************************/
+
+#ifndef VACUUM_H
+#define VACUUM_H
+
+/***************************************** HEADER FILES ******************************************/
+
+#include "table_mgr.h"
+#include "mvcc.h"
+
+/******************************************* CONSTANTS *******************************************/
+
+namespace Table
+{
+  const uint16_t VAC_STEP_PAGES = 8; // pages a step reclaims, or moves records off
+
+  /* Passes of a vacuum, in order */
+  const BYTE VAC_RECLAIM = 0;
+  const BYTE VAC_COMPACT = 1;
+  const BYTE VAC_TRIM = 2;
+  const BYTE VAC_DONE = 3;
+}
+
+/************************************** IMPLEMENT STRUCTURES *************************************/
+
+namespace Table
+{
+  /* Structure for a record a vacuum moved */
+  struct rid_move_t
+  {
+    RID from;
+    RID to;
+  };
+
+  /* Structure for what a vacuum did */
+  struct vacuum_stats_t
+  {
+    size_t steps = 0;
+    size_t pages_before = 0; // pages in the table when the vacuum began
+    size_t pages_after = 0; // and when it was done
+    size_t reclaimed = 0; // dead records removed
+    size_t moved = 0; // live records moved to pages nearer the front
+    size_t unlinked = 0; // pages taken out of the table
+    size_t busy = 0; // pages whose dead records were left because someone had the page pinned
+  };
+
+  /* Structure that holds the state of a vacuum between steps */
+  struct vacuum_t
+  {
+    file_descriptor_t* dbfile;
+    std::string table;
+    BYTE phase; // VAC_*
+    std::vector<uint16_t> pages; // the pages of the pass, in chain order ; any the table no longer has are skipped
+    size_t next; // reclaim and trim: the next page of <pages>
+    size_t head; // compact: records move off <pages[tail]> onto <pages[head]> and the pages after it, until the two meet
+    size_t tail;
+    std::vector<uint16_t> emptied; // pages records were moved off, trimmed at the end
+    std::vector<rid_move_t> remap; // every record moved so far, in the order it moved
+    vacuum_stats_t stats;
+  };
+}
+
+namespace Table
+{
+  /************************************* FUNCTION PROTOTYPES *************************************/
+
+  /* Start vacuuming a table ; throws a <table_error> if there is no such table, or it cannot be vacuumed */
+  void vacuum_begin(file_descriptor_t &dbfile, const std::string &table_name, vacuum_t &vac);
+
+  /* Do one step, in a transaction of its own ; returns false once the vacuum is done. Throws a <table_error> if a transaction is
+     running on the calling thread: its locks would be held until it ends */
+  bool vacuum_step(vacuum_t &vac);
+
+  /* Vacuum a table from start to end */
+  vacuum_stats_t vacuum_table(file_descriptor_t &dbfile, const std::string &table_name);
+
+  /* Give the pages vacuums took out of tables back to the free list, once no reader can be on them, and every page an earlier
+     run of the program left waiting ; returns how many still wait */
+  size_t vacuum_release(file_descriptor_t &dbfile);
+}
+
+#endif // VACUUM_H
@@ -0,0 +1,586 @@
+/**************************************************************************************************
+* Filename:   workload.cpp
+* Details:    Implements the workload generator, traces and runner declared in "workload.h".
+**************************************************************************************************/
+
+/****************************************** HEADER FILES *****************************************/
+
+#include "workload.h"
+#include "../buffer_mgr/buffer_mgr.h"
+#include "../index_mgr/index_mgr.h"
+#include "../lock_mgr/lock_mgr.h"
+#include "../table_mgr/transaction.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <shared_mutex>
+#include <sstream>
+
+/************************************** IMPLEMENT STRUCTURES *************************************/
+
+namespace Workload
+{
+  /* Structure for the table a run works on, and the buffers its operations reuse */
+  struct wl_table_t
+  {
+    file_descriptor_t* dbfile;
+    Table::insert_stmt_t stmt; // every column ; the inserts keep its <indexes> current, the run being the only writer
+    Table::index_def_t idx; // the B+tree on "id", copied from <stmt.indexes> after every insert for its root
+    std::string rec;
+    Table::row_t row;
+    std::vector<Table::RID> rids;
+    std::vector<std::string> vals; // values of a row being written
+    Table::row_t new_row;
+  };
+}
+
+/************************************ FUNCTION IMPLEMENTATIONS ***********************************/
+
+namespace Workload
+{
+
+  /***************************************** KEYS ********************************************/
+
+  /* Sum of 1 / i^theta for i in (from, to] */
+  static double wl_zeta(uint64_t from, uint64_t to)
+  {
+    double sum = 0;
+    for(uint64_t i = from + 1; i <= to; i++)
+      sum += 1 / pow((double)i, WL_ZIPF_THETA);
+    return sum;
+  }
+
+
+  static uint64_t wl_hash(uint64_t x)
+  {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+  }
+
+
+  void wl_keygen_init(wl_keygen_t &gen, BYTE dist, uint64_t n, uint64_t seed)
+  {
+    gen.dist = dist;
+    gen.n = 0;
+    gen.rng.seed(seed);
+    gen.zeta_n = 0;
+    gen.zeta_2 = wl_zeta(0, 2);
+    gen.alpha = 1 / (1 - WL_ZIPF_THETA);
+    wl_keygen_grow(gen, n);
+  }
+
+
+  void wl_keygen_grow(wl_keygen_t &gen, uint64_t n)
+  {
+    if(n <= gen.n)
+      return;
+    if(gen.dist != WL_UNIFORM)
+    {
+      gen.zeta_n += wl_zeta(gen.n, n);
+      gen.eta = (1 - pow(2.0 / n, 1 - WL_ZIPF_THETA)) / (1 - gen.zeta_2 / gen.zeta_n);
+    }
+    gen.n = n;
+  }
+
+
+  uint64_t wl_next_key(wl_keygen_t &gen)
+  {
+    if(gen.n <= 1)
+      return 0;
+    if(gen.dist == WL_UNIFORM)
+      return gen.rng() % gen.n;
+
+    /* Rank 0 is the most popular */
+    double u = std::uniform_real_distribution<double>(0, 1)(gen.rng);
+    double uz = u * gen.zeta_n;
+    uint64_t rank;
+    if(uz < 1)
+      rank = 0;
+    else if(uz < 1 + pow(0.5, WL_ZIPF_THETA))
+      rank = 1;
+    else
+      rank = std::min<uint64_t>(gen.n - 1, (uint64_t)(gen.n * pow(gen.eta * u - gen.eta + 1, gen.alpha)));
+
+    if(gen.dist == WL_LATEST)
+      return gen.n - 1 - rank;
+    return wl_hash(rank) % gen.n;
+  }
+
+
+  /*************************************** CONFIGS *******************************************/
+
+  bool wl_preset(const std::string &name, wl_config_t &cfg)
+  {
+    static const struct { const char* name; double mix[WL_NUM_OPS]; BYTE dist; } presets[] = {
+      {"a", {0.5, 0.5, 0, 0, 0}, WL_ZIPFIAN},    // update heavy
+      {"b", {0.95, 0.05, 0, 0, 0}, WL_ZIPFIAN},  // read mostly
+      {"c", {1, 0, 0, 0, 0}, WL_ZIPFIAN},        // read only
+      {"d", {0.95, 0, 0.05, 0, 0}, WL_LATEST},   // read latest
+      {"e", {0, 0, 0.05, 0.95, 0}, WL_ZIPFIAN},  // short ranges
+      {"f", {0.5, 0, 0, 0, 0.5}, WL_ZIPFIAN},    // read-modify-write
+    };
+    for(const auto &p : presets)
+    {
+      if(name == p.name)
+      {
+        std::copy(p.mix, p.mix + WL_NUM_OPS, cfg.mix);
+        cfg.dist = p.dist;
+        return true;
+      }
+    }
+    return false;
+  }
+
+
+  BYTE wl_dist(const std::string &name)
+  {
+    if(name == "uniform")
+      return WL_UNIFORM;
+    if(name == "zipfian")
+      return WL_ZIPFIAN;
+    if(name == "latest")
+      return WL_LATEST;
+    throw wl_error("Unknown key distribution \"" + name + "\" ; use uniform, zipfian or latest.");
+  }
+
+
+  const char* wl_op_name(BYTE op)
+  {
+    static const char* names[] = {"read", "update", "insert", "scan", "rmw"};
+    return op < WL_NUM_OPS ? names[op] : "?";
+  }
+
+
+  void wl_generate(const wl_config_t &cfg, std::vector<wl_op_t> &ops)
+  {
+    double total = 0;
+    BYTE last = 0; // the last operation in the mix, taken when rounding leaves <at> past the others
+    for(BYTE op = 0; op < WL_NUM_OPS; op++)
+    {
+      total += cfg.mix[op];
+      if(cfg.mix[op] > 0)
+        last = op;
+    }
+    if(total <= 0)
+      throw wl_error("The mix has no operations in it.");
+    if(cfg.records == 0)
+      throw wl_error("The table needs at least one record to start with.");
+    if(cfg.records + cfg.ops > INT32_MAX)
+      throw wl_error("Too many keys for the INT key column.");
+
+    wl_keygen_t gen;
+    wl_keygen_init(gen, cfg.dist, cfg.records, cfg.seed);
+    std::mt19937_64 rng(wl_hash(cfg.seed));
+    std::uniform_real_distribution<double> pick(0, total);
+    uint64_t next_key = cfg.records;
+
+    ops.resize(cfg.ops);
+    for(wl_op_t &op : ops)
+    {
+      double at = pick(rng);
+      op.type = 0;
+      while(op.type < last && (at >= cfg.mix[op.type] || cfg.mix[op.type] <= 0))
+        at -= cfg.mix[op.type++];
+      op.arg = 0;
+      if(op.type == WL_INSERT)
+      {
+        op.key = next_key++;
+        wl_keygen_grow(gen, next_key);
+        continue;
+      }
+      op.key = wl_next_key(gen);
+      if(op.type == WL_SCAN)
+        op.arg = 1 + rng() % std::max<uint16_t>(cfg.max_scan, 1);
+      else if(op.type == WL_UPDATE || op.type == WL_RMW)
+        op.arg = rng() % cfg.fields;
+    }
+  }
+
+
+  /**************************************** TRACES *******************************************/
+
+  static const char WL_OP_CODES[] = "RUISM"; // by operation
+
+  void wl_write_trace(const std::string &fname, const wl_config_t &cfg, const std::vector<wl_op_t> &ops)
+  {
+    std::ofstream out(fname);
+    if(!out.is_open())
+      throw wl_error("Cannot open \"" + fname + "\" to write the trace.");
+    out << "# ycsb trace: <op> <key> [<column> | <rows>] ; R read, U update, I insert, S scan, M read-modify-write\n";
+    out << "load table=" << cfg.table << " records=" << cfg.records << " fields=" << cfg.fields
+        << " field_len=" << cfg.field_len << " seed=" << cfg.seed << "\n";
+    for(const wl_op_t &op : ops)
+    {
+      out << WL_OP_CODES[op.type] << ' ' << op.key;
+      if(op.type == WL_UPDATE || op.type == WL_SCAN || op.type == WL_RMW)
+        out << ' ' << op.arg;
+      out << '\n';
+    }
+    if(!out.good())
+      throw wl_error("Cannot write the trace to \"" + fname + "\".");
+  }
+
+
+  void wl_read_trace(const std::string &fname, wl_config_t &cfg, std::vector<wl_op_t> &ops)
+  {
+    std::ifstream in(fname);
+    if(!in.is_open())
+      throw wl_error("Cannot open the trace \"" + fname + "\".");
+
+    std::string line;
+    size_t line_no = 0;
+    bool loaded = false;
+    ops.clear();
+    while(std::getline(in, line))
+    {
+      line_no++;
+      if(line.empty() || line[0] == '#')
+        continue;
+      std::istringstream words(line);
+      std::string word;
+      words >> word;
+      auto bad = [&](const std::string &why) { return wl_error("Line " + std::to_string(line_no) + " of \"" + fname + "\": " + why); };
+
+      if(word == "load")
+      {
+        while(words >> word)
+        {
+          size_t eq = word.find('=');
+          std::string name = word.substr(0, eq), val = eq == std::string::npos ? "" : word.substr(eq + 1);
+          if(name == "table")
+            cfg.table = val;
+          else if(name == "records")
+            cfg.records = std::stoull(val);
+          else if(name == "fields")
+            cfg.fields = std::stoul(val);
+          else if(name == "field_len")
+            cfg.field_len = std::stoul(val);
+          else if(name == "seed")
+            cfg.seed = std::stoull(val);
+          else
+            throw bad("unknown setting \"" + name + "\"");
+        }
+        loaded = true;
+        continue;
+      }
+
+      const char* code = word.size() == 1 ? strchr(WL_OP_CODES, word[0]) : nullptr;
+      if(code == nullptr || *code == '\0')
+        throw bad("unknown operation \"" + word + "\"");
+      if(!loaded)
+        throw bad("an operation before the \"load\" line");
+      wl_op_t op;
+      op.type = code - WL_OP_CODES;
+      op.arg = 0;
+      uint64_t key;
+      if(!(words >> key) || key > INT32_MAX)
+        throw bad("no key");
+      op.key = key;
+      if((op.type == WL_UPDATE || op.type == WL_SCAN || op.type == WL_RMW) && !(words >> op.arg))
+        throw bad(op.type == WL_SCAN ? "no row count" : "no column");
+      if((op.type == WL_UPDATE || op.type == WL_RMW) && op.arg >= cfg.fields)
+        throw bad("no such column");
+      ops.push_back(op);
+    }
+    if(!loaded)
+      throw wl_error("\"" + fname + "\" has no \"load\" line.");
+    cfg.ops = ops.size();
+  }
+
+
+  /***************************************** LOAD ********************************************/
+
+  /* The value of column <field> of the row of <key> as written by operation <version> (0 for the load) */
+  static void wl_fill(std::string &val, uint16_t len, uint64_t key, uint16_t field, uint64_t version)
+  {
+    val.resize(len);
+    uint64_t x = wl_hash(key * 0x100000001b3ULL ^ wl_hash(field + (version << 16)));
+    for(uint16_t i = 0; i < len; i++)
+    {
+      if(i % 12 == 0 && i != 0)
+        x = wl_hash(x);
+      val[i] = 'a' + (x >> (5 * (i % 12))) % 26;
+    }
+  }
+
+
+  uint16_t wl_pages_needed(const wl_config_t &cfg, const std::vector<wl_op_t> &ops)
+  {
+    uint64_t rows = cfg.records;
+    for(const wl_op_t &op : ops)
+      if(op.type == WL_INSERT || op.type == WL_UPDATE || op.type == WL_RMW) // an update writes a new version
+        rows++;
+    uint64_t rec_size = 16 + (uint64_t)cfg.fields * (cfg.field_len + 4);
+    uint64_t per_page = std::max<uint64_t>(1, (PAGE_SIZE - 64) / (rec_size + sizeof(uint16_t)));
+    uint64_t pages = rows / per_page + rows * 16 / PAGE_SIZE * 2; // records, and B+tree leaves half full
+    pages = pages * 5 / 4 + 200; // room for extents not yet filled, and the catalog
+    if(pages > UINT16_MAX)
+      throw wl_error("The load and run need " + std::to_string(pages) + " pages, more than one DB file holds.");
+    return pages;
+  }
+
+
+  double wl_load(file_descriptor_t &dbfile, const wl_config_t &cfg)
+  {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<Table::col_def_t> cols = {{"id", Table::TBL_TYPE_INT, 1}};
+    std::vector<std::string> names = {"id"};
+    for(uint16_t f = 0; f < cfg.fields; f++)
+    {
+      names.push_back("field" + std::to_string(f));
+      cols.push_back({names.back(), Table::TBL_TYPE_VCHAR, cfg.field_len});
+    }
+    Table::create_table(dbfile, cfg.table, cols, cfg.layout);
+
+    /* The index is built once the rows are in, from the whole table at once */
+    Table::insert_stmt_t stmt;
+    Table::prepare_insert(dbfile, cfg.table, names, stmt);
+    std::vector<Table::row_t> rows;
+    std::vector<std::string> vals(WL_LOAD_BATCH * cfg.fields);
+    for(uint64_t first = 0; first < cfg.records; first += WL_LOAD_BATCH)
+    {
+      rows.resize(std::min<uint64_t>(WL_LOAD_BATCH, cfg.records - first));
+      for(size_t r = 0; r < rows.size(); r++)
+      {
+        Table::row_t &row = rows[r];
+        row.resize(cfg.fields + 1);
+        row[0] = Page::val_int(first + r);
+        for(uint16_t f = 0; f < cfg.fields; f++)
+        {
+          std::string &val = vals[r * cfg.fields + f];
+          wl_fill(val, cfg.field_len, first + r, f, 0);
+          row[f + 1] = Page::val_str(val);
+        }
+      }
+      Table::insert_rows(dbfile, stmt, rows);
+    }
+    Index::create_index(dbfile, cfg.table + "_id", cfg.table, "id");
+    Buffer_mgr::flush_all(dbfile);
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  }
+
+
+  /************************************** OPERATIONS *****************************************/
+
+  static void wl_digest(wl_result_t &res, const Table::row_t &row)
+  {
+    for(const Page::value_t &val : row)
+    {
+      uint64_t h = val.type;
+      if(val.type == Page::RTYPE_INT)
+        h = h * 31 + (uint32_t)val.i;
+      else if(val.type == Page::RTYPE_STRING)
+        for(uint16_t i = 0; i < val.str.len; i++)
+          h = h * 31 + (BYTE)val.str.ptr[i];
+      res.digest = wl_hash(res.digest ^ h);
+    }
+    res.rows_read++;
+  }
+
+
+  /* True if the snapshot sees the row at <rid> ; its page is only read for a version the version store has no say on */
+  static bool wl_visible(wl_table_t &t, const Table::snapshot_t &snap, Table::RID rid)
+  {
+    if(!Table::mvcc_may_see(snap, rid))
+      return false;
+    void* page = Buffer_mgr::buf_pin(*t.dbfile, rid.page_id);
+    bool visible;
+    {
+      std::shared_lock<std::shared_mutex> latch(Buffer_mgr::buf_latch(rid.page_id));
+      visible = Table::mvcc_visible(snap, page, rid);
+    }
+    Buffer_mgr::buf_unpin(rid.page_id);
+    return visible;
+  }
+
+
+  /* The RIDs of the versions of <key> the running transaction sees, in <t.rids> */
+  static void wl_find(wl_table_t &t, Table::txn_id_t xid, uint32_t key)
+  {
+    Table::snapshot_t snap;
+    Table::snapshot_open(snap, xid);
+    std::vector<Table::RID> all;
+    Index::bt_lookup(*t.dbfile, t.idx, Page::val_int(key), all);
+    t.rids.clear();
+    for(Table::RID rid : all)
+      if(wl_visible(t, snap, rid))
+        t.rids.push_back(rid);
+    Table::snapshot_close(snap);
+  }
+
+
+  static void wl_read(wl_table_t &t, uint32_t key, wl_result_t &res)
+  {
+    Table::txn_scope_t scope(*t.dbfile);
+    Lock_mgr::lock_table(scope.txn->xid, t.stmt.td.lock_id, Lock_mgr::LOCK_S);
+    wl_find(t, scope.txn->xid, key);
+    if(t.rids.empty())
+      res.not_found++;
+    for(Table::RID rid : t.rids)
+    {
+      Table::read_row(*t.dbfile, rid, t.rec, t.row);
+      wl_digest(res, t.row);
+    }
+  }
+
+
+  /* Give column <field> of the row of <key> the value of operation <version> */
+  static void wl_update(wl_table_t &t, uint32_t key, uint16_t field, uint64_t version, wl_result_t &res)
+  {
+    Table::txn_scope_t scope(*t.dbfile);
+    Table::txn_id_t xid = scope.txn->xid;
+    Lock_mgr::lock_table(xid, t.stmt.td.lock_id, Lock_mgr::LOCK_X);
+    wl_find(t, xid, key);
+    if(t.rids.empty())
+      res.not_found++;
+    for(Table::RID rid : t.rids)
+    {
+      Table::read_row(*t.dbfile, rid, t.rec, t.row);
+      Table::delete_rows(*t.dbfile, {rid}); // marked deleted on its page too, so the old version stays gone after a restart
+      t.new_row = t.row; // strings point into <t.rec>, which the insert leaves alone
+      wl_fill(t.vals[0], t.stmt.td.col_types[field + 1].max_size, key, field, version);
+      t.new_row[field + 1] = Page::val_str(t.vals[0]);
+      Table::insert_rows(*t.dbfile, t.stmt, {t.new_row});
+    }
+  }
+
+
+  static void wl_insert(wl_table_t &t, uint32_t key)
+  {
+    t.new_row.resize(t.stmt.td.col_types.size());
+    t.new_row[0] = Page::val_int(key);
+    for(uint16_t f = 0; f + 1 < t.new_row.size(); f++)
+    {
+      wl_fill(t.vals[f], t.stmt.td.col_types[f + 1].max_size, key, f, 0);
+      t.new_row[f + 1] = Page::val_str(t.vals[f]);
+    }
+    Table::insert_rows(*t.dbfile, t.stmt, {t.new_row});
+  }
+
+
+  static void wl_scan(wl_table_t &t, uint32_t key, uint16_t rows, wl_result_t &res)
+  {
+    Table::txn_scope_t scope(*t.dbfile);
+    Lock_mgr::lock_table(scope.txn->xid, t.stmt.td.lock_id, Lock_mgr::LOCK_S);
+    Table::snapshot_t snap;
+    Table::snapshot_open(snap, scope.txn->xid);
+    Index::bt_cursor_t cur;
+    Page::value_t lo = Page::val_int(key), at;
+    Table::RID rid;
+    try
+    {
+      Index::bt_open_range(*t.dbfile, t.idx, &lo, nullptr, cur);
+      for(uint16_t n = 0; n < rows && Index::bt_next(cur, at, rid); )
+      {
+        if(!wl_visible(t, snap, rid))
+          continue;
+        Table::read_row(*t.dbfile, rid, t.rec, t.row);
+        wl_digest(res, t.row);
+        n++;
+      }
+    }
+    catch(...)
+    {
+      Table::snapshot_close(snap);
+      throw;
+    }
+    Table::snapshot_close(snap);
+  }
+
+
+  /****************************************** RUN ********************************************/
+
+  void wl_run(file_descriptor_t &dbfile, const wl_config_t &cfg, const std::vector<wl_op_t> &ops, wl_result_t &res)
+  {
+    wl_table_t t;
+    t.dbfile = &dbfile;
+    std::vector<std::string> names = {"id"};
+    for(uint16_t f = 0; f < cfg.fields; f++)
+      names.push_back("field" + std::to_string(f));
+    Table::prepare_insert(dbfile, cfg.table, names, t.stmt);
+    t.idx.name.clear();
+    for(const Table::index_def_t &idx : t.stmt.indexes)
+      if(idx.column == "id" && idx.type == Table::DB_TYPE_BTREE)
+        t.idx = idx;
+    if(t.idx.name.empty())
+      throw wl_error("\"" + cfg.table + "\" has no B+tree on \"id\" ; it was not loaded by \"wl_load()\".");
+    t.vals.resize(std::max<uint16_t>(cfg.fields, 1));
+
+    res = wl_result_t();
+    for(const wl_op_t &op : ops)
+      res.count[op.type]++;
+    for(BYTE op = 0; op < WL_NUM_OPS; op++)
+    {
+      res.lat_ns[op].reserve(res.count[op]);
+      res.count[op] = 0;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < ops.size(); i++)
+    {
+      const wl_op_t &op = ops[i];
+      auto op_start = std::chrono::steady_clock::now();
+      switch(op.type)
+      {
+        case WL_READ:
+          wl_read(t, op.key, res);
+          break;
+        case WL_UPDATE:
+          wl_update(t, op.key, op.arg, i + 1, res);
+          break;
+        case WL_INSERT:
+          wl_insert(t, op.key);
+          break;
+        case WL_SCAN:
+          wl_scan(t, op.key, op.arg, res);
+          break;
+        case WL_RMW:
+        {
+          Table::txn_scope_t scope(dbfile); // the read and the update join it
+          wl_read(t, op.key, res);
+          wl_update(t, op.key, op.arg, i + 1, res);
+          break;
+        }
+      }
+      if(op.type == WL_INSERT || op.type == WL_UPDATE || op.type == WL_RMW)
+      {
+        for(const Table::index_def_t &idx : t.stmt.indexes)
+          if(idx.name == t.idx.name)
+            t.idx = idx;
+      }
+      uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - op_start).count();
+      res.lat_ns[op.type].push_back(std::min<uint64_t>(ns, UINT32_MAX));
+      res.count[op.type]++;
+    }
+    res.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  }
+
+
+  void wl_report(const std::string &name, wl_result_t &res)
+  {
+    uint64_t total = 0;
+    for(BYTE op = 0; op < WL_NUM_OPS; op++)
+      total += res.count[op];
+    printf("{\"bench\": \"ycsb\", \"case\": \"%s\", \"ops\": %llu, \"seconds\": %.6f, \"ops_per_sec\": %.1f}\n", name.c_str(),
+           (unsigned long long)total, res.seconds, res.seconds > 0 ? total / res.seconds : 0.0);
+    for(BYTE op = 0; op < WL_NUM_OPS; op++)
+    {
+      std::vector<uint32_t> &lat = res.lat_ns[op];
+      if(lat.empty())
+        continue;
+      std::sort(lat.begin(), lat.end());
+      auto pct = [&lat](double p) { return lat[std::min(lat.size() - 1, (size_t)(p * lat.size()))] / 1e3; };
+      printf("{\"bench\": \"ycsb\", \"case\": \"%s_%s_latency\", \"requests\": %zu, \"p50_us\": %.1f, \"p99_us\": %.1f, "
+             "\"p999_us\": %.1f, \"max_us\": %.1f}\n", name.c_str(), wl_op_name(op), lat.size(), pct(0.5), pct(0.99),
+             pct(0.999), lat.back() / 1e3);
+    }
+    printf("{\"bench\": \"ycsb\", \"case\": \"%s_check\", \"rows_read\": %llu, \"not_found\": %llu, \"digest\": \"%016llx\"}\n",
+           name.c_str(), (unsigned long long)res.rows_read, (unsigned long long)res.not_found, (unsigned long long)res.digest);
+    fflush(stdout);
+  }
+}
@@ -0,0 +1,167 @@
+/**************************************************************************************************
+* Filename:   workload.h
+* Details:    Defines the API for generating YCSB-style workloads (mixes of reads, updates, inserts
+*             and scans over a key-value table), recording them as traces, and running them through
+*             the Table API while timing every operation.
+**************************************************************************************************/
+
+/*************************************************************************************************
+  The table has an INT key column "id" (indexed with a B+tree) and <fields> VCHAR columns of
+  <field_len> characters, "field0" ... , like YCSB's "usertable". It is loaded with keys
+  0 ... <records> - 1 ; an insert adds the next key up.
+
+  Operations pick their key from one of three distributions over the keys inserted so far:
+  uniform, zipfian (Gray et al.'s generator, with the popular keys scattered over the key space by
+  a hash, as YCSB's "scrambled zipfian"), or latest (zipfian over how recently the key was
+  inserted). A scan reads 1 ... <max_scan> rows (uniformly) in key order from its key on.
+
+  A whole run is generated before it starts, as a list of <wl_op_t>, so the generator costs the
+  run nothing and the list can be written out as a trace and run again. Every value written is
+  derived from its key, column and the position of its operation in the list, so running the
+  same trace against the same load does the same work and reads the same values, whatever the
+  pool size or page layout: <wl_result_t.digest> sums up every value read, for checking that.
+
+  Each operation runs in a transaction of its own, as a server request would ("server.h"): reads
+  and scans hold S on the table while they use its index, and writers hold X (see "table_mgr.cpp").
+  An update deletes the row's current version, marking it deleted on its page ("delete_rows()"),
+  and inserts the new one ("mvcc.h"), so the table grows with every update until its dead
+  versions are reclaimed, and a restart does not bring the old versions back.
+*************************************************************************************************/
+
+/********************************************* GUARD *********************************************/
+
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+
+/***************************************** HEADER FILES ******************************************/
+
+#include "../table_mgr/table_mgr.h"
+
+#include <random>
+
+/******************************************* CONSTANTS *******************************************/
+
+namespace Workload
+{
+  /* Operations */
+  const BYTE WL_READ = 0;   // read the row of a key
+  const BYTE WL_UPDATE = 1; // write one column of the row of a key
+  const BYTE WL_INSERT = 2; // add the row of a new key
+  const BYTE WL_SCAN = 3;   // read rows in key order from a key on
+  const BYTE WL_RMW = 4;    // read the row of a key, then update it, in one transaction
+  const BYTE WL_NUM_OPS = 5;
+
+  /* Key distributions */
+  const BYTE WL_UNIFORM = 0;
+  const BYTE WL_ZIPFIAN = 1;
+  const BYTE WL_LATEST = 2;
+
+  const double WL_ZIPF_THETA = 0.99; // YCSB's skew
+  const size_t WL_LOAD_BATCH = 1000; // rows per insert while loading
+}
+
+/************************************** IMPLEMENT STRUCTURES *************************************/
+
+namespace Workload
+{
+  class wl_error : public std::runtime_error
+  {
+    public:
+      wl_error(std::string what) : std::runtime_error(what) {}
+      wl_error(const char *what) : std::runtime_error(what) {}
+  };
+
+  /* Structure for what to load and what to run */
+  struct wl_config_t
+  {
+    /* the load, which a trace records */
+    std::string table = "usertable";
+    uint64_t records = 10000;
+    uint16_t fields = 10;
+    uint16_t field_len = 100;
+    uint64_t seed = 1;
+
+    /* the run */
+    uint64_t ops = 100000;
+    double mix[WL_NUM_OPS] = {1, 0, 0, 0, 0}; // weight of each operation
+    BYTE dist = WL_ZIPFIAN;
+    uint16_t max_scan = 100;
+    uint16_t layout = Table::DB_TYPE_ROWS; // or DB_TYPE_PAX
+  };
+
+  /* Structure for one operation of a run */
+  struct wl_op_t
+  {
+    BYTE type;
+    uint32_t key;
+    uint16_t arg; // the column an update writes, or the rows a scan reads
+  };
+
+  /* Structure for a key generator over keys 0 ... <n> - 1 */
+  struct wl_keygen_t
+  {
+    BYTE dist;
+    uint64_t n;
+    std::mt19937_64 rng;
+    double zeta_n; // zeta(n, theta), kept up to date as <n> grows
+    double zeta_2;
+    double alpha;
+    double eta;
+  };
+
+  /* Structure for what a run did */
+  struct wl_result_t
+  {
+    double seconds = 0;
+    uint64_t count[WL_NUM_OPS] = {};
+    std::vector<uint32_t> lat_ns[WL_NUM_OPS]; // latency of every operation, by type
+    uint64_t not_found = 0; // reads and updates of a key that had no row
+    uint64_t rows_read = 0;
+    uint64_t digest = 0; // of every value read, in order
+  };
+}
+
+namespace Workload
+{
+  /************************************* FUNCTION PROTOTYPES *************************************/
+
+  /* Set the mix and distribution of YCSB core workload <name> ("a" ... "f") ; false if there is no such workload */
+  bool wl_preset(const std::string &name, wl_config_t &cfg);
+
+  /* Parse "uniform", "zipfian" or "latest" ; throws a <wl_error> otherwise */
+  BYTE wl_dist(const std::string &name);
+
+  /* Start generating keys below <n> */
+  void wl_keygen_init(wl_keygen_t &gen, BYTE dist, uint64_t n, uint64_t seed);
+
+  /* Let the generator pick from keys below <n> (which only grows) */
+  void wl_keygen_grow(wl_keygen_t &gen, uint64_t n);
+
+  uint64_t wl_next_key(wl_keygen_t &gen);
+
+  /* Generate the <cfg.ops> operations of a run */
+  void wl_generate(const wl_config_t &cfg, std::vector<wl_op_t> &ops);
+
+  /* Write the load settings of <cfg> and <ops> to the text file <fname>, one operation per line ; throws a <wl_error> */
+  void wl_write_trace(const std::string &fname, const wl_config_t &cfg, const std::vector<wl_op_t> &ops);
+
+  /* Read a trace written by "wl_write_trace()", setting the load settings of <cfg> from it ; throws a <wl_error> */
+  void wl_read_trace(const std::string &fname, wl_config_t &cfg, std::vector<wl_op_t> &ops);
+
+  /* Pages a DB file needs for the load and the rows <ops> add */
+  uint16_t wl_pages_needed(const wl_config_t &cfg, const std::vector<wl_op_t> &ops);
+
+  /* Create the table and its index and load <cfg.records> rows ; returns the seconds it took */
+  double wl_load(file_descriptor_t &dbfile, const wl_config_t &cfg);
+
+  /* Run <ops> against the loaded table, in order */
+  void wl_run(file_descriptor_t &dbfile, const wl_config_t &cfg, const std::vector<wl_op_t> &ops, wl_result_t &res);
+
+  /* Print the throughput of a run and the latencies of each operation, as JSON lines named after <name> */
+  void wl_report(const std::string &name, wl_result_t &res);
+
+  /* "read", "update", ... */
+  const char* wl_op_name(BYTE op);
+}
+
+#endif // WORKLOAD_H
@@ -0,0 +1,155 @@
+/**************************************************************************************************
+* Filename:   ycsb.cpp
+* Details:    Loads a fresh DB file with a YCSB "usertable" and runs a workload against it (see
+*             "workload.h"), printing the throughput, the latencies of each operation (p50, p99,
+*             p99.9, max) and the buffer pool and file IO of the run as JSON lines. A run can be
+*             recorded as a trace, and a trace replayed: the load it names is made first.
+*             Usage: ./<executable> <db_file> [setting=value ...]
+**************************************************************************************************/
+
+/****************************************** HEADER FILES *****************************************/
+
+#include "workload.h"
+#include "../buffer_mgr/buffer_mgr.h"
+#include "../paging/io_stats.h"
+
+#include <fstream>
+#include <iostream>
+
+/************************************** TOOL IMPLEMENTATION **************************************/
+
+static const char USAGE[] =
+  "Usage: ./<executable> <db_file> [setting=value ...]\n"
+  "  workload=a..f        YCSB core workload: the mix and key distribution (default c)\n"
+  "  read=, update=, insert=, scan=, rmw=   weights of a mix of your own\n"
+  "  dist=uniform|zipfian|latest           key distribution\n"
+  "  records=N ops=N      rows loaded, operations run (10000, 100000)\n"
+  "  fields=N field_len=N VCHAR columns per row and their length (10, 100)\n"
+  "  max_scan=N           longest scan (100)\n"
+  "  seed=N               of the load and the generator (1)\n"
+  "  layout=rows|pax      page layout of the table (rows)\n"
+  "  pool=N               buffer pool pages (1024)\n"
+  "  record=FILE          write the run's trace to FILE\n"
+  "  replay=FILE          run the trace in FILE instead of generating one\n"
+  "  name=NAME            name of the result lines (the workload's, \"custom\" or \"replay\")\n";
+
+int main(int argc, char* argv[])
+{
+
+	/**************************************** ERROR CHECKING ***************************************/
+
+	if(argc < 2)
+	{
+		printf("%s", USAGE);
+		exit(EXIT_FAILURE);
+	}
+
+	/******************************************** SETUP ********************************************/
+
+	const char* db_name = argv[1];
+	Workload::wl_config_t cfg;
+	Workload::wl_preset("c", cfg);
+	std::string preset = "c", name, record, replay;
+	bool custom_mix = false;
+	uint16_t pool_size = 1024;
+	try
+	{
+		for(int a = 2; a < argc; a++)
+		{
+			std::string arg = argv[a];
+			size_t eq = arg.find('=');
+			if(eq == std::string::npos)
+				throw Workload::wl_error("\"" + arg + "\" is not a setting=value.");
+			std::string key = arg.substr(0, eq), val = arg.substr(eq + 1);
+			if(key == "workload")
+			{
+				if(!Workload::wl_preset(val, cfg))
+					throw Workload::wl_error("There is no workload \"" + val + "\" ; use a to f.");
+				preset = val;
+			}
+			else if(key == "dist")
+				cfg.dist = Workload::wl_dist(val);
+			else if(key == "records")
+				cfg.records = std::stoull(val);
+			else if(key == "ops")
+				cfg.ops = std::stoull(val);
+			else if(key == "fields")
+				cfg.fields = std::stoul(val);
+			else if(key == "field_len")
+				cfg.field_len = std::stoul(val);
+			else if(key == "max_scan")
+				cfg.max_scan = std::stoul(val);
+			else if(key == "seed")
+				cfg.seed = std::stoull(val);
+			else if(key == "layout" && (val == "rows" || val == "pax"))
+				cfg.layout = val == "pax" ? Table::DB_TYPE_PAX : Table::DB_TYPE_ROWS;
+			else if(key == "pool")
+				pool_size = std::stoul(val);
+			else if(key == "record")
+				record = val;
+			else if(key == "replay")
+				replay = val;
+			else if(key == "name")
+				name = val;
+			else
+			{
+				BYTE op = 0;
+				while(op < Workload::WL_NUM_OPS && key != Workload::wl_op_name(op))
+					op++;
+				if(op == Workload::WL_NUM_OPS)
+					throw Workload::wl_error("Unknown setting \"" + arg + "\".\n" + USAGE);
+				if(!custom_mix)
+					std::fill(cfg.mix, cfg.mix + Workload::WL_NUM_OPS, 0);
+				custom_mix = true;
+				cfg.mix[op] = std::stod(val);
+			}
+		}
+		if(name.empty())
+			name = !replay.empty() ? "replay" : custom_mix ? "custom" : preset;
+	}
+	catch(const std::exception &e)
+	{
+		std::cerr << e.what() << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	/****************************************** LOAD AND RUN ***************************************/
+
+	int status = EXIT_SUCCESS;
+	try
+	{
+		std::vector<Workload::wl_op_t> ops;
+		if(!replay.empty())
+			Workload::wl_read_trace(replay, cfg, ops);
+		else
+			Workload::wl_generate(cfg, ops);
+		if(!record.empty())
+			Workload::wl_write_trace(record, cfg, ops);
+
+		Buffer_mgr::initialize(pool_size);
+		Table::tbl_format(db_name, Workload::wl_pages_needed(cfg, ops));
+		std::fstream dbfile(db_name, std::ios::in | std::ios::out | std::ios::binary);
+		if(!dbfile.is_open())
+			throw Workload::wl_error(std::string("Cannot open \"") + db_name + "\"");
+
+		double load_secs = Workload::wl_load(dbfile, cfg);
+		printf("{\"bench\": \"ycsb\", \"case\": \"%s_load\", \"ops\": %llu, \"seconds\": %.6f, \"ops_per_sec\": %.1f}\n",
+		       name.c_str(), (unsigned long long)cfg.records, load_secs, load_secs > 0 ? cfg.records / load_secs : 0.0);
+
+		Workload::wl_result_t res;
+		Io_stats::io_reset_stats();
+		Workload::wl_run(dbfile, cfg, ops, res);
+		Workload::wl_report(name, res);
+		printf("{\"bench\": \"ycsb\", \"case\": \"%s_io\", \"io\": %s}\n", name.c_str(),
+		       Io_stats::io_stats_json(Io_stats::io_stats()).c_str());
+
+		Buffer_mgr::shutdown(dbfile);
+		dbfile.close();
+	}
+	catch(const std::exception &e)
+	{
+		std::cerr << e.what() << std::endl;
+		status = EXIT_FAILURE;
+	}
+	return status;
+}